@@ -3,6 +3,7 @@
 
 #if defined(PANDA3DS_DYNAPICA_SUPPORTED) && (defined(PANDA3DS_X64_HOST) || defined(PANDA3DS_ARM64_HOST))
 #define PANDA3DS_SHADER_JIT_SUPPORTED
+#include <array>
 #include <memory>
 #include <unordered_map>
 
@@ -21,6 +22,17 @@ class ShaderJIT {
 	ShaderEmitter::InstructionCallback entrypointCallback;
 
 	ShaderCache cache;
+
+	// The programs prepared most recently, most recent first. Games tend to switch between a handful of vertex shaders every frame, so
+	// this saves going through the cache and looking up the entrypoint on every switch
+	struct RecentProgram {
+		Hash hash = 0;
+		u32 entrypoint = 0;
+		ShaderEmitter::PrologueCallback prologueCallback = nullptr;
+		ShaderEmitter::InstructionCallback entrypointCallback = nullptr;
+	};
+	static constexpr usize recentProgramCount = 4;
+	std::array<RecentProgram, recentProgramCount> recentPrograms{};
 #endif
 	bool accurateMul = false;
 
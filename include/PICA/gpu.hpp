@@ -1,11 +1,15 @@
 #pragma once
 #include <array>
+#include <span>
+#include <vector>
 
 #include "PICA/dynapica/shader_rec.hpp"
 #include "PICA/float_types.hpp"
+#include "PICA/gpu_thread.hpp"
 #include "PICA/pica_vertex.hpp"
 #include "PICA/regs.hpp"
 #include "PICA/shader_unit.hpp"
+#include "PICA/transfer_engine.hpp"
 #include "compiler_builtins.hpp"
 #include "config.hpp"
 #include "helpers.hpp"
@@ -45,6 +49,13 @@ class GPU {
 	uint immediateModeVertIndex;
 	uint immediateModeAttrIndex;  // Index of the immediate mode attribute we're uploading
 
+	// Output of drawArrays, sized to Renderer::vertexBufferSize in the constructor. Heap allocated, as GPUs can live on the stack
+	std::vector<PICA::Vertex> vertices;
+	// For indexed draws, vertices only holds every unique vertex once, and these index into it
+	std::vector<u16> vertexIndices;
+	// For hardware shaded draws, the shader input attributes of each vertex, one after another
+	std::vector<PICA::Vertex::vec4f> hwShaderInputs;
+
 	template <bool indexed, bool useShaderJIT>
 	void drawArrays();
 
@@ -79,6 +90,7 @@ class GPU {
 	u32* cmdBuffCurr = nullptr;
 
 	std::unique_ptr<Renderer> renderer;
+	PICA::TransferEngine transferEngine{*this};  // CPU fallback for renderers without a GPU path for transfers
 	PICA::Vertex getImmediateModeVertex();
 
   public:
@@ -95,10 +107,25 @@ class GPU {
 	bool fogLUTDirty = false;
 	std::array<uint32_t, 128> fogLUT;
 
+	// Bitmask of PICA::RegisterGroup flags. Set whenever a register in the group changes value, cleared by the renderer once it has
+	// re-derived the state of the dirty groups
+	u32 dirtyRegisterGroups = PICA::RegisterGroup::All;
+
 	GPU(Memory& mem, EmulatorConfig& config);
-	void display() { renderer->display(); }
-	void screenshot(const std::string& name) { renderer->screenshot(name); }
-	void deinitGraphicsContext() { renderer->deinitGraphicsContext(); }
+	void display() {
+		sync();
+		renderer->display();
+	}
+
+	void screenshot(const std::string& name) {
+		sync();
+		renderer->screenshot(name);
+	}
+
+	void deinitGraphicsContext() {
+		sync();
+		renderer->deinitGraphicsContext();
+	}
 
 #if defined(PANDA3DS_FRONTEND_SDL)
 	void initGraphicsContext(SDL_Window* window) { renderer->initGraphicsContext(window); }
@@ -108,6 +135,25 @@ class GPU {
 
 	void fireDMA(u32 dest, u32 source, u32 size);
 	void reset();
+	// The contents of VRAM are saved by Memory, whose state goes with the rest of the physical memory
+	void doState(SaveStateStream& stream);
+
+	// Runs a GX command queued by the GSP. Called from the GPU thread in asynchronous mode and from the emulator thread otherwise
+	void executeGXCommand(const PICA::GXCommand& command);
+
+	// Whether GX commands should be queued to the GPU thread instead of being run on the spot
+	bool isAsync() const { return asyncCommands; }
+	GPUThread& getCommandThread() { return commandThread; }
+	// Waits until the GPU thread is done with every queued command. Must be called before touching GPU state from the emulator thread
+	void sync() { commandThread.waitForIdle(); }
+
+	// Marks the VRAM in [paddr, paddr + size) as holding stale data because the renderer has newer data for it, or as being up to date again
+	void setVRAMGuard(u32 paddr, u32 size, bool guarded) { mem.setVRAMGuard(paddr, size, guarded); }
+	// Gets any newer data the renderer has for the VRAM in [paddr, paddr + size) into memory, before the CPU reads or partially overwrites it
+	void flushVRAM(u32 paddr, u32 size) { mem.flushVRAM(paddr, size); }
+	// Tells the save state code about FCRAM in [paddr, paddr + size) written by a transfer. Safe to call from the GPU thread
+	void markFCRAMDirty(u32 paddr, u32 size) { mem.markFCRAMDirtyFromGPU(paddr, size); }
+	PICA::TransferEngine& getTransferEngine() { return transferEngine; }
 
 	Registers& getRegisters() { return regs; }
 	ExternalRegisters& getExtRegisters() { return externalRegs; }
@@ -123,6 +169,9 @@ class GPU {
 	// Used when processing GPU command lists
 	u32 readInternalReg(u32 index);
 	void writeInternalReg(u32 index, u32 value, u32 mask);
+	// Fast path for writes of several words to one of the data ports games use for bulk uploads. Returns false if the write has to go
+	// through writeInternalReg one word at a time instead
+	bool writeInternalRegBlock(u32 index, u32 firstValue, std::span<const u32> values, bool consecutive);
 
 	// Used for setting the size of the window we'll be outputting graphics to
 	void setOutputSize(u32 width, u32 height) { renderer->setOutputSize(width, height); }
@@ -178,6 +227,10 @@ class GPU {
 	// Of the struct, instead of externalRegs being in the middle
 	ExternalRegisters externalRegs;
 
+	// Declared last so that the GPU thread is stopped before anything it uses is destroyed
+	bool asyncCommands = false;
+	GPUThread commandThread{*this};
+
 	ALWAYS_INLINE void setVsOutputMask(u32 val) {
 		val &= 0xffff;
 	
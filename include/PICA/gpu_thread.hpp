@@ -0,0 +1,82 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <thread>
+
+#include "helpers.hpp"
+
+class GPU;
+
+namespace PICA {
+	// A GX command as queued by the GSP. What the arguments mean depends on the type
+	struct GXCommand {
+		enum class Type : u8 {
+			CommandList,      // args: address, size
+			MemoryFill,       // args: start, end, value, control
+			DisplayTransfer,  // args: input address, output address, input size, output size, flags
+			TextureCopy,      // args: input address, output address, total bytes, input size, output size, flags
+			DMA,              // args: dest, source, size
+		};
+
+		Type type;
+		u8 tag;  // Handed back once the command has run, so that the GSP knows which interrupt to raise
+		std::array<u32, 6> args;
+	};
+}  // namespace PICA
+
+// Host worker thread that runs GX commands (command lists, memory fills, transfers and DMAs) off the emulator thread, so that vertex
+// processing and rendering overlap with the emulated CPU.
+// Commands go through a single-producer single-consumer ring without any locks: The emulator thread is the only one that submits and
+// collects finished commands, the worker the only one that executes them. Commands run in submission order.
+// The emulator thread has to call waitForIdle before touching any state the GPU thread uses, ie GPU registers, the renderer, or memory the
+// GPU might be writing to. The GSP does so at interrupts, FlushCacheRegions, register reads/writes and when displaying a frame.
+class GPUThread {
+  public:
+	static constexpr usize capacity = 256;  // Must be a power of 2
+
+  private:
+	GPU& gpu;
+	std::array<PICA::GXCommand, capacity> commands;
+
+	// A command's slot is only reused once it has been collected, so that the tag can still be read after the command has run
+	// submitted >= executed >= collected, and submitted - collected <= capacity
+	alignas(64) std::atomic<u64> submitted = 0;  // Written by the emulator thread
+	alignas(64) std::atomic<u64> executed = 0;   // Written by the GPU thread
+	u64 collected = 0;                           // Only touched by the emulator thread
+
+	std::atomic<u32> wakeups = 0;  // Bumped whenever the worker has something new to look at
+	std::atomic<bool> stopping = false;
+	std::thread worker;
+
+	void workerLoop();
+
+  public:
+	explicit GPUThread(GPU& gpu) : gpu(gpu) {}
+	~GPUThread();
+
+	bool isFull() const { return submitted.load(std::memory_order_relaxed) - collected == capacity; }
+	bool hasOutstanding() const { return submitted.load(std::memory_order_relaxed) != collected; }
+
+	// Queues a command. The ring must not be full
+	void submit(const PICA::GXCommand& command);
+
+	// Calls handler(tag) for every command that has finished since the last call, in submission order. Returns how many there were
+	template <typename Handler>
+	usize collect(Handler&& handler) {
+		const u64 end = executed.load(std::memory_order_acquire);
+		const usize count = usize(end - collected);
+
+		for (; collected != end; collected++) {
+			handler(commands[collected & (capacity - 1)].tag);
+		}
+
+		return count;
+	}
+
+	// Blocks until at least one outstanding command has finished. Returns immediately if there's none
+	void waitForCompletion();
+	// Blocks until every submitted command has finished. Finished commands still need to be collected
+	void waitForIdle();
+	// Waits for the queued work and drops the finished commands without reporting them. Used when the emulator resets
+	void reset();
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+#include "PICA/pica_hash.hpp"
+#include "PICA/regs.hpp"
+#include "helpers.hpp"
+
+namespace PICA {
+	// Config used for identifying unique hardware vertex shaders: The PICA program, and how its inputs and outputs are wired up.
+	// The uniforms aren't part of it, they're uploaded separately (See VertexUniforms)
+	struct VertexConfig {
+		PICAHash::HashType codeHash;
+		PICAHash::HashType opdescHash;
+		u64 inputMapping;  // Attribute i goes to input register (inputMapping >> (i * 4)) & 0xf
+		u32 entrypoint;
+		u32 inputCount;  // Number of attributes fed to the shader
+		u32 outputMask;  // Which output registers the shader writes out, in order
+		u32 outputCount;
+		std::array<u32, 7> outmaps;  // Which vertex fields each of the outputs' components go to
+		u32 padding = 0;             // Keeps the struct free of implicit padding, as it is hashed and compared bytewise
+
+		bool operator==(const VertexConfig& config) const {
+			// Hash function and equality operator required by std::unordered_map
+			return std::memcmp(this, &config, sizeof(VertexConfig)) == 0;
+		}
+
+		VertexConfig(
+			const std::array<u32, 0x300>& regs, PICAHash::HashType codeHash, PICAHash::HashType opdescHash, u32 entrypoint, u32 inputCount,
+			u64 inputMapping
+		)
+			: codeHash(codeHash), opdescHash(opdescHash), inputMapping(inputMapping), entrypoint(entrypoint), inputCount(inputCount) {
+			outputMask = regs[InternalRegs::VertexShaderOutputMask] & 0xffff;
+			outputCount = regs[InternalRegs::ShaderOutputCount] & 7;
+
+			for (u32 i = 0; i < outmaps.size(); i++) {
+				// Unused outmap registers can hold anything, so zero them to avoid generating duplicate shaders
+				outmaps[i] = (i < outputCount) ? regs[InternalRegs::ShaderOutmap0 + i] : 0;
+			}
+		}
+	};
+
+	// Uniforms of the hardware vertex shaders, laid out as a std140 uniform block
+	struct VertexUniforms {
+		using vec4 = std::array<float, 4>;
+		using uvec4 = std::array<u32, 4>;
+
+		alignas(16) std::array<vec4, 96> floats;
+		alignas(16) std::array<uvec4, 4> ints;  // Each of the 4 integer uniforms, one component per byte
+		u32 bools;
+		u32 padding[3];
+	};
+
+	static_assert(std::has_unique_object_representations<VertexConfig>());
+	static_assert(sizeof(VertexUniforms) == 96 * 16 + 4 * 16 + 16);
+}  // namespace PICA
+
+// Override std::hash for our vertex config class
+template <>
+struct std::hash<PICA::VertexConfig> {
+	std::size_t operator()(const PICA::VertexConfig& config) const noexcept { return PICAHash::computeHash((const char*)&config, sizeof(config)); }
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <array>
+
 #include "helpers.hpp"
 
 namespace PICA {
@@ -214,6 +216,59 @@ namespace PICA {
 		};
 	}
 
+	// Groups of internal registers that renderers derive a piece of host state from. The GPU flags a group as dirty whenever one of its
+	// registers changes value, so that a renderer only has to re-derive the state of the groups that changed since its last draw
+	namespace RegisterGroup {
+		enum : u32 {
+			Rasterizer = 1 << 0,    // Viewport, clipping, depth scale/offset and the shader output map
+			TextureUnits = 1 << 1,  // Texture unit config, addresses, dimensions and formats
+			TexEnv = 1 << 2,        // TEV stages and the TEV buffer
+			Fog = 1 << 3,
+			Blend = 1 << 4,  // Blending and logic ops
+			AlphaTest = 1 << 5,
+			Stencil = 1 << 6,
+			Depth = 1 << 7,  // Depth test and colour/depth write masks
+			Framebuffer = 1 << 8,
+			Lighting = 1 << 9,
+			Misc = 1 << 10,  // Every other register below the geometry pipeline registers
+
+			All = (1 << 11) - 1,
+		};
+
+		// Group of every internal register. The geometry pipeline and shader registers (0x200 onwards) are consumed by the GPU's vertex
+		// processing instead of the renderer, so they don't belong to any group
+		inline constexpr std::array<u16, 0x300> groups = [] {
+			using namespace InternalRegs;
+			std::array<u16, 0x300> ret{};
+
+			const auto setRange = [&](u32 first, u32 last, u16 group) {
+				for (u32 i = first; i <= last; i++) {
+					ret[i] = group;
+				}
+			};
+
+			setRange(0, 0x1FF, Misc);
+			setRange(0x40, 0x7F, Rasterizer);
+			setRange(TexUnitCfg, 0xBF, TextureUnits);
+			setRange(TexEnv0Source, 0xFF, TexEnv);
+			setRange(FogColor, FogLUTData7, Fog);
+			setRange(ColourOperation, BlendColour, Blend);
+			setRange(0x108, 0x11F, Framebuffer);
+			setRange(Light0Specular0, 0x1DF, Lighting);
+
+			ret[TexEnvUpdateBuffer] = TexEnv | Fog;  // Also holds the fog mode
+			ret[LightingEnable] = Lighting;
+			ret[AlphaTestConfig] = AlphaTest;
+			ret[StencilTest] = Stencil;
+			ret[StencilOp] = Stencil;
+			ret[DepthAndColorMask] = Depth;
+			ret[DepthBufferWrite] = Depth | Stencil;  // Gates stencil writes too
+			return ret;
+		}();
+
+		static constexpr u32 get(u32 index) { return index < groups.size() ? groups[index] : 0; }
+	}  // namespace RegisterGroup
+
 	namespace ExternalRegs {
 		enum : u32 {
 			MemFill1BufferStartPaddr = 0x3,
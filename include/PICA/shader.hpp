@@ -2,11 +2,18 @@
 #include <algorithm>
 #include <array>
 #include <cstring>
+#include <span>
 
 #include "PICA/float_types.hpp"
 #include "PICA/pica_hash.hpp"
 #include "helpers.hpp"
 
+namespace PICA::ShaderGen {
+	class ShaderDecompiler;
+}
+
+class SaveStateStream;
+
 enum class ShaderType {
 	Vertex,
 	Geometry,
@@ -127,9 +134,25 @@ class PICAShader {
 	bool codeHashDirty = false;
 	bool opdescHashDirty = false;
 
+	// Range of loadedShader words that changed since the code was last hashed, as [dirtyCodeBegin, dirtyCodeEnd)
+	u32 dirtyCodeBegin = 0;
+	u32 dirtyCodeEnd = 0;
+
+	// The code is hashed in fixed-size blocks, and the code hash is the hash of the block hashes. That way a partial upload only costs
+	// rehashing the blocks it touched, instead of the whole 16KB of program memory
+	static constexpr u32 codeBlockSize = 64;  // In words
+	std::array<Hash, 4096 / codeBlockSize> codeBlockHashes{};
+
+	void markCodeDirty(u32 begin, u32 end) {
+		dirtyCodeBegin = codeHashDirty ? std::min(dirtyCodeBegin, begin) : begin;
+		dirtyCodeEnd = codeHashDirty ? std::max(dirtyCodeEnd, end) : end;
+		codeHashDirty = true;  // Signal the JIT if necessary that the program hash has potentially changed
+	}
+
 	// Add these as friend classes for the JIT so it has access to all important state
 	friend class ShaderJIT;
 	friend class ShaderEmitter;
+	friend class PICA::ShaderGen::ShaderDecompiler;
 
 	vec4f getSource(u32 source);
 	vec4f& getDest(u32 dest);
@@ -231,10 +254,13 @@ class PICAShader {
 			Helpers::panic("o no, shader upload overflew");
 		}
 
-		loadedShader[bufferIndex++] = word;
-		bufferIndex &= 0xfff;
+		// Games often upload the same program again, which doesn't invalidate the code hash
+		if (loadedShader[bufferIndex] != word) {
+			loadedShader[bufferIndex] = word;
+			markCodeDirty(bufferIndex, bufferIndex + 1);
+		}
 
-		codeHashDirty = true;  // Signal the JIT if necessary that the program hash has potentially changed
+		bufferIndex = (bufferIndex + 1) & 0xfff;
 	}
 
 	void uploadDescriptor(u32 word) {
@@ -244,6 +270,11 @@ class PICAShader {
 		opdescHashDirty = true;  // Signal the JIT if necessary that the program hash has potentially changed
 	}
 
+	// Block versions of the upload functions, used by the command processor for long runs of writes to the same data port
+	void uploadWords(std::span<const u32> words);
+	void uploadDescriptors(std::span<const u32> words);
+	void uploadFloatUniforms(std::span<const u32> words);
+
 	void setFloatUniformIndex(u32 word) {
 		floatUniformIndex = word & 0xff;
 		floatUniformWordCount = 0;
@@ -288,6 +319,7 @@ class PICAShader {
 
 	void run();
 	void reset();
+	void doState(SaveStateStream& stream);
 
 	Hash getCodeHash();
 	Hash getOpdescHash();
@@ -0,0 +1,58 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "PICA/pica_vert_config.hpp"
+#include "PICA/shader.hpp"
+#include "PICA/shader_gen_types.hpp"
+#include "helpers.hpp"
+
+namespace PICA::ShaderGen {
+	// Translates a PICA vertex shader to a shader for the host GPU.
+	// PICA control flow (IF, LOOP, CALL, forward jumps and breaks) is mapped to structured GLSL control flow, with subroutines becoming
+	// functions. Programs whose control flow can't be mapped this way (eg backwards jumps or recursion) are rejected, and have to be run on the CPU
+	class ShaderDecompiler {
+		// A CALL target, ie a function spanning the instructions [start, end)
+		struct Function {
+			u32 start;
+			u32 end;
+			std::string body;
+		};
+
+		const PICAShader& shader;
+		const PICA::VertexConfig& config;
+		API api;
+		Language language;
+
+		std::vector<Function> functions;
+		std::vector<u32> callStack;  // Starts of the functions being compiled, to catch recursion
+		u32 loopDepth = 0;           // How many LOOP blocks deep we are in the current function
+		bool compilationError = false;
+
+		std::string getSource(u32 source, u32 index) const;
+		std::string getSwizzledSource(u32 sourceIndex, u32 source, u32 index, u32 operandDescriptor) const;
+		std::string getDest(u32 dest) const;
+		std::string getCondition(u32 instruction) const;
+		std::string getBoolUniform(u32 instruction) const;
+		std::string getFunctionName(u32 start, u32 end) const;
+		void setDest(std::string& shader, u32 operandDescriptor, const std::string& dest, const std::string& value);
+
+		// Compiles the instructions in [start, end) and returns where compilation stopped, which is end unless an END was reached first
+		u32 compileRange(std::string& shader, u32 start, u32 end);
+		// Compiles the instruction at pc and returns the pc of the next instruction to compile
+		u32 compileInstruction(std::string& shader, u32 pc, u32 end);
+		bool compileFunction(u32 start, u32 end);
+
+		void fail(const char* reason, u32 pc);
+
+	  public:
+		ShaderDecompiler(const PICAShader& shader, const PICA::VertexConfig& config, API api, Language language)
+			: shader(shader), config(config), api(api), language(language) {}
+
+		// Returns the code to paste into FragmentGenerator::getHwVertexShader, or nothing if the shader can't be translated
+		std::optional<std::string> decompile();
+	};
+
+	std::optional<std::string> decompileShader(const PICAShader& shader, const PICA::VertexConfig& config, API api, Language language);
+}  // namespace PICA::ShaderGen
@@ -1,9 +1,12 @@
 #pragma once
+#include <optional>
 #include <string>
 
 #include "PICA/gpu.hpp"
 #include "PICA/pica_frag_config.hpp"
+#include "PICA/pica_vert_config.hpp"
 #include "PICA/regs.hpp"
+#include "PICA/shader.hpp"
 #include "PICA/shader_gen_types.hpp"
 #include "helpers.hpp"
 
@@ -25,11 +28,15 @@ namespace PICA::ShaderGen {
 		bool isSamplerEnabled(u32 environmentID, u32 lutID);
 
 		void compileFog(std::string& shader, const PICA::FragmentConfig& config);
+		// Wraps the code that sets up the vertex fields (a_coords etc) into a full vertex shader
+		std::string getVertexShader(const std::string& vertexSource);
 
 	  public:
 		FragmentGenerator(API api, Language language) : api(api), language(language) {}
 		std::string generate(const PICA::FragmentConfig& config);
 		std::string getDefaultVertexShader();
+		// Vertex shader running the PICA vertex shader on the host GPU, or nothing if the PICA shader can't be translated
+		std::optional<std::string> getHwVertexShader(const PICAShader& shader, const PICA::VertexConfig& config);
 
 		void setTarget(API api, Language language) {
 			this->api = api;
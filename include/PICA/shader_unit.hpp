@@ -9,4 +9,9 @@ public:
 
 	ShaderUnit() : vs(ShaderType::Vertex), gs(ShaderType::Geometry) {}
 	void reset();
+
+	void doState(SaveStateStream& stream) {
+		vs.doState(stream);
+		gs.doState(stream);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PICA/regs.hpp"
+#include "helpers.hpp"
+
+class GPU;
+
+namespace PICA {
+	// CPU implementation of the PICA transfer engine, running display transfers and texture copies directly on emulated VRAM and FCRAM.
+	// Renderers without a GPU path for a transfer fall back to this, which also gives headless runs correct framebuffers.
+	// Big display transfers are split into bands of rows which are converted in parallel by a small pool of worker threads
+	class TransferEngine {
+		GPU& gpu;
+
+		// Row-parallel execution. The workers are only started once a transfer big enough to need them comes along
+		using RowJob = std::function<void(u32 firstRow, u32 lastRow)>;
+		std::vector<std::thread> workers;
+		std::mutex jobMutex;
+		std::condition_variable jobReady;
+		std::condition_variable jobDone;
+		const RowJob* job = nullptr;
+		u32 jobRows = 0;
+		u32 jobBandRows = 0;
+		u32 pendingWorkers = 0;
+		u64 jobGeneration = 0;
+		bool workersStarted = false;
+		bool stopping = false;
+
+		void startWorkers();
+		void workerLoop(u32 band);
+		// Runs job over the rows [0, rows), splitting them across the workers if the transfer touches enough memory to be worth it
+		void forEachRowBand(u32 rows, usize bytes, const RowJob& job);
+
+		// Returns a pointer to the transfer range [paddr, paddr + size), or nullptr if it's not fully inside FCRAM or VRAM
+		u8* getPointer(u32 paddr, u32 size);
+
+	  public:
+		TransferEngine(GPU& gpu) : gpu(gpu) {}
+		~TransferEngine();
+
+		// The transfer engine numbers colour formats differently from the framebuffer registers, with RGB565 and RGBA5551 swapped
+		static ColorFmt toColorFmt(u32 format) {
+			switch (format) {
+				case 2: return ColorFmt::RGB565;
+				case 3: return ColorFmt::RGBA5551;
+				default: return static_cast<ColorFmt>(format);
+			}
+		}
+
+		void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags);
+		void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags);
+	};
+}  // namespace PICA
@@ -18,6 +18,7 @@ namespace Applets {
 	  public:
 		AppletManager(Memory& mem);
 		void reset();
+		void doState(SaveStateStream& stream);
 		AppletBase* getApplet(u32 id);
 
 		Applets::Parameter glanceParameter();
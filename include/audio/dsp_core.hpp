@@ -14,6 +14,7 @@
 // The DSP core must have access to the DSP service to be able to trigger interrupts properly
 class DSPService;
 class Memory;
+class SaveStateStream;
 
 namespace Audio {
 	// There are 160 stereo samples in 1 audio frame, so 320 samples total
@@ -54,6 +55,8 @@ namespace Audio {
 		virtual void loadComponent(std::vector<u8>& data, u32 programMask, u32 dataMask) = 0;
 		virtual void unloadComponent() = 0;
 		virtual void setSemaphoreMask(u16 value) = 0;
+		// Save or load the state of the core. DSP RAM isn't included, as it's saved along with the rest of memory
+		virtual void doState(SaveStateStream& stream) = 0;
 
 		static Audio::DSPCore::Type typeFromString(std::string inString);
 		static const char* typeToString(Audio::DSPCore::Type type);
@@ -74,6 +74,7 @@ namespace Audio {
 		int index = 0;  // Index of the voice in [0, 23] for debugging
 
 		void reset();
+		void doState(SaveStateStream& stream);
 
 		// Push a buffer to the buffer queue
 		void pushBuffer(const Buffer& buffer) { buffers.push(buffer); }
@@ -198,6 +199,7 @@ namespace Audio {
 		void unloadComponent() override;
 		void setSemaphore(u16 value) override {}
 		void setSemaphoreMask(u16 value) override {}
+		void doState(SaveStateStream& stream) override;
 	};
 
 }  // namespace Audio
@@ -41,6 +41,7 @@ namespace Audio {
 		void unloadComponent() override;
 		void setSemaphore(u16 value) override {}
 		void setSemaphoreMask(u16 value) override {}
+		void doState(SaveStateStream& stream) override;
 	};
 
 }  // namespace Audio
\ No newline at end of file
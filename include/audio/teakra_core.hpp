@@ -100,5 +100,6 @@ namespace Audio {
 		std::vector<u8> readPipe(u32 channel, u32 peer, u32 size, u32 buffer) override;
 		void loadComponent(std::vector<u8>& data, u32 programMask, u32 dataMask) override;
 		void unloadComponent() override;
+		void doState(SaveStateStream& stream) override;
 	};
 }  // namespace Audio
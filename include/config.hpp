@@ -30,9 +30,36 @@ struct EmulatorConfig {
 	bool forceShadergenForLights = true;
 	int lightShadergenThreshold = 1;
 
+	// Run PICA vertex shaders on the host GPU when the renderer supports it and the shader can be translated, instead of on the CPU
+	bool hwShaderEnabled = false;
+
+	// Run GX commands on a host thread, overlapping them with the emulated CPU. Only the software and null renderers support it for now.
+	// The OpenGL and Vulkan renderers record GPU work on the emulator thread, so this does nothing with them
+	bool asyncGPU = false;
+	// Present frames from a thread of their own, so that waiting for vsync doesn't hold up emulation. Emulation is then paced by the frame
+	// limiter instead. Only used with renderers and frontends that support it
+	bool threadedPresentation = true;
+	// Emulation speed relative to the console when frames are presented on their own thread, and the speed fast-forwarding runs at.
+	// 0 runs uncapped
+	float emulationSpeed = 1.0f;
+	float turboSpeed = 4.0f;
+
 	RendererType rendererType = RendererType::OpenGL;
 	Audio::DSPCore::Type dspType = Audio::DSPCore::Type::Null;
 
+	// Run guest file reads and writes on a host thread, blocking only the requesting guest thread instead of the whole emulator
+	bool asyncFileIO = true;
+	// Fast-forward to the next scheduler event when the guest is spinning in a loop that only polls memory
+	bool skipIdleLoops = true;
+	// Replace the guest's memcpy, memset and friends with native versions, in executables that still have their symbol table
+	bool hleLibcHooks = true;
+	// Frames to run ahead of the displayed one to hide the game's own input lag. 0 disables run-ahead. Every frame of run-ahead costs a
+	// save state restore and a full extra emulated frame, so this should be no more than the frames of lag the game has
+	int runAheadFrames = 0;
+	static constexpr int maxRunAheadFrames = 4;
+	// Count and time every IPC request the guest makes, per service and command. Can also be toggled at runtime from Lua
+	bool profileIPC = false;
+
 	bool sdCardInserted = true;
 	bool sdWriteProtected = false;
 	bool usePortableBuild = false;
@@ -49,6 +76,8 @@ struct EmulatorConfig {
 	std::filesystem::path filePath;
 
 	EmulatorConfig(const std::filesystem::path& path);
+	// A config with every setting at its default that isn't backed by a file, for emulators created by code rather than by the user
+	EmulatorConfig() = default;
 	void load();
 	void save();
 };
@@ -7,6 +7,7 @@
 #include "dynarmic/interface/exclusive_monitor.h"
 #include "dynarmic_cp15.hpp"
 #include "helpers.hpp"
+#include "idle_loop_detector.hpp"
 #include "kernel.hpp"
 #include "memory.hpp"
 #include "scheduler.hpp"
@@ -17,6 +18,7 @@ class CPU;
 class MyEnvironment final : public Dynarmic::A32::UserCallbacks {
   public:
 	u64 ticksLeft = 0;
+	u64 sideEffectCount = 0;  // Number of memory writes and SVCs so far, which tells the idle loop detector whether a loop is read-only
 	Memory& mem;
 	Kernel& kernel;
 	Scheduler& scheduler;
@@ -40,24 +42,29 @@ class MyEnvironment final : public Dynarmic::A32::UserCallbacks {
     }
 
     void MemoryWrite8(u32 vaddr, u8 value) override {
+        sideEffectCount++;
         mem.write8(vaddr, value);
     }
 
     void MemoryWrite16(u32 vaddr, u16 value) override {
+        sideEffectCount++;
         mem.write16(vaddr, value);
     }
 
     void MemoryWrite32(u32 vaddr, u32 value) override {
+        sideEffectCount++;
         mem.write32(vaddr, value);
     }
 
     void MemoryWrite64(u32 vaddr, u64 value) override {
+        sideEffectCount++;
         mem.write64(vaddr, value);
     }
 
     #define makeExclusiveWriteHandler(size) \
     bool MemoryWriteExclusive##size(u32 vaddr, u##size value, u##size expected) override { \
         u##size current = mem.read##size(vaddr); /* Get current value */                   \
+        sideEffectCount++;                                                                 \
         if (current == expected) {   /* Perform the write if current == expected */        \
             mem.write##size(vaddr, value);                                                 \
             return true; /* Exclusive write succeeded */                                   \
@@ -79,6 +86,7 @@ class MyEnvironment final : public Dynarmic::A32::UserCallbacks {
     }
 
 	void CallSVC(u32 swi) override {
+		sideEffectCount++;
 		kernel.serviceSVC(swi);
 	}
 
@@ -123,6 +131,13 @@ class CPU {
 	Memory& mem;
 	Scheduler& scheduler;
 	Emulator& emu;
+	IdleLoopDetector idleLoopDetector;
+
+	// Changes every time the JIT cache is cleared because guest code changed, eg when a CRO is loaded. Save states store it, so that
+	// restoring one only throws away the JIT cache if the code could be different. Generations are never reused, even when a state takes
+	// us back to an older one
+	u64 cacheGeneration = 0;
+	u64 lastCacheGeneration = 0;
 
   public:
     static constexpr u64 ticksPerSec = Scheduler::arm11Clock;
@@ -180,6 +195,11 @@ class CPU {
 
     void addTicks(u64 ticks) { env.AddTicks(ticks); }
 
-    void clearCache() { jit->ClearCache(); }
+    void clearCache() {
+        jit->ClearCache();
+        cacheGeneration = ++lastCacheGeneration;
+    }
+
     void runFrame();
+    void doState(SaveStateStream& stream);
 };
\ No newline at end of file
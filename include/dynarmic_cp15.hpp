@@ -66,6 +66,10 @@ public:
         threadStoragePointer = value;
     }
 
+    u32 getTLSBase() const {
+        return threadStoragePointer;
+    }
+
     // Currently does nothing but may be needed in the future
     void reset() {}
 };
\ No newline at end of file
@@ -18,6 +18,7 @@
 #include "io_file.hpp"
 #include "lua_manager.hpp"
 #include "memory.hpp"
+#include "savestate.hpp"
 #include "scheduler.hpp"
 
 #ifdef PANDA3DS_ENABLE_HTTP_SERVER
@@ -77,6 +78,23 @@ class Emulator {
 	std::optional<std::filesystem::path> romPath = std::nullopt;
 	LuaManager lua;
 
+	// Index of the loaded ROM's RomFS, built once when the ROM is loaded. Left empty if the ROM has no RomFS
+	RomFS::Index romFSIndex;
+	void buildRomFSIndex();
+
+	// Gets every host thread that works on emulated state (GPU thread, file I/O) to a stop, so that the state can be saved or replaced.
+	// Optionally also has the renderer write what it drew back to VRAM, which any state that's saved or restored needs, and commits save data
+	void prepareForSaveState(bool writeBackVRAM = true, bool commitSaveData = true);
+	// Everything but FCRAM, which is saved separately as it's the bulk of the state
+	void doState(SaveStateStream& stream);
+
+	void runEmulatedFrame();
+	// Runs config.runAheadFrames frames past the real one and displays the last, then goes back to the real one
+	void runAhead();
+	bool runAheadWarned = false;
+	// Set if going back to the real frame failed once. Kept apart from the config, so that saving it doesn't turn run-ahead off for good
+	bool runAheadDisabled = false;
+
   public:
 	// Decides whether to reload or not reload the ROM when resetting. We use enum class over a plain bool for clarity.
 	// If NoReload is selected, the emulator will not reload its selected ROM. This is useful for things like booting up the emulator, or resetting to
@@ -87,6 +105,9 @@ class Emulator {
 	bool frameDone = false;
 
 	Emulator();
+	// Creates an emulator with the given settings instead of the ones in the config file. Any number of emulators can exist at once, each
+	// driven from its own thread, which is what tests and tools running several games side by side rely on
+	explicit Emulator(const EmulatorConfig& emulatorConfig);
 	~Emulator();
 
 	void step();
@@ -114,13 +135,22 @@ class Emulator {
 	void initGraphicsContext(SDL_Window* window) { gpu.initGraphicsContext(window); }
 #endif
 
-	RomFS::DumpingResult dumpRomFS(const std::filesystem::path& path);
+	// Extracts the RomFS of the loaded ROM to a folder on a pool of threads. The progress callback receives (bytes written, total bytes)
+	RomFS::DumpingResult dumpRomFS(const std::filesystem::path& path, const RomFS::ProgressCallback& progress = {});
+	// Reads from the RomFS of the loaded ROM, decrypting it if needed. The offset is relative to the start of the RomFS
+	// The overload taking a file reads through that handle to the ROM instead of the one the emulator uses, for reading from other threads
+	bool readRomFS(u64 offset, void* dst, u64 size);
+	bool readRomFS(IOFile& file, u64 offset, void* dst, u64 size);
+	std::optional<u64> getRomFSSize();
+	const RomFS::Index& getRomFSIndex() const { return romFSIndex; }
 	void setOutputSize(u32 width, u32 height) { gpu.setOutputSize(width, height); }
 	void deinitGraphicsContext() { gpu.deinitGraphicsContext(); }
 
 	EmulatorConfig& getConfig() { return config; }
 	Cheats& getCheats() { return cheats; }
+	Kernel& getKernel() { return kernel; }
 	ServiceManager& getServiceManager() { return kernel.getServiceManager(); }
+	IPCProfiler& getIPCProfiler() { return kernel.getIPCProfiler(); }
 	LuaManager& getLua() { return lua; }
 	Scheduler& getScheduler() { return scheduler; }
 	Memory& getMemory() { return memory; }
@@ -135,4 +165,31 @@ class Emulator {
 	std::filesystem::path getAppDataRoot();
 
 	std::span<u8> getSMDH();
+
+	// In-memory snapshot, for rewinding and for going back to checkpoints. FCRAM is stored as the pages that changed since a keyframe that
+	// snapshots share, so taking one costs a copy of the dirty pages instead of all of FCRAM
+	struct Snapshot {
+		std::vector<u8> state;
+		Memory::FCRAMSnapshot fcram;
+	};
+
+	// Run-ahead snapshots are restored a few frames after they're taken, from frames that never touched the host (see runAhead). They skip
+	// the save data commit, and restoring one keeps the renderer's caches. VRAM is still written back, so that no surface holds newer data
+	// than the VRAM in the snapshot
+	enum class SnapshotKind { Full, RunAhead };
+
+	void takeSnapshot(Snapshot& snapshot, SnapshotKind kind = SnapshotKind::Full);
+	bool restoreSnapshot(const Snapshot& snapshot, SnapshotKind kind = SnapshotKind::Full);
+
+  private:
+	// State of the real frame while run-ahead shows a speculative one. Kept around so its buffers are reused from frame to frame
+	Snapshot runAheadSnapshot;
+
+  public:
+
+	// Self-contained save states, which can be written to disk and loaded by a later run of the same game
+	void saveState(std::vector<u8>& output);
+	bool loadState(std::span<const u8> input);
+	// Upper bound for the size of a state from saveState, for frontends that need to know the size up front
+	usize getSaveStateSize();
 };
@@ -0,0 +1,32 @@
+#pragma once
+#include <chrono>
+
+#include "helpers.hpp"
+
+// Paces the emulator thread to the frame rate of the console, or a multiple of it for fast-forwarding.
+// Waits sleep for most of the time and spin for the rest, as OS sleeps can overshoot by a millisecond or more, which is enough to make
+// frame times visibly uneven
+class FrameLimiter {
+	using Clock = std::chrono::steady_clock;
+
+	Clock::time_point nextFrame;
+	Clock::duration frameTime;
+	double speed = 1.0;
+	bool started = false;
+
+  public:
+	// VBlanks per second on the 3DS, which is how often games produce a frame
+	static constexpr double refreshRate = 60.0;
+
+	FrameLimiter() { setSpeed(1.0); }
+
+	// Speed relative to the console, eg 4.0 runs 4 frames in the time of one. 0 runs uncapped
+	void setSpeed(double multiplier);
+	double getSpeed() const { return speed; }
+
+	// Forgets about the frames run so far, for after a pause, so that the limiter doesn't try to make up for the lost time
+	void reset() { started = false; }
+
+	// Waits until it's time to run the next frame
+	void wait();
+};
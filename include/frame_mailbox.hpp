@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "helpers.hpp"
+
+// Triple-buffered mailbox for handing finished frames from the emulator thread to the presentation thread.
+// The producer always has a slot of its own to render into and the consumer always has the newest finished frame, so neither side ever waits
+// for the other: frames the consumer doesn't get to in time are replaced by newer ones. The mailbox only passes slot indices around, the
+// frames themselves are kept by whoever uses it
+class FrameMailbox {
+  public:
+	static constexpr u32 slotCount = 3;
+
+  private:
+	static constexpr u32 slotMask = 0x3;
+	static constexpr u32 freshBit = 0x4;  // Set while the shared slot holds a frame the consumer hasn't taken yet
+
+	u32 producerSlot = 0;             // Only touched by the producer
+	u32 consumerSlot = 1;             // Only touched by the consumer
+	std::atomic<u32> sharedSlot = 2;  // Slot in between the two, plus freshBit
+
+	std::mutex waitMutex;
+	std::condition_variable frameReady;
+
+  public:
+	// Slot the producer renders the next frame into
+	u32 getProducerSlot() const { return producerSlot; }
+	// Slot holding the frame the consumer took last
+	u32 getConsumerSlot() const { return consumerSlot; }
+
+	// Hands the frame in the producer slot over to the consumer, replacing the previous one if it wasn't taken, and gets a new producer slot
+	void publish() {
+		producerSlot = sharedSlot.exchange(producerSlot | freshBit, std::memory_order_acq_rel) & slotMask;
+
+		// Taking the lock makes sure a consumer that just found no frame is already waiting when we notify it
+		{ std::scoped_lock lock(waitMutex); }
+		frameReady.notify_one();
+	}
+
+	// Takes the newest published frame into the consumer slot. Returns false if nothing was published since the last call
+	bool consume() {
+		if ((sharedSlot.load(std::memory_order_relaxed) & freshBit) == 0) {
+			return false;
+		}
+
+		consumerSlot = sharedSlot.exchange(consumerSlot, std::memory_order_acq_rel) & slotMask;
+		return true;
+	}
+
+	// Blocks the consumer until there's a frame to take or the timeout runs out. Returns whether there's a frame
+	bool waitForFrame(std::chrono::microseconds timeout) {
+		std::unique_lock lock(waitMutex);
+		return frameReady.wait_for(lock, timeout, [&]() { return (sharedSlot.load(std::memory_order_acquire) & freshBit) != 0; });
+	}
+};
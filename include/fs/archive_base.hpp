@@ -7,7 +7,9 @@
 #include <string>
 #include <type_traits>
 #include <vector>
+#include "fs/write_back_cache.hpp"
 #include "helpers.hpp"
+#include "io_file.hpp"
 #include "memory.hpp"
 #include "result.hpp"
 #include "result/result.hpp"
@@ -103,6 +105,7 @@ struct FileSession {
     FSPath path;
     FSPath archivePath;
     u32 priority = 0; // TODO: What does this even do
+    u32 openFlags = 0; // The flags the file was opened with, so that save states can reopen it
     bool isOpen;
 
     FileSession(ArchiveBase* archive, const FSPath& filePath, const FSPath& archivePath, FILE* fd, bool isOpen = true) :
@@ -110,7 +113,7 @@ struct FileSession {
 
     // For cloning a file session
     FileSession(const FileSession& other) : archive(other.archive), path(other.path),
-        archivePath(other.archivePath), fd(other.fd), isOpen(other.isOpen), priority(other.priority) {}
+        archivePath(other.archivePath), fd(other.fd), isOpen(other.isOpen), priority(other.priority), openFlags(other.openFlags) {}
 };
 
 struct ArchiveSession {
@@ -149,6 +152,11 @@ struct DirectorySession {
 			entries.push_back(entry);
 		}
 	}
+
+	// For restoring a directory session from a save state, without looking at the host directory again
+	DirectorySession(ArchiveBase* archive, std::optional<std::filesystem::path> pathOnDisk, std::vector<DirectoryEntry> entries, size_t currentEntry,
+					 bool isOpen)
+		: archive(archive), pathOnDisk(std::move(pathOnDisk)), entries(std::move(entries)), currentEntry(currentEntry), isOpen(isOpen) {}
 };
 
 // Represents a file descriptor obtained from OpenFile. If the optional is nullopt, opening the file failed.
@@ -170,6 +178,25 @@ protected:
     static constexpr FileDescriptor NoFile = nullptr;
     static constexpr FileDescriptor FileError = std::nullopt;
     Memory& mem;
+    // Write-back cache for archives whose files are written by the guest. nullptr for archives that write straight to the host
+    WriteBackCache* writeBackCache = nullptr;
+    // Directory holding the host files of the running title. Owned by the FS service, so that every emulator instance has its own
+    const std::filesystem::path* appDataPath = nullptr;
+
+    const std::filesystem::path& getAppData() const { return *appDataPath; }
+
+    // Opens the host file backing a guest file session, registering it with the write-back cache if the archive uses one
+    FileDescriptor openHostFile(const std::filesystem::path& path, const char* permissions) {
+        IOFile file(path, permissions);
+        if (!file.isOpen()) {
+            return FileError;
+        }
+
+        if (writeBackCache != nullptr) {
+            writeBackCache->track(file.getHandle(), path);
+        }
+        return file.getHandle();
+    }
 
     // Returns if a specified 3DS path in UTF16 or ASCII format is safe or not
     // A 3DS path is considered safe if its first character is '/' which means we're not trying to access anything outside the root of the fs
@@ -255,6 +282,14 @@ public:
     // Returns the number of bytes read, or nullopt if the read failed
     virtual std::optional<u32> readFile(FileSession* file, u64 offset, u32 size, u32 dataPointer) = 0;
 
+    // Same as readFile but into a host buffer, for archives without file descriptors that can be read off the emulator thread.
+    // Implementations may be called from the kernel's I/O thread, so they must not touch emulated memory
+    virtual bool supportsHostReads() { return false; }
+    virtual std::optional<u32> readFileToHost(FileSession* file, u64 offset, u32 size, u8* buffer) { return std::nullopt; }
+
+    void setWriteBackCache(WriteBackCache* cache) { writeBackCache = cache; }
+    void setAppDataPath(const std::filesystem::path* path) { appDataPath = path; }
+
     ArchiveBase(Memory& mem) : mem(mem) {}
 };
 
@@ -21,7 +21,7 @@ public:
 	Rust::Result<FormatInfo, HorizonResult> getFormatInfo(const FSPath& path) override;
 
 	std::filesystem::path getFormatInfoPath() {
-		return IOFile::getAppData() / "FormatInfo" / "SaveData.format";
+		return getAppData() / "FormatInfo" / "SaveData.format";
 	}
 
 	// Returns whether the cart has save data or not
@@ -2,6 +2,9 @@
 #include "archive_base.hpp"
 
 class SelfNCCHArchive : public ArchiveBase {
+	// Reads from the ROM through the emulator thread's handle, or the I/O thread's one if "ioThread" is set
+	std::optional<u32> readROM(FileSession* file, u64 offset, u32 size, u8* buffer, bool ioThread);
+
 public:
 	SelfNCCHArchive(Memory& mem) : ArchiveBase(mem) {}
 
@@ -15,6 +18,9 @@ public:
 	FileDescriptor openFile(const FSPath& path, const FilePerms& perms) override;
 	std::optional<u32> readFile(FileSession* file, u64 offset, u32 size, u32 dataPointer) override;
 
+	bool supportsHostReads() override { return true; }
+	std::optional<u32> readFileToHost(FileSession* file, u64 offset, u32 size, u8* buffer) override;
+
 	// Returns whether the cart has a RomFS
 	bool hasRomFS() {
 		auto cxi = mem.getCXI();
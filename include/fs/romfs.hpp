@@ -1,23 +1,15 @@
 #pragma once
-#include <memory>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "helpers.hpp"
 
 namespace RomFS {
-	struct RomFSNode {
-		std::u16string name;
-		// The file/directory offset relative to the start of the RomFS
-		u64 metadataOffset = 0;
-		u64 dataOffset = 0;
-		u64 dataSize = 0;
-		bool isDirectory = false;
-
-		std::vector<std::unique_ptr<RomFSNode>> directories;
-		std::vector<std::unique_ptr<RomFSNode>> files;
-	};
-
 	// Result codes when dumping RomFS. These are used by the frontend to print appropriate error messages if RomFS dumping fails
 	enum class DumpingResult {
 		Success = 0,
@@ -25,5 +17,80 @@ namespace RomFS {
 		NoRomFS = 2
 	};
 
-	std::unique_ptr<RomFSNode> parseRomFSTree(uintptr_t romFS, u64 romFSSize);
-}  // namespace RomFS
\ No newline at end of file
+	// Reads "size" bytes at "offset" from the start of the RomFS (ie the IVFC header) into dst. Returns false on failure
+	using ReadCallback = std::function<bool(u64 offset, void* dst, u64 size)>;
+
+	static constexpr u32 invalidEntry = 0xFFFFFFFF;
+
+	// All links between entries are indices into the index's directory/file arrays, or invalidEntry
+	struct DirectoryEntry {
+		u32 parent;          // The root directory is its own parent
+		u32 nextSibling;     // Next directory with the same parent
+		u32 firstDirectory;  // First child directory
+		u32 firstFile;       // First file in this directory
+		u32 nextInBucket;    // Next directory in the same hash bucket
+		u32 metadataOffset;  // Offset of the entry in the on-disk metadata, which is what the RomFS path hash is keyed on
+		u32 nameOffset;      // Offset of the name in the name pool, in characters
+		u32 nameLength;      // In characters
+	};
+
+	struct FileEntry {
+		u64 dataOffset;  // Offset of the file data from the start of the RomFS
+		u64 dataSize;
+		u32 parent;
+		u32 nextSibling;   // Next file in the same directory
+		u32 nextInBucket;  // Next file in the same hash bucket
+		u32 nameOffset;
+		u32 nameLength;
+	};
+
+	// Flat index of a RomFS' directory tree, built once from the level 3 metadata when a ROM is loaded.
+	// Directories and files live in contiguous arrays, names are interned in a single pool, and lookups go through the same hash buckets
+	// as the on-disk RomFS hash tables, so resolving a path costs one hash probe per component.
+	class Index {
+		std::vector<DirectoryEntry> directories;
+		std::vector<FileEntry> files;
+		std::u16string names;
+		std::vector<u32> directoryBuckets;
+		std::vector<u32> fileBuckets;
+
+		bool isTree() const;
+
+	  public:
+		static constexpr u32 rootDirectory = 0;
+
+		// Parses the RomFS metadata. Returns false and leaves the index empty if the RomFS is malformed.
+		// A successfully built index is guaranteed to be a tree, so walking it through the child/sibling links always terminates
+		bool build(const ReadCallback& read, u64 romFSSize);
+		void clear();
+		bool isValid() const { return !directories.empty(); }
+
+		std::span<const DirectoryEntry> getDirectories() const { return directories; }
+		std::span<const FileEntry> getFiles() const { return files; }
+		const DirectoryEntry& getDirectory(u32 index) const { return directories[index]; }
+		const FileEntry& getFile(u32 index) const { return files[index]; }
+
+		std::u16string_view getName(const DirectoryEntry& entry) const { return std::u16string_view(names).substr(entry.nameOffset, entry.nameLength); }
+		std::u16string_view getName(const FileEntry& entry) const { return std::u16string_view(names).substr(entry.nameOffset, entry.nameLength); }
+
+		// Looks up a single path component inside a directory
+		std::optional<u32> findDirectory(u32 parent, std::u16string_view name) const;
+		std::optional<u32> findFile(u32 parent, std::u16string_view name) const;
+		// Resolves a '/'-separated path relative to the RomFS root, eg u"/data/sound/bgm.bcstm"
+		std::optional<u32> findDirectory(std::u16string_view path) const;
+		std::optional<u32> findFile(std::u16string_view path) const;
+
+		// The hash function used by the on-disk RomFS hash tables
+		static u32 hashName(u32 parentMetadataOffset, std::u16string_view name);
+	};
+
+	// Creates a reader with its own file handle, so that every extraction thread can read without fighting over a file position.
+	// Returns an empty callback on failure
+	using ReaderFactory = std::function<ReadCallback()>;
+	// Receives (bytes written, total bytes). Always called from the thread that called extract
+	using ProgressCallback = std::function<void(u64, u64)>;
+
+	// Extracts every file in the index to outputPath, streaming each file's range in fixed-size chunks on a pool of threads, so memory use
+	// stays bounded no matter how big the RomFS is. Returns false if any file failed to extract
+	bool extract(const Index& index, const ReaderFactory& openReader, const std::filesystem::path& outputPath, const ProgressCallback& progress = {});
+}  // namespace RomFS
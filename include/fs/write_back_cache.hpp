@@ -0,0 +1,99 @@
+#pragma once
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "helpers.hpp"
+#include "io_file.hpp"
+
+// Page-granular write-back cache for the writable archives (SaveData, ExtSaveData, SDMC)
+// Guest writes land in dirty pages in host memory and are committed to the host file in one batch: from a timer, when an archive is
+// closed, or when the emulator shuts down. Games that stream lots of tiny save writes thus only hit the host filesystem once per flush.
+//
+// Commits are crash-safe. The dirty pages are first written to a journal next to the file, which is then renamed to its final name. The
+// rename is the commit point. Only after that are the pages written into the file itself, and the journal is deleted. If the emulator dies
+// half-way, a complete journal is replayed the next time the file is opened, while a partial one that never got renamed is thrown away.
+//
+// Guest file sessions keep the FILE* the archive opened, but it's only used as a key into the cache. All I/O goes through the cache's own
+// handle to the file, so that data written through one session is visible through every other session on the same file.
+// Every method may be called concurrently from the emulator thread and the kernel's I/O thread.
+class WriteBackCache {
+  public:
+	static constexpr u64 pageSize = 0x1000;
+
+  private:
+	using Page = std::array<u8, pageSize>;
+	using PageMap = std::map<u64, std::unique_ptr<Page>>;  // Keyed by page index, ordered so that commits write files front to back
+
+	struct CachedFile {
+		std::filesystem::path path;
+		IOFile file;
+
+		u64 size = 0;       // Size of the file as seen by the guest, including unflushed writes
+		u64 hostSize = 0;   // Size of the file on the host
+		u64 validSize = 0;  // How many bytes of the host file are still valid. Smaller than hostSize if the guest shrunk the file
+		PageMap dirtyPages;
+		usize sessions = 0;  // How many guest sessions have this file open
+
+		bool isDirty() const { return !dirtyPages.empty() || size != hostSize || validSize != hostSize; }
+	};
+
+	// What a file looked like before its first change in a speculative run, to go back to when the run ends
+	struct FileBackup {
+		u64 size;
+		u64 validSize;
+		PageMap dirtyPages;
+	};
+
+	std::mutex mutex;
+	std::map<std::filesystem::path, std::unique_ptr<CachedFile>> files;
+	std::unordered_map<FILE*, CachedFile*> handles;
+
+	bool speculating = false;
+	std::unordered_map<CachedFile*, FileBackup> backups;
+
+	CachedFile* getFile(FILE* fd);
+	// Called before every change to a file, to back it up if this is its first change since the speculative run started
+	void backUp(CachedFile& file);
+	// Restores the backups and ends the speculative run
+	void rollBack();
+	bool readClean(CachedFile& file, u64 offset, u8* dst, u64 size);
+	bool commit(CachedFile& file);
+	bool flushLocked();
+
+	// Writes a set of pages to a file: Truncates it to validSize, writes the pages, then resizes it to finalSize
+	static bool applyPages(IOFile& file, u64 validSize, u64 finalSize, const PageMap& pages);
+	// Replays or discards a journal left behind by a commit that was interrupted
+	static void recoverJournal(const std::filesystem::path& path);
+
+  public:
+	~WriteBackCache();
+
+	// Registers a host file an archive just opened for a guest session. Sessions on the same host file share a cache entry
+	void track(FILE* fd, const std::filesystem::path& path);
+	// Called when the guest closes a session. The file's dirty pages stay in the cache until the next flush
+	void untrack(FILE* fd);
+	bool isTracked(FILE* fd);
+
+	// File operations for tracked sessions. They return nullopt/false on host I/O errors or if the session is not tracked
+	std::optional<u32> read(FILE* fd, u64 offset, u8* dst, u32 size);
+	std::optional<u32> write(FILE* fd, u64 offset, const u8* src, u32 size);
+	std::optional<u64> size(FILE* fd);
+	bool setSize(FILE* fd, u64 size);
+
+	// Commits every dirty file to the host, then closes the files that no session has open anymore. Returns false if a commit failed
+	bool flush();
+	bool hasDirtyData();
+	// Flushes and forgets every file. Used when the emulator resets, after which the handles of the old sessions are gone
+	void reset();
+
+	// Speculative runs are for frames that will be thrown away, like the ones run-ahead runs past the real frame. Nothing is committed to
+	// the host while one is going on, and endSpeculation undoes every write and resize made since beginSpeculation
+	void beginSpeculation();
+	void endSpeculation();
+};
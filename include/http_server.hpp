@@ -8,12 +8,13 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <thread>
 
 #include "helpers.hpp"
 
-enum class HttpActionType { None, Screenshot, Key, TogglePause, Reset, LoadRom, Step };
+enum class HttpActionType { None, Screenshot, Key, TogglePause, Reset, LoadRom, Step, KernelObjects, IPCProfile };
 
 class Emulator;
 namespace httplib {
@@ -47,6 +48,8 @@ class HttpAction {
 	static std::unique_ptr<HttpAction> createTogglePauseAction();
 	static std::unique_ptr<HttpAction> createResetAction();
 	static std::unique_ptr<HttpAction> createStepAction(DeferredResponseWrapper& response, int frames);
+	static std::unique_ptr<HttpAction> createKernelObjectsAction(DeferredResponseWrapper& response);
+	static std::unique_ptr<HttpAction> createIPCProfileAction(DeferredResponseWrapper& response, bool json, bool reset, std::optional<bool> enable);
 };
 
 struct HttpServer {
@@ -72,6 +75,7 @@ struct HttpServer {
 	void startHttpServer();
 	void pushAction(std::unique_ptr<HttpAction> action);
 	std::string status();
+	std::string kernelObjectStats();
 	u32 stringToKey(const std::string& key_name);
 
 	HttpServer(const HttpServer&) = delete;
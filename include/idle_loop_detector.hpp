@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <span>
+
+#include "helpers.hpp"
+
+// Detects guest threads spinning in loops that can't exit until something outside the CPU changes, like a thread busy-polling a GSP
+// interrupt flag, the HID shared memory indices or a DSP semaphore.
+// While detection is on, the CPU runs in short slices and the detector samples the CPU state at the end of each of them. If the CPU comes
+// back to a state it was in at the end of an earlier slice, without having written memory or called an SVC in between, then it's in a loop
+// that only reads memory. Nothing it reads can change before the next scheduler event, so it would keep looping until then and that
+// time can be skipped.
+class IdleLoopDetector {
+	struct Sample {
+		u32 pc;
+		u64 stateHash;
+	};
+
+	// Loops that don't fit in a few slices do enough work per iteration that spinning in them isn't worth catching
+	static constexpr usize historySize = 8;
+	std::array<Sample, historySize> history;
+	usize historyCount = 0;
+	usize nextSample = 0;
+	u64 lastSideEffectCount = 0;
+
+	static u64 hashState(std::span<const u32> gprs, std::span<const u32> fprs, u32 cpsr, u32 fpscr) {
+		// FNV-1a over the registers. Collisions only matter if they also land on the same PC with no writes in between
+		u64 hash = 0xcbf29ce484222325ull;
+		const auto mix = [&hash](u32 value) {
+			hash ^= value;
+			hash *= 0x100000001b3ull;
+		};
+
+		for (u32 value : gprs) mix(value);
+		for (u32 value : fprs) mix(value);
+		mix(cpsr);
+		mix(fpscr);
+		return hash;
+	}
+
+	void clearHistory() {
+		historyCount = 0;
+		nextSample = 0;
+	}
+
+  public:
+	// Length of the slices the CPU runs in while detection is on. Shorter slices catch loops sooner, at the cost of exiting the JIT more often
+	static constexpr u64 sliceTicks = 16384;
+
+	// Called at the end of every slice with the CPU state and the number of memory writes and SVCs so far.
+	// Returns true if the CPU is in an idle loop, in which case it can be fast-forwarded to the next scheduler event
+	bool check(std::span<const u32> gprs, std::span<const u32> fprs, u32 cpsr, u32 fpscr, u64 sideEffectCount) {
+		// Anything sampled before the last write or SVC is no use, as the loop may have changed what it's waiting on
+		if (sideEffectCount != lastSideEffectCount) {
+			lastSideEffectCount = sideEffectCount;
+			clearHistory();
+		}
+
+		const Sample sample = {.pc = gprs[15], .stateHash = hashState(gprs, fprs, cpsr, fpscr)};
+		for (usize i = 0; i < historyCount; i++) {
+			if (history[i].pc == sample.pc && history[i].stateHash == sample.stateHash) {
+				clearHistory();
+				return true;
+			}
+		}
+
+		history[nextSample] = sample;
+		nextSample = (nextSample + 1) % historySize;
+		historyCount = std::min(historyCount + 1, historySize);
+		return false;
+	}
+
+	void reset() {
+		clearHistory();
+		lastSideEffectCount = 0;
+	}
+};
@@ -1,11 +1,19 @@
 #pragma once
 #include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <optional>
 
+namespace CompressedROM {
+	class Reader;
+}
+
 class IOFile {
 	FILE* handle = nullptr;
-	static inline std::filesystem::path appData = "";  // Directory for holding app data. AppData on Windows
+
+	// Set if this file is a block-compressed ROM container. Reads, seeks and size queries then operate on the decompressed image
+	std::shared_ptr<CompressedROM::Reader> compressedReader = nullptr;
+	std::uint64_t compressedPosition = 0;
 
   public:
 	IOFile() : handle(nullptr) {}
@@ -28,9 +36,12 @@ class IOFile {
 	bool seek(std::int64_t offset, int origin = SEEK_SET);
 	bool rewind();
 	bool flush();
+	// Flushes the file and waits until the OS has written it to the storage device
+	bool sync();
 	FILE* getHandle();
-	static void setAppDataDir(const std::filesystem::path& dir);
-	static std::filesystem::path getAppData() { return appData; }
+
+	void setCompressedReader(std::shared_ptr<CompressedROM::Reader> reader);
+	bool isCompressed() const { return compressedReader != nullptr; }
 
 	// Sets the size of the file to "size" and returns whether it succeeded or not
 	bool setSize(std::uint64_t size);
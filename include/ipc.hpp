@@ -1,9 +1,114 @@
 #pragma once
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+#include "helpers.hpp"
+#include "memory.hpp"
 
 namespace IPC {
 	constexpr std::uint32_t responseHeader(std::uint32_t commandID, std::uint32_t normalResponses, std::uint32_t translateResponses) {
 		// TODO: Maybe validate the response count stuff fits in 6 bits
 		return (commandID << 16) | (normalResponses << 6) | translateResponses;
 	}
-}
\ No newline at end of file
+
+	constexpr std::uint32_t commandID(std::uint32_t header) { return header >> 16; }
+
+	// The command buffer of an IPC request, which lives in the TLS of the thread making the request. The host pointer to it is looked up once
+	// per request and parameters and responses go straight through it, instead of every word doing its own page table lookup through
+	// Memory::read32/write32. A thread's TLS never crosses a page, so the whole buffer is behind that one pointer, static buffer descriptors
+	// at offset 0x100 included
+	class CommandBuffer {
+		u32* words;
+		u32 pointer;
+
+	  public:
+		CommandBuffer(Memory& mem, u32 messagePointer) : words(static_cast<u32*>(mem.getWritePointer(messagePointer))), pointer(messagePointer) {
+			if (words == nullptr) [[unlikely]] {
+				Helpers::panic("IPC command buffer at %08X is not mapped", messagePointer);
+			}
+		}
+
+		u32 getPointer() const { return pointer; }
+		u32 header() const { return words[0]; }
+		u32& operator[](usize index) { return words[index]; }
+
+		// Reads the parameters that follow the header, laid out as the fields of T
+		template <typename T>
+		T request() const {
+			static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(u32) == 0, "IPC parameters must be made of whole words");
+
+			T params;
+			std::memcpy(&params, &words[1], sizeof(T));
+			return params;
+		}
+
+		// Writes the response header and result code of a command that only returns a result
+		template <u32 commandID>
+		void respond(u32 result) {
+			words[0] = responseHeader(commandID, 1, 0);
+			words[1] = result;
+		}
+
+		// Writes the response header and result code, followed by the fields of "response". Handles and buffer descriptors go at the end of
+		// the response, and translateWords is how many words of it they take up
+		template <u32 commandID, u32 translateWords = 0, typename T>
+		void respond(u32 result, const T& response) {
+			static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(u32) == 0, "IPC responses must be made of whole words");
+			constexpr u32 responseWords = sizeof(T) / sizeof(u32);
+			static_assert(translateWords <= responseWords, "More translate words than there are words in the response");
+
+			words[0] = responseHeader(commandID, 1 + responseWords - translateWords, translateWords);
+			words[1] = result;
+			std::memcpy(&words[2], &response, sizeof(T));
+		}
+	};
+
+	template <typename Service>
+	using CommandHandler = void (Service::*)(CommandBuffer& cmd);
+
+	// The handlers of a service's commands, indexed by command ID, so that dispatching a request is a bounds check, a header compare and an
+	// indirect call. Tables are built at compile time, from the full header of every command, as the parameter counts in the header are part
+	// of what tells commands apart
+	template <typename Handler, u32 firstID, u32 lastID>
+	class CommandTable {
+	  public:
+		struct Command {
+			u32 header;
+			Handler handler;
+		};
+
+	  private:
+		std::array<Command, lastID - firstID + 1> commands{};
+		bool valid = true;
+
+	  public:
+		constexpr CommandTable(std::initializer_list<Command> list) {
+			for (const Command& command : list) {
+				const u32 id = commandID(command.header);
+
+				if (id < firstID || id > lastID || commands[id - firstID].handler != nullptr) {
+					valid = false;
+				} else {
+					commands[id - firstID] = command;
+				}
+			}
+		}
+
+		// Whether every command fit in the table without clashing with another one. Meant for static_assert
+		constexpr bool isValid() const { return valid; }
+
+		// Returns the handler for a request header, or nullptr if the service doesn't know the command
+		Handler find(u32 header) const {
+			const u32 index = commandID(header) - firstID;  // IDs below the first one wrap around and fail the bounds check
+			if (index >= commands.size()) [[unlikely]] {
+				return nullptr;
+			}
+
+			const Command& command = commands[index];
+			return command.header == header ? command.handler : nullptr;
+		}
+	};
+}  // namespace IPC
@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "helpers.hpp"
+
+// Host worker thread that performs guest file I/O off the emulator thread, so that a guest thread blocked on a big RomFS read or a save
+// write doesn't freeze every other guest thread and the GPU.
+// Requests run one at a time in submission order, so reads and writes to the same file observe each other like synchronous I/O would.
+// The work callback runs on the I/O thread and must not touch emulated state. The completion callback runs on the emulator thread,
+// from Kernel::pollAsyncIO, and is where emulated memory and IPC replies get written.
+class AsyncIO {
+  public:
+	using Callback = std::function<void()>;
+
+  private:
+	struct Request {
+		Callback work;
+		Callback complete;
+	};
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+
+	std::deque<Request> pending;     // Requests waiting for the I/O thread
+	std::vector<Callback> finished;  // Completion callbacks of requests the I/O thread is done with, in submission order
+	bool busy = false;               // Is the I/O thread executing a request right now?
+	bool stopping = false;
+	std::thread worker;
+
+	// Only touched by the emulator thread: Requests submitted whose completion hasn't been delivered yet
+	usize outstanding = 0;
+
+	void workerLoop();
+
+  public:
+	~AsyncIO();
+
+	void submit(Callback work, Callback complete);
+
+	// Runs the completion callbacks of all finished requests. Returns how many were delivered
+	usize poll();
+	// Blocks until at least one outstanding request has finished. Returns immediately if there's none
+	void waitForCompletion();
+	// Waits for every outstanding request to finish and delivers them. Used before synchronous file operations that could race the I/O thread
+	void drain();
+	// Waits for all queued work to finish and drops the completions without running them. Used when the emulator resets
+	void reset();
+
+	bool hasOutstanding() const { return outstanding != 0; }
+};
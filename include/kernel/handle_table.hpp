@@ -0,0 +1,101 @@
+#pragma once
+#include <optional>
+#include <vector>
+
+#include "helpers.hpp"
+#include "kernel_types.hpp"
+
+class SaveStateStream;
+
+// The table of kernel objects, indexed by handle. Like on the 3DS kernel, a handle holds the index of its object's slot in the low bits and
+// the generation of the slot above them. Closing an object frees its slot for reuse and bumps the generation, so handles to closed objects
+// stop resolving rather than silently referring to whatever object took over their slot.
+// Slot 0 holds a dummy object that is never freed, so handle 0 is never given out for a real object
+class HandleTable {
+	static constexpr u32 indexBits = 15;
+	static constexpr u32 indexMask = (1u << indexBits) - 1;
+	static constexpr u32 generationMask = 0x7FFF;  // Keeps handles well below the hardcoded ones, which start at 0xFFFF8000
+
+	std::vector<KernelObject> slots;
+	std::vector<u16> generations;  // The generation of each slot, which is part of the handle of the object in it
+	std::vector<u32> freeSlots;    // Indices of free slots. The last one is reused first
+
+	Handle makeHandle(u32 index) const { return index | (u32(generations[index]) << indexBits); }
+
+  public:
+	static constexpr u32 maxSlots = indexMask + 1;
+	static constexpr u32 getIndex(Handle handle) { return handle & indexMask; }
+
+	// Returns the handle of the new object, or nullopt if every slot is taken
+	std::optional<Handle> allocate(KernelObjectType type) {
+		u32 index;
+		if (!freeSlots.empty()) {
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		} else {
+			if (slots.size() >= maxSlots) [[unlikely]] {
+				return std::nullopt;
+			}
+
+			index = u32(slots.size());
+			slots.push_back(KernelObject(0, KernelObjectType::Dummy));
+			generations.push_back(0);
+		}
+
+		const Handle handle = makeHandle(index);
+		slots[index] = KernelObject(handle, type);
+		return handle;
+	}
+
+	// Frees the slot of an object. Its data must have been freed already
+	void free(Handle handle) {
+		const u32 index = getIndex(handle);
+		slots[index] = KernelObject(0, KernelObjectType::Dummy);
+		generations[index] = (generations[index] + 1) & generationMask;
+		freeSlots.push_back(index);
+	}
+
+	KernelObject* get(Handle handle) {
+		const u32 index = getIndex(handle);
+		if (index >= slots.size() || slots[index].handle != handle) [[unlikely]] {
+			return nullptr;
+		}
+
+		return &slots[index];
+	}
+
+	KernelObject* get(Handle handle, KernelObjectType type) {
+		KernelObject* object = get(handle);
+		if (object == nullptr || object->type != type) [[unlikely]] {
+			return nullptr;
+		}
+
+		return object;
+	}
+
+	// A slot is free if the object in it doesn't have the handle the slot currently hands out
+	bool isFree(u32 index) const { return slots[index].handle != makeHandle(index); }
+
+	usize slotCount() const { return slots.size(); }
+	usize freeSlotCount() const { return freeSlots.size(); }
+	usize liveCount() const { return slots.size() - freeSlots.size(); }
+
+	void reserve(usize count) {
+		slots.reserve(count);
+		generations.reserve(count);
+	}
+
+	void clear() {
+		slots.clear();
+		generations.clear();
+		freeSlots.clear();
+	}
+
+	// Iterates over every slot, free or not. Free slots hold a dummy object with no data
+	auto begin() { return slots.begin(); }
+	auto end() { return slots.end(); }
+
+	// Saves or loads the handle and type of every slot along with the generations and free list, so that the handles the guest gets after
+	// loading a state are the same it would have gotten if the state had never been saved. Object data is up to the kernel
+	void doState(SaveStateStream& stream);
+};
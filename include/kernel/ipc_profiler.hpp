@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "handles.hpp"
+#include "helpers.hpp"
+
+// Counts the IPC requests the guest makes and how much host time we spend handling them, per target and command header.
+// Targets are service handles, or one of the pseudo-targets below for requests sent to file and directory sessions, which are merged so that
+// every file counts towards the same commands. Times are kept as a histogram of power-of-2 nanosecond buckets per command, so percentiles
+// are approximate (the upper bound of the bucket they land in) but recording a request never allocates after its command has been seen once
+class IPCProfiler {
+  public:
+	using Clock = std::chrono::steady_clock;
+
+	enum Target : Handle {
+		FileSessions = 0,
+		DirectorySessions = 1,
+	};
+
+	// Bucket i holds requests that took [2^i, 2^(i+1)) ns, with the last one also holding anything slower
+	static constexpr usize bucketCount = 32;
+
+	struct CommandStats {
+		Handle target;
+		u32 header;
+		u64 count = 0;
+		u64 totalNs = 0;
+		u64 minNs = ~0ull;
+		u64 maxNs = 0;
+		std::array<u64, bucketCount> histogram{};
+
+		// Returns an upper bound for the time under which "fraction" of the requests finished
+		u64 percentileNs(double fraction) const;
+	};
+
+	// Times a request from construction to destruction, if the profiler was enabled when it started
+	class Scope {
+		IPCProfiler& profiler;
+		Handle target;
+		u32 header;
+		bool active;
+		Clock::time_point start;
+
+	  public:
+		Scope(IPCProfiler& profiler, Handle target, u32 header)
+			: profiler(profiler), target(target), header(header), active(profiler.isEnabled()) {
+			if (active) [[unlikely]] {
+				start = Clock::now();
+			}
+		}
+
+		~Scope() {
+			if (active) [[unlikely]] {
+				profiler.record(target, header, Clock::now() - start);
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+  private:
+	std::unordered_map<u64, CommandStats> commands;  // Keyed by target in the top 32 bits and header in the bottom 32
+	bool enabled = false;
+
+  public:
+	bool isEnabled() const { return enabled; }
+	void setEnabled(bool enable) { enabled = enable; }
+	void reset() { commands.clear(); }
+
+	void record(Handle target, u32 header, Clock::duration elapsed);
+
+	// Every command seen so far, the ones we spent the most time on first
+	std::vector<CommandStats> getStats() const;
+	static const char* getTargetName(Handle target);
+
+	std::string dumpTable() const;
+	std::string dumpJSON() const;
+};
@@ -4,37 +4,63 @@
 #include <limits>
 #include <span>
 #include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "async_io.hpp"
 #include "config.hpp"
+#include "handle_table.hpp"
 #include "helpers.hpp"
+#include "ipc_profiler.hpp"
 #include "kernel_types.hpp"
 #include "logger.hpp"
 #include "memory.hpp"
+#include "object_pool.hpp"
 #include "resource_limits.hpp"
 #include "services/service_manager.hpp"
+#include "wait_queue.hpp"
 
 class CPU;
 struct Scheduler;
 
+// How many objects of one type exist and how much host memory their pool holds, for tracking down leaks
+struct KernelObjectStats {
+	KernelObjectType type;
+	usize handles = 0;        // Live handles to objects of this type
+	usize liveObjects = 0;    // Objects of this type allocated from their pool
+	usize pooledObjects = 0;  // How many objects the pool has room for before it needs another slab
+	usize pooledBytes = 0;    // Host memory held by the pool
+};
+
 class Kernel {
 	std::span<u32, 16> regs;
 	CPU& cpu;
 	Memory& mem;
+	const EmulatorConfig& config;
 
-	// The handle number for the next kernel object to be created
-	u32 handleCounter;
 	// A list of our OS threads, the max number of which depends on the resource limit (hardcoded 32 per process on retail it seems).
 	// We have an extra thread for when no thread is capable of running. This thread is called the "idle thread" in our code
 	// This thread is set up in setupIdleThread and just yields in a loop to see if any other thread has woken up
 	std::array<Thread, appResourceLimits.maxThreads + 1> threads;
 	static constexpr int idleThreadIndex = appResourceLimits.maxThreads;
-	// Our waitlist system uses a bitfield of 64 bits to show which threads are waiting on an object.
-	// That means we can have a maximum of 63 threads + 1 idle thread. This assert should never trigger because the max thread # is 32
-	// But we have it here for safety purposes
-	static_assert(appResourceLimits.maxThreads <= 63, "The waitlist system is built on the premise that <= 63 threads max can be active");
 
-	std::vector<KernelObject> objects;
+	// Threads waiting on address arbiters, keyed by the address they are waiting on
+	std::unordered_map<u32, WaitQueue> arbiterWaitQueues;
+	// Threads waiting on sync objects, keyed by the data of the object. Several handles can refer to the same object, so we can't key by handle.
+	// Neither map goes in save states, since both can be rebuilt from the status and wait list of every thread
+	std::unordered_map<const void*, WaitQueue> objectWaitQueues;
+
+	HandleTable objects;
+	// Pools for the data of every type of object that owns its data. Resource limits live in their process and thread objects point
+	// into our thread array, so neither has a pool
+	std::tuple<
+		ObjectPool<AddressArbiter>, ObjectPool<ArchiveSession>, ObjectPool<DirectorySession>, ObjectPool<Event>, ObjectPool<FileSession>,
+		ObjectPool<MemoryBlock>, ObjectPool<Port>, ObjectPool<Process>, ObjectPool<Session>, ObjectPool<Mutex>, ObjectPool<Semaphore>,
+		ObjectPool<Timer>>
+		objectPools;
+
 	std::vector<Handle> portHandles;
 	std::vector<Handle> mutexHandles;
 	std::vector<Handle> timerHandles;
@@ -59,6 +85,25 @@ class Kernel {
 	// Shows whether a reschedule will be need
 	bool needReschedule = false;
 
+	// Service calls via SendSyncRequest and file access needs to put the caller to sleep for a given amount of time
+	// To make sure that the other threads don't get starved. Various games rely on this (including Sonic Boom: Shattering Crystal it seems)
+	static constexpr u64 syncRequestDelayNs = 39000;
+
+	// Host thread for file reads and writes. The requesting guest thread waits in WaitIPC until the host I/O is done, and the reply is
+	// delivered from a scheduler event, no earlier than syncRequestDelayNs after the request
+	AsyncIO asyncIO;
+	bool asyncIOPollScheduled = false;
+	static constexpr u64 asyncIOPollIntervalNs = 20000;
+
+	// Save writes are gathered in the FS write-back cache and committed to the host at most this often
+	bool saveDataFlushScheduled = false;
+	static constexpr u64 saveDataFlushDelayNs = 1'000'000'000;
+	// Set while a commit is queued on the I/O thread. Nothing saves a state with one in flight, as save states drain the I/O thread first
+	bool saveDataCommitPending = false;
+
+	// Host-side statistics, so they're neither saved in save states nor rolled back when loading one
+	IPCProfiler ipcProfiler;
+
 	Handle makeArbiter();
 	Handle makeProcess(u32 id);
 	Handle makePort(const char* name);
@@ -103,14 +148,27 @@ public:
 	void signalTimer(Handle timerHandle, Timer* timer);
 	u64 getWakeupTick(s64 ns);
 
-	// Wake up the thread with the highest priority out of all threads in the waitlist
-	// Returns the index of the woken up thread
-	// Do not call this function with an empty waitlist!!!
-	int wakeupOneThread(u64 waitlist, Handle handle);
-	void wakeupAllThreads(u64 waitlist, Handle handle);
+	// Wait queue management. Threads are added to the queues of whatever they wait on when they go to sleep, according to their status,
+	// and have to be removed from all of them whenever they stop waiting, be it from being woken up or from timing out
+	void addWaiter(Thread& t);
+	void removeWaiter(Thread& t);
+	void rebuildWaitQueues();
+	bool hasWaiters(const KernelObject* object) const { return objectWaitQueues.contains(object->data); }
+
+	// Wake up the thread with the highest priority out of all threads waiting on an object
+	// Returns the index of the woken up thread, or nullopt if no thread was waiting
+	std::optional<int> wakeupOneThread(KernelObject* object);
+	void wakeupAllThreads(KernelObject* object);
+	void wakeupWaiter(const WaitQueue::Waiter& waiter);
 
 	std::optional<Handle> getPortHandle(const char* name);
 	void deleteObjectData(KernelObject& object);
+	void doObjectState(SaveStateStream& stream, KernelObject& object, HandleTable& oldObjects, std::unordered_set<FILE*>& reusedFiles);
+
+	template <typename T>
+	ObjectPool<T>& getObjectPool() {
+		return std::get<ObjectPool<T>>(objectPools);
+	}
 
 	KernelObject* getProcessFromPID(Handle handle);
 	s32 getCurrentResourceValue(const KernelObject* limit, u32 resourceName);
@@ -121,6 +179,11 @@ public:
 	void acquireSyncObject(KernelObject* object, const Thread& thread);
 	bool isWaitable(const KernelObject* object);
 
+	// Puts the current thread to sleep until "work" has run on the I/O thread. "complete" runs on the emulator thread and writes the reply
+	void submitAsyncIO(AsyncIO::Callback work, AsyncIO::Callback complete);
+	void scheduleAsyncIOPoll(u64 delayNs);
+	void scheduleSaveDataFlush();
+
 	// Functions for the err:f port
 	void handleErrorSyncRequest(u32 messagePointer);
 	void throwError(u32 messagePointer);
@@ -173,6 +236,7 @@ public:
 	void svcSignalEvent();
 	void svcSetTimer();
 	void svcSleepThread();
+	void callLibcHook(u32 svc);  // Runs one of the native libc routines from LibcHooks
 	void connectToPort();
 	void outputDebugString();
 	void waitSynchronization1();
@@ -196,12 +260,23 @@ public:
 
 public:
 	Kernel(CPU& cpu, Memory& mem, GPU& gpu, const EmulatorConfig& config);
+	~Kernel();
 	void initializeFS() { return serviceManager.initializeFS(); }
 	void setVersion(u8 major, u8 minor);
 	void serviceSVC(u32 svc);
 	void reset();
+	void doState(SaveStateStream& stream);
 
 	void requireReschedule() { needReschedule = true; }
+	// Whether every guest thread is blocked, ie the idle thread is running
+	bool isIdle() const { return currentThreadIndex == idleThreadIndex; }
+
+	// Delivers finished asynchronous file operations. Called from the scheduler
+	void pollAsyncIO();
+	// Waits for all in-flight file operations and delivers them, for operations that touch host files synchronously
+	void drainAsyncIO() { asyncIO.drain(); }
+	// Commits cached save writes to the host. Called from the scheduler
+	void flushSaveData();
 
 	void evalReschedule() {
 		if (needReschedule) {
@@ -211,40 +286,56 @@ public:
 	}
 
 	Handle makeObject(KernelObjectType type) {
-		if (handleCounter > KernelHandles::Max) [[unlikely]] {
+		const std::optional<Handle> handle = objects.allocate(type);
+		if (!handle.has_value()) [[unlikely]] {
 			Helpers::panic("Hlep we somehow created enough kernel objects to overflow this thing");
 		}
 
-		objects.push_back(KernelObject(handleCounter, type));
-		log("Created %s object with handle %d\n", kernelObjectTypeToString(type), handleCounter);
-		return handleCounter++;
+		log("Created %s object with handle %X\n", kernelObjectTypeToString(type), handle.value());
+		return handle.value();
 	}
 
-	std::vector<KernelObject>& getObjects() {
-		return objects;
+	// Allocates the data of a freshly made object from the pool for its type
+	template <typename T, typename... Args>
+	T* allocateObjectData(Handle handle, Args&&... args) {
+		T* data = getObjectPool<T>().allocate(std::forward<Args>(args)...);
+		objects.get(handle)->data = data;
+		return data;
 	}
 
-	// Get pointer to the object with the specified handle
-	KernelObject* getObject(Handle handle) {
-		// Accessing an object that has not been created
-		if (handle >= objects.size()) [[unlikely]] {
-			return nullptr;
-		}
+	// Marks an object as owned by the guest, so that it gets destroyed when the guest closes its handle. Returns the handle for convenience
+	Handle giveToGuest(Handle handle) {
+		objects.get(handle)->ownedByGuest = true;
+		return handle;
+	}
 
-		return &objects[handle];
+	// Keeps a guest object alive after the guest closes its handle, for services that hold onto the handle and use it later
+	// We don't reference count objects, so a pinned object lives for as long as the emulated system does
+	void pinObject(Handle handle) {
+		if (KernelObject* object = objects.get(handle); object != nullptr) {
+			object->ownedByGuest = false;
+		}
 	}
 
+	// Closes a handle the way svcCloseHandle does, destroying its object if the guest owns it and nothing else needs it
+	Result::HorizonResult closeHandle(Handle handle);
+
+	// Destroys an object, freeing its data and its handle for reuse. The handle has to be valid
+	void destroyObject(Handle handle);
+
+	// Get pointer to the object with the specified handle, or nullptr if the handle is invalid or its object has been closed
+	KernelObject* getObject(Handle handle) { return objects.get(handle); }
+
 	// Get pointer to the object with the specified handle and type
-	KernelObject* getObject(Handle handle, KernelObjectType type) {
-		if (handle >= objects.size() || objects[handle].type != type) [[unlikely]] {
-			return nullptr;
-		}
+	KernelObject* getObject(Handle handle, KernelObjectType type) { return objects.get(handle, type); }
 
-		return &objects[handle];
-	}
+	std::vector<KernelObjectStats> getObjectStats();
+	const HandleTable& getHandleTable() const { return objects; }
 
 	ServiceManager& getServiceManager() { return serviceManager; }
+	IPCProfiler& getIPCProfiler() { return ipcProfiler; }
 	Scheduler& getScheduler();
+	u64 getTicks();
 
 	void sendGPUInterrupt(GPUInterrupt type) { serviceManager.sendGPUInterrupt(type); }
 	void clearInstructionCache();
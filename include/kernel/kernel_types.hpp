@@ -68,13 +68,12 @@ struct Event {
         None, DSPSemaphore,
     };
 
-    u64 waitlist; // A bitfield where each bit symbolizes if the thread with thread with the corresponding index is waiting on the event
     ResetType resetType = ResetType::OneShot;
     CallbackType callback = CallbackType::None;
     bool fired = false;
 
-    Event(ResetType resetType) : resetType(resetType), waitlist(0) {}
-    Event(ResetType resetType, CallbackType cb) : resetType(resetType), waitlist(0), callback(cb) {}
+    Event(ResetType resetType) : resetType(resetType) {}
+    Event(ResetType resetType, CallbackType cb) : resetType(resetType), callback(cb) {}
 };
 
 struct Port {
@@ -136,8 +135,8 @@ struct Thread {
 	u32 fpscr;
 	u32 tlsBase;  // Base pointer for thread-local storage
 
-	// A list of threads waiting for this thread to terminate. Yes, threads are sync objects too.
-	u64 threadsWaitingForTermination;
+	// Whether the guest closed the handle of the thread while it was still running, in which case its object is destroyed when it exits
+	bool handleClosed;
 };
 
 static const char* kernelObjectTypeToString(KernelObjectType t) {
@@ -161,25 +160,22 @@ static const char* kernelObjectTypeToString(KernelObjectType t) {
 }
 
 struct Mutex {
-    u64 waitlist;           // Refer to the getWaitlist function below for documentation
     Handle ownerThread = 0; // Index of the thread that holds the mutex if it's locked
     Handle handle; // Handle of the mutex itself
     u32 lockCount; // Number of times this mutex has been locked by its daddy. 0 = not locked
     bool locked;
 
-    Mutex(bool lock, Handle handle) : locked(lock), waitlist(0), lockCount(lock ? 1 : 0), handle(handle) {}
+    Mutex(bool lock, Handle handle) : locked(lock), lockCount(lock ? 1 : 0), handle(handle) {}
 };
 
 struct Semaphore {
-    u64 waitlist; // Refer to the getWaitlist function below for documentation
     s32 availableCount;
     s32 maximumCount;
 
-    Semaphore(s32 initialCount, s32 maximumCount) : availableCount(initialCount), maximumCount(maximumCount), waitlist(0) {}
+    Semaphore(s32 initialCount, s32 maximumCount) : availableCount(initialCount), maximumCount(maximumCount) {}
 };
 
 struct Timer {
-	u64 waitlist;  // Refer to the getWaitlist function below for documentation
 	ResetType resetType = ResetType::OneShot;
 
 	u64 fireTick;      // CPU tick the timer will be fired
@@ -187,7 +183,7 @@ struct Timer {
 	bool fired;        // Has this timer been signalled?
 	bool running;      // Is this timer running or stopped?
 
-	Timer(ResetType type) : resetType(type), fireTick(0), interval(0), waitlist(0), fired(false), running(false) {}
+	Timer(ResetType type) : resetType(type), fireTick(0), interval(0), fired(false), running(false) {}
 };
 
 struct MemoryBlock {
@@ -206,6 +202,9 @@ struct KernelObject {
     Handle handle = 0; // A u32 the OS will use to identify objects
     void* data = nullptr;
     KernelObjectType type;
+    // Whether the guest owns the object, in which case closing its handle destroys it. Objects made by services and by the kernel itself
+    // live for as long as the emulated system does, so closing the guest's copy of their handle does nothing
+    bool ownedByGuest = false;
 
     KernelObject(Handle handle, KernelObjectType type) : handle(handle), type(type) {}
 
@@ -221,25 +220,4 @@ struct KernelObject {
     const char* getTypeName() const {
         return kernelObjectTypeToString(type);
     }
-
-    // Retrieves a reference to the waitlist for a specified object
-	// We return a reference because this function is only called in the kernel threading internals
-	// We want the kernel to be able to easily manage waitlists, by reading/parsing them or setting/clearing bits.
-	// As we mention in the definition of the "Event" struct, the format for wailists is very simple and made to be efficient.
-	// Each bit corresponds to a thread index and denotes whether the corresponding thread is waiting on this object
-	// For example if bit 0 of the wait list is set, then the thread with index 0 is waiting on our object
-	u64& getWaitlist() {
-		// This code is actually kinda trash but eh good enough
-		switch (type) {
-			case KernelObjectType::Event: return getData<Event>()->waitlist;
-			case KernelObjectType::Mutex: return getData<Mutex>()->waitlist;
-			case KernelObjectType::Semaphore: return getData<Mutex>()->waitlist;
-			case KernelObjectType::Thread: return getData<Thread>()->threadsWaitingForTermination;
-			case KernelObjectType::Timer: return getData<Timer>()->waitlist;
-
-			// This should be unreachable once we fully implement sync objects
-			default: [[unlikely]]
-                Helpers::panic("Called GetWaitList on kernel object without a waitlist (Type: %s)", getTypeName());
-		}
-	}
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "helpers.hpp"
+
+// Slab allocator for the data of one type of kernel object. Objects are carved out of slabs of slabSize objects, and destroyed objects go
+// on a free list to be handed out again by the next allocation, so creating and destroying objects is O(1) and doesn't churn the host heap.
+// Slabs are only given back when the pool is destroyed, so the memory a pool holds is bounded by the peak number of live objects.
+// Objects never move once allocated, which lets other objects point into them (eg resource limits live inside their process)
+template <typename T, usize slabSize = 32>
+class ObjectPool {
+	struct alignas(T) Slot {
+		std::byte bytes[sizeof(T)];
+	};
+
+	std::vector<std::unique_ptr<Slot[]>> slabs;
+	std::vector<Slot*> freeSlots;  // The last slot is handed out first
+	usize liveCount = 0;
+
+	void addSlab() {
+		Slot* slab = slabs.emplace_back(std::make_unique<Slot[]>(slabSize)).get();
+
+		// Push the slots in reverse so that allocations go through the slab in order
+		for (usize i = slabSize; i > 0; i--) {
+			freeSlots.push_back(&slab[i - 1]);
+		}
+	}
+
+  public:
+	ObjectPool() = default;
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	~ObjectPool() {
+		if (liveCount != 0) {
+			Helpers::warn("ObjectPool: Destroyed with %zu objects still alive", liveCount);
+		}
+	}
+
+	template <typename... Args>
+	T* allocate(Args&&... args) {
+		if (freeSlots.empty()) {
+			addSlab();
+		}
+
+		Slot* slot = freeSlots.back();
+		freeSlots.pop_back();
+		liveCount++;
+
+		return new (slot->bytes) T(std::forward<Args>(args)...);
+	}
+
+	void free(T* object) {
+		object->~T();
+		freeSlots.push_back(reinterpret_cast<Slot*>(object));
+		liveCount--;
+	}
+
+	usize liveObjects() const { return liveCount; }
+	usize capacity() const { return slabs.size() * slabSize; }
+	usize reservedBytes() const { return capacity() * sizeof(Slot); }
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "helpers.hpp"
+
+// Threads waiting on an address arbiter address or on a sync object, kept in the order they are to be woken up in: the highest priority
+// (lowest priority value) first, and first come first served among threads of the same priority.
+// Queues only ever hold a handful of threads, so a sorted vector beats any node-based container here
+class WaitQueue {
+  public:
+	struct Waiter {
+		u32 priority;
+		int threadIndex;
+		// For WaitSynchronizationN, the index of the object in the thread's wait list, which is returned to the thread in r1 when the object
+		// wakes it up
+		u32 waitIndex;
+	};
+
+  private:
+	std::vector<Waiter> waiters;
+
+  public:
+	bool empty() const { return waiters.empty(); }
+	usize size() const { return waiters.size(); }
+	auto begin() const { return waiters.begin(); }
+	auto end() const { return waiters.end(); }
+
+	void push(const Waiter& waiter) {
+		// Insert after every waiter with the same or a higher priority
+		const auto position = std::upper_bound(
+			waiters.begin(), waiters.end(), waiter.priority, [](u32 priority, const Waiter& other) { return priority < other.priority; }
+		);
+		waiters.insert(position, waiter);
+	}
+
+	// Removes and returns the next thread to wake up. Must not be called on an empty queue
+	Waiter pop() {
+		const Waiter waiter = waiters.front();
+		waiters.erase(waiters.begin());
+		return waiter;
+	}
+
+	// Removes every entry of a thread from the queue. A thread appears more than once if it passed the same object to WaitSynchronizationN
+	// several times
+	void remove(int threadIndex) {
+		std::erase_if(waiters, [&](const Waiter& waiter) { return waiter.threadIndex == threadIndex; });
+	}
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "helpers.hpp"
+
+class Memory;
+
+// High-level replacements for hot guest libc routines (memcpy, memmove, memset, strlen and their AEABI variants).
+// Copies and fills are a big share of the instructions games run while loading assets, and running them through the JIT costs a memory
+// callback per access. Instead, when an executable is loaded, the first instruction of every such routine is patched with an SVC carrying
+// one of our own numbers. The kernel hands those SVCs to us and we run the routine natively over the
+// page tables, then return to the caller.
+//
+// The routines are found by name, so only executables that still have their symbol table (homebrew ELFs) get hooked. Retail titles are
+// stripped, and the code of these routines depends on the toolchain version a game was built with, so there's nothing reliable to find
+// them by
+class LibcHooks {
+  public:
+	enum class Function : u32 {
+		Memcpy,       // void* memcpy(void* dest, const void* src, size_t size)
+		Memmove,      // void* memmove(void* dest, const void* src, size_t size)
+		Memset,       // void* memset(void* dest, int value, size_t size)
+		AeabiMemset,  // void __aeabi_memset(void* dest, size_t size, int value)
+		AeabiMemclr,  // void __aeabi_memclr(void* dest, size_t size)
+		Strlen,       // size_t strlen(const char* string)
+		Count,
+	};
+
+	// SVC numbers from svcBase onwards are ours, with the low bits being the Function to run. Real SVCs only use the bottom 8 bits
+	static constexpr u32 svcBase = 0xFF0000;
+	static bool isHookSVC(u32 svc) { return svc >= svcBase && svc < svcBase + u32(Function::Count); }
+
+  private:
+	using PatchCounts = std::array<u32, usize(Function::Count)>;
+
+	std::vector<u8> scratch;  // Copies are staged through here, a chunk at a time
+
+	static std::optional<Function> functionFromSymbol(std::string_view name);
+	static const char* functionName(Function function);
+
+	// Replaces the first instruction of a routine with its hook SVC
+	static void patchEntry(u8* entry, Function function);
+	static u32 printSummary(const PatchCounts& counts);
+
+  public:
+	struct Symbol {
+		std::string name;
+		u32 address;
+	};
+
+	// Patches the entry of every routine in symbols that we replace, for executables that still have their symbol table. getCode returns
+	// the host pointer to the instruction at a guest address, or nullptr if it isn't loaded. Thumb routines (odd addresses) can't take an
+	// ARM SVC, so they're left alone. Returns the number of routines patched
+	u32 patchSymbols(std::span<const Symbol> symbols, const std::function<u8*(u32 address)>& getCode);
+
+	// Runs the routine of a hook SVC with the arguments in regs, writing its return value to r0. Returns the cycles the call took,
+	// which is an estimate of what the guest routine would have taken. Returning to the caller is left to the kernel
+	u64 call(u32 svc, std::span<u32, 16> regs, Memory& mem);
+};
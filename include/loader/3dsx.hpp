@@ -77,4 +77,6 @@ struct HB3DSX {
 
     bool hasRomFs() const;
     std::pair<bool, std::size_t> readRomFSBytes(void *dst, std::size_t offset, std::size_t size);
+    // Same as above, but through another handle to the 3DSX
+    std::pair<bool, std::size_t> readRomFSBytes(IOFile& romFile, void *dst, std::size_t offset, std::size_t size);
 };
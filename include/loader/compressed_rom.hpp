@@ -0,0 +1,100 @@
+#pragma once
+#include <array>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "helpers.hpp"
+#include "io_file.hpp"
+
+// Seekable block-compressed container for NCSD/CXI images (.zcci/.zcxi)
+// The image is split into fixed-size blocks which are compressed independently, followed by an index of block offsets so that any byte
+// of the original image can be reached by decompressing a single block. Layout:
+//   Header (32 bytes)
+//   BlockEntry[blockCount]
+//   Compressed block data
+// All fields are little endian.
+namespace CompressedROM {
+	static constexpr std::array<u8, 4> magic = {'Z', 'C', 'C', 'I'};
+	static constexpr u32 version = 1;
+	static constexpr u32 defaultBlockSize = u32(64_KB);
+	static constexpr u32 minBlockSize = u32(4_KB);
+	static constexpr u32 maxBlockSize = u32(4_MB);
+
+	struct Header {
+		u8 magic[4];
+		u32 version;
+		u32 blockSize;
+		u32 blockCount;
+		u64 uncompressedSize;
+		u64 reserved;
+	};
+	static_assert(sizeof(Header) == 32, "Compressed ROM header must be 32 bytes");
+
+	struct BlockEntry {
+		u64 offset;          // Offset of the block's data from the start of the container
+		u32 compressedSize;  // Size of the block's data in the container
+		u32 flags;
+
+		static constexpr u32 Stored = 1 << 0;  // Block is stored raw because it did not compress
+	};
+	static_assert(sizeof(BlockEntry) == 16, "Compressed ROM block entries must be 16 bytes");
+
+	// LZ4-compatible block codec used for each block. Decompression is bounds-checked as the input comes from an untrusted file
+	namespace Codec {
+		// Worst-case size of compressing "size" bytes
+		constexpr usize compressBound(usize size) { return size + size / 255 + 16; }
+
+		// Compresses "size" bytes from src into dst, returning the number of bytes written. dst must hold at least compressBound(size) bytes
+		usize compress(const u8* src, usize size, u8* dst);
+		// Decompresses into dst, which must be exactly dstSize bytes. Returns false if the input is malformed
+		bool decompress(const u8* src, usize srcSize, u8* dst, usize dstSize);
+	}  // namespace Codec
+
+	// Random-access reader over a compressed container. Keeps a small LRU cache of decompressed blocks so that the sequential small reads
+	// done by the NCCH loader and the RomFS archive don't decompress the same block over and over
+	class Reader {
+		static constexpr usize cacheSlotCount = 16;
+
+		struct CacheSlot {
+			u32 block = 0;
+			u64 lastUse = 0;  // 0 = slot is empty
+			std::vector<u8> data;
+		};
+
+		IOFile file;
+		Header header;
+		std::vector<BlockEntry> index;
+		std::array<CacheSlot, cacheSlotCount> cache;
+		std::vector<u8> compressedBuffer;
+		u64 useCounter = 0;
+		// Reads can come from the emulator thread and from the RomFS dumper at the same time
+		std::mutex mutex;
+
+		const u8* getBlock(u32 block);
+
+	  public:
+		// Parses the header and index of the container backing "file". Returns false if it is not a valid container
+		bool init(IOFile file);
+		u64 size() const { return header.uncompressedSize; }
+		u32 blockSize() const { return header.blockSize; }
+
+		// Reads up to "size" bytes at uncompressed offset "offset". Returns how many bytes were read
+		usize read(u64 offset, void* dst, usize size);
+	};
+
+	// Returns whether the file starts with the container magic. Does not change the file position
+	bool isCompressed(IOFile& file);
+
+	// Opens a ROM image for reading, transparently mounting it through a Reader if it is a compressed container
+	bool openROM(IOFile& file, const std::filesystem::path& path);
+
+	// Converts a raw NCSD/CXI image to the compressed container. The callback receives (bytes processed, total bytes) and may be empty
+	using ProgressCallback = std::function<void(u64, u64)>;
+	bool compressROM(
+		const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, u32 blockSize = defaultBlockSize,
+		const ProgressCallback& progress = {}
+	);
+}  // namespace CompressedROM
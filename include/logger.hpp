@@ -7,11 +7,11 @@
 #endif
 
 namespace Log {
-	// Our logger class
+	// Our logger class. Loggers hold no state, so they are constexpr and can be used from any number of emulator instances and threads at once
 	template <bool enabled>
 	class Logger {
 	  public:
-		void log(const char* fmt, ...) {
+		void log(const char* fmt, ...) const {
 			if constexpr (!enabled) return;
 
 			std::va_list args;
@@ -26,50 +26,50 @@ namespace Log {
 	};
 
 	// Our loggers here. Enable/disable by toggling the template param
-	static Logger<false> kernelLogger;
+	static constexpr Logger<false> kernelLogger;
 	// Enables output for the outputDebugString SVC
-	static Logger<true> debugStringLogger;
-	static Logger<false> errorLogger;
-	static Logger<false> fileIOLogger;
-	static Logger<false> svcLogger;
-	static Logger<false> threadLogger;
-	static Logger<false> gpuLogger;
-	static Logger<false> rendererLogger;
-	static Logger<false> shaderJITLogger;
-	static Logger<false> dspLogger;
+	static constexpr Logger<true> debugStringLogger;
+	static constexpr Logger<false> errorLogger;
+	static constexpr Logger<false> fileIOLogger;
+	static constexpr Logger<false> svcLogger;
+	static constexpr Logger<false> threadLogger;
+	static constexpr Logger<false> gpuLogger;
+	static constexpr Logger<false> rendererLogger;
+	static constexpr Logger<false> shaderJITLogger;
+	static constexpr Logger<false> dspLogger;
 
 	// Service loggers
-	static Logger<false> acLogger;
-	static Logger<false> actLogger;
-	static Logger<false> amLogger;
-	static Logger<false> aptLogger;
-	static Logger<false> bossLogger;
-	static Logger<false> camLogger;
-	static Logger<false> cecdLogger;
-	static Logger<false> cfgLogger;
-	static Logger<false> csndLogger;
-	static Logger<false> dspServiceLogger;
-	static Logger<false> dlpSrvrLogger;
-	static Logger<false> frdLogger;
-	static Logger<false> fsLogger;
-	static Logger<false> hidLogger;
-	static Logger<false> httpLogger;
-	static Logger<false> irUserLogger;
-	static Logger<false> gspGPULogger;
-	static Logger<false> gspLCDLogger;
-	static Logger<false> ldrLogger;
-	static Logger<false> mcuLogger;
-	static Logger<false> micLogger;
-	static Logger<false> newsLogger;
-	static Logger<false> nfcLogger;
-	static Logger<false> nwmUdsLogger;
-	static Logger<false> nimLogger;
-	static Logger<false> ndmLogger;
-	static Logger<false> ptmLogger;
-	static Logger<false> socLogger;
-	static Logger<false> sslLogger;
-	static Logger<false> y2rLogger;
-	static Logger<false> srvLogger;
+	static constexpr Logger<false> acLogger;
+	static constexpr Logger<false> actLogger;
+	static constexpr Logger<false> amLogger;
+	static constexpr Logger<false> aptLogger;
+	static constexpr Logger<false> bossLogger;
+	static constexpr Logger<false> camLogger;
+	static constexpr Logger<false> cecdLogger;
+	static constexpr Logger<false> cfgLogger;
+	static constexpr Logger<false> csndLogger;
+	static constexpr Logger<false> dspServiceLogger;
+	static constexpr Logger<false> dlpSrvrLogger;
+	static constexpr Logger<false> frdLogger;
+	static constexpr Logger<false> fsLogger;
+	static constexpr Logger<false> hidLogger;
+	static constexpr Logger<false> httpLogger;
+	static constexpr Logger<false> irUserLogger;
+	static constexpr Logger<false> gspGPULogger;
+	static constexpr Logger<false> gspLCDLogger;
+	static constexpr Logger<false> ldrLogger;
+	static constexpr Logger<false> mcuLogger;
+	static constexpr Logger<false> micLogger;
+	static constexpr Logger<false> newsLogger;
+	static constexpr Logger<false> nfcLogger;
+	static constexpr Logger<false> nwmUdsLogger;
+	static constexpr Logger<false> nimLogger;
+	static constexpr Logger<false> ndmLogger;
+	static constexpr Logger<false> ptmLogger;
+	static constexpr Logger<false> socLogger;
+	static constexpr Logger<false> sslLogger;
+	static constexpr Logger<false> y2rLogger;
+	static constexpr Logger<false> srvLogger;
 
 	// We have 2 ways to create a log function
 	// MAKE_LOG_FUNCTION: Creates a log function which is toggleable but always killed for user-facing builds
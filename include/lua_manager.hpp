@@ -22,6 +22,9 @@ extern "C" {
 }
 
 class LuaManager {
+	// The emulator our script thunks act on. Each Lua state stores a pointer to its manager in the registry, so that several emulator
+	// instances can run scripts at once. See the thunks in lua.cpp
+	Emulator& emulator;
 	lua_State* L = nullptr;
 	bool initialized = false;
 	bool haveScript = false;
@@ -29,11 +32,10 @@ class LuaManager {
 	void signalEventInternal(LuaEvent e);
 
   public:
-	// For Lua we must have some global pointers to our emulator objects to use them in script code via thunks. See the thunks in lua.cpp as an
-	// example
-	static Emulator* g_emulator;
+	LuaManager(Emulator& emulator) : emulator(emulator) {}
 
-	LuaManager(Emulator& emulator) { g_emulator = &emulator; }
+	// Returns the emulator of the manager that owns a Lua state, for use in thunks
+	static Emulator& getEmulator(lua_State* L);
 
 	void close();
 	void initialize();
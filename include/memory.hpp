@@ -1,8 +1,11 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -10,6 +13,7 @@
 #include "crypto/aes_engine.hpp"
 #include "handles.hpp"
 #include "helpers.hpp"
+#include "libc_hooks.hpp"
 #include "loader/ncsd.hpp"
 #include "loader/3dsx.hpp"
 #include "services/region_codes.hpp"
@@ -101,6 +105,8 @@ namespace KernelMemoryTypes {
 	};
 }
 
+class SaveStateStream;
+
 class Memory {
 	u8* fcram;
 	u8* dspRam;  // Provided to us by Audio
@@ -138,8 +144,48 @@ public:
 	static constexpr u32 DSP_CODE_MEMORY_OFFSET = u32(0_KB);
 	static constexpr u32 DSP_DATA_MEMORY_OFFSET = u32(256_KB);
 
+	static constexpr u32 VRAM_PAGE_COUNT = VirtualAddrs::VramSize / pageSize;
+
+	// Called with a physical address range of VRAM the CPU is about to access, when some of it is guarded
+	using VRAMFlushCallback = std::function<void(u32 paddr, u32 size)>;
+
 private:
 	std::bitset<FCRAM_PAGE_COUNT> usedFCRAMPages;
+
+	// Save state snapshots share a full copy of FCRAM, the keyframe, and only store the pages that changed since it was taken.
+	// To know which those are, every write through the page tables marks its FCRAM page as dirty here, as does anything else that
+	// writes FCRAM through a host pointer (see markFCRAMDirty). The bitmap only covers writes since the last capture or restore, and the
+	// pages that already differed from the keyframe at that point are in keyframeDiffPages. Keeping the two apart is what lets run-ahead
+	// restore the snapshot it just took by copying back only the pages touched since
+	std::array<u64, FCRAM_PAGE_COUNT / 64> dirtyFCRAMPages{};
+	std::array<u64, FCRAM_PAGE_COUNT / 64> keyframeDiffPages{};
+	// Pages written by the GPU thread, kept apart so that writes from the emulator thread don't need atomics. Merged into dirtyFCRAMPages
+	// once the GPU is idle, before taking or restoring a snapshot
+	std::array<std::atomic<u64>, FCRAM_PAGE_COUNT / 64> gpuDirtyFCRAMPages{};
+	std::shared_ptr<const u8[]> fcramKeyframe;
+	// Identifies the snapshot FCRAM was last captured to or restored from
+	u64 lastSnapshotID = 0;
+	// Once this many pages are dirty, snapshots get a new keyframe instead of copying all of them every time
+	static constexpr u32 keyframeDirtyPageLimit = FCRAM_PAGE_COUNT / 8;
+
+	void markHostWritesDirty();
+	void markFCRAMPageDirty(uintptr_t pagePointer) {
+		// Page table entries also point to DSP RAM, which wraps around to a huge offset here and is ignored
+		const uintptr_t offset = pagePointer - uintptr_t(fcram);
+		if (offset < FCRAM_SIZE) [[likely]] {
+			const u32 page = u32(offset >> pageShift);
+			dirtyFCRAMPages[page / 64] |= u64(1) << (page % 64);
+		}
+	}
+
+	// VRAM pages whose contents are stale because the renderer holds newer data for them, eg render targets drawn to on the host GPU.
+	// VRAM isn't in the page tables, so every CPU access to it goes through the slow path, where accessing a guarded page has the renderer
+	// write its data back first
+	std::bitset<VRAM_PAGE_COUNT> guardedVRAMPages;
+	VRAMFlushCallback vramFlushCallback;
+
+	// Returns a pointer to the VRAM backing a CPU access of "size" bytes at vaddr after flushing it, or nullptr if the access isn't to VRAM
+	u8* getVRAMPointer(u32 vaddr, u32 size);
 	std::optional<u32> findPaddr(u32 size);
 	u64 timeSince3DSEpoch();
 
@@ -162,6 +208,7 @@ private:
 	// Adjusted upon loading a ROM based on the ROM header. Used by CFG::SecureInfoGetArea to get past region locks
 	Regions region = Regions::USA;
 	const EmulatorConfig& config;
+	LibcHooks libcHooks;
 
 	static constexpr std::array<u8, 6> MACAddress = {0x40, 0xF4, 0x07, 0xFF, 0xFF, 0xEE};
 
@@ -193,8 +240,14 @@ private:
 	void write32(u32 vaddr, u32 value);
 	void write64(u32 vaddr, u64 value);
 
+	// Bulk copies between host buffers and guest virtual memory, walking the page tables once per page instead of once per byte
+	// Pages missing from the page tables (config memory, VRAM, etc) fall back to read8/write8 so they behave exactly like byte accesses
+	void readBlock(u32 vaddr, void* dst, u32 size);
+	void writeBlock(u32 vaddr, const void* src, u32 size);
+
 	u32 getLinearHeapVaddr();
 	u8* getFCRAM() { return fcram; }
+	LibcHooks& getLibcHooks() { return libcHooks; }
 
 	// Total amount of OS-only FCRAM available (Can vary depending on how much FCRAM the app requests via the cart exheader)
 	u32 totalSysFCRAM() {
@@ -277,6 +330,8 @@ private:
 	std::optional<HB3DSX> loaded3DSX = std::nullopt;
 	// File handle for reading the loaded ncch
 	IOFile CXIFile;
+	// Separate handle to the loaded ROM for the kernel's async I/O thread, so its reads don't race the emulator thread on the file position
+	IOFile asyncROMFile;
 
 	std::optional<u64> getProgramID();
 
@@ -286,9 +341,36 @@ private:
 	u32 getUsedUserMem() { return usedUserMemory; }
 
 	void setVRAM(u8* pointer) { vram = pointer; }
+	void setVRAMFlushCallback(VRAMFlushCallback callback) { vramFlushCallback = std::move(callback); }
+
+	// Sets whether the renderer holds newer data than VRAM for the physical range [paddr, paddr + size)
+	void setVRAMGuard(u32 paddr, u32 size, bool guarded);
+	// Makes sure VRAM in the physical range [paddr, paddr + size) is up to date, by having the renderer write back any guarded pages in it
+	void flushVRAM(u32 paddr, u32 size);
 	void setDSPMem(u8* pointer) { dspRam = pointer; }
 
 	bool allocateMainThreadStack(u32 size);
 	Regions getConsoleRegion();
 	void copySharedFont(u8* ptr);
+
+	// FCRAM contents of an in-memory snapshot, as a keyframe shared between snapshots plus the pages that differ from it
+	struct FCRAMSnapshot {
+		std::shared_ptr<const u8[]> keyframe;
+		std::vector<u32> pages;  // Indices of the pages stored in pageData
+		std::vector<u8> pageData;
+		u64 id = 0;
+	};
+
+	// Marks the FCRAM in the physical range [paddr, paddr + size) as modified, for code that writes FCRAM without going through the page
+	// tables, eg GPU DMAs and the LLE DSP. Ranges outside FCRAM are ignored
+	void markFCRAMDirty(u32 paddr, u32 size);
+	// Same as markFCRAMDirty, for writes made from the GPU thread
+	void markFCRAMDirtyFromGPU(u32 paddr, u32 size);
+	void captureFCRAM(FCRAMSnapshot& snapshot);
+	void restoreFCRAM(const FCRAMSnapshot& snapshot);
+
+	// Saves or loads everything but the contents of FCRAM, which either go in a snapshot or through doFCRAMState
+	void doState(SaveStateStream& stream);
+	// Saves or loads the allocated pages of FCRAM
+	void doFCRAMState(SaveStateStream& stream);
 };
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "emulator.hpp"
+#include "frame_limiter.hpp"
 #include "input_mappings.hpp"
 #include "panda_qt/about_window.hpp"
 #include "panda_qt/cheats_window.hpp"
@@ -50,6 +51,7 @@ class MainWindow : public QMainWindow {
 		PressTouchscreen,
 		ReleaseTouchscreen,
 		ReloadUbershader,
+		SetTurbo,
 	};
 
 	// Tagged union representing our message queue messages
@@ -81,6 +83,10 @@ class MainWindow : public QMainWindow {
 				u16 x;
 				u16 y;
 			} touchscreen;
+
+			struct {
+				bool enabled;
+			} turbo;
 		};
 	};
 
@@ -88,6 +94,12 @@ class MainWindow : public QMainWindow {
 	Emulator* emu = nullptr;
 	std::thread emuThread;
 
+	// With threaded presentation, the screen's GL context belongs to the presentation thread and the emulator renders on a shared context
+	std::thread presentThread;
+	std::unique_ptr<GL::Context> emuGLContext;
+	bool usingPresentThread = false;
+	FrameLimiter frameLimiter;
+
 	std::atomic<bool> appRunning = true;  // Is the application itself running?
 	// Used for synchronizing messages between the emulator and UI
 	std::mutex messageQueueMutex;
@@ -109,6 +121,7 @@ class MainWindow : public QMainWindow {
 
 	void swapEmuBuffer();
 	void emuThreadMainLoop();
+	void presentThreadMainLoop();
 	void selectLuaFile();
 	void selectROM();
 	void dumpDspFirmware();
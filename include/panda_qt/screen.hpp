@@ -12,6 +12,8 @@ class ScreenWidget : public QWidget {
   public:
 	ScreenWidget(QWidget* parent = nullptr);
 	GL::Context* getGLContext() { return glContext.get(); }
+	// Creates a context that shares objects with the screen's, for rendering on another thread while the screen's context presents
+	std::unique_ptr<GL::Context> createSharedGLContext();
 
 	// Dimensions of our output surface
 	u32 surfaceWidth = 0;
@@ -2,17 +2,36 @@
 
 #include <SDL.h>
 
+#include <atomic>
 #include <filesystem>
+#include <mutex>
+#include <vector>
 
 #include "emulator.hpp"
+#include "frame_limiter.hpp"
 #include "input_mappings.hpp"
 
 class FrontendSDL {
 	Emulator emu;
 #ifdef PANDA3DS_ENABLE_OPENGL
 	SDL_GLContext glContext;
+	// Context of the main thread when frames are presented on it while the emulator runs on a thread of its own. Shares objects with glContext
+	SDL_GLContext presentContext = nullptr;
 #endif
 
+	// With threaded presentation, events are still polled on the main thread as SDL wants, but handled on the emulator thread
+	std::mutex eventMutex;
+	std::vector<SDL_Event> pendingEvents;
+
+	FrameLimiter frameLimiter;
+	bool turbo = false;
+
+	void handleEvent(SDL_Event& event);
+	void updateInputs();
+	void setTurbo(bool enable);
+	void runThreaded();
+	void emuThreadMainLoop();
+
   public:
 	FrontendSDL();
 	bool loadROM(const std::filesystem::path& path);
@@ -24,8 +43,8 @@ class FrontendSDL {
 	InputMappings keyboardMappings;
 
 	int gameControllerID;
-	bool programRunning = true;
-	
+	std::atomic<bool> programRunning = true;
+
 	// For tracking whether to update gyroscope
 	// We bind gyro to right click + mouse movement
 	bool holdingRightClick = false;
@@ -1,8 +1,12 @@
 #pragma once
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <span>
 #include <string>
 #include <optional>
+#include <vector>
 
 #include "PICA/pica_vertex.hpp"
 #include "PICA/regs.hpp"
@@ -22,8 +26,13 @@ enum class RendererType : s8 {
 
 struct EmulatorConfig;
 class GPU;
+class PICAShader;
 struct SDL_Window;
 
+namespace PICA {
+	struct VertexConfig;
+}
+
 class Renderer {
   protected:
 	GPU& gpu;
@@ -44,10 +53,16 @@ class Renderer {
 
 	// Width and height of the window we're outputting to, needed for properly scaling the final image
 	// We initialize it to the 3DS resolution by default and the frontend can notify us if it changes via the setOutputSize function
-	u32 outputWindowWidth = 400;
-	u32 outputWindowHeight = 240 * 2;
+	// Atomic, as the thread presenting frames can read it while the frontend sets it from another thread
+	std::atomic<u32> outputWindowWidth = 400;
+	std::atomic<u32> outputWindowHeight = 240 * 2;
 
 	EmulatorConfig* emulatorConfig = nullptr;
+	// Directory of the running title's host files, for caches that are kept on disk. Empty if no title has been loaded
+	std::filesystem::path appDataPath;
+
+	// Scratch buffer for expanding indexed draws on backends that can only draw flat vertex arrays
+	std::vector<PICA::Vertex> expandedVertices;
 
   public:
 	Renderer(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs);
@@ -58,12 +73,32 @@ class Renderer {
 	static const char* typeToString(RendererType rendererType);
 
 	virtual void reset() = 0;
+	// Drops everything cached from emulated memory and registers after they were replaced, eg by loading a save state. Unlike reset, this
+	// can keep caches that don't depend on the emulated state, like compiled shaders
+	virtual void invalidateCaches() { reset(); }
 	virtual void display() = 0;                                                              // Display the 3DS screen contents to the window
 	virtual void initGraphicsContext(SDL_Window* window) = 0;                                // Initialize graphics context
 	virtual void clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) = 0;  // Clear a GPU buffer in VRAM
-	virtual void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) = 0;  // Perform display transfer
-	virtual void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) = 0;
+	// Perform display transfers and texture copies. By default these run on the CPU through the GPU's transfer engine, which backends with
+	// a faster path on the host GPU can also fall back to for transfers that path doesn't handle
+	virtual void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags);
+	virtual void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags);
 	virtual void drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) = 0;  // Draw the given vertices
+	// Draw the primitives formed by indexing into a buffer of unique transformed vertices. Backends without an indexed path get the
+	// vertices expanded and passed to drawVertices
+	virtual void drawIndexed(PICA::PrimType primType, std::span<const PICA::Vertex> vertices, std::span<const u16> indices);
+
+	// Hardware vertex shading: Backends that can run the PICA vertex shader themselves get the shader input attributes of each vertex
+	// instead of shaded vertices. prepareHwShader returns whether the backend can run the current shader for a draw of up to vertexCount
+	// vertices, if not the GPU shades on the CPU
+	virtual bool prepareHwShader(const PICAShader& shader, const PICA::VertexConfig& config, u32 vertexCount) { return false; }
+	// Draws using the shader set up by the last successful prepareHwShader. attributes holds config.inputCount attributes per vertex, and
+	// indices is empty for non-indexed draws
+	virtual void drawHwShaded(PICA::PrimType primType, std::span<const PICA::Vertex::vec4f> attributes, std::span<const u16> indices) {}
+
+	// Writes the data the renderer holds for VRAM in [paddr, paddr + size) back to VRAM. Called before the CPU accesses VRAM that the renderer
+	// guarded with GPU::setVRAMGuard, for backends that render to surfaces on the host GPU
+	virtual void flushVRAM(u32 paddr, u32 size) {}
 
 	virtual void screenshot(const std::string& name) = 0;
 	// Some frontends and platforms may require that we delete our GL or misc context and obtain a new one for things like exclusive fullscreen
@@ -79,6 +114,21 @@ class Renderer {
 
 	virtual void setUbershaderSetting(bool value) {}
 
+	// Whether the renderer can be driven from the GPU thread when asynchronous GPU emulation is enabled. Renderers that talk to a graphics
+	// context bound to the emulator thread can't be
+	virtual bool supportsCommandThread() { return false; }
+
+	// Threaded presentation, where display() hands finished frames over instead of drawing them to the window, and the frontend puts them on
+	// screen from a thread of its own, with a graphics context shared with the emulator thread's. Has to be enabled before the first frame
+	virtual bool supportsPresentThread() { return false; }
+	virtual void setPresentThreadEnabled(bool enable) {}
+	// Called from the presentation thread with its context current. Draws the newest frame to the window, or returns false if there's none yet
+	virtual bool presentFrame() { return false; }
+	// Called from the presentation thread before its context goes away
+	virtual void releasePresentContext() {}
+	// Blocks the presentation thread until a new frame comes in or the timeout runs out. Returns whether there's a new frame
+	virtual bool waitForFrame(std::chrono::microseconds timeout) { return false; }
+
 	// Functions for initializing the graphics context for the Qt frontend, where we don't have the convenience of SDL_Window
 #ifdef PANDA3DS_FRONTEND_QT
 	virtual void initGraphicsContext(GL::Context* context) { Helpers::panic("Tried to initialize incompatible renderer with GL context"); }
@@ -106,4 +156,5 @@ class Renderer {
 	}
 
 	void setConfig(EmulatorConfig* config) { emulatorConfig = config; }
+	void setAppDataPath(const std::filesystem::path& path) { appDataPath = path; }
 };
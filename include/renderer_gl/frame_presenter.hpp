@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <chrono>
+
+#include "frame_mailbox.hpp"
+#include "helpers.hpp"
+#include "opengl.hpp"
+
+// Hands finished frames from the emulator thread's GL context to a presentation thread with a context of its own, shared with the first.
+// Frames are copied into textures cycled through a FrameMailbox, which the presentation context blits to the window. Textures are shared
+// between contexts but framebuffer objects aren't, so each side has its own framebuffers for them.
+// Both directions are fenced: the presentation side waits for a frame to finish rendering before reading it, and the emulator side waits
+// for a presented frame to be read before rendering over it. The waits are glWaitSync, so they only order the GPU work and don't block
+class FramePresenter {
+	struct Slot {
+		OpenGL::Texture texture;
+		OpenGL::Framebuffer drawFramebuffer;  // Emulator context
+		GLuint readFramebuffer = 0;           // Presentation context
+		GLsync renderedFence = nullptr;       // Signalled on the emulator context once the frame is in the texture
+		GLsync presentedFence = nullptr;      // Signalled on the presentation context once the frame has been blitted to the window
+	};
+
+	std::array<Slot, FrameMailbox::slotCount> slots;
+	FrameMailbox mailbox;
+
+	u32 width = 0;
+	u32 height = 0;
+	bool initialized = false;
+	bool hasFrame = false;  // Whether the presentation side has taken a frame yet. Before that the consumer slot holds nothing
+
+	static void waitAndDelete(GLsync& fence);
+
+  public:
+	bool isInitialized() const { return initialized; }
+
+	// Emulator context. Creates the frame textures, of the same size as the frames that will be published
+	void init(u32 width, u32 height);
+	// Emulator context. Copies the frame in source and hands it over to the presentation thread
+	void publish(OpenGL::Framebuffer& source);
+	// Emulator context. Frees the textures, once the presentation side is done with them
+	void free();
+
+	// Presentation context. Blits the newest frame to the default framebuffer, scaled to the given size, and returns false if there's no
+	// frame yet. The last frame is drawn again if no new one came in
+	bool present(u32 outputWidth, u32 outputHeight);
+	// Presentation context. Frees its framebuffers, before the context goes away
+	void releasePresentContext();
+
+	// Blocks the presentation thread until a new frame comes in or the timeout runs out. Returns whether there's a new frame
+	bool waitForFrame(std::chrono::microseconds timeout) { return mailbox.waitForFrame(timeout); }
+};
@@ -5,18 +5,23 @@
 #include <functional>
 #include <span>
 #include <unordered_map>
+#include <vector>
 
 #include "PICA/float_types.hpp"
 #include "PICA/pica_frag_config.hpp"
 #include "PICA/pica_hash.hpp"
+#include "PICA/pica_vert_config.hpp"
 #include "PICA/pica_vertex.hpp"
 #include "PICA/regs.hpp"
 #include "PICA/shader_gen.hpp"
+#include "frame_presenter.hpp"
 #include "gl_state.hpp"
 #include "helpers.hpp"
 #include "logger.hpp"
 #include "renderer.hpp"
+#include "stream_buffer.hpp"
 #include "surface_cache.hpp"
+#include "surface_readback.hpp"
 #include "textures.hpp"
 
 // More circular dependencies!
@@ -29,7 +34,34 @@ class RendererGL final : public Renderer {
 	OpenGL::Program displayProgram;
 
 	OpenGL::VertexArray vao;
-	OpenGL::VertexBuffer vbo;
+	// Streaming ring buffers for vertex and index data. The vertex one is bound to the VAO as its vertex buffer, the index one as its element buffer
+	StreamBuffer vertexStream;
+	StreamBuffer indexStream;
+	static constexpr u32 vertexStreamSize = 16 * 1024 * 1024;
+	static constexpr u32 indexStreamSize = 1024 * 1024;
+
+	// Consecutive draws with the same state are queued up here, and submitted together as one multi-draw once the state changes or
+	// something else needs the GPU
+	struct DrawBatch {
+		PICA::PrimType primType;
+		OpenGL::Primitives topology;
+		bool indexed = false;
+		OpenGL::Shader* vertexShader = nullptr;  // Hardware vertex shader the draws use, if any
+
+		std::vector<GLint> firsts;  // First vertex of each draw, or its base vertex for indexed draws
+		std::vector<GLsizei> counts;
+		std::vector<const void*> indexOffsets;  // Offset of each draw's indices in the index buffer, for indexed draws
+
+		bool empty() const { return counts.empty(); }
+		void clear() {
+			firsts.clear();
+			counts.clear();
+			indexOffsets.clear();
+		}
+	} drawBatch;
+
+	bool supportsMultiDraw = false;
+	bool supportsBaseVertex = false;
 	bool enableUbershader = true;
 
 	// Data 
@@ -54,10 +86,25 @@ class RendererGL final : public Renderer {
 	float oldDepthOffset = 0.0;
 	bool oldDepthmapEnable = false;
 
+	// PICA::RegisterGroup flags for host state that was changed outside of draws (eg by display or clearBuffer) and needs to be set up again
+	u32 clobberedRegisterGroups = PICA::RegisterGroup::All;
+	// Groups that changed since the ubershader uniforms were last uploaded, or since lastSpecializedProgram's UBO was last filled.
+	// These are tracked separately as draws can switch between the ubershader and shadergen
+	u32 ubershaderDirtyGroups = PICA::RegisterGroup::All;
+	u32 specializedDirtyGroups = PICA::RegisterGroup::All;
+
 	SurfaceCache<DepthBuffer, 16, true> depthBufferCache;
 	SurfaceCache<ColourBuffer, 16, true> colourBufferCache;
 	SurfaceCache<Texture, 256, true> textureCache;
 
+	// Writing rendered surfaces back to VRAM. Every GPU write to a surface gives it a new write serial, so serials are unique across surfaces
+	SurfaceReadback surfaceReadback;
+	FramePresenter framePresenter;
+	bool presentThreadEnabled = false;
+	// How many texture copies we've had to do on the CPU. We stop printing about it after a few, so as not to spam the console
+	int cpuTextureCopyCount = 0;
+	u64 nextWriteSerial = 1;
+
 	// Dummy VAO/VBO for blitting the final output
 	OpenGL::VertexArray dummyVAO;
 	OpenGL::VertexBuffer dummyVBO;
@@ -74,8 +121,32 @@ class RendererGL final : public Renderer {
 	struct CachedProgram {
 		OpenGL::Program program;
 		uint uboBinding;
+
+		// The fragment shader linked with each hardware vertex shader it was used with, keyed by vertex shader handle
+		OpenGL::Shader fragmentShader;
+		std::unordered_map<GLuint, OpenGL::Program> hwShaderPrograms;
+
+		OpenGL::Program& getProgram(OpenGL::Shader* vertexShader) {
+			return vertexShader == nullptr ? program : hwShaderPrograms[vertexShader->handle()];
+		}
 	};
 	std::unordered_map<PICA::FragmentConfig, CachedProgram> shaderCache;
+	CachedProgram* lastSpecializedProgram = nullptr;
+	OpenGL::Shader* lastSpecializedVertexShader = nullptr;
+
+	// Hardware vertex shading. Vertex shaders are cached by PICA program and I/O configuration. Programs that couldn't be translated are
+	// cached as shaders that don't exist, so that we only try once
+	std::unordered_map<PICA::VertexConfig, OpenGL::Shader> hwShaderCache;
+	OpenGL::Shader* hwVertexShader = nullptr;  // Shader of the current draw, or nullptr if its vertices were shaded on the CPU
+	u32 hwShaderStride = 0;                    // Bytes per vertex of the shader input attributes
+
+	// The VAO for hardware shaded draws, which feeds the shader input attributes as vec4s
+	OpenGL::VertexArray hwShaderVao;
+	u32 hwShaderVaoStride = 0;
+
+	static constexpr uint hwShaderUboBinding = 3;
+	GLuint hwShaderUbo = 0;
+	PICA::VertexUniforms hwShaderUniforms;
 
 	OpenGL::Framebuffer getColourFBO();
 	OpenGL::Texture getTexture(Texture& tex);
@@ -85,6 +156,8 @@ class RendererGL final : public Renderer {
 
 	MAKE_LOG_FUNCTION(log, rendererLogger)
 	void setupBlending();
+	void setupDraw(PICA::PrimType primType, bool indexed);
+	void flushDraws();
 	void setupStencilTest(bool stencilEnable);
 	void bindDepthBuffer();
 	void setupUbershaderTexEnv();
@@ -93,31 +166,61 @@ class RendererGL final : public Renderer {
 	void updateFogLUT();
 	void initGraphicsContextInternal();
 
+	// Marks a surface as written by the GPU, guarding its VRAM until it's written back
+	template <typename SurfaceType>
+	void markSurfaceWritten(SurfaceType& surface);
+	// Writes back finished surface downloads, waiting for the unfinished ones if wait is set, and updates the VRAM guards accordingly
+	void completeReadbacks(bool wait);
+	void guardDirtySurfaces();
+
   public:
 	RendererGL(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
 		: Renderer(gpu, internalRegs, externalRegs), fragShaderGen(PICA::ShaderGen::API::GL, PICA::ShaderGen::Language::GLSL) {}
 	~RendererGL() override;
 
 	void reset() override;
+	void invalidateCaches() override;
 	void display() override;                                                              // Display the 3DS screen contents to the window
 	void initGraphicsContext(SDL_Window* window) override;                                // Initialize graphics context
 	void clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) override;  // Clear a GPU buffer in VRAM
 	void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) override;  // Perform display transfer
 	void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) override;
 	void drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) override;             // Draw the given vertices
+	void drawIndexed(PICA::PrimType primType, std::span<const PICA::Vertex> vertices, std::span<const u16> indices) override;
+	bool prepareHwShader(const PICAShader& shader, const PICA::VertexConfig& config, u32 vertexCount) override;
+	void drawHwShaded(PICA::PrimType primType, std::span<const PICA::Vertex::vec4f> attributes, std::span<const u16> indices) override;
+	void flushVRAM(u32 paddr, u32 size) override;
 	void deinitGraphicsContext() override;
 
 	virtual bool supportsShaderReload() override { return true; }
 	virtual std::string getUbershader() override;
 	virtual void setUbershader(const std::string& shader) override;
 
-	virtual void setUbershaderSetting(bool value) override { enableUbershader = value; }
+	virtual void setUbershaderSetting(bool value) override {
+		flushDraws();
+		enableUbershader = value;
+		clobberedRegisterGroups = PICA::RegisterGroup::All;
+	}
+
+	bool supportsPresentThread() override { return true; }
+	void setPresentThreadEnabled(bool enable) override;
+	bool presentFrame() override { return framePresenter.present(outputWindowWidth, outputWindowHeight); }
+	void releasePresentContext() override { framePresenter.releasePresentContext(); }
+	bool waitForFrame(std::chrono::microseconds timeout) override { return framePresenter.waitForFrame(timeout); }
 	
 	std::optional<ColourBuffer> getColourBuffer(u32 addr, PICA::ColorFmt format, u32 width, u32 height, bool createIfnotFound = true);
 
 	// Note: The caller is responsible for deleting the currently bound FBO before calling this
-	void setFBO(uint handle) { screenFramebuffer.m_handle = handle; }
-	void resetStateManager() { gl.reset(); }
+	void setFBO(uint handle) {
+		flushDraws();
+		screenFramebuffer.m_handle = handle;
+	}
+
+	void resetStateManager() {
+		flushDraws();
+		gl.reset();
+		clobberedRegisterGroups = PICA::RegisterGroup::All;
+	}
 	void clearShaderCache();
 	void initUbershader(OpenGL::Program& program);
 
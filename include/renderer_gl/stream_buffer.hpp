@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+
+#include "helpers.hpp"
+#include "opengl.hpp"
+
+// Ring buffer for streaming per-draw data (vertices, indices) to the GPU without making the driver synchronize on every upload.
+// If the driver supports buffer storage, the buffer is mapped once and stays mapped. Otherwise every upload maps its range unsynchronized.
+// The buffer is split into segments, each guarded by a fence: Before the write pointer moves into a segment, we wait until the GPU is done
+// with the draws that last read from it.
+// This means that draws reading uploaded data have to be submitted before the next call to fence(), and since the data written between 2 fences
+// must not wrap around onto itself, callers should submit their draws and fence whenever needsFence() returns true.
+class StreamBuffer {
+	static constexpr u32 segmentCount = 4;
+
+	GLuint handle = 0;
+	u8* mappedPointer = nullptr;  // Persistent mapping, or nullptr if we map on every upload
+	u32 size = 0;
+	u32 segmentSize = 0;
+
+	u32 position = 0;          // Write pointer
+	u32 currentSegment = 0;    // Segment the write pointer is in
+	u32 unfencedBytes = 0;     // Bytes consumed since the last fence, including padding
+	u32 unfencedSegments = 0;  // Bitmask of segments written to since the last fence
+	std::array<GLsync, segmentCount> fences{};
+
+	void waitForSegment(u32 segment);
+
+  public:
+	// (Re)creates the buffer, freeing the previous one if there is one
+	void create(u32 bufferSize);
+	void release();
+
+	GLuint getHandle() const { return handle; }
+	bool isPersistent() const { return mappedPointer != nullptr; }
+	bool needsFence(u32 bytes) const { return unfencedBytes + bytes > segmentSize; }
+
+	// Copies data into the buffer and returns the offset it was placed at, which is a multiple of alignment
+	u32 upload(const void* data, u32 bytes, u32 alignment);
+	// Fences every segment written since the last fence. Must be called after submitting the draws that read the data
+	void fence();
+};
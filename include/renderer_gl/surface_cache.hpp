@@ -99,6 +99,10 @@ public:
 		Helpers::panic("Couldn't add surface to cache\n");
 	}
 
+    // Iteration goes over every slot of the cache, including the ones holding invalid surfaces
+    auto begin() { return buffer.begin(); }
+    auto end() { return buffer.end(); }
+
     SurfaceType& operator[](size_t i) {
         return buffer[i];
     }
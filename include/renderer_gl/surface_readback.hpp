@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+
+#include "PICA/regs.hpp"
+#include "helpers.hpp"
+#include "opengl.hpp"
+
+// Downloads of rendered colour and depth surfaces, for writing them back to emulated VRAM.
+// Surfaces are read into pixel buffer objects and the downloads are fenced, so starting one doesn't stall the pipeline. Their data is only
+// mapped and written back once the fence has signaled, which is usually by the next frame, unless the CPU needs it right away.
+class SurfaceReadback {
+  public:
+	// The surface a download reads, and where its data goes in VRAM
+	struct Surface {
+		u32 location;  // Physical address, must be in VRAM
+		u32 width;
+		u32 height;
+		bool depth;
+		u32 format;       // PICA::ColorFmt for colour surfaces, PICA::DepthFmt for depth ones
+		u64 writeSerial;  // The surface's write serial when the download started, which identifies the surface and its contents
+	};
+
+  private:
+	struct Download {
+		Surface surface;
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	std::vector<Download> downloads;
+	std::vector<GLuint> freeBuffers;
+
+	// Converts the surface from the host format read back by glReadPixels to the PICA format, and tiles it into VRAM
+	static void encode(const Surface& surface, const u8* pixels, u8* vram);
+
+  public:
+	// Starts downloading a surface, which must be attached to fbo
+	void start(const Surface& surface, OpenGL::Framebuffer& fbo);
+	bool isPending(u64 writeSerial) const;
+
+	// Writes downloads back to VRAM and returns the write serials of the surfaces they came from.
+	// Downloads that haven't finished yet are waited on if wait is set, and kept for a later call otherwise.
+	// Downloads for which isCurrent returns false have been superseded by later GPU writes to their surface, and are dropped unwritten
+	template <typename IsCurrent>
+	std::vector<u64> complete(u8* vram, bool wait, IsCurrent isCurrent) {
+		std::vector<u64> written;
+
+		for (auto it = downloads.begin(); it != downloads.end();) {
+			Download& download = *it;
+
+			if (!isCurrent(download.surface.writeSerial)) {
+				release(download);
+				it = downloads.erase(it);
+				continue;
+			}
+
+			if (!waitForDownload(download, wait)) {
+				++it;
+				continue;
+			}
+
+			writeBack(download, vram);
+			written.push_back(download.surface.writeSerial);
+			release(download);
+			it = downloads.erase(it);
+		}
+
+		return written;
+	}
+
+	// Drops every download and frees the buffers
+	void reset();
+
+  private:
+	// Returns whether the download has finished, waiting for it to if wait is set
+	bool waitForDownload(Download& download, bool wait);
+	void writeBack(const Download& download, u8* vram);
+	void release(Download& download);
+};
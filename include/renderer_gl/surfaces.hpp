@@ -20,6 +20,12 @@ struct ColourBuffer {
 	OpenGL::Texture texture;
 	OpenGL::Framebuffer fbo;
 
+	// Readback tracking (See RendererGL::flushVRAM). writeSerial identifies the last GPU write to the surface, and readbackSerial the write
+	// VRAM was last brought up to date with. cpuAccessed marks surfaces the CPU has read back before, which get downloaded every frame
+	u64 writeSerial = 0;
+	u64 readbackSerial = 0;
+	bool cpuAccessed = false;
+
 	ColourBuffer() : valid(false) {}
 
 	ColourBuffer(u32 loc, PICA::ColorFmt format, u32 x, u32 y, bool valid = true) : location(loc), format(format), size({x, y}), valid(valid) {
@@ -83,6 +89,8 @@ struct ColourBuffer {
 		return Math::Rect<u32>{x0, size.y() - y0, x0 + width, size.y() - height - y0};
 	}
 
+	bool isGPUDirty() const { return writeSerial != readbackSerial; }
+
 	bool matches(ColourBuffer& other) {
 		return location == other.location && format == other.format && size.x() == other.size.x() && size.y() == other.size.y();
 	}
@@ -104,6 +112,11 @@ struct DepthBuffer {
 	OpenGL::Texture texture;
 	OpenGL::Framebuffer fbo;
 
+	// Readback tracking, same as for colour buffers
+	u64 writeSerial = 0;
+	u64 readbackSerial = 0;
+	bool cpuAccessed = false;
+
 	DepthBuffer() : valid(false) {}
 
 	DepthBuffer(u32 loc, PICA::DepthFmt format, u32 x, u32 y, bool valid = true) : location(loc), format(format), size({x, y}), valid(valid) {
@@ -165,6 +178,8 @@ struct DepthBuffer {
 		}
 	}
 
+	bool isGPUDirty() const { return writeSerial != readbackSerial; }
+
 	bool matches(DepthBuffer& other) {
 		return location == other.location && format == other.format && size.x() == other.size.x() && size.y() == other.size.y();
 	}
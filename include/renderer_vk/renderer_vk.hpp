@@ -1,5 +1,7 @@
+#include <filesystem>
 #include <map>
 #include <optional>
+#include <tuple>
 
 #include "math_util.hpp"
 #include "renderer.hpp"
@@ -49,13 +51,10 @@ class RendererVK final : public Renderer {
 	std::vector<vk::UniqueSemaphore> swapImageFreeSemaphore = {};
 	std::vector<vk::UniqueSemaphore> renderFinishedSemaphore = {};
 	std::vector<vk::UniqueFence> frameFinishedFences = {};
-	std::vector<std::vector<vk::UniqueFramebuffer>> frameFramebuffers = {};
 	std::vector<vk::UniqueCommandBuffer> frameCommandBuffers = {};
 
 	const vk::CommandBuffer& getCurrentCommandBuffer() const { return frameCommandBuffers[frameBufferingIndex].get(); }
 
-	// Todo:
-	// Use `{colourBuffer,depthBuffer}Loc` to maintain an std::map-cache of framebuffers
 	struct Texture {
 		u32 loc = 0;
 		u32 sizePerPixel = 0;
@@ -66,6 +65,10 @@ class RendererVK final : public Renderer {
 		vk::UniqueDeviceMemory imageMemory;
 		vk::UniqueImageView imageView;
 
+		// Clears are deferred until the texture is next used, so that a render pass starting on it can clear it through its load op
+		// instead of a separate clear and the barriers around it
+		std::optional<vk::ClearValue> pendingClear;
+
 		Math::Rect<u32> getSubRect(u32 inputAddress, u32 width, u32 height) {
 			// PICA textures have top-left origin, same as Vulkan
 			const u32 startOffset = (inputAddress - loc) / sizePerPixel;
@@ -80,6 +83,8 @@ class RendererVK final : public Renderer {
 	Texture* findRenderTexture(u32 addr);
 	Texture& getColorRenderTexture(u32 addr, PICA::ColorFmt format, u32 width, u32 height);
 	Texture& getDepthRenderTexture(u32 addr, PICA::DepthFmt format, u32 width, u32 height);
+	void clearTexture(Texture& texture, const vk::ClearValue& value);
+	void flushPendingClear(Texture& texture);
 
 	// Framebuffer for the top/bottom image
 	std::vector<vk::UniqueImage> screenTexture = {};
@@ -89,9 +94,27 @@ class RendererVK final : public Renderer {
 
 	std::map<u64, vk::UniqueRenderPass> renderPassCache;
 
-	vk::RenderPass getRenderPass(vk::Format colorFormat, std::optional<vk::Format> depthFormat);
+	// Render passes only differ in their load ops when clearing, which doesn't affect compatibility, so they can all share the same framebuffers
+	vk::RenderPass getRenderPass(vk::Format colorFormat, std::optional<vk::Format> depthFormat, bool clearColor = false, bool clearDepth = false);
 	vk::RenderPass getRenderPass(PICA::ColorFmt colorFormat, std::optional<PICA::DepthFmt> depthFormat);
 
+	// Render target framebuffers, keyed by (colour view, depth view, width, height). They live as long as the render textures they use
+	std::map<std::tuple<VkImageView, VkImageView, u32, u32>, vk::UniqueFramebuffer> framebufferCache;
+	vk::Framebuffer getFramebuffer(Texture& colorTexture, Texture* depthTexture);
+
+	// Consecutive draws to the same framebuffer are recorded into one render pass, which stays open until something else needs the
+	// command buffer or the draws move to another framebuffer
+	vk::Framebuffer activeFramebuffer = {};
+	void beginRenderPass(vk::Framebuffer framebuffer, Texture& colorTexture, Texture* depthTexture);
+	void endRenderPass();
+
+	// Pipeline cache, persisted in the app data folder of the running title
+	vk::UniquePipelineCache pipelineCache = {};
+	std::filesystem::path pipelineCachePath;
+	bool pipelineCacheNeedsLoad = true;
+	void loadPipelineCache();
+	void savePipelineCache();
+
 	std::unique_ptr<Vulkan::DescriptorUpdateBatch> descriptorUpdateBatch;
 	std::unique_ptr<Vulkan::SamplerCache> samplerCache;
 
@@ -116,7 +139,6 @@ class RendererVK final : public Renderer {
 	void initGraphicsContext(SDL_Window* window) override;
 	void clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) override;
 	void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) override;
-	void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) override;
 	void drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) override;
 	void screenshot(const std::string& name) override;
 	void deinitGraphicsContext() override;
@@ -0,0 +1,212 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "helpers.hpp"
+
+// Serialization stream for save states. Every subsystem has a single doState function that goes through its state in a fixed order, and the
+// same function is used both for saving and loading depending on the mode of the stream, so the two can't go out of sync.
+// Reads past the end of the buffer or mismatching section tags mark the stream as failed instead of panicking, so that a bad state file
+// can be rejected. Values read from a failed stream are zeroed.
+class SaveStateStream {
+  public:
+	enum class Mode {
+		Read,     // Load state from a buffer
+		Write,    // Append state to a buffer
+		Measure,  // Only count how many bytes a write would take
+	};
+
+  private:
+	Mode mode;
+	std::vector<u8>* output = nullptr;
+	std::span<const u8> input;
+	usize offset = 0;
+	bool failed = false;
+	bool keepHostCaches = false;
+
+	SaveStateStream(Mode mode) : mode(mode) {}
+
+  public:
+	static SaveStateStream writer(std::vector<u8>& output) {
+		SaveStateStream stream(Mode::Write);
+		stream.output = &output;
+		return stream;
+	}
+
+	static SaveStateStream reader(std::span<const u8> input) {
+		SaveStateStream stream(Mode::Read);
+		stream.input = input;
+		return stream;
+	}
+
+	static SaveStateStream measurer() { return SaveStateStream(Mode::Measure); }
+
+	bool isReading() const { return mode == Mode::Read; }
+	bool isWriting() const { return mode != Mode::Read; }
+	bool hasFailed() const { return failed; }
+	// Number of bytes read, written or measured so far
+	usize size() const { return offset; }
+
+	// Marks the stream as failed, for subsystems that find the state they're loading makes no sense
+	void fail() { failed = true; }
+
+	// Set when restoring a snapshot taken moments ago, like run-ahead's. What the host caches from emulated state (eg the renderer's surfaces
+	// and textures) is no more out of date than after any other few frames of emulation then, so it doesn't need to be thrown away
+	void setKeepHostCaches(bool keep) { keepHostCaches = keep; }
+	bool keepsHostCaches() const { return keepHostCaches; }
+
+	void bytes(void* data, usize count) {
+		switch (mode) {
+			case Mode::Read:
+				if (failed || count > input.size() - offset) [[unlikely]] {
+					failed = true;
+					std::memset(data, 0, count);
+					return;
+				}
+
+				std::memcpy(data, &input[offset], count);
+				break;
+
+			case Mode::Write: {
+				const usize oldSize = output->size();
+				output->resize(oldSize + count);
+				std::memcpy(output->data() + oldSize, data, count);
+				break;
+			}
+
+			case Mode::Measure: break;
+		}
+
+		offset += count;
+	}
+
+	template <typename T>
+	void value(T& value) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be saved as raw bytes");
+		bytes(&value, sizeof(T));
+	}
+
+	// Marks the start of a subsystem's state. When loading, the tag has to match, which catches states that went out of sync early
+	void section(const char (&tag)[5]) {
+		u32 expected;
+		std::memcpy(&expected, tag, sizeof(u32));
+
+		u32 found = expected;
+		value(found);
+		if (found != expected) {
+			failed = true;
+		}
+	}
+
+	// Sizes are stored as u32. When loading, they are checked against what's left in the buffer so a corrupt size can't make us allocate
+	// gigabytes before the stream fails
+	u32 count(usize size, usize elementSize) {
+		u32 stored = u32(size);
+		value(stored);
+
+		if (isReading() && u64(stored) * elementSize > input.size() - std::min(offset, input.size())) [[unlikely]] {
+			failed = true;
+			return 0;
+		}
+
+		return stored;
+	}
+
+	template <typename T>
+	void vector(std::vector<T>& vec) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only vectors of trivially copyable types can be saved as raw bytes");
+		const u32 size = count(vec.size(), sizeof(T));
+
+		if (isReading()) {
+			vec.resize(size);
+		}
+		bytes(vec.data(), size * sizeof(T));
+	}
+
+	template <typename T>
+	void optional(std::optional<T>& opt) {
+		bool hasValue = opt.has_value();
+		value(hasValue);
+
+		if (isReading()) {
+			if (hasValue) {
+				T data{};
+				value(data);
+				opt = data;
+			} else {
+				opt = std::nullopt;
+			}
+		} else if (hasValue) {
+			value(opt.value());
+		}
+	}
+
+	template <typename Char>
+	void string(std::basic_string<Char>& str) {
+		const u32 size = count(str.size(), sizeof(Char));
+
+		if (isReading()) {
+			str.resize(size);
+		}
+		bytes(str.data(), size * sizeof(Char));
+	}
+
+	void path(std::filesystem::path& path) {
+		std::u8string str = isReading() ? std::u8string() : path.u8string();
+		string(str);
+
+		if (isReading()) {
+			path = std::filesystem::path(str);
+		}
+	}
+
+	// Host pointers into FCRAM, like the shared memory pointers services hold, are saved as offsets into FCRAM
+	void fcramPointer(u8*& pointer, u8* fcram) {
+		constexpr u32 null = 0xFFFFFFFF;
+		u32 fcramOffset = (pointer == nullptr) ? null : u32(pointer - fcram);
+		value(fcramOffset);
+
+		if (isReading()) {
+			pointer = (fcramOffset == null) ? nullptr : fcram + fcramOffset;
+		}
+	}
+
+	template <usize size>
+	void bitset(std::bitset<size>& bits) {
+		std::array<u64, (size + 63) / 64> words{};
+
+		if (isWriting()) {
+			for (usize i = 0; i < size; i++) {
+				words[i / 64] |= u64(bits[i]) << (i % 64);
+			}
+		}
+
+		value(words);
+		if (isReading()) {
+			for (usize i = 0; i < size; i++) {
+				bits[i] = (words[i / 64] >> (i % 64)) & 1;
+			}
+		}
+	}
+};
+
+namespace SaveState {
+	static constexpr u32 magic = 0x53533350;  // "P3SS"
+	// Bump whenever the layout of any doState function changes. Older states are rejected rather than misread
+	static constexpr u32 version = 3;
+
+	struct Header {
+		u32 magic;
+		u32 version;
+		u64 programID;    // Title ID of the running game, or 0 for homebrew. States only load into the game they were made with
+		u64 payloadSize;  // Bytes of state following the header. Anything after that, like libretro's padding, is ignored
+	};
+}  // namespace SaveState
@@ -5,6 +5,7 @@
 
 #include "helpers.hpp"
 #include "logger.hpp"
+#include "savestate.hpp"
 
 struct Scheduler {
 	enum class EventType {
@@ -12,7 +13,10 @@ struct Scheduler {
 		UpdateTimers = 1,    // Update kernel timer objects
 		RunDSP = 2,          // Make the emulated DSP run for one audio frame
 		SignalY2R = 3,       // Signal that a Y2R conversion has finished
-		Panic = 4,           // Dummy event that is always pending and should never be triggered (Timestamp = UINT64_MAX)
+		PollAsyncIO = 4,     // Deliver the replies of file operations that finished on the host I/O thread
+		FlushSaveData = 5,   // Commit the save data writes gathered in the write-back cache to the host
+		PollGPU = 6,         // Raise the interrupts of GX commands that finished on the GPU thread
+		Panic = 7,           // Dummy event that is always pending and should never be triggered (Timestamp = UINT64_MAX)
 		TotalNumberOfEvents  // How many event types do we have in total?
 	};
 	static constexpr usize totalNumberOfEvents = static_cast<usize>(EventType::TotalNumberOfEvents);
@@ -56,6 +60,43 @@ struct Scheduler {
 		addEvent(EventType::Panic, std::numeric_limits<u64>::max());
 	}
 
+	void doState(SaveStateStream& stream) {
+		stream.section("SCHD");
+		stream.value(currentTimestamp);
+
+		const u32 eventCount = stream.count(events.size(), sizeof(u64) + sizeof(EventType));
+		if (stream.isReading()) {
+			events.clear();
+
+			for (u32 i = 0; i < eventCount; i++) {
+				u64 timestamp;
+				EventType type;
+				stream.value(timestamp);
+				stream.value(type);
+
+				if (events.size() == totalNumberOfEvents || type >= EventType::TotalNumberOfEvents) [[unlikely]] {
+					stream.fail();
+					break;
+				}
+				events.emplace(timestamp, type);
+			}
+
+			// The dummy event must always be there, even if the state was garbage
+			if (stream.hasFailed() || events.empty()) {
+				events.clear();
+				events.emplace(std::numeric_limits<u64>::max(), EventType::Panic);
+			}
+			updateNextTimestamp();
+		} else {
+			for (auto& [timestamp, type] : events) {
+				u64 eventTimestamp = timestamp;
+				EventType eventType = type;
+				stream.value(eventTimestamp);
+				stream.value(eventType);
+			}
+		}
+	}
+
   private:
 	static constexpr u64 MAX_VALUE_TO_MULTIPLY = std::numeric_limits<s64>::max() / arm11Clock;
 
@@ -30,5 +30,6 @@ class ACService {
   public:
 	ACService(Memory& mem) : mem(mem) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 };
\ No newline at end of file
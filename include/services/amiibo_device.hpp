@@ -4,6 +4,8 @@
 #include "io_file.hpp"
 #include "nfc_types.hpp"
 
+class SaveStateStream;
+
 class AmiiboDevice {
 	bool loaded = false;
 	bool encrypted = false;
@@ -14,4 +16,5 @@ class AmiiboDevice {
 
 	void loadFromRaw();
 	void reset();
+	void doState(SaveStateStream& stream);
 };
\ No newline at end of file
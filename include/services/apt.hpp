@@ -102,5 +102,6 @@ class APTService {
 public:
 	APTService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel), appletManager(mem) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 };
\ No newline at end of file
@@ -38,5 +38,6 @@ class BOSSService {
 public:
 	BOSSService(Memory& mem) : mem(mem) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 };
\ No newline at end of file
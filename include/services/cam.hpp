@@ -55,5 +55,6 @@ class CAMService {
   public:
 	CAMService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 };
\ No newline at end of file
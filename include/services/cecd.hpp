@@ -23,5 +23,6 @@ class CECDService {
 public:
 	CECDService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 };
\ No newline at end of file
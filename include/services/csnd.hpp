@@ -28,6 +28,7 @@ class CSNDService {
   public:
 	CSNDService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 
 	void setSharedMemory(u8* ptr) {
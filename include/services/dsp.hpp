@@ -6,6 +6,7 @@
 
 #include "audio/dsp_core.hpp"
 #include "helpers.hpp"
+#include "ipc.hpp"
 #include "logger.hpp"
 #include "memory.hpp"
 #include "result/result.hpp"
@@ -40,24 +41,25 @@ class DSPService {
 	std::vector<u8> loadedComponent;
 
 	// Service functions
-	void convertProcessAddressFromDspDram(u32 messagePointer);  // Nice function name
-	void flushDataCache(u32 messagePointer);
-	void getHeadphoneStatus(u32 messagePointer);
-	void getSemaphoreEventHandle(u32 messagePointer);
-	void invalidateDCache(u32 messagePointer);
-	void loadComponent(u32 messagePointer);
-	void readPipeIfPossible(u32 messagePointer);
-	void recvData(u32 messagePointer);
-	void recvDataIsReady(u32 messagePointer);
-	void registerInterruptEvents(u32 messagePointer);
-	void setSemaphore(u32 messagePointer);
-	void setSemaphoreMask(u32 messagePointer);
-	void unloadComponent(u32 messagePointer);
-	void writeProcessPipe(u32 messagePointer);
+	void convertProcessAddressFromDspDram(IPC::CommandBuffer& cmd);  // Nice function name
+	void flushDataCache(IPC::CommandBuffer& cmd);
+	void getHeadphoneStatus(IPC::CommandBuffer& cmd);
+	void getSemaphoreEventHandle(IPC::CommandBuffer& cmd);
+	void invalidateDCache(IPC::CommandBuffer& cmd);
+	void loadComponent(IPC::CommandBuffer& cmd);
+	void readPipeIfPossible(IPC::CommandBuffer& cmd);
+	void recvData(IPC::CommandBuffer& cmd);
+	void recvDataIsReady(IPC::CommandBuffer& cmd);
+	void registerInterruptEvents(IPC::CommandBuffer& cmd);
+	void setSemaphore(IPC::CommandBuffer& cmd);
+	void setSemaphoreMask(IPC::CommandBuffer& cmd);
+	void unloadComponent(IPC::CommandBuffer& cmd);
+	void writeProcessPipe(IPC::CommandBuffer& cmd);
 
   public:
 	DSPService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 	void setDSPCore(Audio::DSPCore* pointer) { dsp = pointer; }
 
@@ -60,5 +60,6 @@ public:
 
 	FRDService(Memory& mem) : mem(mem) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer, Type type);
 };
\ No newline at end of file
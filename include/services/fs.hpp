@@ -7,6 +7,7 @@
 #include "fs/archive_self_ncch.hpp"
 #include "fs/archive_system_save_data.hpp"
 #include "fs/archive_user_save_data.hpp"
+#include "fs/write_back_cache.hpp"
 #include "helpers.hpp"
 #include "kernel_types.hpp"
 #include "logger.hpp"
@@ -22,6 +23,11 @@ class FSService {
 
 	MAKE_LOG_FUNCTION(log, fsLogger)
 
+	// Shared by every archive the guest writes saves to. Declared before the archives so it outlives them
+	WriteBackCache writeBackCache;
+	// Directory for the host files of the running title, which the archives point to. AppData/<ROM name> on Windows
+	std::filesystem::path appDataPath;
+
 	// The different filesystem archives (Save data, SelfNCCH, SDMC, NCCH, ExtData, etc)
 	SelfNCCHArchive selfNcch;
 	SaveDataArchive saveData;
@@ -37,6 +43,10 @@ class FSService {
 	ExtSaveDataArchive sharedExtSaveData_nand;
 	SystemSaveDataArchive systemSaveData;
 
+	// Every archive session points to one of the archives above. Save states store that as an index into this list
+	static constexpr usize archiveCount = 10;
+	std::array<ArchiveBase*, archiveCount> getArchives();
+
 	ArchiveBase* getArchiveFromID(u32 id, const FSPath& archivePath);
 	Rust::Result<Handle, HorizonResult> openArchiveHandle(u32 archiveID, const FSPath& path);
 	Rust::Result<Handle, HorizonResult> openDirectoryHandle(ArchiveBase* archive, const FSPath& path);
@@ -80,15 +90,45 @@ class FSService {
 
 	// Used for set/get priority: Not sure what sort of priority this is referring to
 	u32 priority;
+	// Set while running frames that will be thrown away (see setSpeculative)
+	bool speculative = false;
 
 public:
 	FSService(Memory& mem, Kernel& kernel, const EmulatorConfig& config)
 		: mem(mem), saveData(mem), sharedExtSaveData_nand(mem, "../SharedFiles/NAND", true), extSaveData_sdmc(mem, "SDMC"), sdmc(mem),
 		  sdmcWriteOnly(mem, true), selfNcch(mem), ncch(mem), userSaveData1(mem, ArchiveID::UserSaveData1),
-		  userSaveData2(mem, ArchiveID::UserSaveData2), kernel(kernel), config(config), systemSaveData(mem) {}
+		  userSaveData2(mem, ArchiveID::UserSaveData2), kernel(kernel), config(config), systemSaveData(mem) {
+		for (ArchiveBase* archive : std::initializer_list<ArchiveBase*>{
+				 &saveData, &userSaveData1, &userSaveData2, &extSaveData_sdmc, &sharedExtSaveData_nand, &sdmc, &sdmcWriteOnly}) {
+			archive->setWriteBackCache(&writeBackCache);
+		}
+
+		for (ArchiveBase* archive : getArchives()) {
+			archive->setAppDataPath(&appDataPath);
+		}
+	}
 
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 	// Creates directories for NAND, ExtSaveData, etc if they don't already exist. Should be executed after loading a new ROM.
 	void initializeFilesystem();
+
+	WriteBackCache& getWriteBackCache() { return writeBackCache; }
+
+	void setAppDataPath(const std::filesystem::path& path) {
+		if (path.empty()) Helpers::panic("Failed to set app data directory");
+		appDataPath = path;
+	}
+	const std::filesystem::path& getAppDataPath() const { return appDataPath; }
+	// Commits cached save writes to the host. Called from a timer and before operations that touch save files behind the cache's back
+	void flushSaveData();
+
+	// While speculative, the guest can't change the host filesystem: Save writes are undone when speculation ends, and commands that
+	// create, delete or rename files and directories report success without doing anything. For run-ahead
+	void setSpeculative(bool enable);
+	bool isSpeculative() const { return speculative; }
+
+	std::optional<u32> getArchiveIndex(const ArchiveBase* archive);
+	ArchiveBase* getArchiveFromIndex(u32 index);
 };
\ No newline at end of file
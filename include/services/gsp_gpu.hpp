@@ -3,6 +3,7 @@
 #include <optional>
 #include "PICA/gpu.hpp"
 #include "helpers.hpp"
+#include "ipc.hpp"
 #include "kernel_types.hpp"
 #include "logger.hpp"
 #include "memory.hpp"
@@ -37,6 +38,10 @@ class GPUService {
 	// Number of threads registered via RegisterInterruptRelayQueue
 	u32 gspThreadCount = 0;
 
+	// Asynchronous GPU mode: Is a PollGPU event pending to collect the GX commands the GPU thread finished?
+	bool commandPollScheduled = false;
+	static constexpr u64 commandPollIntervalNs = 20000;
+
 	MAKE_LOG_FUNCTION(log, gspGPULogger)
 	void processCommandBuffer();
 
@@ -70,22 +75,22 @@ class GPUService {
 	static_assert(sizeof(CaptureInfo) == 16, "GSP::GPU::CaptureInfo has the wrong size");
 
 	// Service commands
-	void acquireRight(u32 messagePointer);
-	void flushDataCache(u32 messagePointer);
-	void importDisplayCaptureInfo(u32 messagePointer);
-	void readHwRegs(u32 messagePointer);
-	void registerInterruptRelayQueue(u32 messagePointer);
-	void releaseRight(u32 messagePointer);
-	void restoreVramSysArea(u32 messagePointer);
-	void saveVramSysArea(u32 messagePointer);
-	void setAxiConfigQoSMode(u32 messagePointer);
-	void setBufferSwap(u32 messagePointer);
-	void setInternalPriorities(u32 messagePointer);
-	void setLCDForceBlack(u32 messagePointer);
-	void storeDataCache(u32 messagePointer);
-	void triggerCmdReqQueue(u32 messagePointer);
-	void writeHwRegs(u32 messagePointer);
-	void writeHwRegsWithMask(u32 messagePointer);
+	void acquireRight(IPC::CommandBuffer& cmd);
+	void flushDataCache(IPC::CommandBuffer& cmd);
+	void importDisplayCaptureInfo(IPC::CommandBuffer& cmd);
+	void readHwRegs(IPC::CommandBuffer& cmd);
+	void registerInterruptRelayQueue(IPC::CommandBuffer& cmd);
+	void releaseRight(IPC::CommandBuffer& cmd);
+	void restoreVramSysArea(IPC::CommandBuffer& cmd);
+	void saveVramSysArea(IPC::CommandBuffer& cmd);
+	void setAxiConfigQoSMode(IPC::CommandBuffer& cmd);
+	void setBufferSwap(IPC::CommandBuffer& cmd);
+	void setInternalPriorities(IPC::CommandBuffer& cmd);
+	void setLCDForceBlack(IPC::CommandBuffer& cmd);
+	void storeDataCache(IPC::CommandBuffer& cmd);
+	void triggerCmdReqQueue(IPC::CommandBuffer& cmd);
+	void writeHwRegs(IPC::CommandBuffer& cmd);
+	void writeHwRegsWithMask(IPC::CommandBuffer& cmd);
 
 	// GSP commands processed via TriggerCmdReqQueue
 	void processCommandList(u32* cmd);
@@ -95,6 +100,10 @@ class GPUService {
 	void triggerTextureCopy(u32* cmd);
 	void flushCacheRegions(u32* cmd);
 
+	void runGXCommand(const PICA::GXCommand& command);
+	void collectGXCommands();
+	void scheduleCommandPoll();
+
 	void setBufferSwapImpl(u32 screen_id, const FramebufferInfo& info);
 
 	// Get the framebuffer info in shared memory for a given screen
@@ -110,8 +119,13 @@ public:
 	GPUService(Memory& mem, GPU& gpu, Kernel& kernel, u32& currentPID) : mem(mem), gpu(gpu),
 		kernel(kernel), currentPID(currentPID) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 	void requestInterrupt(GPUInterrupt type);
+	// Raises the interrupts of the GX commands the GPU thread has finished. Called from the scheduler
+	void pollCommandThread();
+	// Waits for the GPU thread to run every queued GX command and raises their interrupts, so that no GPU work is in flight
+	void finishGXCommands();
 	void setSharedMem(u8* ptr) {
 		sharedMem = ptr;
 		if (ptr != nullptr) { // Zero-fill shared memory in case the process tries to read stale service data or vice versa
@@ -3,6 +3,7 @@
 #include <optional>
 
 #include "helpers.hpp"
+#include "ipc.hpp"
 #include "kernel_types.hpp"
 #include "logger.hpp"
 #include "memory.hpp"
@@ -65,14 +66,14 @@ class HIDService {
 	MAKE_LOG_FUNCTION(log, hidLogger)
 
 	// Service commands
-	void disableAccelerometer(u32 messagePointer);
-	void disableGyroscopeLow(u32 messagePointer);
-	void enableAccelerometer(u32 messagePointer);
-	void enableGyroscopeLow(u32 messagePointer);
-	void getGyroscopeLowCalibrateParam(u32 messagePointer);
-	void getGyroscopeCoefficient(u32 messagePointer);
-	void getIPCHandles(u32 messagePointer);
-	void getSoundVolume(u32 messagePointer);
+	void disableAccelerometer(IPC::CommandBuffer& cmd);
+	void disableGyroscopeLow(IPC::CommandBuffer& cmd);
+	void enableAccelerometer(IPC::CommandBuffer& cmd);
+	void enableGyroscopeLow(IPC::CommandBuffer& cmd);
+	void getGyroscopeLowCalibrateParam(IPC::CommandBuffer& cmd);
+	void getGyroscopeCoefficient(IPC::CommandBuffer& cmd);
+	void getIPCHandles(IPC::CommandBuffer& cmd);
+	void getSoundVolume(IPC::CommandBuffer& cmd);
 
 	// Don't call these prior to initializing shared mem pls
 	template <typename T>
@@ -88,6 +89,7 @@ class HIDService {
   public:
 	HIDService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 
 	void pressKey(u32 mask) { newButtons |= mask; }
@@ -19,5 +19,6 @@ class HTTPService {
   public:
 	HTTPService(Memory& mem) : mem(mem) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 };
\ No newline at end of file
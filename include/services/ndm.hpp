@@ -28,5 +28,6 @@ class NDMService {
 public:
 	NDMService(Memory& mem) : mem(mem) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 };
\ No newline at end of file
@@ -60,6 +60,7 @@ class NFCService {
   public:
 	NFCService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel) {}
 	void reset();
+	void doState(SaveStateStream& stream);
 	void handleSyncRequest(u32 messagePointer);
 
 	bool loadAmiibo(const std::filesystem::path& path);
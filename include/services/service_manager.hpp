@@ -93,6 +93,7 @@ class ServiceManager {
   public:
 	ServiceManager(std::span<u32, 16> regs, Memory& mem, GPU& gpu, u32& currentPID, Kernel& kernel, const EmulatorConfig& config);
 	void reset();
+	void doState(SaveStateStream& stream);
 	void initializeFS() { fs.initializeFilesystem(); }
 	void handleSyncRequest(u32 messagePointer);
 
@@ -109,5 +110,7 @@ class ServiceManager {
 	HIDService& getHID() { return hid; }
 	NFCService& getNFC() { return nfc; }
 	DSPService& getDSP() { return dsp; }
+	FSService& getFS() { return fs; }
+	GPUService& getGSP() { return gsp_gpu; }
 	Y2RService& getY2R() { return y2r; }
 };
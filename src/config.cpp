@@ -1,5 +1,6 @@
 #include "config.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <map>
@@ -41,6 +42,13 @@ void EmulatorConfig::load() {
 			discordRpcEnabled = toml::find_or<toml::boolean>(general, "EnableDiscordRPC", false);
 			usePortableBuild = toml::find_or<toml::boolean>(general, "UsePortableBuild", false);
 			defaultRomPath = toml::find_or<std::string>(general, "DefaultRomPath", "");
+			asyncFileIO = toml::find_or<toml::boolean>(general, "AsyncFileIO", true);
+			skipIdleLoops = toml::find_or<toml::boolean>(general, "SkipIdleLoops", true);
+			hleLibcHooks = toml::find_or<toml::boolean>(general, "HLELibcHooks", true);
+			profileIPC = toml::find_or<toml::boolean>(general, "ProfileIPC", false);
+
+			const auto runAhead = toml::find_or<toml::integer>(general, "RunAheadFrames", 0);
+			runAheadFrames = int(std::clamp<toml::integer>(runAhead, 0, maxRunAheadFrames));
 		}
 	}
 
@@ -67,6 +75,11 @@ void EmulatorConfig::load() {
 
 			forceShadergenForLights = toml::find_or<toml::boolean>(gpu, "ForceShadergenForLighting", true);
 			lightShadergenThreshold = toml::find_or<toml::integer>(gpu, "ShadergenLightThreshold", 1);
+			asyncGPU = toml::find_or<toml::boolean>(gpu, "AsyncGPU", false);
+			hwShaderEnabled = toml::find_or<toml::boolean>(gpu, "HardwareVertexShaders", false);
+			threadedPresentation = toml::find_or<toml::boolean>(gpu, "ThreadedPresentation", true);
+			emulationSpeed = std::max(float(toml::find_or<toml::floating>(gpu, "EmulationSpeed", 1.0)), 0.0f);
+			turboSpeed = std::max(float(toml::find_or<toml::floating>(gpu, "TurboSpeed", 4.0)), 0.0f);
 		}
 	}
 
@@ -106,6 +119,11 @@ void EmulatorConfig::load() {
 }
 
 void EmulatorConfig::save() {
+	// Configs that don't come from a file have nothing to save to
+	if (filePath.empty()) {
+		return;
+	}
+
 	toml::basic_value<toml::preserve_comments, std::map> data;
 	const std::filesystem::path& path = filePath;
 
@@ -127,6 +145,11 @@ void EmulatorConfig::save() {
 	data["General"]["EnableDiscordRPC"] = discordRpcEnabled;
 	data["General"]["UsePortableBuild"] = usePortableBuild;
 	data["General"]["DefaultRomPath"] = defaultRomPath.string();
+	data["General"]["AsyncFileIO"] = asyncFileIO;
+	data["General"]["SkipIdleLoops"] = skipIdleLoops;
+	data["General"]["RunAheadFrames"] = runAheadFrames;
+	data["General"]["HLELibcHooks"] = hleLibcHooks;
+	data["General"]["ProfileIPC"] = profileIPC;
 	
 	data["GPU"]["EnableShaderJIT"] = shaderJitEnabled;
 	data["GPU"]["Renderer"] = std::string(Renderer::typeToString(rendererType));
@@ -135,6 +158,11 @@ void EmulatorConfig::save() {
 	data["GPU"]["UseUbershaders"] = useUbershaders;
 	data["GPU"]["ForceShadergenForLighting"] = forceShadergenForLights;
 	data["GPU"]["ShadergenLightThreshold"] = lightShadergenThreshold;
+	data["GPU"]["AsyncGPU"] = asyncGPU;
+	data["GPU"]["HardwareVertexShaders"] = hwShaderEnabled;
+	data["GPU"]["ThreadedPresentation"] = threadedPresentation;
+	data["GPU"]["EmulationSpeed"] = emulationSpeed;
+	data["GPU"]["TurboSpeed"] = turboSpeed;
 
 	data["Audio"]["DSPEmulation"] = std::string(Audio::DSPCore::typeToString(dspType));
 	data["Audio"]["EnableAudio"] = audioEnabled;
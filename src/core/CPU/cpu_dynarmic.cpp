@@ -1,6 +1,8 @@
 #ifdef CPU_DYNARMIC
 #include "cpu_dynarmic.hpp"
 
+#include <algorithm>
+
 #include "arm_defs.hpp"
 #include "emulator.hpp"
 
@@ -28,18 +30,73 @@ void CPU::reset() {
 	jit->ClearCache();
 	jit->Regs().fill(0);
 	jit->ExtRegs().fill(0);
+	idleLoopDetector.reset();
+}
+
+void CPU::doState(SaveStateStream& stream) {
+	stream.section("CPU ");
+
+	std::array<u32, 16> gprs;
+	std::array<u32, 64> extRegs;
+	u32 cpsr = jit->Cpsr();
+	u32 fpscr = jit->Fpscr();
+	u32 tlsBase = cp15->getTLSBase();
+	u64 generation = cacheGeneration;
+
+	std::copy(jit->Regs().begin(), jit->Regs().end(), gprs.begin());
+	std::copy(jit->ExtRegs().begin(), jit->ExtRegs().end(), extRegs.begin());
+
+	stream.value(gprs);
+	stream.value(extRegs);
+	stream.value(cpsr);
+	stream.value(fpscr);
+	stream.value(tlsBase);
+	stream.value(generation);
+
+	if (stream.isReading()) {
+		std::copy(gprs.begin(), gprs.end(), jit->Regs().begin());
+		std::copy(extRegs.begin(), extRegs.end(), jit->ExtRegs().begin());
+		jit->SetCpsr(cpsr);
+		jit->SetFpscr(fpscr);
+		jit->ClearExclusiveState();
+		cp15->setTLSBase(tlsBase);
+		idleLoopDetector.reset();
+
+		// Code only changes through the paths that clear the cache, so the same generation means the compiled code is still valid
+		if (generation != cacheGeneration) {
+			clearCache();
+			cacheGeneration = generation;
+		}
+	}
 }
 
 void CPU::runFrame() {
 	emu.frameDone = false;
 
+	const bool skipIdleLoops = emu.getConfig().skipIdleLoops;
+
 	while (!emu.frameDone) {
-		// Run CPU until the next scheduler event
+		// Run CPU until the next scheduler event, or in short slices if we're looking for idle loops
 		env.ticksLeft = scheduler.nextTimestamp - scheduler.currentTimestamp;
+		if (skipIdleLoops) {
+			env.ticksLeft = std::min(env.ticksLeft, IdleLoopDetector::sliceTicks);
+		}
 
 	execute:
 		const auto exitReason = jit->Run();
 
+		if (skipIdleLoops && scheduler.currentTimestamp < scheduler.nextTimestamp) {
+			if (idleLoopDetector.check(jit->Regs(), fprs(), jit->Cpsr(), jit->Fpscr(), env.sideEffectCount)) {
+				// The guest is spinning on memory that can't change before the next event, so skip straight to it
+				scheduler.currentTimestamp = scheduler.nextTimestamp;
+			}
+		}
+
+		// Events can change the memory a loop is polling without the CPU writing to it, so whatever was sampled before them is useless
+		if (scheduler.currentTimestamp >= scheduler.nextTimestamp) {
+			idleLoopDetector.reset();
+		}
+
 		// Handle any scheduler events that need handling.
 		emu.pollScheduler();
 
@@ -1,9 +1,11 @@
 #include "PICA/dynapica/shader_rec.hpp"
+#include <algorithm>
 #include <bit>
 
 #ifdef PANDA3DS_SHADER_JIT_SUPPORTED
 void ShaderJIT::reset() {
 	cache.clear();
+	recentPrograms.fill(RecentProgram{});
 }
 
 void ShaderJIT::prepare(PICAShader& shaderUnit) {
@@ -13,20 +15,39 @@ void ShaderJIT::prepare(PICAShader& shaderUnit) {
 	// The combine does rotl(x, 1) ^ y for the merging instead of x ^ y because xor is commutative, hence creating possible collisions
 	// re: https://github.com/wheremyfoodat/Panda3DS/pull/15#discussion_r1229925372
 	Hash hash = std::rotl(shaderUnit.getCodeHash(), 1) ^ shaderUnit.getOpdescHash();
+	const u32 entrypoint = shaderUnit.entrypoint;
+
+	// Check the recently used programs first, moving a hit to the front
+	for (usize i = 0; i < recentPrograms.size(); i++) {
+		const RecentProgram& program = recentPrograms[i];
+
+		if (program.prologueCallback != nullptr && program.hash == hash && program.entrypoint == entrypoint) {
+			prologueCallback = program.prologueCallback;
+			entrypointCallback = program.entrypointCallback;
+			std::rotate(recentPrograms.begin(), recentPrograms.begin() + i, recentPrograms.begin() + i + 1);
+			return;
+		}
+	}
+
 	auto it = cache.find(hash);
 
 	if (it == cache.end()) { // Block has not been compiled yet
 		auto emitter = std::make_unique<ShaderEmitter>(accurateMul);
 		emitter->compile(shaderUnit);
 		// Get pointer to callbacks
-		entrypointCallback = emitter->getInstructionCallback(shaderUnit.entrypoint);
+		entrypointCallback = emitter->getInstructionCallback(entrypoint);
 		prologueCallback = emitter->getPrologueCallback();
 
 		cache.emplace_hint(it, hash, std::move(emitter));
 	} else { // Block has been compiled and found, use it
 		auto emitter = it->second.get();
-		entrypointCallback = emitter->getInstructionCallback(shaderUnit.entrypoint);
+		entrypointCallback = emitter->getInstructionCallback(entrypoint);
 		prologueCallback = emitter->getPrologueCallback();
 	}
+
+	// Evict the least recently used program
+	std::rotate(recentPrograms.begin(), recentPrograms.end() - 1, recentPrograms.end());
+	recentPrograms[0] = RecentProgram{
+		.hash = hash, .entrypoint = entrypoint, .prologueCallback = prologueCallback, .entrypointCallback = entrypointCallback};
 }
 #endif // PANDA3DS_SHADER_JIT_SUPPORTED
\ No newline at end of file
@@ -1,14 +1,17 @@
 #include "PICA/gpu.hpp"
 
 #include <array>
-#include <bitset>
 #include <cstddef>
 #include <cstdio>
+#include <span>
+#include <vector>
 
 #include "PICA/float_types.hpp"
+#include "PICA/pica_vert_config.hpp"
 #include "PICA/regs.hpp"
 #include "renderer_null/renderer_null.hpp"
 #include "renderer_sw/renderer_sw.hpp"
+#include "savestate.hpp"
 #ifdef PANDA3DS_ENABLE_OPENGL
 #include "renderer_gl/renderer_gl.hpp"
 #endif
@@ -29,6 +32,8 @@ using namespace Floats;
 GPU::GPU(Memory& mem, EmulatorConfig& config) : mem(mem), config(config) {
 	vram = new u8[vramSize];
 	mem.setVRAM(vram);  // Give the bus a pointer to our VRAM
+	vertices.resize(Renderer::vertexBufferSize);
+	vertexIndices.resize(Renderer::vertexBufferSize);
 
 	switch (config.rendererType) {
 		case RendererType::Null: {
@@ -62,9 +67,21 @@ GPU::GPU(Memory& mem, EmulatorConfig& config) : mem(mem), config(config) {
 	if (renderer != nullptr) {
 		renderer->setConfig(&config);
 	}
+
+	// Renderers that keep rendered surfaces on the host GPU guard their VRAM, and write them back when the CPU touches it
+	mem.setVRAMFlushCallback([this](u32 paddr, u32 size) { renderer->flushVRAM(paddr, size); });
 }
 
 void GPU::reset() {
+	// Let the GPU thread finish whatever the old game queued before pulling the state from under it
+	commandThread.reset();
+	// Only renderers that don't depend on a graphics context bound to the emulator thread can run commands on the GPU thread
+	asyncCommands = config.asyncGPU && renderer->supportsCommandThread();
+	if (config.asyncGPU && !asyncCommands) {
+		const char* rendererName = Renderer::typeToString(config.rendererType);
+		Helpers::warn("AsyncGPU is not supported by the %s renderer, running GX commands on the emulator thread", rendererName);
+	}
+
 	regs.fill(0);
 	shaderUnit.reset();
 	shaderJIT.reset();
@@ -76,6 +93,7 @@ void GPU::reset() {
 
 	fogLUT.fill(0);
 	fogLUTDirty = true;
+	dirtyRegisterGroups = PICA::RegisterGroup::All;
 
 	totalAttribCount = 0;
 	fixedAttribMask = 0;
@@ -121,6 +139,49 @@ void GPU::reset() {
 	renderer->reset();
 }
 
+void GPU::doState(SaveStateStream& stream) {
+	stream.section("GPU ");
+	stream.value(regs);
+	stream.value(externalRegs);
+	stream.value(lightingLUT);
+	stream.value(fogLUT);
+
+	stream.value(currentAttributes);
+	stream.value(attributeInfo);
+	stream.value(totalAttribCount);
+	stream.value(fixedAttribMask);
+	stream.value(fixedAttribIndex);
+	stream.value(fixedAttribCount);
+	stream.value(fixedAttrBuff);
+
+	stream.value(immediateModeAttributes);
+	stream.value(immediateModeVertices);
+	stream.value(immediateModeVertIndex);
+	stream.value(immediateModeAttrIndex);
+	stream.value(oldVsOutputMask);
+	shaderUnit.doState(stream);
+
+	if (stream.isReading()) {
+		// Rebuild the output register pointers, by making the saved mask look like a change
+		const u32 vsOutputMask = oldVsOutputMask;
+		oldVsOutputMask = 0xFFFFFFFF;
+		setVsOutputMask(vsOutputMask);
+
+		fixedAttribIndex = std::min(fixedAttribIndex, maxAttribCount - 1);
+		fixedAttribCount = std::min<u32>(fixedAttribCount, 3);
+		immediateModeAttrIndex = std::min(immediateModeAttrIndex, maxAttribCount - 1);
+		immediateModeVertIndex = std::min<uint>(immediateModeVertIndex, 2);
+
+		// Everything the renderer derived from the registers and memory is out of date
+		lightingLUTDirty = true;
+		fogLUTDirty = true;
+		dirtyRegisterGroups = PICA::RegisterGroup::All;
+		if (!stream.keepsHostCaches()) {
+			renderer->invalidateCaches();
+		}
+	}
+}
+
 // Call the correct version of drawArrays based on whether this is an indexed draw (first template parameter)
 // And whether we are going to use the shader JIT (second template parameter)
 void GPU::drawArrays(bool indexed) {
@@ -139,12 +200,25 @@ void GPU::drawArrays(bool indexed) {
 	}
 }
 
-static std::array<PICA::Vertex, Renderer::vertexBufferSize> vertices;
-
 template <bool indexed, bool useShaderJIT>
 void GPU::drawArrays() {
+	// Total number of input attributes to shader. Differs between GS and VS. Currently stubbed to the VS one, as we don't have geometry shaders.
+	const u32 inputAttrCount = (regs[PICA::InternalRegs::VertexShaderInputBufferCfg] & 0xf) + 1;
+	const u64 inputAttrCfg = getVertexShaderInputConfig();
+	const u32 vertexCount = regs[PICA::InternalRegs::VertexCountReg];  // Total # of vertices to transfer
+
+	// If the renderer can run the vertex shader, we only fetch the attributes and leave the shading to the host GPU
+	bool hwShaded = false;
+	if (config.hwShaderEnabled) {
+		PICAShader& vs = shaderUnit.vs;
+		const PICA::VertexConfig vertexConfig(regs, vs.getCodeHash(), vs.getOpdescHash(), vs.entrypoint, totalAttribCount, inputAttrCfg);
+		hwShaded = renderer->prepareHwShader(vs, vertexConfig, vertexCount);
+	}
+
 	if constexpr (useShaderJIT) {
-		shaderJIT.prepare(shaderUnit.vs);
+		if (!hwShaded) {
+			shaderJIT.prepare(shaderUnit.vs);
+		}
 	}
 
 	setVsOutputMask(regs[PICA::InternalRegs::VertexShaderOutputMask]);
@@ -152,7 +226,6 @@ void GPU::drawArrays() {
 	// Base address for vertex attributes
 	// The vertex base is always on a quadword boundary because the PICA does weird alignment shit any time possible
 	const u32 vertexBase = ((regs[PICA::InternalRegs::VertexAttribLoc] >> 1) & 0xfffffff) * 16;
-	const u32 vertexCount = regs[PICA::InternalRegs::VertexCountReg];  // Total # of vertices to transfer
 
 	// Configures the type of primitive and the number of vertex shader outputs
 	const u32 primConfig = regs[PICA::InternalRegs::PrimitiveConfig];
@@ -180,19 +253,34 @@ void GPU::drawArrays() {
 		log("PICA::DrawElements(vertex count = %d, index buffer config = %08X)\n", vertexCount, indexBufferConfig);
 	}
 
-	// Total number of input attributes to shader. Differs between GS and VS. Currently stubbed to the VS one, as we don't have geometry shaders.
-	const u32 inputAttrCount = (regs[PICA::InternalRegs::VertexShaderInputBufferCfg] & 0xf) + 1;
-	const u64 inputAttrCfg = getVertexShaderInputConfig();
+	if (hwShaded) {
+		hwShaderInputs.resize(usize(vertexCount) * totalAttribCount);
+	}
 
-	// When doing indexed rendering, we have a cache of vertices to avoid processing attributes and shaders for a single vertex many times
+	// When doing indexed rendering, we have a post-transform cache to avoid processing attributes and shaders for a single vertex many times
+	// Every vertex that misses the cache is shaded once and appended to the vertex buffer, while the index buffer references it
+	// The cache is set-associative with round-robin replacement inside each set, so index patterns that alias in a direct-mapped cache
+	// (eg a grid whose row stride is a multiple of the cache size) still hit
 	constexpr bool vertexCacheEnabled = true;
-	constexpr size_t vertexCacheSize = 64;
+	constexpr u32 vertexCacheSets = 64;
+	constexpr u32 vertexCacheWays = 4;
+	constexpr u32 invalidVertexID = 0xFFFFFFFF;  // Vertex indices are at most 16 bits wide so this never matches a real one
+
+	struct VertexCacheSet {
+		std::array<u32, vertexCacheWays> ids;              // IDs (ie indices of the cached vertices in the 3DS vertex buffer)
+		std::array<u16, vertexCacheWays> bufferPositions;  // Positions of the cached vertices in our own vertex buffer
+		u32 nextWay;                                       // Way to replace on the next miss
+	};
+
+	std::array<VertexCacheSet, vertexCacheSets> vertexCache;
+	if constexpr (indexed) {
+		for (auto& set : vertexCache) {
+			set.ids.fill(invalidVertexID);
+			set.nextWay = 0;
+		}
+	}
 
-	struct {
-		std::bitset<vertexCacheSize> validBits{0};         // Shows which tags are valid. If the corresponding bit is 1, then there's an entry
-		std::array<u32, vertexCacheSize> ids;              // IDs (ie indices of the cached vertices in the 3DS vertex buffer)
-		std::array<u32, vertexCacheSize> bufferPositions;  // Positions of the cached vertices in our own vertex buffer
-	} vertexCache;
+	u32 uniqueVertexCount = 0;  // How many vertices we've actually shaded and written to the vertex buffer
 
 	for (u32 i = 0; i < vertexCount; i++) {
 		u32 vertexIndex;  // Index of the vertex in the VBO for indexed rendering
@@ -211,22 +299,37 @@ void GPU::drawArrays() {
 			}
 		}
 
-		// Check if the vertex corresponding to the index is in cache
-		if constexpr (indexed && vertexCacheEnabled) {
-			auto& cache = vertexCache;
-			size_t tag = vertexIndex % vertexCacheSize;
-			// Cache hit
-			if (cache.validBits[tag] && cache.ids[tag] == vertexIndex) {
-				vertices[i] = vertices[cache.bufferPositions[tag]];
-				continue;
-			}
+		// Position of this vertex's output in our vertex buffer
+		u32 outputPosition = i;
+
+		if constexpr (indexed) {
+			outputPosition = uniqueVertexCount;
 
-			// Cache miss. Set cache entry, fetch attributes and run shaders as normal
-			else {
-				cache.validBits[tag] = true;
-				cache.ids[tag] = vertexIndex;
-				cache.bufferPositions[tag] = i;
+			// Check if the vertex corresponding to the index is in cache
+			if constexpr (vertexCacheEnabled) {
+				VertexCacheSet& set = vertexCache[vertexIndex % vertexCacheSets];
+				bool hit = false;
+
+				for (u32 way = 0; way < vertexCacheWays; way++) {
+					if (set.ids[way] == vertexIndex) {
+						vertexIndices[i] = set.bufferPositions[way];
+						hit = true;
+						break;
+					}
+				}
+
+				if (hit) {
+					continue;
+				}
+
+				// Cache miss. Set cache entry, fetch attributes and run shaders as normal
+				set.ids[set.nextWay] = vertexIndex;
+				set.bufferPositions[set.nextWay] = u16(outputPosition);
+				set.nextWay = (set.nextWay + 1) % vertexCacheWays;
 			}
+
+			vertexIndices[i] = u16(outputPosition);
+			uniqueVertexCount++;
 		}
 
 		int attrCount = 0;
@@ -322,6 +425,13 @@ void GPU::drawArrays() {
 			}
 		}
 
+		if (hwShaded) {
+			// The input permutation is applied by the shader itself
+			vec4f* inputs = &hwShaderInputs[usize(outputPosition) * totalAttribCount];
+			std::memcpy(inputs, &currentAttributes[0], totalAttribCount * sizeof(vec4f));
+			continue;
+		}
+
 		// Before running the shader, the PICA maps the fetched attributes from the attribute registers to the shader input registers
 		// Based on the SH_ATTRIBUTES_PERMUTATION registers.
 		// Ie it might attribute #0 to v2, #1 to v7, etc
@@ -336,7 +446,7 @@ void GPU::drawArrays() {
 			shaderUnit.vs.run();
 		}
 
-		PICA::Vertex& out = vertices[i];
+		PICA::Vertex& out = vertices[outputPosition];
 		// Map shader outputs to fixed function properties
 		const u32 totalShaderOutputs = regs[PICA::InternalRegs::ShaderOutputCount] & 7;
 		for (int i = 0; i < totalShaderOutputs; i++) {
@@ -349,7 +459,20 @@ void GPU::drawArrays() {
 		}
 	}
 
-	renderer->drawVertices(primType, std::span(vertices).first(vertexCount));
+	if (hwShaded) {
+		const u32 shadedVertexCount = indexed ? uniqueVertexCount : vertexCount;
+		const auto attributes = std::span(hwShaderInputs).first(usize(shadedVertexCount) * totalAttribCount);
+
+		if constexpr (indexed) {
+			renderer->drawHwShaded(primType, attributes, std::span(vertexIndices).first(vertexCount));
+		} else {
+			renderer->drawHwShaded(primType, attributes, {});
+		}
+	} else if constexpr (indexed) {
+		renderer->drawIndexed(primType, std::span(vertices).first(uniqueVertexCount), std::span(vertexIndices).first(vertexCount));
+	} else {
+		renderer->drawVertices(primType, std::span(vertices).first(vertexCount));
+	}
 }
 
 PICA::Vertex GPU::getImmediateModeVertex() {
@@ -402,6 +525,9 @@ void GPU::fireDMA(u32 dest, u32 source, u32 size) {
 	}
 
 	if (cpuToVRAM) [[likely]] {
+		// A write back of the destination finishing later would overwrite the DMA'd data, so get any pending ones out of the way first
+		mem.flushVRAM(dest - vramStart + PhysicalAddrs::VRAM, size);
+
 		// Valid, optimized FCRAM->VRAM DMA. TODO: Is VRAM->VRAM DMA allowed?
 		u8* fcram = mem.getFCRAM();
 		std::memcpy(&vram[dest - vramStart], &fcram[source - fcramStart], size);
@@ -413,3 +539,17 @@ void GPU::fireDMA(u32 dest, u32 source, u32 size) {
 		}
 	}
 }
+
+void GPU::executeGXCommand(const PICA::GXCommand& command) {
+	using Type = PICA::GXCommand::Type;
+	const auto& args = command.args;
+
+	switch (command.type) {
+		case Type::CommandList: startCommandList(args[0], args[1]); break;
+		case Type::MemoryFill: clearBuffer(args[0], args[1], args[2], args[3]); break;
+		case Type::DisplayTransfer: displayTransfer(args[0], args[1], args[2], args[3], args[4]); break;
+		case Type::TextureCopy: textureCopy(args[0], args[1], args[2], args[3], args[4], args[5]); break;
+		case Type::DMA: fireDMA(args[0], args[1], args[2]); break;
+		default: Helpers::panic("[GPU] Unknown GX command type %d", static_cast<int>(command.type)); break;
+	}
+}
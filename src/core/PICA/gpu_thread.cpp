@@ -0,0 +1,84 @@
+#include "PICA/gpu_thread.hpp"
+
+#include "PICA/gpu.hpp"
+
+GPUThread::~GPUThread() {
+	stopping.store(true, std::memory_order_release);
+	wakeups.fetch_add(1, std::memory_order_release);
+	wakeups.notify_one();
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+void GPUThread::workerLoop() {
+	u64 next = executed.load(std::memory_order_relaxed);
+
+	while (true) {
+		// Read the wakeup counter before checking for work, so that a submit that lands in between makes the wait below return at once
+		const u32 seen = wakeups.load(std::memory_order_acquire);
+		const u64 end = submitted.load(std::memory_order_acquire);
+
+		if (next == end) {
+			// Queued work is always finished before stopping, as it might be a DMA the game is waiting on
+			if (stopping.load(std::memory_order_acquire)) {
+				return;
+			}
+
+			wakeups.wait(seen, std::memory_order_acquire);
+			continue;
+		}
+
+		for (; next != end; next++) {
+			gpu.executeGXCommand(commands[next & (capacity - 1)]);
+			executed.store(next + 1, std::memory_order_release);
+			executed.notify_all();
+		}
+	}
+}
+
+void GPUThread::submit(const PICA::GXCommand& command) {
+	const u64 index = submitted.load(std::memory_order_relaxed);
+	if (index - collected == capacity) [[unlikely]] {
+		Helpers::panic("GPUThread: Submitted a command to a full ring");
+	}
+
+	commands[index & (capacity - 1)] = command;
+	submitted.store(index + 1, std::memory_order_release);
+
+	// Start the worker lazily, so that the synchronous path never pays for it
+	if (!worker.joinable()) {
+		worker = std::thread(&GPUThread::workerLoop, this);
+	}
+
+	wakeups.fetch_add(1, std::memory_order_release);
+	wakeups.notify_one();
+}
+
+void GPUThread::waitForCompletion() {
+	if (!hasOutstanding()) {
+		return;
+	}
+
+	u64 done = executed.load(std::memory_order_acquire);
+	while (done == collected) {
+		executed.wait(done, std::memory_order_acquire);
+		done = executed.load(std::memory_order_acquire);
+	}
+}
+
+void GPUThread::waitForIdle() {
+	const u64 end = submitted.load(std::memory_order_relaxed);
+	u64 done = executed.load(std::memory_order_acquire);
+
+	while (done != end) {
+		executed.wait(done, std::memory_order_acquire);
+		done = executed.load(std::memory_order_acquire);
+	}
+}
+
+void GPUThread::reset() {
+	waitForIdle();
+	collected = executed.load(std::memory_order_relaxed);
+}
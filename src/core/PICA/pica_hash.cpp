@@ -1,4 +1,7 @@
 #include "PICA/pica_hash.hpp"
+
+#include <algorithm>
+
 #include "PICA/shader.hpp"
 
 #ifdef PANDA3DS_PICA_CITYHASH
@@ -20,10 +23,20 @@ PICAHash::HashType PICAHash::computeHash(const char* buf, std::size_t len) {
 }
 
 PICAShader::Hash PICAShader::getCodeHash() {
-	// Hash the code again if the code changed
+	// Hash the code again if the code changed. Only the blocks that overlap the dirty range need to be rehashed
+	static_assert(std::tuple_size_v<decltype(codeBlockHashes)> * codeBlockSize == maxInstructionCount, "Code blocks must cover the whole program");
+
 	if (codeHashDirty) {
 		codeHashDirty = false;
-		lastCodeHash = PICAHash::computeHash((const char*)&loadedShader[0], loadedShader.size() * sizeof(loadedShader[0]));
+
+		const u32 firstBlock = dirtyCodeBegin / codeBlockSize;
+		const u32 lastBlock = std::min<u32>((dirtyCodeEnd + codeBlockSize - 1) / codeBlockSize, u32(codeBlockHashes.size()));
+		for (u32 block = firstBlock; block < lastBlock; block++) {
+			const char* data = (const char*)&loadedShader[block * codeBlockSize];
+			codeBlockHashes[block] = PICAHash::computeHash(data, codeBlockSize * sizeof(loadedShader[0]));
+		}
+
+		lastCodeHash = PICAHash::computeHash((const char*)&codeBlockHashes[0], codeBlockHashes.size() * sizeof(codeBlockHashes[0]));
 	}
 
 	// Return the code hash
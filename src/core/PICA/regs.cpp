@@ -1,5 +1,8 @@
 #include "PICA/regs.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include "PICA/gpu.hpp"
 
 using namespace Floats;
@@ -88,6 +91,10 @@ void GPU::writeInternalReg(u32 index, u32 value, u32 mask) {
 	u32 newValue = (currentValue & ~mask) | (value & mask);  // Only overwrite the bits specified by "mask"
 	regs[index] = newValue;
 
+	if (newValue != currentValue) {
+		dirtyRegisterGroups |= PICA::RegisterGroup::get(index);
+	}
+
 	// TODO: Figure out if things like the shader index use the unmasked value or the masked one
 	// We currently use the unmasked value like Citra does
 	switch (index) {
@@ -147,6 +154,7 @@ void GPU::writeInternalReg(u32 index, u32 value, u32 mask) {
 			fogLUT[index] = value;
 			fogLUTDirty = true;
 			regs[FogLUTIndex] = (index + 1) & 0x7F;
+			dirtyRegisterGroups |= PICA::RegisterGroup::Fog;
 			break;
 		}
 
@@ -170,6 +178,7 @@ void GPU::writeInternalReg(u32 index, u32 value, u32 mask) {
 			// Increment the bottom 8 bits of the lighting LUT index register
 			lutIndex += 1;
 			regs[LightingLUTIndex] = (index & ~0xff) | (lutIndex & 0xff);
+			dirtyRegisterGroups |= PICA::RegisterGroup::Lighting;
 
 			break;
 		}
@@ -377,6 +386,73 @@ void GPU::writeInternalReg(u32 index, u32 value, u32 mask) {
 	}
 }
 
+bool GPU::writeInternalRegBlock(u32 index, u32 firstValue, std::span<const u32> values, bool consecutive) {
+	using namespace PICA::InternalRegs;
+
+	// Each data port is 8 registers wide, all of which do the same thing. Consecutive writes that run past the end of the port have
+	// to go through the slow path, as they reach other registers
+	const auto inPort = [&](u32 first, u32 last) {
+		return index >= first && index <= last && (!consecutive || index + values.size() <= last);
+	};
+
+	// Copies values to a ring of LUT entries, wrapping the index around like the hardware does
+	const auto copyToLUT = [](u32* lut, u32 lutSize, u32 lutIndex, std::span<const u32> data) {
+		while (!data.empty()) {
+			const usize count = std::min<usize>(data.size(), lutSize - lutIndex);
+			std::memcpy(&lut[lutIndex], data.data(), count * sizeof(u32));
+
+			lutIndex = (lutIndex + u32(count)) & (lutSize - 1);
+			data = data.subspan(count);
+		}
+	};
+
+	const u32 count = u32(values.size()) + 1;
+	if (inPort(VertexFloatUniformData0, VertexFloatUniformData7)) {
+		shaderUnit.vs.uploadFloatUniforms(std::span(&firstValue, 1));
+		shaderUnit.vs.uploadFloatUniforms(values);
+	} else if (inPort(VertexShaderData0, VertexShaderData7)) {
+		shaderUnit.vs.uploadWords(std::span(&firstValue, 1));
+		shaderUnit.vs.uploadWords(values);
+	} else if (inPort(VertexShaderOpDescriptorData0, VertexShaderOpDescriptorData7)) {
+		shaderUnit.vs.uploadDescriptors(std::span(&firstValue, 1));
+		shaderUnit.vs.uploadDescriptors(values);
+	} else if (inPort(LightingLUTData0, LightingLUTData7)) {
+		const u32 lutRegister = regs[LightingLUTIndex];
+		const u32 lutID = getBits<8, 5>(lutRegister);
+		const u32 lutIndex = getBits<0, 8>(lutRegister);
+
+		if (lutID < PICA::Lights::LUT_Count) {
+			u32* lut = &lightingLUT[lutID * 256];
+			copyToLUT(lut, 256, lutIndex, std::span(&firstValue, 1));
+			copyToLUT(lut, 256, (lutIndex + 1) & 0xff, values);
+			lightingLUTDirty = true;
+		}
+
+		// Only the bottom 8 bits of the index register are incremented
+		regs[LightingLUTIndex] = (lutRegister & ~0xff) | ((lutIndex + count) & 0xff);
+	} else if (inPort(FogLUTData0, FogLUTData7)) {
+		const u32 lutIndex = regs[FogLUTIndex] & 0x7F;
+		copyToLUT(fogLUT.data(), 128, lutIndex, std::span(&firstValue, 1));
+		copyToLUT(fogLUT.data(), 128, (lutIndex + 1) & 0x7F, values);
+
+		fogLUTDirty = true;
+		regs[FogLUTIndex] = (lutIndex + count) & 0x7F;
+	} else {
+		return false;
+	}
+
+	// Leave the port registers holding the last value written to them, like a word-by-word write would
+	dirtyRegisterGroups |= PICA::RegisterGroup::get(index);
+	if (consecutive) {
+		regs[index] = firstValue;
+		std::copy(values.begin(), values.end(), &regs[index + 1]);
+	} else {
+		regs[index] = values.back();
+	}
+
+	return true;
+}
+
 void GPU::startCommandList(u32 addr, u32 size) {
 	cmdBuffStart = static_cast<u32*>(mem.getReadPointer(addr));
 	if (!cmdBuffStart) Helpers::panic("Couldn't get buffer for command list");
@@ -419,6 +495,14 @@ void GPU::startCommandList(u32 addr, u32 size) {
 		// Increment the ID by 1 after each write if we're in consecutive mode, or 0 otherwise
 		u32 idIncrement = (consecutiveWritingMode) ? 1 : 0;
 
+		if (mask == 0xffffffff && paramCount != 0) {
+			const std::span<const u32> params(cmdBuffCurr, paramCount);
+			if (writeInternalRegBlock(id, param1, params, consecutiveWritingMode)) {
+				cmdBuffCurr += paramCount;
+				continue;
+			}
+		}
+
 		writeInternalReg(id, param1, mask);
 		for (u32 i = 0; i < paramCount; i++) {
 			id += idIncrement;
@@ -0,0 +1,534 @@
+#include "PICA/shader_decompiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace PICA;
+using namespace PICA::ShaderGen;
+using namespace Helpers;
+
+// Register file and helpers shared by every translated shader. The PICA has no integer registers besides the address and loop registers,
+// so everything else is a vec4 array
+static constexpr const char* registerDefinitions = R"(
+	#ifdef USING_GLES
+	precision highp float;
+	precision highp int;
+	#endif
+
+	layout(std140) uniform VertexUniforms {
+		vec4 floatUniforms[96];
+		uvec4 intUniforms[4];
+		uint boolUniforms;
+	};
+
+	vec4 inputRegs[16];
+	vec4 tempRegs[16];
+	vec4 outputRegs[16];
+	ivec2 addrRegs;
+	int loopCounter;
+	bvec2 cmpRegs;
+
+	vec4 a_coords;
+	vec4 a_quaternion;
+	vec4 a_vertexColour;
+	vec2 a_texcoord0;
+	vec2 a_texcoord1;
+	float a_texcoord0_w;
+	vec3 a_view;
+	vec2 a_texcoord2;
+
+	// Reads a source register with relative addressing applied. Matches PICAShader::getIndexedSource and PICAShader::getSource
+	vec4 readIndexed(int index) {
+		index &= 0xff;
+		if (index < 0x10) return inputRegs[index];
+		if (index < 0x20) return tempRegs[index - 0x10];
+
+		index = (index - 0x20) & 0x7f;
+		return index < 96 ? floatUniforms[index] : vec4(1.0);
+	}
+
+	int addrOffset(int offset) { return (offset < -128 || offset > 127) ? 0 : offset; }
+
+	// The PICA gives 0 instead of NaN for inf * 0, so lanes that only became NaN in the multiplication are zeroed. Matches f24::operator*
+	vec4 picaMul(vec4 a, vec4 b) {
+		vec4 product = a * b;
+		bvec4 infTimesZero = bvec4(vec4(isnan(product)) * (1.0 - vec4(isnan(a))) * (1.0 - vec4(isnan(b))));
+		return mix(product, vec4(0.0), infTimesZero);
+	}
+
+	float picaDot3(vec4 a, vec4 b) {
+		vec4 product = picaMul(a, b);
+		return product.x + product.y + product.z;
+	}
+
+	float picaDot4(vec4 a, vec4 b) {
+		vec4 product = picaMul(a, b);
+		return product.x + product.y + product.z + product.w;
+	}
+)";
+
+// Where each component of PICA::Vertex goes in the vertex shader, indexed by outmap value. Empty for the padding fields
+static constexpr std::array<const char*, 24> vertexFields = {
+	"a_coords.x",       "a_coords.y",       "a_coords.z",      "a_coords.w",      "a_quaternion.x",   "a_quaternion.y",
+	"a_quaternion.z",   "a_quaternion.w",   "a_vertexColour.x", "a_vertexColour.y", "a_vertexColour.z", "a_vertexColour.w",
+	"a_texcoord0.x",    "a_texcoord0.y",    "a_texcoord1.x",   "a_texcoord1.y",   "a_texcoord0_w",    "",
+	"a_view.x",         "a_view.y",         "a_view.z",        "",                "a_texcoord2.x",    "a_texcoord2.y",
+};
+
+void ShaderDecompiler::fail(const char* reason, u32 pc) {
+	if (!compilationError) {
+		Helpers::warn("ShaderDecompiler: %s at pc %03X, falling back to CPU vertex shading", reason, pc);
+	}
+
+	compilationError = true;
+}
+
+std::string ShaderDecompiler::getSource(u32 source, u32 index) const {
+	// Relative addressing only applies to float uniforms
+	if (source >= 0x20 && index != 0) {
+		switch (index) {
+			case 1: return "readIndexed(" + std::to_string(source) + " + addrOffset(addrRegs.x))";
+			case 2: return "readIndexed(" + std::to_string(source) + " + addrOffset(addrRegs.y))";
+			default: return "readIndexed(" + std::to_string(source) + " + loopCounter)";
+		}
+	}
+
+	if (source < 0x10) {
+		return "inputRegs[" + std::to_string(source) + "]";
+	} else if (source < 0x20) {
+		return "tempRegs[" + std::to_string(source - 0x10) + "]";
+	} else {
+		const u32 floatIndex = (source - 0x20) & 0x7f;
+		return floatIndex < 96 ? "floatUniforms[" + std::to_string(floatIndex) + "]" : "vec4(1.0)";
+	}
+}
+
+std::string ShaderDecompiler::getSwizzledSource(u32 sourceIndex, u32 source, u32 index, u32 operandDescriptor) const {
+	// See PICAShader::swizzle for the operand descriptor layout
+	bool negate;
+	u32 compSwizzle;
+
+	switch (sourceIndex) {
+		case 1:
+			negate = getBit<4>(operandDescriptor) != 0;
+			compSwizzle = getBits<5, 8>(operandDescriptor);
+			break;
+		case 2:
+			negate = getBit<13>(operandDescriptor) != 0;
+			compSwizzle = getBits<14, 8>(operandDescriptor);
+			break;
+		default:
+			negate = getBit<22>(operandDescriptor) != 0;
+			compSwizzle = getBits<23, 8>(operandDescriptor);
+			break;
+	}
+
+	std::string ret = getSource(source, index);
+
+	// 0x1B is the identity swizzle (xyzw)
+	if (compSwizzle != 0x1B) {
+		static constexpr char components[] = "xyzw";
+		ret += '.';
+
+		for (int comp = 0; comp < 4; comp++) {
+			ret += components[(compSwizzle >> (6 - comp * 2)) & 3];
+		}
+	}
+
+	return negate ? "(-" + ret + ")" : ret;
+}
+
+std::string ShaderDecompiler::getDest(u32 dest) const {
+	if (dest < 0x10) {
+		return "outputRegs[" + std::to_string(dest) + "]";
+	} else if (dest < 0x20) {
+		return "tempRegs[" + std::to_string(dest - 0x10) + "]";
+	}
+
+	return "";
+}
+
+void ShaderDecompiler::setDest(std::string& shader, u32 operandDescriptor, const std::string& dest, const std::string& value) {
+	// Bit 3 of the component mask is x, bit 0 is w
+	std::string mask;
+	for (int i = 0; i < 4; i++) {
+		if (operandDescriptor & (8 >> i)) {
+			mask += "xyzw"[i];
+		}
+	}
+
+	if (mask.empty()) {
+		return;
+	}
+
+	if (dest.empty()) {
+		fail("Unimplemented destination register", 0);
+		return;
+	}
+
+	if (mask == "xyzw") {
+		shader += dest + " = " + value + ";\n";
+	} else {
+		shader += dest + "." + mask + " = (" + value + ")." + mask + ";\n";
+	}
+}
+
+std::string ShaderDecompiler::getCondition(u32 instruction) const {
+	// See PICAShader::isCondTrue
+	const u32 condition = getBits<22, 2>(instruction);
+	const bool refY = getBit<24>(instruction) != 0;
+	const bool refX = getBit<25>(instruction) != 0;
+	const std::string x = refX ? "cmpRegs.x" : "!cmpRegs.x";
+	const std::string y = refY ? "cmpRegs.y" : "!cmpRegs.y";
+
+	switch (condition) {
+		case 0: return "(" + x + " || " + y + ")";
+		case 1: return "(" + x + " && " + y + ")";
+		case 2: return x;
+		default: return y;
+	}
+}
+
+std::string ShaderDecompiler::getBoolUniform(u32 instruction) const {
+	const u32 bit = getBits<22, 4>(instruction);
+	return "((boolUniforms & " + std::to_string(1u << bit) + "u) != 0u)";
+}
+
+std::string ShaderDecompiler::getFunctionName(u32 start, u32 end) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "func_%03X_%03X", start, end);
+	return name;
+}
+
+bool ShaderDecompiler::compileFunction(u32 start, u32 end) {
+	if (std::find(callStack.begin(), callStack.end(), start) != callStack.end()) {
+		fail("Recursive CALL", start);
+		return false;
+	}
+
+	// Already compiled
+	for (const auto& func : functions) {
+		if (func.start == start && func.end == end) {
+			return true;
+		}
+	}
+
+	// A LOOP can't be broken out of from a function it calls, so functions are compiled with their own loop depth
+	const u32 oldLoopDepth = loopDepth;
+	loopDepth = 0;
+	callStack.push_back(start);
+
+	std::string body;
+	compileRange(body, start, end);
+	body += "return false;\n";
+
+	callStack.pop_back();
+	loopDepth = oldLoopDepth;
+
+	functions.push_back({start, end, std::move(body)});
+	return !compilationError;
+}
+
+u32 ShaderDecompiler::compileRange(std::string& shader, u32 start, u32 end) {
+	u32 pc = start;
+	while (pc < end && !compilationError) {
+		pc = compileInstruction(shader, pc, end);
+	}
+
+	return pc;
+}
+
+u32 ShaderDecompiler::compileInstruction(std::string& shader, u32 pc, u32 end) {
+	const u32 instruction = this->shader.loadedShader[pc];
+	const u32 opcode = instruction >> 26;
+
+	// Operands of the common instruction formats. The "inverted" formats (DPHI, SGEI etc) swap the sizes of src1 and src2, and apply
+	// relative addressing to src2 instead of src1
+	const u32 operandDescriptor = this->shader.operandDescriptors[instruction & 0x7f];
+	const u32 idx = getBits<19, 2>(instruction);
+	const std::string dest = getDest(getBits<21, 5>(instruction));
+
+	const auto src1 = [&]() { return getSwizzledSource(1, getBits<12, 7>(instruction), idx, operandDescriptor); };
+	const auto src2 = [&]() { return getSwizzledSource(2, getBits<7, 5>(instruction), 0, operandDescriptor); };
+	const auto src1i = [&]() { return getSwizzledSource(1, getBits<14, 5>(instruction), 0, operandDescriptor); };
+	const auto src2i = [&]() { return getSwizzledSource(2, getBits<7, 7>(instruction), idx, operandDescriptor); };
+
+	// Control flow instructions share a destination and a count
+	const u32 dst = getBits<10, 12>(instruction);
+	const u32 num = instruction & 0xff;
+
+	switch (opcode) {
+		case ShaderOpcodes::ADD: setDest(shader, operandDescriptor, dest, src1() + " + " + src2()); break;
+		case ShaderOpcodes::MUL: setDest(shader, operandDescriptor, dest, "picaMul(" + src1() + ", " + src2() + ")"); break;
+		case ShaderOpcodes::DP3: setDest(shader, operandDescriptor, dest, "vec4(picaDot3(" + src1() + ", " + src2() + "))"); break;
+		case ShaderOpcodes::DP4: setDest(shader, operandDescriptor, dest, "vec4(picaDot4(" + src1() + ", " + src2() + "))"); break;
+
+		case ShaderOpcodes::DPH:
+		case ShaderOpcodes::DPHI: {
+			const bool inverted = opcode == ShaderOpcodes::DPHI;
+			const std::string a = inverted ? src1i() : src1();
+			const std::string b = inverted ? src2i() : src2();
+			setDest(shader, operandDescriptor, dest, "vec4(picaDot3(" + a + ", " + b + ") + " + b + ".w)");
+			break;
+		}
+
+		case ShaderOpcodes::DST:
+		case ShaderOpcodes::DSTI: {
+			const bool inverted = opcode == ShaderOpcodes::DSTI;
+			const std::string a = inverted ? src1i() : src1();
+			const std::string b = inverted ? src2i() : src2();
+			setDest(shader, operandDescriptor, dest, "vec4(1.0, picaMul(" + a + ", " + b + ").y, " + a + ".z, " + b + ".w)");
+			break;
+		}
+
+		case ShaderOpcodes::EX2: setDest(shader, operandDescriptor, dest, "vec4(exp2(" + src1() + ".x))"); break;
+		case ShaderOpcodes::LG2: setDest(shader, operandDescriptor, dest, "vec4(log2(" + src1() + ".x))"); break;
+		case ShaderOpcodes::FLR: setDest(shader, operandDescriptor, dest, "floor(" + src1() + ")"); break;
+		case ShaderOpcodes::MAX: setDest(shader, operandDescriptor, dest, "max(" + src1() + ", " + src2() + ")"); break;
+		case ShaderOpcodes::MIN: setDest(shader, operandDescriptor, dest, "min(" + src1() + ", " + src2() + ")"); break;
+		case ShaderOpcodes::RCP: setDest(shader, operandDescriptor, dest, "vec4(1.0 / " + src1() + ".x)"); break;
+		case ShaderOpcodes::RSQ: setDest(shader, operandDescriptor, dest, "vec4(inversesqrt(" + src1() + ".x))"); break;
+		case ShaderOpcodes::MOV: setDest(shader, operandDescriptor, dest, src1()); break;
+
+		case ShaderOpcodes::SGE: setDest(shader, operandDescriptor, dest, "vec4(greaterThanEqual(" + src1() + ", " + src2() + "))"); break;
+		case ShaderOpcodes::SGEI: setDest(shader, operandDescriptor, dest, "vec4(greaterThanEqual(" + src1i() + ", " + src2i() + "))"); break;
+		case ShaderOpcodes::SLT: setDest(shader, operandDescriptor, dest, "vec4(lessThan(" + src1() + ", " + src2() + "))"); break;
+		case ShaderOpcodes::SLTI: setDest(shader, operandDescriptor, dest, "vec4(lessThan(" + src1i() + ", " + src2i() + "))"); break;
+
+		case ShaderOpcodes::MOVA: {
+			const std::string value = src1();
+			if (operandDescriptor & 0b1000) {
+				shader += "addrRegs.x = int(" + value + ".x);\n";
+			}
+
+			if (operandDescriptor & 0b0100) {
+				shader += "addrRegs.y = int(" + value + ".y);\n";
+			}
+			break;
+		}
+
+		case ShaderOpcodes::CMP1:
+		case ShaderOpcodes::CMP2: {
+			static constexpr std::array<const char*, 6> operators = {" == ", " != ", " < ", " <= ", " > ", " >= "};
+			const u32 cmpOperations[2] = {getBits<24, 3>(instruction), getBits<21, 3>(instruction)};
+			const std::string a = src1();
+			const std::string b = src2();
+
+			for (int i = 0; i < 2; i++) {
+				const char* component = (i == 0) ? ".x" : ".y";
+				shader += std::string("cmpRegs") + component + " = ";
+
+				if (cmpOperations[i] < operators.size()) {
+					shader += a + component + operators[cmpOperations[i]] + b + component + ";\n";
+				} else {
+					shader += "true;\n";
+				}
+			}
+			break;
+		}
+
+		case ShaderOpcodes::NOP: break;
+		case ShaderOpcodes::END: shader += "return true;\n"; return end;  // Anything after an END in this block is unreachable
+
+		case ShaderOpcodes::BREAK:
+		case ShaderOpcodes::BREAKC: {
+			if (loopDepth == 0) {
+				fail("BREAK outside of a LOOP", pc);
+				break;
+			}
+
+			shader += (opcode == ShaderOpcodes::BREAK) ? "break;\n" : "if (" + getCondition(instruction) + ") break;\n";
+			break;
+		}
+
+		case ShaderOpcodes::CALL:
+		case ShaderOpcodes::CALLC:
+		case ShaderOpcodes::CALLU: {
+			if (dst + num > PICAShader::maxInstructionCount || !compileFunction(dst, dst + num)) {
+				fail("Invalid CALL", pc);
+				break;
+			}
+
+			const std::string call = "if (" + getFunctionName(dst, dst + num) + "()) return true;\n";
+			if (opcode == ShaderOpcodes::CALL) {
+				shader += call;
+			} else {
+				shader += "if (" + (opcode == ShaderOpcodes::CALLC ? getCondition(instruction) : getBoolUniform(instruction)) + ") {\n";
+				shader += call;
+				shader += "}\n";
+			}
+			break;
+		}
+
+		case ShaderOpcodes::IFU:
+		case ShaderOpcodes::IFC: {
+			// The if block is [pc + 1, dst), the else block [dst, dst + num)
+			if (dst <= pc || dst + num > end) {
+				fail("IF block overlapping its parent block", pc);
+				break;
+			}
+
+			shader += "if (" + (opcode == ShaderOpcodes::IFC ? getCondition(instruction) : getBoolUniform(instruction)) + ") {\n";
+			compileRange(shader, pc + 1, dst);
+
+			if (num != 0) {
+				shader += "} else {\n";
+				compileRange(shader, dst, dst + num);
+			}
+
+			shader += "}\n";
+			return dst + num;
+		}
+
+		case ShaderOpcodes::LOOP: {
+			// The loop body is [pc + 1, dst], and runs intUniform.x + 1 times. See PICAShader::loop
+			if (dst < pc || dst + 1 > end) {
+				fail("LOOP block overlapping its parent block", pc);
+				break;
+			}
+
+			const std::string uniform = "intUniforms[" + std::to_string(getBits<22, 2>(instruction)) + "]";
+			shader += "loopCounter = int(" + uniform + ".y);\n";
+			shader += "for (uint loopIteration = 0u; loopIteration <= " + uniform + ".x; loopIteration++) {\n";
+
+			loopDepth++;
+			compileRange(shader, pc + 1, dst + 1);
+			loopDepth--;
+
+			shader += "loopCounter += int(" + uniform + ".z);\n";
+			shader += "}\n";
+			return dst + 1;
+		}
+
+		case ShaderOpcodes::JMPC:
+		case ShaderOpcodes::JMPU: {
+			// Only forward jumps inside the current block are supported, which become an if around the instructions they skip
+			if (dst <= pc || dst > end) {
+				fail("Unsupported JMP", pc);
+				break;
+			}
+
+			std::string condition;
+			if (opcode == ShaderOpcodes::JMPC) {
+				condition = getCondition(instruction);
+			} else {
+				// If the LSB is 0 we jump if the bool uniform is true, otherwise if it is false
+				condition = (instruction & 1) ? "!" + getBoolUniform(instruction) : getBoolUniform(instruction);
+			}
+
+			shader += "if (!" + condition + ") {\n";
+			compileRange(shader, pc + 1, dst);
+			shader += "}\n";
+			return dst;
+		}
+
+		default: {
+			if (opcode >= 0x30) {
+				// MAD and MADI use 5-bit operand descriptor indices and lay out their operands differently
+				const bool isMADI = opcode < 0x38;
+				const u32 madDescriptor = this->shader.operandDescriptors[instruction & 0x1f];
+				const u32 madIdx = getBits<22, 2>(instruction);
+				const std::string madDest = getDest(getBits<24, 5>(instruction));
+
+				const std::string a = getSwizzledSource(1, getBits<17, 5>(instruction), 0, madDescriptor);
+				const std::string b = isMADI ? getSwizzledSource(2, getBits<12, 5>(instruction), 0, madDescriptor)
+											 : getSwizzledSource(2, getBits<10, 7>(instruction), madIdx, madDescriptor);
+				const std::string c = isMADI ? getSwizzledSource(3, getBits<5, 7>(instruction), madIdx, madDescriptor)
+											 : getSwizzledSource(3, getBits<5, 5>(instruction), 0, madDescriptor);
+
+				setDest(shader, madDescriptor, madDest, "picaMul(" + a + ", " + b + ") + " + c);
+			} else {
+				// LIT, EMIT and SETEMIT, which vertex shaders don't use in practice
+				fail("Unimplemented instruction", pc);
+			}
+			break;
+		}
+	}
+
+	return pc + 1;
+}
+
+std::optional<std::string> ShaderDecompiler::decompile() {
+	if (config.entrypoint >= PICAShader::maxInstructionCount) {
+		return std::nullopt;
+	}
+
+	std::string main;
+	compileRange(main, config.entrypoint, PICAShader::maxInstructionCount);
+
+	if (compilationError) {
+		return std::nullopt;
+	}
+
+	std::string ret = registerDefinitions;
+
+	for (u32 i = 0; i < config.inputCount; i++) {
+		ret += "layout(location = " + std::to_string(i) + ") in vec4 a_attribute" + std::to_string(i) + ";\n";
+	}
+
+	// Declare every function first, as they can call each other in any order
+	for (const auto& func : functions) {
+		ret += "bool " + getFunctionName(func.start, func.end) + "();\n";
+	}
+
+	for (const auto& func : functions) {
+		ret += "bool " + getFunctionName(func.start, func.end) + "() {\n" + func.body + "}\n";
+	}
+
+	ret += "bool picaMain() {\n" + main + "return true;\n}\n";
+
+	// Run the shader and map its outputs to the vertex fields, the same way GPU::drawArrays does for CPU-shaded vertices
+	ret += R"(
+		void fetchVertex() {
+			for (int i = 0; i < 16; i++) {
+				inputRegs[i] = vec4(0.0);
+				tempRegs[i] = vec4(0.0);
+				outputRegs[i] = vec4(0.0);
+			}
+
+			addrRegs = ivec2(0);
+			loopCounter = 0;
+			cmpRegs = bvec2(false);
+
+			a_coords = vec4(0.0);
+			a_quaternion = vec4(0.0);
+			a_vertexColour = vec4(0.0);
+			a_texcoord0 = vec2(0.0);
+			a_texcoord1 = vec2(0.0);
+			a_texcoord0_w = 0.0;
+			a_view = vec3(0.0);
+			a_texcoord2 = vec2(0.0);
+	)";
+
+	for (u32 i = 0; i < config.inputCount; i++) {
+		const u32 mapping = (config.inputMapping >> (i * 4)) & 0xf;
+		ret += "inputRegs[" + std::to_string(mapping) + "] = a_attribute" + std::to_string(i) + ";\n";
+	}
+
+	ret += "picaMain();\n";
+
+	// The n-th output is the n-th register enabled in the output mask. See GPU::setVsOutputMask
+	u32 outputRegister = 0;
+	for (u32 i = 0; i < config.outputCount; i++) {
+		while (outputRegister < 16 && (config.outputMask & (1 << outputRegister)) == 0) {
+			outputRegister++;
+		}
+
+		const u32 reg = (outputRegister < 16) ? outputRegister++ : i;
+		for (int j = 0; j < 4; j++) {
+			const u32 mapping = (config.outmaps[i] >> (j * 8)) & 0x1F;
+
+			if (mapping < vertexFields.size() && vertexFields[mapping][0] != '\0') {
+				ret += std::string(vertexFields[mapping]) + " = outputRegs[" + std::to_string(reg) + "]." + "xyzw"[j] + ";\n";
+			}
+		}
+	}
+
+	ret += "}\n";
+	return ret;
+}
+
+std::optional<std::string> PICA::ShaderGen::decompileShader(const PICAShader& shader, const VertexConfig& config, API api, Language language) {
+	ShaderDecompiler decompiler(shader, config, api, language);
+	return decompiler.decompile();
+}
@@ -1,5 +1,6 @@
 #include "PICA/pica_frag_config.hpp"
 #include "PICA/regs.hpp"
+#include "PICA/shader_decompiler.hpp"
 #include "PICA/shader_gen.hpp"
 using namespace PICA;
 using namespace PICA::ShaderGen;
@@ -32,6 +33,31 @@ static constexpr const char* uniformDefinition = R"(
 )";
 
 std::string FragmentGenerator::getDefaultVertexShader() {
+	// Vertices come in already shaded by the CPU, so the vertex fields are plain attributes
+	return getVertexShader(R"(
+		layout(location = 0) in vec4 a_coords;
+		layout(location = 1) in vec4 a_quaternion;
+		layout(location = 2) in vec4 a_vertexColour;
+		layout(location = 3) in vec2 a_texcoord0;
+		layout(location = 4) in vec2 a_texcoord1;
+		layout(location = 5) in float a_texcoord0_w;
+		layout(location = 6) in vec3 a_view;
+		layout(location = 7) in vec2 a_texcoord2;
+
+		void fetchVertex() {}
+	)");
+}
+
+std::optional<std::string> FragmentGenerator::getHwVertexShader(const PICAShader& shader, const PICA::VertexConfig& config) {
+	std::optional<std::string> picaShader = decompileShader(shader, config, api, language);
+	if (!picaShader.has_value()) {
+		return std::nullopt;
+	}
+
+	return getVertexShader(picaShader.value());
+}
+
+std::string FragmentGenerator::getVertexShader(const std::string& vertexSource) {
 	std::string ret = "";
 
 	switch (api) {
@@ -50,17 +76,9 @@ std::string FragmentGenerator::getDefaultVertexShader() {
 	}
 
 	ret += uniformDefinition;
+	ret += vertexSource;
 
 	ret += R"(
-		layout(location = 0) in vec4 a_coords;
-		layout(location = 1) in vec4 a_quaternion;
-		layout(location = 2) in vec4 a_vertexColour;
-		layout(location = 3) in vec2 a_texcoord0;
-		layout(location = 4) in vec2 a_texcoord1;
-		layout(location = 5) in float a_texcoord0_w;
-		layout(location = 6) in vec3 a_view;
-		layout(location = 7) in vec2 a_texcoord2;
-
 		out vec4 v_quaternion;
 		out vec4 v_colour;
 		out vec3 v_texcoord0;
@@ -78,6 +96,8 @@ std::string FragmentGenerator::getDefaultVertexShader() {
 		}
 
 		void main() {
+			fetchVertex();
+
 			gl_Position = a_coords;
 			vec4 colourAbs = abs(a_vertexColour);
 			v_colour = min(colourAbs, vec4(1.f));
@@ -1,6 +1,16 @@
 #include "PICA/shader_unit.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include "cityhash.hpp"
+#include "savestate.hpp"
+
+#if defined(PANDA3DS_X64_HOST)
+#include <immintrin.h>
+#elif defined(PANDA3DS_ARM64_HOST)
+#include <arm_neon.h>
+#endif
 
 void ShaderUnit::reset() {
 	vs.reset();
@@ -33,5 +43,149 @@ void PICAShader::reset() {
 	loopCounter = 0;
 
 	codeHashDirty = true;
+	dirtyCodeBegin = 0;
+	dirtyCodeEnd = maxInstructionCount;
 	opdescHashDirty = true;
+}
+
+// Registers and the flow control stacks only live for the duration of a single vertex, so they aren't saved
+void PICAShader::doState(SaveStateStream& stream) {
+	stream.section("SHDR");
+	stream.value(loadedShader);
+	stream.value(operandDescriptors);
+	stream.value(entrypoint);
+	stream.value(boolUniform);
+	stream.value(intUniforms);
+	stream.value(floatUniforms);
+	stream.value(fixedAttributes);
+
+	stream.value(bufferIndex);
+	stream.value(opDescriptorIndex);
+	stream.value(floatUniformIndex);
+	stream.value(floatUniformWordCount);
+	stream.value(f32UniformTransfer);
+	stream.value(floatUniformBuffer);
+
+	if (stream.isReading()) {
+		bufferIndex &= 0xfff;
+		opDescriptorIndex &= 0x7f;
+		floatUniformWordCount = std::min<u32>(floatUniformWordCount, 3);
+
+		// The JIT and the hardware shader cache look shaders up by hash, which has to be recomputed for the new code
+		markCodeDirty(0, maxInstructionCount);
+		opdescHashDirty = true;
+	}
+}
+
+void PICAShader::uploadWords(std::span<const u32> words) {
+	// Uploads that run into the end of the program memory go through uploadWord, which reports the overflow
+	if (bufferIndex + words.size() >= maxInstructionCount - 1) [[unlikely]] {
+		for (u32 word : words) {
+			uploadWord(word);
+		}
+		return;
+	}
+
+	const u32 begin = bufferIndex;
+	const usize bytes = words.size_bytes();
+	if (std::memcmp(&loadedShader[begin], words.data(), bytes) != 0) {
+		std::memcpy(&loadedShader[begin], words.data(), bytes);
+		markCodeDirty(begin, begin + u32(words.size()));
+	}
+
+	bufferIndex += int(words.size());
+}
+
+void PICAShader::uploadDescriptors(std::span<const u32> words) {
+	while (!words.empty()) {
+		// The descriptor index wraps around, so copy up to the end of the array at a time
+		const usize count = std::min<usize>(words.size(), operandDescriptors.size() - opDescriptorIndex);
+		const usize bytes = count * sizeof(u32);
+
+		if (std::memcmp(&operandDescriptors[opDescriptorIndex], words.data(), bytes) != 0) {
+			std::memcpy(&operandDescriptors[opDescriptorIndex], words.data(), bytes);
+			opdescHashDirty = true;
+		}
+
+		opDescriptorIndex = (opDescriptorIndex + int(count)) & 0x7f;
+		words = words.subspan(count);
+	}
+}
+
+namespace {
+	static_assert(sizeof(Floats::f24) == sizeof(u32), "f24 must be stored as a plain f32 for uniform uploads");
+
+	// Converts 4 raw f24 values to f32 at once. Does the same as f24::fromRaw for each lane
+	void unpackF24(const std::array<u32, 4>& raw, Floats::f24* out) {
+#if defined(PANDA3DS_X64_HOST)
+		const __m128i hex = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw.data()));
+		const __m128i sign = _mm_slli_epi32(_mm_srli_epi32(hex, 23), 31);
+		const __m128i mantissa = _mm_slli_epi32(_mm_and_si128(hex, _mm_set1_epi32(0xffff)), 7);
+		__m128i exponent = _mm_and_si128(_mm_srli_epi32(hex, 16), _mm_set1_epi32(0x7f));
+
+		// Rebias the exponent, mapping the maximum f24 exponent to the f32 inf/NaN one. Values with all bits but the sign clear become 0
+		const __m128i isInfOrNaN = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7f));
+		exponent = _mm_or_si128(_mm_add_epi32(exponent, _mm_set1_epi32(64)), _mm_and_si128(isInfOrNaN, _mm_set1_epi32(0xff)));
+		const __m128i isZero = _mm_cmpeq_epi32(_mm_and_si128(hex, _mm_set1_epi32(0x7fffff)), _mm_setzero_si128());
+
+		const __m128i magnitude = _mm_andnot_si128(isZero, _mm_or_si128(mantissa, _mm_slli_epi32(exponent, 23)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(sign, magnitude));
+#elif defined(PANDA3DS_ARM64_HOST)
+		const uint32x4_t hex = vld1q_u32(raw.data());
+		const uint32x4_t sign = vshlq_n_u32(vshrq_n_u32(hex, 23), 31);
+		const uint32x4_t mantissa = vshlq_n_u32(vandq_u32(hex, vdupq_n_u32(0xffff)), 7);
+		uint32x4_t exponent = vandq_u32(vshrq_n_u32(hex, 16), vdupq_n_u32(0x7f));
+
+		const uint32x4_t isInfOrNaN = vceqq_u32(exponent, vdupq_n_u32(0x7f));
+		exponent = vorrq_u32(vaddq_u32(exponent, vdupq_n_u32(64)), vandq_u32(isInfOrNaN, vdupq_n_u32(0xff)));
+		const uint32x4_t isZero = vceqq_u32(vandq_u32(hex, vdupq_n_u32(0x7fffff)), vdupq_n_u32(0));
+
+		const uint32x4_t magnitude = vbicq_u32(vorrq_u32(mantissa, vshlq_n_u32(exponent, 23)), isZero);
+		vst1q_u32(reinterpret_cast<u32*>(out), vorrq_u32(sign, magnitude));
+#else
+		for (int i = 0; i < 4; i++) {
+			out[i] = Floats::f24::fromRaw(raw[i]);
+		}
+#endif
+	}
+}  // namespace
+
+void PICAShader::uploadFloatUniforms(std::span<const u32> words) {
+	// Finish off a uniform a previous write left half-done
+	while (floatUniformWordCount != 0 && !words.empty()) {
+		uploadFloatUniform(words[0]);
+		words = words.subspan(1);
+	}
+
+	const usize wordsPerUniform = f32UniformTransfer ? 4 : 3;
+	while (words.size() >= wordsPerUniform) {
+		if (floatUniformIndex >= floatUniforms.size()) [[unlikely]] {
+			// Writes past the last uniform are dropped
+			words = words.subspan(words.size() - words.size() % wordsPerUniform);
+			break;
+		}
+
+		vec4f& uniform = floatUniforms[floatUniformIndex++];
+		if (f32UniformTransfer) {
+			// f24 is stored as an f32, so this is just a copy with the components in reverse order
+			for (int i = 0; i < 4; i++) {
+				std::memcpy(&uniform[i], &words[3 - i], sizeof(u32));
+			}
+		} else {
+			const std::array<u32, 4> raw = {
+				words[2] & 0xffffff,
+				((words[1] & 0xffff) << 8) | (words[2] >> 24),
+				((words[0] & 0xff) << 16) | (words[1] >> 16),
+				words[0] >> 8,
+			};
+			unpackF24(raw, uniform.data());
+		}
+
+		words = words.subspan(wordsPerUniform);
+	}
+
+	// Buffer whatever is left of the last uniform for the next write
+	for (u32 word : words) {
+		uploadFloatUniform(word);
+	}
 }
\ No newline at end of file
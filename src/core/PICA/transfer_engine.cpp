@@ -0,0 +1,467 @@
+#include "PICA/transfer_engine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "PICA/gpu.hpp"
+#include "colour.hpp"
+
+#if defined(PANDA3DS_X64_HOST)
+#include <immintrin.h>
+#elif defined(PANDA3DS_ARM64_HOST)
+#include <arm_neon.h>
+#endif
+
+using namespace PICA;
+
+namespace {
+	// Offsets of the texels in an 8x8 tile, depending on their x and y. See Texture::mortonInterleave
+	constexpr std::array<u32, 8> xOffsets = {0, 1, 4, 5, 16, 17, 20, 21};
+	constexpr std::array<u32, 8> yOffsets = {0, 2, 8, 10, 32, 34, 40, 42};
+
+	u32 getPixelOffset(bool tiled, u32 x, u32 y, u32 width, u32 bpp) {
+		if (tiled) {
+			return (((x & ~7) * 8) + ((y & ~7) * width) + xOffsets[x & 7] + yOffsets[y & 7]) * bpp;
+		} else {
+			return (x + y * width) * bpp;
+		}
+	}
+
+	// Offset of the start of row y in a tiled image. Pairs of horizontally adjacent texels are contiguous inside a tile, with the rest of the
+	// row's texels at fixed offsets from there
+	u32 getTiledRowOffset(u32 y, u32 width, u32 bpp) { return ((y & ~7) * width + yOffsets[y & 7]) * bpp; }
+
+	// Decoded pixel. The channels are wider than 8 bits so that they can hold the sums of the pixels being averaged when scaling
+	struct Pixel {
+		u32 r, g, b, a;
+	};
+
+	// Same layouts as Texture::decodeTexel
+	Pixel decodePixel(ColorFmt format, const u8* in) {
+		switch (format) {
+			case ColorFmt::RGBA8: return {in[3], in[2], in[1], in[0]};
+			case ColorFmt::RGB8: return {in[2], in[1], in[0], 0xff};
+
+			case ColorFmt::RGBA5551: {
+				const u16 texel = u16(in[0]) | (u16(in[1]) << 8);
+				return {
+					Colour::convert5To8Bit(Helpers::getBits<11, 5>(texel)),
+					Colour::convert5To8Bit(Helpers::getBits<6, 5>(texel)),
+					Colour::convert5To8Bit(Helpers::getBits<1, 5>(texel)),
+					(texel & 1) ? 0xffu : 0u,
+				};
+			}
+
+			case ColorFmt::RGB565: {
+				const u16 texel = u16(in[0]) | (u16(in[1]) << 8);
+				return {
+					Colour::convert5To8Bit(Helpers::getBits<11, 5>(texel)),
+					Colour::convert6To8Bit(Helpers::getBits<5, 6>(texel)),
+					Colour::convert5To8Bit(Helpers::getBits<0, 5>(texel)),
+					0xff,
+				};
+			}
+
+			case ColorFmt::RGBA4: {
+				const u16 texel = u16(in[0]) | (u16(in[1]) << 8);
+				return {
+					Colour::convert4To8Bit(Helpers::getBits<12, 4>(texel)),
+					Colour::convert4To8Bit(Helpers::getBits<8, 4>(texel)),
+					Colour::convert4To8Bit(Helpers::getBits<4, 4>(texel)),
+					Colour::convert4To8Bit(Helpers::getBits<0, 4>(texel)),
+				};
+			}
+
+			default: return {0, 0, 0, 0};
+		}
+	}
+
+	void encodePixel(ColorFmt format, const Pixel& colour, u8* out) {
+		const u32 r = colour.r, g = colour.g, b = colour.b, a = colour.a;
+		u16 texel;
+
+		switch (format) {
+			case ColorFmt::RGBA8:
+				out[0] = u8(a);
+				out[1] = u8(b);
+				out[2] = u8(g);
+				out[3] = u8(r);
+				return;
+
+			case ColorFmt::RGB8:
+				out[0] = u8(b);
+				out[1] = u8(g);
+				out[2] = u8(r);
+				return;
+
+			case ColorFmt::RGBA5551: texel = u16(((r >> 3) << 11) | ((g >> 3) << 6) | ((b >> 3) << 1) | (a >> 7)); break;
+			case ColorFmt::RGB565: texel = u16(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)); break;
+			case ColorFmt::RGBA4: texel = u16(((r >> 4) << 12) | ((g >> 4) << 8) | ((b >> 4) << 4) | (a >> 4)); break;
+			default: return;
+		}
+
+		out[0] = u8(texel);
+		out[1] = u8(texel >> 8);
+	}
+
+	// Fast paths for transfers that don't convert formats or scale, which is what games use to present their framebuffers.
+	// These copy a whole row between a tiled and a linear image, a tile (8 pixels) at a time, so width must be a multiple of 8.
+	// Each pair of pixels is contiguous in the tile, so 32bpp rows are copied with 64-bit loads and 128-bit stores
+	template <u32 bpp>
+	void tiledToLinearRow(const u8* tiles, u8* out, u32 width) {
+		for (u32 x = 0; x < width; x += 8) {
+			const u8* tile = tiles + x * 8 * bpp;
+			u8* dest = out + x * bpp;
+
+#if defined(PANDA3DS_X64_HOST)
+			if constexpr (bpp == 4) {
+				const __m128i p01 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tile));
+				const __m128i p23 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tile + 4 * bpp));
+				const __m128i p45 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tile + 16 * bpp));
+				const __m128i p67 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tile + 20 * bpp));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_unpacklo_epi64(p01, p23));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 16), _mm_unpacklo_epi64(p45, p67));
+				continue;
+			}
+#elif defined(PANDA3DS_ARM64_HOST)
+			if constexpr (bpp == 4) {
+				vst1q_u8(dest, vcombine_u8(vld1_u8(tile), vld1_u8(tile + 4 * bpp)));
+				vst1q_u8(dest + 16, vcombine_u8(vld1_u8(tile + 16 * bpp), vld1_u8(tile + 20 * bpp)));
+				continue;
+			}
+#endif
+			for (u32 pair = 0; pair < 8; pair += 2) {
+				std::memcpy(dest + pair * bpp, tile + xOffsets[pair] * bpp, 2 * bpp);
+			}
+		}
+	}
+
+	template <u32 bpp>
+	void linearToTiledRow(const u8* in, u8* tiles, u32 width) {
+		for (u32 x = 0; x < width; x += 8) {
+			const u8* source = in + x * bpp;
+			u8* tile = tiles + x * 8 * bpp;
+
+#if defined(PANDA3DS_X64_HOST)
+			if constexpr (bpp == 4) {
+				const __m128i p0123 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+				const __m128i p4567 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 16));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(tile), p0123);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(tile + 4 * bpp), _mm_unpackhi_epi64(p0123, p0123));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(tile + 16 * bpp), p4567);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(tile + 20 * bpp), _mm_unpackhi_epi64(p4567, p4567));
+				continue;
+			}
+#elif defined(PANDA3DS_ARM64_HOST)
+			if constexpr (bpp == 4) {
+				const uint8x16_t p0123 = vld1q_u8(source);
+				const uint8x16_t p4567 = vld1q_u8(source + 16);
+				vst1_u8(tile, vget_low_u8(p0123));
+				vst1_u8(tile + 4 * bpp, vget_high_u8(p0123));
+				vst1_u8(tile + 16 * bpp, vget_low_u8(p4567));
+				vst1_u8(tile + 20 * bpp, vget_high_u8(p4567));
+				continue;
+			}
+#endif
+			for (u32 pair = 0; pair < 8; pair += 2) {
+				std::memcpy(tile + xOffsets[pair] * bpp, source + pair * bpp, 2 * bpp);
+			}
+		}
+	}
+
+	template <u32 bpp>
+	void copyRow(const u8* in, u8* out, bool inputTiled, bool outputTiled, u32 inputY, u32 outputY, u32 inputWidth, u32 outputWidth) {
+		const u8* source = in + (inputTiled ? getTiledRowOffset(inputY, inputWidth, bpp) : inputY * inputWidth * bpp);
+		u8* dest = out + (outputTiled ? getTiledRowOffset(outputY, outputWidth, bpp) : outputY * outputWidth * bpp);
+
+		if (inputTiled && !outputTiled) {
+			tiledToLinearRow<bpp>(source, dest, outputWidth);
+		} else if (!inputTiled && outputTiled) {
+			linearToTiledRow<bpp>(source, dest, outputWidth);
+		} else if (!inputTiled) {
+			std::memcpy(dest, source, outputWidth * bpp);
+		} else {
+			// Tiled to tiled with different strides, which only moves whole tiles around
+			for (u32 x = 0; x < outputWidth; x += 8) {
+				for (u32 pair = 0; pair < 8; pair += 2) {
+					std::memcpy(dest + (x * 8 + xOffsets[pair]) * bpp, source + (x * 8 + xOffsets[pair]) * bpp, 2 * bpp);
+				}
+			}
+		}
+	}
+}  // namespace
+
+TransferEngine::~TransferEngine() {
+	{
+		std::unique_lock lock(jobMutex);
+		stopping = true;
+	}
+
+	jobReady.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void TransferEngine::startWorkers() {
+	workersStarted = true;
+
+	// The emulator and GPU threads are already busy, so don't go overboard with the workers
+	const u32 threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+	for (u32 band = 1; band < threadCount; band++) {
+		workers.emplace_back([this, band]() { workerLoop(band); });
+	}
+}
+
+void TransferEngine::workerLoop(u32 band) {
+	u64 lastGeneration = 0;
+
+	while (true) {
+		std::unique_lock lock(jobMutex);
+		jobReady.wait(lock, [&]() { return stopping || jobGeneration != lastGeneration; });
+		if (stopping) {
+			return;
+		}
+
+		lastGeneration = jobGeneration;
+		const RowJob& currentJob = *job;
+		const u32 firstRow = band * jobBandRows;
+		const u32 lastRow = std::min(firstRow + jobBandRows, jobRows);
+		lock.unlock();
+
+		if (firstRow < lastRow) {
+			currentJob(firstRow, lastRow);
+		}
+
+		lock.lock();
+		if (--pendingWorkers == 0) {
+			jobDone.notify_one();
+		}
+	}
+}
+
+void TransferEngine::forEachRowBand(u32 rows, usize bytes, const RowJob& rowJob) {
+	// Below this, waking the workers up costs more than it saves
+	static constexpr usize parallelThreshold = 256_KB;
+
+	if (bytes >= parallelThreshold && !workersStarted) {
+		startWorkers();
+	}
+
+	if (bytes < parallelThreshold || workers.empty()) {
+		rowJob(0, rows);
+		return;
+	}
+
+	const u32 bandCount = u32(workers.size()) + 1;
+	// Bands are made of whole rows of tiles, so that no 2 threads write to the same tile
+	const u32 bandRows = ((rows + bandCount - 1) / bandCount + 7) & ~7u;
+
+	{
+		std::unique_lock lock(jobMutex);
+		job = &rowJob;
+		jobRows = rows;
+		jobBandRows = bandRows;
+		pendingWorkers = u32(workers.size());
+		jobGeneration++;
+	}
+
+	jobReady.notify_all();
+	rowJob(0, std::min(bandRows, rows));
+
+	std::unique_lock lock(jobMutex);
+	jobDone.wait(lock, [&]() { return pendingWorkers == 0; });
+	job = nullptr;
+}
+
+u8* TransferEngine::getPointer(u32 paddr, u32 size) {
+	const bool inFCRAM = paddr >= PhysicalAddrs::FCRAM && u64(paddr) + size <= PhysicalAddrs::FCRAMEnd;
+	const bool inVRAM = paddr >= PhysicalAddrs::VRAM && u64(paddr) + size <= PhysicalAddrs::VRAMEnd;
+
+	if (!inFCRAM && !inVRAM) [[unlikely]] {
+		return nullptr;
+	}
+
+	return gpu.getPointerPhys<u8>(paddr, size);
+}
+
+void TransferEngine::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) {
+	const u32 inputWidth = inputSize & 0xffff;
+	const u32 inputHeight = inputSize >> 16;
+	const u32 inputFormatIndex = Helpers::getBits<8, 3>(flags);
+	const u32 outputFormatIndex = Helpers::getBits<12, 3>(flags);
+	const bool verticalFlip = flags & 1;
+	const bool inputLinear = flags & 2;
+	const bool dontSwizzle = flags & (1 << 5);
+	const Scaling scaling = static_cast<Scaling>(Helpers::getBits<24, 2>(flags));
+
+	if (inputFormatIndex > 4 || outputFormatIndex > 4 || scaling > Scaling::XY) [[unlikely]] {
+		Helpers::warn("TransferEngine: Invalid display transfer (flags = %08X)", flags);
+		return;
+	}
+
+	if (flags & (1 << 16)) {
+		Helpers::warn("TransferEngine: Display transfer with 32x32 blocks is not supported");
+	}
+
+	const ColorFmt inputFormat = toColorFmt(inputFormatIndex);
+	const ColorFmt outputFormat = toColorFmt(outputFormatIndex);
+	const u32 inputBpp = sizePerPixel(inputFormat);
+	const u32 outputBpp = sizePerPixel(outputFormat);
+
+	// Scaling halves the output in the scaled directions, with each output pixel being the average of the input pixels it covers
+	const u32 horizontalScale = (scaling != Scaling::None) ? 1 : 0;
+	const u32 verticalScale = (scaling == Scaling::XY) ? 1 : 0;
+	const u32 outputWidth = (outputSize & 0xffff) >> horizontalScale;
+	const u32 outputHeight = (outputSize >> 16) >> verticalScale;
+
+	const bool inputTiled = !inputLinear;
+	// By default the transfer converts between tiled and linear images, unless swizzling is disabled
+	const bool outputTiled = dontSwizzle ? inputTiled : !inputTiled;
+
+	// Every output pixel reads the input pixels it covers, so the input has to be at least as big as the output before scaling. Tiled
+	// images are made of whole 8x8 tiles, otherwise tiles at the edges would stick out of the image
+	const auto isWholeTiles = [](bool tiled, u32 width, u32 height) { return !tiled || ((width | height) & 7) == 0; };
+	if ((outputWidth << horizontalScale) > inputWidth || (outputHeight << verticalScale) > inputHeight ||
+		!isWholeTiles(inputTiled, inputWidth, inputHeight) || !isWholeTiles(outputTiled, outputWidth, outputHeight)) [[unlikely]] {
+		Helpers::warn(
+			"TransferEngine: Display transfer with mismatched sizes (input = %dx%d, output = %dx%d, flags = %08X)", inputWidth, inputHeight,
+			outputWidth, outputHeight, flags
+		);
+		return;
+	}
+
+	const u32 inputBytes = inputWidth * inputHeight * inputBpp;
+	const u32 outputBytes = outputWidth * outputHeight * outputBpp;
+	if (outputBytes == 0) {
+		return;
+	}
+
+	// Get any newer copy of the data the renderer has into memory first. The output too, as the transfer might not overwrite all of it
+	gpu.flushVRAM(inputAddr, inputBytes);
+	gpu.flushVRAM(outputAddr, outputBytes);
+
+	const u8* in = getPointer(inputAddr, inputBytes);
+	u8* out = getPointer(outputAddr, outputBytes);
+	if (in == nullptr || out == nullptr) [[unlikely]] {
+		Helpers::warn("TransferEngine: Display transfer from %08X to %08X out of bounds", inputAddr, outputAddr);
+		return;
+	}
+	gpu.markFCRAMDirty(outputAddr, outputBytes);
+
+	const bool fastPath = inputFormat == outputFormat && scaling == Scaling::None && (outputWidth % 8) == 0 && outputWidth <= inputWidth;
+
+	forEachRowBand(outputHeight, usize(outputBytes) + inputBytes, [&](u32 firstRow, u32 lastRow) {
+		for (u32 y = firstRow; y < lastRow; y++) {
+			const u32 outputY = verticalFlip ? (outputHeight - y - 1) : y;
+			const u32 inputY = y << verticalScale;
+
+			if (fastPath) {
+				switch (inputBpp) {
+					case 2: copyRow<2>(in, out, inputTiled, outputTiled, inputY, outputY, inputWidth, outputWidth); break;
+					case 3: copyRow<3>(in, out, inputTiled, outputTiled, inputY, outputY, inputWidth, outputWidth); break;
+					default: copyRow<4>(in, out, inputTiled, outputTiled, inputY, outputY, inputWidth, outputWidth); break;
+				}
+				continue;
+			}
+
+			for (u32 x = 0; x < outputWidth; x++) {
+				const u32 inputX = x << horizontalScale;
+				Pixel colour = decodePixel(inputFormat, &in[getPixelOffset(inputTiled, inputX, inputY, inputWidth, inputBpp)]);
+
+				if (scaling != Scaling::None) {
+					const Pixel right = decodePixel(inputFormat, &in[getPixelOffset(inputTiled, inputX + 1, inputY, inputWidth, inputBpp)]);
+					colour = {colour.r + right.r, colour.g + right.g, colour.b + right.b, colour.a + right.a};
+
+					if (scaling == Scaling::XY) {
+						const Pixel bottom =
+							decodePixel(inputFormat, &in[getPixelOffset(inputTiled, inputX, inputY + 1, inputWidth, inputBpp)]);
+						const Pixel bottomRight =
+							decodePixel(inputFormat, &in[getPixelOffset(inputTiled, inputX + 1, inputY + 1, inputWidth, inputBpp)]);
+
+						colour.r = (colour.r + bottom.r + bottomRight.r) / 4;
+						colour.g = (colour.g + bottom.g + bottomRight.g) / 4;
+						colour.b = (colour.b + bottom.b + bottomRight.b) / 4;
+						colour.a = (colour.a + bottom.a + bottomRight.a) / 4;
+					} else {
+						colour = {colour.r / 2, colour.g / 2, colour.b / 2, colour.a / 2};
+					}
+				}
+
+				encodePixel(outputFormat, colour, &out[getPixelOffset(outputTiled, x, outputY, outputWidth, outputBpp)]);
+			}
+		}
+	});
+}
+
+void TransferEngine::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) {
+	// Texture copy size is aligned to 16 byte units
+	const u32 copySize = totalBytes & ~0xf;
+	if (copySize == 0) {
+		return;
+	}
+
+	// The width and gap are provided in 16-byte units. A width of 0 means the data is copied contiguously
+	u32 inputWidth = (inputSize & 0xffff) << 4;
+	u32 inputGap = (inputSize >> 16) << 4;
+	u32 outputWidth = (outputSize & 0xffff) << 4;
+	u32 outputGap = (outputSize >> 16) << 4;
+
+	if (inputWidth == 0) {
+		inputWidth = copySize;
+		inputGap = 0;
+	}
+
+	if (outputWidth == 0) {
+		outputWidth = copySize;
+		outputGap = 0;
+	}
+
+	// Both ranges span every line of the copy, including the gaps between them
+	const u64 inputLines = (copySize + inputWidth - 1) / inputWidth;
+	const u64 outputLines = (copySize + outputWidth - 1) / outputWidth;
+	const u64 inputSpan = inputLines * (inputWidth + inputGap) - inputGap;
+	const u64 outputSpan = outputLines * (outputWidth + outputGap) - outputGap;
+
+	if (inputSpan > 0xffffffff || outputSpan > 0xffffffff) [[unlikely]] {
+		Helpers::warn("TransferEngine: Texture copy from %08X to %08X out of bounds", inputAddr, outputAddr);
+		return;
+	}
+
+	gpu.flushVRAM(inputAddr, u32(inputSpan));
+	gpu.flushVRAM(outputAddr, u32(outputSpan));
+
+	const u8* in = getPointer(inputAddr, u32(inputSpan));
+	u8* out = getPointer(outputAddr, u32(outputSpan));
+	if (in == nullptr || out == nullptr) [[unlikely]] {
+		Helpers::warn("TransferEngine: Texture copy from %08X to %08X out of bounds", inputAddr, outputAddr);
+		return;
+	}
+	gpu.markFCRAMDirty(outputAddr, u32(outputSpan));
+
+	u32 remainingSize = copySize;
+	u32 remainingInput = inputWidth;
+	u32 remainingOutput = outputWidth;
+
+	while (remainingSize > 0) {
+		const u32 size = std::min({remainingInput, remainingOutput, remainingSize});
+		std::memmove(out, in, size);
+
+		in += size;
+		out += size;
+		remainingInput -= size;
+		remainingOutput -= size;
+		remainingSize -= size;
+
+		if (remainingInput == 0) {
+			remainingInput = inputWidth;
+			in += inputGap;
+		}
+
+		if (remainingOutput == 0) {
+			remainingOutput = outputWidth;
+			out += outputGap;
+		}
+	}
+}
@@ -1,5 +1,6 @@
 #include "applets/applet_manager.hpp"
 
+#include "savestate.hpp"
 #include "services/apt.hpp"
 
 using namespace Applets;
@@ -14,6 +15,24 @@ void AppletManager::reset() {
 	error.reset();
 }
 
+void AppletManager::doState(SaveStateStream& stream) {
+	bool hasParameter = nextParameter.has_value();
+	stream.value(hasParameter);
+
+	if (stream.isReading()) {
+		nextParameter = hasParameter ? std::optional<Parameter>(Parameter{}) : std::nullopt;
+	}
+
+	if (hasParameter) {
+		Parameter& parameter = nextParameter.value();
+		stream.value(parameter.senderID);
+		stream.value(parameter.destID);
+		stream.value(parameter.signal);
+		stream.value(parameter.object);
+		stream.vector(parameter.data);
+	}
+}
+
 AppletBase* AppletManager::getApplet(u32 id) {
 	switch (id) {
 		case AppletIDs::MiiSelector:
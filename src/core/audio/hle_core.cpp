@@ -5,6 +5,7 @@
 #include <thread>
 #include <utility>
 
+#include "savestate.hpp"
 #include "services/dsp.hpp"
 
 namespace Audio {
@@ -76,6 +77,20 @@ namespace Audio {
 		resetAudioPipe();
 	}
 
+	void HLE_DSP::doState(SaveStateStream& stream) {
+		stream.section("HDSP");
+		stream.value(dspState);
+		stream.value(loaded);
+
+		for (auto& pipe : pipeData) {
+			stream.vector(pipe);
+		}
+
+		for (auto& source : sources) {
+			source.doState(stream);
+		}
+	}
+
 	void HLE_DSP::loadComponent(std::vector<u8>& data, u32 programMask, u32 dataMask) {
 		if (loaded) {
 			Helpers::warn("Loading DSP component when already loaded");
@@ -571,4 +586,50 @@ namespace Audio {
 
 		buffers = {};
 	}
+
+	void DSPSource::doState(SaveStateStream& stream) {
+		stream.value(sampleFormat);
+		stream.value(sourceType);
+		stream.value(gain0);
+		stream.value(gain1);
+		stream.value(gain2);
+		stream.value(samplePosition);
+		stream.value(syncCount);
+		stream.value(currentBufferID);
+		stream.value(previousBufferID);
+		stream.value(enabled);
+		stream.value(isBufferIDDirty);
+		stream.value(adpcmCoefficients);
+		stream.value(history1);
+		stream.value(history2);
+
+		// The priority queue doesn't let us look at its contents, so go through a copy of it. The order doesn't matter as pushing the
+		// buffers back re-sorts them
+		std::vector<Buffer> queued;
+		if (stream.isWriting()) {
+			BufferQueue copy = buffers;
+			while (!copy.empty()) {
+				queued.push_back(copy.top());
+				copy.pop();
+			}
+		}
+
+		stream.vector(queued);
+		if (stream.isReading()) {
+			buffers = {};
+			for (const auto& buffer : queued) {
+				buffers.push(buffer);
+			}
+		}
+
+		std::vector<std::array<s16, 2>> samples;
+		if (stream.isWriting()) {
+			samples.assign(currentSamples.begin(), currentSamples.end());
+		}
+
+		stream.vector(samples);
+		if (stream.isReading()) {
+			currentSamples.assign(samples.begin(), samples.end());
+		}
+	}
 }  // namespace Audio
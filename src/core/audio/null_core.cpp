@@ -1,5 +1,6 @@
 #include "audio/null_core.hpp"
 
+#include "savestate.hpp"
 #include "services/dsp.hpp"
 
 namespace Audio {
@@ -56,6 +57,16 @@ namespace Audio {
 		resetAudioPipe();
 	}
 
+	void NullDSP::doState(SaveStateStream& stream) {
+		stream.section("NDSP");
+		stream.value(dspState);
+		stream.value(loaded);
+
+		for (auto& pipe : pipeData) {
+			stream.vector(pipe);
+		}
+	}
+
 	void NullDSP::loadComponent(std::vector<u8>& data, u32 programMask, u32 dataMask) {
 		if (loaded) {
 			Helpers::warn("Loading DSP component when already loaded");
@@ -5,6 +5,7 @@
 #include <cstring>
 #include <thread>
 
+#include "savestate.hpp"
 #include "services/dsp.hpp"
 
 using namespace Audio;
@@ -48,9 +49,18 @@ TeakraDSP::TeakraDSP(Memory& mem, Scheduler& scheduler, DSPService& dspService)
 	ahbm.read16 = [&](u32 addr) -> u16 { return *(u16*)&mem.getFCRAM()[addr - PhysicalAddrs::FCRAM]; };
 	ahbm.read32 = [&](u32 addr) -> u32 { return *(u32*)&mem.getFCRAM()[addr - PhysicalAddrs::FCRAM]; };
 
-	ahbm.write8 = [&](u32 addr, u8 value) { mem.getFCRAM()[addr - PhysicalAddrs::FCRAM] = value; };
-	ahbm.write16 = [&](u32 addr, u16 value) { *(u16*)&mem.getFCRAM()[addr - PhysicalAddrs::FCRAM] = value; };
-	ahbm.write32 = [&](u32 addr, u32 value) { *(u32*)&mem.getFCRAM()[addr - PhysicalAddrs::FCRAM] = value; };
+	ahbm.write8 = [&](u32 addr, u8 value) {
+		mem.getFCRAM()[addr - PhysicalAddrs::FCRAM] = value;
+		mem.markFCRAMDirty(addr, sizeof(u8));
+	};
+	ahbm.write16 = [&](u32 addr, u16 value) {
+		*(u16*)&mem.getFCRAM()[addr - PhysicalAddrs::FCRAM] = value;
+		mem.markFCRAMDirty(addr, sizeof(u16));
+	};
+	ahbm.write32 = [&](u32 addr, u32 value) {
+		*(u32*)&mem.getFCRAM()[addr - PhysicalAddrs::FCRAM] = value;
+		mem.markFCRAMDirty(addr, sizeof(u32));
+	};
 
 	teakra.SetAHBMCallback(ahbm);
 	teakra.SetAudioCallback([](std::array<s16, 2> sample) { /* Do nothing */ });
@@ -117,6 +127,21 @@ void TeakraDSP::reset() {
 	audioFrameIndex = 0;
 }
 
+void TeakraDSP::doState(SaveStateStream& stream) {
+	// Teakra has no way to get at the internal state of the DSP, so only our side of it gets saved. Audio may break after loading a state
+	// until the game reloads its DSP component
+	if (stream.isReading()) {
+		Helpers::warn("Teakra: Loading a save state doesn't restore the state of the DSP");
+	}
+
+	stream.section("TDSP");
+	stream.value(running);
+	stream.value(loaded);
+	stream.value(signalledData);
+	stream.value(signalledSemaphore);
+	stream.value(pipeBaseAddr);
+}
+
 void TeakraDSP::setAudioEnabled(bool enable) {
 	if (audioEnabled != enable) {
 		audioEnabled = enable;
@@ -11,7 +11,7 @@ HorizonResult ExtSaveDataArchive::createFile(const FSPath& path, u64 size) {
 		if (!isPathSafe<PathType::UTF16>(path))
 			Helpers::panic("Unsafe path in ExtSaveData::CreateFile");
 
-		fs::path p = IOFile::getAppData() / backingFolder;
+		fs::path p = getAppData() / backingFolder;
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::exists(p))
@@ -37,7 +37,7 @@ HorizonResult ExtSaveDataArchive::deleteFile(const FSPath& path) {
 		if (!isPathSafe<PathType::UTF16>(path))
 			Helpers::panic("Unsafe path in ExtSaveData::DeleteFile");
 
-		fs::path p = IOFile::getAppData() / backingFolder;
+		fs::path p = getAppData() / backingFolder;
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_directory(p)) {
@@ -72,12 +72,12 @@ FileDescriptor ExtSaveDataArchive::openFile(const FSPath& path, const FilePerms&
 		if (perms.create())
 			Helpers::panic("[ExtSaveData] Can't open file with create flag");
 
-		fs::path p = IOFile::getAppData() / backingFolder;
+		fs::path p = getAppData() / backingFolder;
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::exists(p)) { // Return file descriptor if the file exists
-			IOFile file(p.string().c_str(), "r+b"); // According to Citra, this ignores the OpenFlags field and always opens as r+b? TODO: Check
-			return file.isOpen() ? file.getHandle() : FileError;
+			// According to Citra, this ignores the OpenFlags field and always opens as r+b? TODO: Check
+			return openHostFile(p, "r+b");
 		} else {
 			return FileError;
 		}
@@ -97,7 +97,7 @@ HorizonResult ExtSaveDataArchive::renameFile(const FSPath& oldPath, const FSPath
 	}
 
 	// Construct host filesystem paths
-	fs::path sourcePath = IOFile::getAppData() / backingFolder;
+	fs::path sourcePath = getAppData() / backingFolder;
 	fs::path destPath = sourcePath;
 
 	sourcePath += fs::path(oldPath.utf16_string).make_preferred();
@@ -130,7 +130,7 @@ HorizonResult ExtSaveDataArchive::createDirectory(const FSPath& path) {
 			Helpers::panic("Unsafe path in ExtSaveData::OpenFile");
 		}
 
-		fs::path p = IOFile::getAppData() / backingFolder;
+		fs::path p = getAppData() / backingFolder;
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_directory(p)) return Result::FS::AlreadyExists;
@@ -162,7 +162,7 @@ Rust::Result<ArchiveBase*, HorizonResult> ExtSaveDataArchive::openArchive(const
 
 	// TODO: Readd the format check. I didn't manage to fix it sadly
 	// Create a format info path in the style of AppData/FormatInfo/Cartridge10390390194.format
-	// fs::path formatInfopath = IOFile::getAppData() / "FormatInfo" / (getExtSaveDataPathFromBinary(path) + ".format");
+	// fs::path formatInfopath = getAppData() / "FormatInfo" / (getExtSaveDataPathFromBinary(path) + ".format");
 	// Format info not found so the archive is not formatted
 	// if (!fs::is_regular_file(formatInfopath)) {
 	//	return isShared ? Err(Result::FS::NotFormatted) : Err(Result::FS::NotFoundInvalid);
@@ -176,7 +176,7 @@ Rust::Result<DirectorySession, HorizonResult> ExtSaveDataArchive::openDirectory(
 		if (!isPathSafe<PathType::UTF16>(path))
 			Helpers::panic("Unsafe path in ExtSaveData::OpenDirectory");
 
-		fs::path p = IOFile::getAppData() / backingFolder;
+		fs::path p = getAppData() / backingFolder;
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_regular_file(p)) {
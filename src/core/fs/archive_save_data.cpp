@@ -9,7 +9,7 @@ HorizonResult SaveDataArchive::createFile(const FSPath& path, u64 size) {
 		if (!isPathSafe<PathType::UTF16>(path))
 			Helpers::panic("Unsafe path in SaveData::CreateFile");
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::exists(p)) {
@@ -44,7 +44,7 @@ HorizonResult SaveDataArchive::createDirectory(const FSPath& path) {
 			Helpers::panic("Unsafe path in SaveData::OpenFile");
 		}
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_directory(p)) {
@@ -68,7 +68,7 @@ HorizonResult SaveDataArchive::deleteFile(const FSPath& path) {
 			Helpers::panic("Unsafe path in SaveData::DeleteFile");
 		}
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_directory(p)) {
@@ -105,22 +105,20 @@ FileDescriptor SaveDataArchive::openFile(const FSPath& path, const FilePerms& pe
 			Helpers::panic("[SaveData] Unsupported flags for OpenFile");
 		}
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		const char* permString = perms.write() ? "r+b" : "rb";
 
 		if (fs::exists(p)) { // Return file descriptor if the file exists
-			IOFile file(p.string().c_str(), permString);
-			return file.isOpen() ? file.getHandle() : FileError;
+			return openHostFile(p, permString);
 		} else {
 			// If the file is not found, create it if the create flag is on
 			if (perms.create()) {
 				IOFile file(p.string().c_str(), "wb"); // Create file
 				file.close(); // Close it
 
-				file.open(p.string().c_str(), permString); // Reopen with proper perms
-				return file.isOpen() ? file.getHandle() : FileError;
+				return openHostFile(p, permString); // Reopen with proper perms
 			} else {
 				return FileError;
 			}
@@ -137,7 +135,7 @@ Rust::Result<DirectorySession, HorizonResult> SaveDataArchive::openDirectory(con
 			Helpers::panic("Unsafe path in SaveData::OpenDirectory");
 		}
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_regular_file(p)) {
@@ -178,7 +176,7 @@ Rust::Result<ArchiveBase::FormatInfo, HorizonResult> SaveDataArchive::getFormatI
 }
 
 void SaveDataArchive::format(const FSPath& path, const ArchiveBase::FormatInfo& info) {
-	const fs::path saveDataPath = IOFile::getAppData() / "SaveData";
+	const fs::path saveDataPath = getAppData() / "SaveData";
 	const fs::path formatInfoPath = getFormatInfoPath();
 
 	// Delete all contents by deleting the directory then recreating it
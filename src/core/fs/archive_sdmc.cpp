@@ -9,7 +9,7 @@ HorizonResult SDMCArchive::createFile(const FSPath& path, u64 size) {
 			Helpers::panic("Unsafe path in SDMC::CreateFile");
 		}
 
-		fs::path p = IOFile::getAppData() / "SDMC";
+		fs::path p = getAppData() / "SDMC";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::exists(p)) {
@@ -44,7 +44,7 @@ HorizonResult SDMCArchive::deleteFile(const FSPath& path) {
 			Helpers::panic("Unsafe path in SDMC::DeleteFile");
 		}
 
-		fs::path p = IOFile::getAppData() / "SDMC";
+		fs::path p = getAppData() / "SDMC";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_directory(p)) {
@@ -88,7 +88,7 @@ FileDescriptor SDMCArchive::openFile(const FSPath& path, const FilePerms& perms)
 		Helpers::panic("[SDMC] Unsupported flags for OpenFile");
 	}
 
-	std::filesystem::path p = IOFile::getAppData() / "SDMC";
+	std::filesystem::path p = getAppData() / "SDMC";
 
 	switch (path.type) {
 		case PathType::ASCII:
@@ -113,16 +113,14 @@ FileDescriptor SDMCArchive::openFile(const FSPath& path, const FilePerms& perms)
 	const char* permString = perms.write() ? "r+b" : "rb";
 
 	if (fs::exists(p)) {  // Return file descriptor if the file exists
-		IOFile file(p.string().c_str(), permString);
-		return file.isOpen() ? file.getHandle() : FileError;
+		return openHostFile(p, permString);
 	} else {
 		// If the file is not found, create it if the create flag is on
 		if (realPerms.create()) {
 			IOFile file(p.string().c_str(), "wb");  // Create file
 			file.close();                           // Close it
 
-			file.open(p.string().c_str(), permString);  // Reopen with proper perms
-			return file.isOpen() ? file.getHandle() : FileError;
+			return openHostFile(p, permString);  // Reopen with proper perms
 		} else {
 			return FileError;
 		}
@@ -130,7 +128,7 @@ FileDescriptor SDMCArchive::openFile(const FSPath& path, const FilePerms& perms)
 }
 
 HorizonResult SDMCArchive::createDirectory(const FSPath& path) {
-	std::filesystem::path p = IOFile::getAppData() / "SDMC";
+	std::filesystem::path p = getAppData() / "SDMC";
 
 	switch (path.type) {
 		case PathType::ASCII:
@@ -176,7 +174,7 @@ Rust::Result<DirectorySession, HorizonResult> SDMCArchive::openDirectory(const F
 			Helpers::panic("Unsafe path in SDMC::OpenDirectory");
 		}
 
-		fs::path p = IOFile::getAppData() / "SDMC";
+		fs::path p = getAppData() / "SDMC";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_regular_file(p)) {
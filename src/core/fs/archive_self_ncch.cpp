@@ -51,6 +51,21 @@ Rust::Result<ArchiveBase*, HorizonResult> SelfNCCHArchive::openArchive(const FSP
 }
 
 std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32 size, u32 dataPointer) {
+	std::unique_ptr<u8[]> data(new u8[size]);
+	std::optional<u32> bytesRead = readROM(file, offset, size, &data[0], false);
+
+	if (bytesRead.has_value()) {
+		mem.writeBlock(dataPointer, &data[0], bytesRead.value());
+	}
+
+	return bytesRead;
+}
+
+std::optional<u32> SelfNCCHArchive::readFileToHost(FileSession* file, u64 offset, u32 size, u8* buffer) {
+	return readROM(file, offset, size, buffer, true);
+}
+
+std::optional<u32> SelfNCCHArchive::readROM(FileSession* file, u64 offset, u32 size, u8* buffer, bool ioThread) {
 	const FSPath& path = file->path;          // Path of the file
 	const u32 type = *(u32*)&path.binary[0];  // Type of the path
 
@@ -71,10 +86,9 @@ std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32
 
 	bool success = false;
 	std::size_t bytesRead = 0;
-	std::unique_ptr<u8[]> data(new u8[size]);
 
 	if (auto cxi = mem.getCXI(); cxi != nullptr) {
-		IOFile& ioFile = mem.CXIFile;
+		IOFile& ioFile = ioThread ? mem.asyncROMFile : mem.CXIFile;
 
 		NCCH::FSInfo fsInfo;
 
@@ -122,7 +136,7 @@ std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32
 			default: Helpers::panic("Unimplemented file path type for SelfNCCH archive");
 		}
 
-		std::tie(success, bytesRead) = cxi->readFromFile(ioFile, fsInfo, &data[0], offset, size);
+		std::tie(success, bytesRead) = cxi->readFromFile(ioFile, fsInfo, buffer, offset, size);
 	}
 
 	else if (auto hb3dsx = mem.get3DSX(); hb3dsx != nullptr) {
@@ -138,16 +152,13 @@ std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32
 			default: Helpers::panic("Unimplemented file path type for 3DSX SelfNCCH archive");
 		}
 
-		std::tie(success, bytesRead) = hb3dsx->readRomFSBytes(&data[0], offset, size);
+		IOFile& ioFile = ioThread ? mem.asyncROMFile : hb3dsx->file;
+		std::tie(success, bytesRead) = hb3dsx->readRomFSBytes(ioFile, buffer, offset, size);
 	}
 
 	if (!success) {
 		Helpers::panic("Failed to read from SelfNCCH archive");
 	}
 
-	for (u64 i = 0; i < bytesRead; i++) {
-		mem.write8(u32(dataPointer + i), data[i]);
-	}
-
 	return u32(bytesRead);
 }
@@ -9,7 +9,7 @@ HorizonResult UserSaveDataArchive::createFile(const FSPath& path, u64 size) {
 	if (path.type == PathType::UTF16) {
 		if (!isPathSafe<PathType::UTF16>(path)) Helpers::panic("Unsafe path in UserSaveData::CreateFile");
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::exists(p)) return Result::FS::AlreadyExists;
@@ -40,7 +40,7 @@ HorizonResult UserSaveDataArchive::createDirectory(const FSPath& path) {
 	if (path.type == PathType::UTF16) {
 		if (!isPathSafe<PathType::UTF16>(path)) Helpers::panic("Unsafe path in UserSaveData::OpenFile");
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_directory(p)) return Result::FS::AlreadyExists;
@@ -59,7 +59,7 @@ HorizonResult UserSaveDataArchive::deleteFile(const FSPath& path) {
 	if (path.type == PathType::UTF16) {
 		if (!isPathSafe<PathType::UTF16>(path)) Helpers::panic("Unsafe path in UserSaveData::DeleteFile");
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_directory(p)) {
@@ -92,22 +92,20 @@ FileDescriptor UserSaveDataArchive::openFile(const FSPath& path, const FilePerms
 
 		if (perms.raw == 0 || (perms.create() && !perms.write())) Helpers::panic("[UserSaveData] Unsupported flags for OpenFile");
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		const char* permString = perms.write() ? "r+b" : "rb";
 
 		if (fs::exists(p)) {  // Return file descriptor if the file exists
-			IOFile file(p.string().c_str(), permString);
-			return file.isOpen() ? file.getHandle() : FileError;
+			return openHostFile(p, permString);
 		} else {
 			// If the file is not found, create it if the create flag is on
 			if (perms.create()) {
 				IOFile file(p.string().c_str(), "wb");  // Create file
 				file.close();                           // Close it
 
-				file.open(p.string().c_str(), permString);  // Reopen with proper perms
-				return file.isOpen() ? file.getHandle() : FileError;
+				return openHostFile(p, permString);  // Reopen with proper perms
 			} else {
 				return FileError;
 			}
@@ -122,7 +120,7 @@ Rust::Result<DirectorySession, HorizonResult> UserSaveDataArchive::openDirectory
 	if (path.type == PathType::UTF16) {
 		if (!isPathSafe<PathType::UTF16>(path)) Helpers::panic("Unsafe path in UserSaveData::OpenDirectory");
 
-		fs::path p = IOFile::getAppData() / "SaveData";
+		fs::path p = getAppData() / "SaveData";
 		p += fs::path(path.utf16_string).make_preferred();
 
 		if (fs::is_regular_file(p)) {
@@ -163,7 +161,7 @@ Rust::Result<ArchiveBase::FormatInfo, HorizonResult> UserSaveDataArchive::getFor
 }
 
 void UserSaveDataArchive::format(const FSPath& path, const ArchiveBase::FormatInfo& info) {
-	const fs::path saveDataPath = IOFile::getAppData() / "SaveData";
+	const fs::path saveDataPath = getAppData() / "SaveData";
 	const fs::path formatInfoPath = getFormatInfoPath();
 
 	// Delete all contents by deleting the directory then recreating it
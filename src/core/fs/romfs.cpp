@@ -1,15 +1,20 @@
 #include "fs/romfs.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
-#include <queue>
-#include <string>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "fs/ivfc.hpp"
-#include "helpers.hpp"
+#include "io_file.hpp"
 
 namespace RomFS {
-	constexpr u32 metadataInvalidEntry = 0xFFFFFFFF;
-
 	struct Level3Header {
 		u32 headerSize;
 		u32 directoryHashTableOffset;
@@ -22,6 +27,36 @@ namespace RomFS {
 		u32 fileMetadataSize;
 		u32 fileDataOffset;
 	};
+	static_assert(sizeof(Level3Header) == 0x28);
+
+	// On-disk metadata entries. Each one is followed by its UTF-16 name, padded to a multiple of 4 bytes
+	struct DirectoryMetadata {
+		u32 parent;
+		u32 nextSibling;
+		u32 firstDirectory;
+		u32 firstFile;
+		u32 nextInBucket;
+		u32 nameSize;  // In bytes
+	};
+	static_assert(sizeof(DirectoryMetadata) == 0x18);
+
+	struct FileMetadata {
+		u32 parent;
+		u32 nextSibling;
+		u64 dataOffset;  // Relative to the level 3 file data
+		u64 dataSize;
+		u32 nextInBucket;
+		u32 nameSize;  // In bytes
+	};
+	static_assert(sizeof(FileMetadata) == 0x20);
+
+	// Arbitrary limits to reject corrupt images before allocating absurd amounts of memory
+	static constexpr u32 maxNameLength = 256;
+	static constexpr u32 maxTableSize = u32(64_MB);
+
+	// Extraction streams files through a buffer of this size per thread
+	static constexpr usize extractChunkSize = 1_MB;
+	static constexpr unsigned maxExtractThreads = 8;
 
 	inline constexpr uintptr_t alignUp(uintptr_t value, uintptr_t alignment) {
 		if (value % alignment == 0) return value;
@@ -29,166 +64,457 @@ namespace RomFS {
 		return value + (alignment - (value % alignment));
 	}
 
-	void printNode(const RomFSNode& node, int indentation) {
-		for (int i = 0; i < indentation; i++) {
-			printf("  ");
+	u32 Index::hashName(u32 parentMetadataOffset, std::u16string_view name) {
+		u32 hash = parentMetadataOffset ^ 123456789;
+		for (char16_t c : name) {
+			hash = (hash >> 5) | (hash << 27);
+			hash ^= u16(c);
 		}
-		printf("%s/\n", std::string(node.name.begin(), node.name.end()).c_str());
 
-		for (auto& file : node.files) {
-			for (int i = 0; i <= indentation; i++) {
-				printf("  ");
+		return hash;
+	}
+
+	void Index::clear() {
+		directories.clear();
+		files.clear();
+		names.clear();
+		directoryBuckets.clear();
+		fileBuckets.clear();
+	}
+
+	// Walks a metadata table and returns the offset of every entry in it, in ascending order. Metadata links are stored as offsets into
+	// their table, so this is what they get translated into indices with. Returns false if an entry is cut off or has a bogus name
+	template <typename Metadata>
+	static bool getEntryOffsets(const std::vector<u8>& table, std::vector<u32>& offsets) {
+		usize offset = 0;
+
+		while (offset < table.size()) {
+			if (offset + sizeof(Metadata) > table.size()) {
+				return false;
+			}
+
+			Metadata metadata;
+			std::memcpy(&metadata, &table[offset], sizeof(Metadata));
+
+			const usize entrySize = sizeof(Metadata) + alignUp(metadata.nameSize, 4);
+			if (metadata.nameSize / 2 > maxNameLength || offset + entrySize > table.size()) {
+				printf("Invalid RomFS name length: %08X\n", metadata.nameSize);
+				return false;
 			}
-			printf("%s\n", std::string(file->name.begin(), file->name.end()).c_str());
-		}
 
-		indentation++;
-		for (auto& directory : node.directories) {
-			printNode(*directory, indentation);
+			offsets.push_back(u32(offset));
+			offset += entrySize;
 		}
-		indentation--;
+
+		return true;
 	}
 
-	std::vector<std::unique_ptr<RomFSNode>> getFiles(uintptr_t fileMetadataBase, u32 currentFileOffset) {
-		std::vector<std::unique_ptr<RomFSNode>> files;
+	bool Index::build(const ReadCallback& read, u64 romFSSize) {
+		clear();
+
+		// parseIVFC works on memory, so fetch the header first. RomFS IVFC headers are always 0x5C bytes
+		std::array<u8, 0x60> ivfcHeader;
+		if (romFSSize < ivfcHeader.size() || !read(0, ivfcHeader.data(), ivfcHeader.size())) {
+			return false;
+		}
+
+		// Homebrew (3DSX) RomFS images are a bare level 3 image without the IVFC hash levels in front of it
+		u64 level3Offset = 0;
+
+		if (std::memcmp(ivfcHeader.data(), "IVFC", 4) == 0) {
+			IVFC::IVFC ivfc;
+			const size_t ivfcSize = IVFC::parseIVFC((uintptr_t)ivfcHeader.data(), ivfc);
+			if (ivfcSize == 0) {
+				printf("Failed to parse IVFC\n");
+				return false;
+			}
+
+			const u64 masterHashOffset = alignUp(ivfcSize, 0x10);
+			// From GBATEK:
+			// The "Logical Offsets" are completely unrelated to the physical offsets in the RomFS partition.
+			// Instead, the "Logical Offsets" might be something about where to map the Level 1-3 sections in
+			// virtual memory (with the physical Level 3,1,2 ordering being re-ordered to Level 1,2,3)?
+			level3Offset = alignUp(masterHashOffset + ivfc.masterHashSize, ivfc.levels[2].blockSize);
+		}
+
+		Level3Header header;
+		if (level3Offset + sizeof(header) > romFSSize || !read(level3Offset, &header, sizeof(header))) {
+			return false;
+		}
+
+		if (header.headerSize != 0x28) {
+			printf("Invalid level 3 header size: %08X\n", header.headerSize);
+			return false;
+		}
+
+		bool success = true;
+		auto readTable = [&](u32 offset, u32 size) {
+			std::vector<u8> table;
+			if (size > maxTableSize || level3Offset + offset + size > romFSSize) {
+				success = false;
+			} else {
+				table.resize(size);
+				success = success && read(level3Offset + offset, table.data(), size);
+			}
+
+			return table;
+		};
+
+		const std::vector<u8> directoryHashTable = readTable(header.directoryHashTableOffset, header.directoryHashTableSize);
+		const std::vector<u8> directoryMetadata = readTable(header.directoryMetadataOffset, header.directoryMetadataSize);
+		const std::vector<u8> fileHashTable = readTable(header.fileHashTableOffset, header.fileHashTableSize);
+		const std::vector<u8> fileMetadata = readTable(header.fileMetadataOffset, header.fileMetadataSize);
+
+		std::vector<u32> directoryOffsets, fileOffsets;
+		if (!success || !getEntryOffsets<DirectoryMetadata>(directoryMetadata, directoryOffsets) ||
+			!getEntryOffsets<FileMetadata>(fileMetadata, fileOffsets)) {
+			printf("Invalid RomFS metadata\n");
+			return false;
+		}
+
+		// The root directory is always the first entry
+		if (directoryOffsets.empty()) {
+			printf("RomFS has no root directory\n");
+			return false;
+		}
+
+		// Turns a metadata offset into an index into the directory or file array. Links pointing in the middle of an entry fail the build
+		auto toIndex = [&success](const std::vector<u32>& offsets, u32 offset) -> u32 {
+			if (offset == invalidEntry) {
+				return invalidEntry;
+			}
+
+			auto it = std::lower_bound(offsets.begin(), offsets.end(), offset);
+			if (it == offsets.end() || *it != offset) {
+				success = false;
+				return invalidEntry;
+			}
+
+			return u32(it - offsets.begin());
+		};
 
-		while (currentFileOffset != metadataInvalidEntry) {
-			u32* metadataPtr = (u32*)(fileMetadataBase + currentFileOffset);
-			metadataPtr++;  // Skip the containing directory
-			u32 nextFileOffset = *metadataPtr++;
-			u64 fileDataOffset = *(u64*)metadataPtr;
-			metadataPtr += 2;
-			u64 fileSize = *(u64*)metadataPtr;
-			metadataPtr += 2;
-			metadataPtr++;  // Skip the offset of the next file in the same hash table bucket
-			u32 nameLength = *metadataPtr++ / 2;
+		// Intern names, so that the many files sharing a name across directories (eg every "info.bin") are only stored once.
+		// The pool is reserved up front so that the views used as keys stay valid
+		std::unordered_map<std::u16string_view, u32> internedNames;
+		names.reserve((directoryMetadata.size() + fileMetadata.size()) / sizeof(char16_t));
 
-			// Arbitrary limit
-			if (nameLength > 128) {
-				printf("Invalid file name length: %08X\n", nameLength);
-				return {};
+		auto internName = [&](const std::vector<u8>& table, usize offset, u32 nameSize) {
+			std::u16string name(nameSize / sizeof(char16_t), u'\0');
+			std::memcpy(name.data(), &table[offset], name.size() * sizeof(char16_t));
+
+			auto it = internedNames.find(name);
+			if (it != internedNames.end()) {
+				return it->second;
+			}
+
+			const u32 nameOffset = u32(names.size());
+			names += name;
+			internedNames.emplace(std::u16string_view(names).substr(nameOffset, name.size()), nameOffset);
+			return nameOffset;
+		};
+
+		directories.reserve(directoryOffsets.size());
+		for (u32 offset : directoryOffsets) {
+			DirectoryMetadata metadata;
+			std::memcpy(&metadata, &directoryMetadata[offset], sizeof(metadata));
+
+			directories.push_back(DirectoryEntry{
+				.parent = toIndex(directoryOffsets, metadata.parent),
+				.nextSibling = toIndex(directoryOffsets, metadata.nextSibling),
+				.firstDirectory = toIndex(directoryOffsets, metadata.firstDirectory),
+				.firstFile = toIndex(fileOffsets, metadata.firstFile),
+				.nextInBucket = toIndex(directoryOffsets, metadata.nextInBucket),
+				.metadataOffset = offset,
+				.nameOffset = internName(directoryMetadata, offset + sizeof(metadata), metadata.nameSize),
+				.nameLength = metadata.nameSize / u32(sizeof(char16_t)),
+			});
+		}
+
+		const u64 fileDataBase = level3Offset + header.fileDataOffset;
+		files.reserve(fileOffsets.size());
+
+		for (u32 offset : fileOffsets) {
+			FileMetadata metadata;
+			std::memcpy(&metadata, &fileMetadata[offset], sizeof(metadata));
+
+			const u64 dataOffset = fileDataBase + metadata.dataOffset;
+			if (dataOffset < fileDataBase || dataOffset > romFSSize || metadata.dataSize > romFSSize - dataOffset) {
+				printf("RomFS file data out of bounds\n");
+				success = false;
 			}
 
-			char16_t* namePtr = (char16_t*)metadataPtr;
-			std::u16string name(namePtr, nameLength);
+			files.push_back(FileEntry{
+				.dataOffset = dataOffset,
+				.dataSize = metadata.dataSize,
+				.parent = toIndex(directoryOffsets, metadata.parent),
+				.nextSibling = toIndex(fileOffsets, metadata.nextSibling),
+				.nextInBucket = toIndex(fileOffsets, metadata.nextInBucket),
+				.nameOffset = internName(fileMetadata, offset + sizeof(metadata), metadata.nameSize),
+				.nameLength = metadata.nameSize / u32(sizeof(char16_t)),
+			});
+		}
 
-			std::unique_ptr file = std::make_unique<RomFSNode>();
-			file->isDirectory = false;
-			file->name = name;
-			file->metadataOffset = currentFileOffset;
-			file->dataOffset = fileDataOffset;
-			file->dataSize = fileSize;
+		// The hash tables are arrays of metadata offsets heading each bucket's chain
+		auto loadBuckets = [&](const std::vector<u8>& table, const std::vector<u32>& offsets, std::vector<u32>& buckets) {
+			buckets.resize(table.size() / sizeof(u32));
+			for (usize i = 0; i < buckets.size(); i++) {
+				u32 offset;
+				std::memcpy(&offset, &table[i * sizeof(u32)], sizeof(u32));
+				buckets[i] = toIndex(offsets, offset);
+			}
+		};
 
-			files.push_back(std::move(file));
+		loadBuckets(directoryHashTable, directoryOffsets, directoryBuckets);
+		loadBuckets(fileHashTable, fileOffsets, fileBuckets);
 
-			currentFileOffset = nextFileOffset;
+		if (!success || directories[rootDirectory].parent != rootDirectory || !isTree()) {
+			printf("Invalid RomFS metadata links\n");
+			clear();
+			return false;
 		}
 
-		return files;
+		return true;
 	}
 
-	std::unique_ptr<RomFSNode> parseRootDirectory(uintptr_t directoryMetadataBase, uintptr_t fileMetadataBase) {
-		std::unique_ptr<RomFSNode> rootDirectory = std::make_unique<RomFSNode>();
-		rootDirectory->isDirectory = true;
-		rootDirectory->name = u"romfs:";
-		rootDirectory->metadataOffset = 0;
-
-		u32 rootFilesOffset = *((u32*)(directoryMetadataBase) + 3);
-		if (rootFilesOffset != metadataInvalidEntry) {
-			rootDirectory->files = getFiles(fileMetadataBase, rootFilesOffset);
-		}
-
-		std::queue<RomFSNode*> directoryOffsets;
-		directoryOffsets.push(rootDirectory.get());
-
-		while (!directoryOffsets.empty()) {
-			RomFSNode* currentNode = directoryOffsets.front();
-			directoryOffsets.pop();
-
-			u32* metadataPtr = (u32*)(directoryMetadataBase + currentNode->metadataOffset);
-			metadataPtr += 2;
-
-			// Offset of first child directory
-			u32 currentDirectoryOffset = *metadataPtr;
-
-			// Loop over all the sibling directories of the first child to get all the children directories
-			// of the current directory
-			while (currentDirectoryOffset != metadataInvalidEntry) {
-				metadataPtr = (u32*)(directoryMetadataBase + currentDirectoryOffset);
-				metadataPtr++;  // Skip the parent offset
-				u32 siblingDirectoryOffset = *metadataPtr++;
-				metadataPtr++;  // Skip offset of first child directory
-				u32 currentFileOffset = *metadataPtr++;
-				metadataPtr++;  // Skip offset of next directory in the same hash table bucket
-				u32 nameLength = *metadataPtr++ / 2;
-
-				// Arbitrary limit
-				if (nameLength > 128) {
-					printf("Invalid directory name length: %08X\n", nameLength);
-					return {};
+	// Checks that following the child and sibling links from the root never reaches an entry twice, so that users of the index can walk
+	// it without guarding against loops in corrupt images
+	bool Index::isTree() const {
+		std::vector<bool> seenDirectories(directories.size(), false);
+		std::vector<bool> seenFiles(files.size(), false);
+		std::vector<u32> stack = {rootDirectory};
+		seenDirectories[rootDirectory] = true;
+
+		while (!stack.empty()) {
+			const DirectoryEntry& directory = directories[stack.back()];
+			stack.pop_back();
+
+			for (u32 i = directory.firstFile; i != invalidEntry; i = files[i].nextSibling) {
+				if (seenFiles[i]) {
+					return false;
 				}
+				seenFiles[i] = true;
+			}
 
-				char16_t* namePtr = (char16_t*)metadataPtr;
-				std::u16string name(namePtr, nameLength);
+			for (u32 i = directory.firstDirectory; i != invalidEntry; i = directories[i].nextSibling) {
+				if (seenDirectories[i]) {
+					return false;
+				}
+				seenDirectories[i] = true;
+				stack.push_back(i);
+			}
+		}
 
-				std::unique_ptr directory = std::make_unique<RomFSNode>();
-				directory->isDirectory = true;
-				directory->name = name;
-				directory->metadataOffset = currentDirectoryOffset;
-				directory->files = getFiles(fileMetadataBase, currentFileOffset);
+		return true;
+	}
 
-				currentNode->directories.push_back(std::move(directory));
-				currentDirectoryOffset = siblingDirectoryOffset;
+	std::optional<u32> Index::findDirectory(u32 parent, std::u16string_view name) const {
+		if (parent >= directories.size()) {
+			return std::nullopt;
+		}
+
+		// Images without a hash table can still be searched by walking the parent's children
+		if (directoryBuckets.empty()) {
+			for (u32 i = directories[parent].firstDirectory; i != invalidEntry; i = directories[i].nextSibling) {
+				if (getName(directories[i]) == name) {
+					return i;
+				}
 			}
 
-			for (auto& directory : currentNode->directories) {
-				directoryOffsets.push(directory.get());
+			return std::nullopt;
+		}
+
+		const u32 hash = hashName(directories[parent].metadataOffset, name);
+		for (u32 i = directoryBuckets[hash % directoryBuckets.size()]; i != invalidEntry; i = directories[i].nextInBucket) {
+			if (directories[i].parent == parent && getName(directories[i]) == name) {
+				return i;
 			}
 		}
 
-		return rootDirectory;
+		return std::nullopt;
 	}
 
-	std::unique_ptr<RomFSNode> parseRomFSTree(uintptr_t romFS, u64 romFSSize) {
-		IVFC::IVFC ivfc;
-		size_t ivfcSize = IVFC::parseIVFC((uintptr_t)romFS, ivfc);
+	std::optional<u32> Index::findFile(u32 parent, std::u16string_view name) const {
+		if (parent >= directories.size()) {
+			return std::nullopt;
+		}
+
+		if (fileBuckets.empty()) {
+			for (u32 i = directories[parent].firstFile; i != invalidEntry; i = files[i].nextSibling) {
+				if (getName(files[i]) == name) {
+					return i;
+				}
+			}
 
-		if (ivfcSize == 0) {
-			printf("Failed to parse IVFC\n");
-			return {};
+			return std::nullopt;
 		}
 
-		uintptr_t masterHashOffset = RomFS::alignUp(ivfcSize, 0x10);
-		// From GBATEK:
-		// The "Logical Offsets" are completely unrelated to the physical offsets in the RomFS partition.
-		// Instead, the "Logical Offsets" might be something about where to map the Level 1-3 sections in
-		// virtual memory (with the physical Level 3,1,2 ordering being re-ordered to Level 1,2,3)?
-		uintptr_t level3Offset = RomFS::alignUp(masterHashOffset + ivfc.masterHashSize, ivfc.levels[2].blockSize);
-		uintptr_t level3Base = (uintptr_t)romFS + level3Offset;
-		u32* level3Ptr = (u32*)level3Base;
+		const u32 hash = hashName(directories[parent].metadataOffset, name);
+		for (u32 i = fileBuckets[hash % fileBuckets.size()]; i != invalidEntry; i = files[i].nextInBucket) {
+			if (files[i].parent == parent && getName(files[i]) == name) {
+				return i;
+			}
+		}
 
-		Level3Header header;
-		header.headerSize = *level3Ptr++;
-		header.directoryHashTableOffset = *level3Ptr++;
-		header.directoryHashTableSize = *level3Ptr++;
-		header.directoryMetadataOffset = *level3Ptr++;
-		header.directoryMetadataSize = *level3Ptr++;
-		header.fileHashTableOffset = *level3Ptr++;
-		header.fileHashTableSize = *level3Ptr++;
-		header.fileMetadataOffset = *level3Ptr++;
-		header.fileMetadataSize = *level3Ptr++;
-		header.fileDataOffset = *level3Ptr;
+		return std::nullopt;
+	}
 
-		if (header.headerSize != 0x28) {
-			printf("Invalid level 3 header size: %08X\n", header.headerSize);
-			return {};
+	std::optional<u32> Index::findDirectory(std::u16string_view path) const {
+		if (!isValid()) {
+			return std::nullopt;
+		}
+
+		u32 directory = rootDirectory;
+		while (!path.empty()) {
+			const usize separator = path.find(u'/');
+			const std::u16string_view component = path.substr(0, separator);
+			path = (separator == std::u16string_view::npos) ? std::u16string_view() : path.substr(separator + 1);
+
+			if (component.empty()) {
+				continue;
+			}
+
+			auto child = findDirectory(directory, component);
+			if (!child.has_value()) {
+				return std::nullopt;
+			}
+			directory = child.value();
 		}
 
-		std::unique_ptr<RomFSNode> root = parseRootDirectory(level3Base + header.directoryMetadataOffset, level3Base + header.fileMetadataOffset);
+		return directory;
+	}
+
+	std::optional<u32> Index::findFile(std::u16string_view path) const {
+		const usize separator = path.rfind(u'/');
+		const std::u16string_view directoryPath = (separator == std::u16string_view::npos) ? std::u16string_view() : path.substr(0, separator);
+		const std::u16string_view name = (separator == std::u16string_view::npos) ? path : path.substr(separator + 1);
+
+		auto directory = findDirectory(directoryPath);
+		if (!directory.has_value()) {
+			return std::nullopt;
+		}
 
-		// If you want to print the tree, uncomment this
-		// printNode(*root, 0);
+		return findFile(directory.value(), name);
+	}
+
+	bool extract(const Index& index, const ReaderFactory& openReader, const std::filesystem::path& outputPath, const ProgressCallback& progress) {
+		if (!index.isValid()) {
+			return false;
+		}
+
+		struct FileJob {
+			u32 file;
+			u32 directory;
+		};
+
+		// Create the whole directory tree up front on this thread, so the workers only deal with files
+		std::vector<std::filesystem::path> directoryPaths(index.getDirectories().size());
+		std::vector<FileJob> jobs;
+		std::vector<u32> stack = {Index::rootDirectory};
+		directoryPaths[Index::rootDirectory] = outputPath;
+		u64 totalBytes = 0;
+		std::atomic<bool> failed = false;
+
+		while (!stack.empty()) {
+			const u32 directoryIndex = stack.back();
+			const DirectoryEntry& directory = index.getDirectory(directoryIndex);
+			stack.pop_back();
+
+			std::error_code ec;
+			std::filesystem::create_directories(directoryPaths[directoryIndex], ec);
+			if (ec) {
+				printf("Failed to create RomFS directory %s\n", directoryPaths[directoryIndex].string().c_str());
+				failed = true;
+				continue;
+			}
+
+			for (u32 i = directory.firstFile; i != invalidEntry; i = index.getFile(i).nextSibling) {
+				jobs.push_back(FileJob{.file = i, .directory = directoryIndex});
+				totalBytes += index.getFile(i).dataSize;
+			}
+
+			for (u32 i = directory.firstDirectory; i != invalidEntry; i = index.getDirectory(i).nextSibling) {
+				directoryPaths[i] = directoryPaths[directoryIndex] / index.getName(index.getDirectory(i));
+				stack.push_back(i);
+			}
+		}
+
+		// Extract in on-disk order, so the reads sweep through the image front to back
+		std::sort(jobs.begin(), jobs.end(), [&index](const FileJob& a, const FileJob& b) {
+			return index.getFile(a.file).dataOffset < index.getFile(b.file).dataOffset;
+		});
+
+		std::atomic<usize> nextJob = 0;
+		std::atomic<u64> bytesDone = 0;
+		std::mutex mutex;
+		std::condition_variable workerDone;
+		const unsigned threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, maxExtractThreads);
+		unsigned workersRunning = threadCount;
+
+		auto extractFile = [&](const ReadCallback& read, const FileJob& job, std::vector<u8>& buffer) {
+			const FileEntry& file = index.getFile(job.file);
+			const auto path = directoryPaths[job.directory] / index.getName(file);
+
+			IOFile out(path, "wb");
+			if (!out.isOpen()) {
+				printf("Failed to create RomFS file %s\n", path.string().c_str());
+				return false;
+			}
+
+			bool success = true;
+			for (u64 offset = 0; offset < file.dataSize && success; offset += extractChunkSize) {
+				const u64 size = std::min<u64>(extractChunkSize, file.dataSize - offset);
+				success = read(file.dataOffset + offset, buffer.data(), size) && out.writeBytes(buffer.data(), size).second == size;
+				bytesDone += size;
+			}
+
+			out.close();
+			return success;
+		};
+
+		auto worker = [&]() {
+			const ReadCallback read = openReader();
+			std::vector<u8> buffer(extractChunkSize);
+
+			// Without a reader this thread can't help, the other threads pick up its share of files
+			if (read) {
+				for (usize i = nextJob++; i < jobs.size(); i = nextJob++) {
+					if (!extractFile(read, jobs[i], buffer)) {
+						failed = true;
+					}
+				}
+			}
+
+			std::scoped_lock lock(mutex);
+			workersRunning--;
+			workerDone.notify_one();
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < threadCount; i++) {
+			threads.emplace_back(worker);
+		}
+
+		// Report progress from the calling thread while the workers run
+		{
+			std::unique_lock lock(mutex);
+			while (!workerDone.wait_for(lock, std::chrono::milliseconds(100), [&]() { return workersRunning == 0; })) {
+				if (progress) {
+					lock.unlock();
+					progress(bytesDone, totalBytes);
+					lock.lock();
+				}
+			}
+		}
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		if (progress) {
+			progress(bytesDone, totalBytes);
+		}
 
-		return root;
+		// Files are only left over if every thread failed to open a reader
+		return !failed && nextJob >= jobs.size();
 	}
-}  // namespace RomFS
\ No newline at end of file
+}  // namespace RomFS
@@ -0,0 +1,424 @@
+#include "fs/write_back_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+	struct JournalHeader {
+		u8 magic[4];
+		u32 pageCount;
+		u64 validSize;
+		u64 finalSize;
+	};
+	static_assert(sizeof(JournalHeader) == 24, "Save data journal header must be 24 bytes");
+
+	constexpr u8 journalMagic[4] = {'S', 'J', 'N', 'L'};
+
+	std::filesystem::path getJournalPath(const std::filesystem::path& path) {
+		std::filesystem::path ret = path;
+		ret += ".journal";
+		return ret;
+	}
+
+	std::filesystem::path getPartialJournalPath(const std::filesystem::path& path) {
+		std::filesystem::path ret = path;
+		ret += ".journal.tmp";
+		return ret;
+	}
+}  // namespace
+
+WriteBackCache::~WriteBackCache() { reset(); }
+
+WriteBackCache::CachedFile* WriteBackCache::getFile(FILE* fd) {
+	auto it = handles.find(fd);
+	return (it == handles.end()) ? nullptr : it->second;
+}
+
+void WriteBackCache::backUp(CachedFile& file) {
+	if (!speculating || backups.contains(&file)) {
+		return;
+	}
+
+	FileBackup& backup = backups[&file];
+	backup.size = file.size;
+	backup.validSize = file.validSize;
+	for (const auto& [index, page] : file.dirtyPages) {
+		backup.dirtyPages[index] = std::make_unique<Page>(*page);
+	}
+}
+
+void WriteBackCache::track(FILE* fd, const std::filesystem::path& path) {
+	std::scoped_lock lock(mutex);
+	const auto key = path.lexically_normal();
+
+	auto it = files.find(key);
+	if (it == files.end()) {
+		recoverJournal(key);
+
+		auto file = std::make_unique<CachedFile>();
+		file->path = key;
+		// Read-only files (eg opened through a read-only session) are still tracked, so they see data written by other sessions
+		if (!file->file.open(key, "r+b") && !file->file.open(key, "rb")) {
+			Helpers::warn("WriteBackCache: Failed to open %s", key.string().c_str());
+			return;
+		}
+
+		const u64 size = file->file.size().value_or(0);
+		file->size = file->hostSize = file->validSize = size;
+		it = files.emplace(key, std::move(file)).first;
+	}
+
+	it->second->sessions++;
+	handles[fd] = it->second.get();
+}
+
+void WriteBackCache::untrack(FILE* fd) {
+	std::scoped_lock lock(mutex);
+	auto it = handles.find(fd);
+
+	if (it != handles.end()) {
+		it->second->sessions--;
+		handles.erase(it);
+	}
+}
+
+bool WriteBackCache::isTracked(FILE* fd) {
+	std::scoped_lock lock(mutex);
+	return handles.contains(fd);
+}
+
+// Reads bytes that aren't in a dirty page from the host file. Anything past the valid part of the host file reads as zero
+bool WriteBackCache::readClean(CachedFile& file, u64 offset, u8* dst, u64 size) {
+	u64 fromHost = 0;
+	if (offset < file.validSize) {
+		fromHost = std::min(size, file.validSize - offset);
+
+		if (!file.file.seek(s64(offset))) {
+			return false;
+		}
+
+		auto [success, bytesRead] = file.file.readBytes(dst, fromHost);
+		if (!success) {
+			return false;
+		}
+		fromHost = bytesRead;
+	}
+
+	std::memset(dst + fromHost, 0, size - fromHost);
+	return true;
+}
+
+std::optional<u32> WriteBackCache::read(FILE* fd, u64 offset, u8* dst, u32 size) {
+	std::scoped_lock lock(mutex);
+	CachedFile* file = getFile(fd);
+	if (file == nullptr) {
+		return std::nullopt;
+	}
+
+	if (offset >= file->size) {
+		return 0;
+	}
+
+	const u64 end = offset + std::min<u64>(size, file->size - offset);
+	u64 pos = offset;
+
+	while (pos < end) {
+		const u64 index = pos / pageSize;
+		auto it = file->dirtyPages.lower_bound(index);
+		u64 chunk;
+
+		if (it != file->dirtyPages.end() && it->first == index) {
+			const u64 pageOffset = pos % pageSize;
+			chunk = std::min(pageSize - pageOffset, end - pos);
+			std::memcpy(dst + (pos - offset), it->second->data() + pageOffset, chunk);
+		} else {
+			// Read the whole run of clean pages up to the next dirty one in one go
+			u64 runEnd = end;
+			if (it != file->dirtyPages.end()) {
+				runEnd = std::min(runEnd, it->first * pageSize);
+			}
+
+			chunk = runEnd - pos;
+			if (!readClean(*file, pos, dst + (pos - offset), chunk)) {
+				return std::nullopt;
+			}
+		}
+
+		pos += chunk;
+	}
+
+	return u32(end - offset);
+}
+
+std::optional<u32> WriteBackCache::write(FILE* fd, u64 offset, const u8* src, u32 size) {
+	std::scoped_lock lock(mutex);
+	CachedFile* file = getFile(fd);
+	if (file == nullptr) {
+		return std::nullopt;
+	}
+
+	backUp(*file);
+	const u64 end = offset + size;
+	u64 pos = offset;
+
+	while (pos < end) {
+		const u64 index = pos / pageSize;
+		const u64 pageOffset = pos % pageSize;
+		const u64 chunk = std::min(pageSize - pageOffset, end - pos);
+
+		auto& page = file->dirtyPages[index];
+		if (!page) {
+			page = std::make_unique<Page>();
+
+			// Partial writes to a page need the rest of it from the host file
+			if (chunk != pageSize && !readClean(*file, index * pageSize, page->data(), pageSize)) {
+				file->dirtyPages.erase(index);
+				return std::nullopt;
+			}
+		}
+
+		std::memcpy(page->data() + pageOffset, src + (pos - offset), chunk);
+		pos += chunk;
+	}
+
+	file->size = std::max(file->size, end);
+	return size;
+}
+
+std::optional<u64> WriteBackCache::size(FILE* fd) {
+	std::scoped_lock lock(mutex);
+	CachedFile* file = getFile(fd);
+	return (file == nullptr) ? std::nullopt : std::optional<u64>(file->size);
+}
+
+bool WriteBackCache::setSize(FILE* fd, u64 size) {
+	std::scoped_lock lock(mutex);
+	CachedFile* file = getFile(fd);
+	if (file == nullptr) {
+		return false;
+	}
+
+	backUp(*file);
+	if (size < file->size) {
+		// Drop the pages past the new end and zero the tail of the last page, so that growing the file again reads back zeroes
+		const u64 firstDroppedPage = (size + pageSize - 1) / pageSize;
+		file->dirtyPages.erase(file->dirtyPages.lower_bound(firstDroppedPage), file->dirtyPages.end());
+
+		auto it = file->dirtyPages.find(size / pageSize);
+		if (it != file->dirtyPages.end()) {
+			const u64 pageOffset = size % pageSize;
+			std::memset(it->second->data() + pageOffset, 0, pageSize - pageOffset);
+		}
+
+		file->validSize = std::min(file->validSize, size);
+	}
+
+	file->size = size;
+	return true;
+}
+
+bool WriteBackCache::applyPages(IOFile& file, u64 validSize, u64 finalSize, const PageMap& pages) {
+	// Data past validSize was cut off by the guest and must not reappear if the file grows again
+	if (file.size().value_or(0) > validSize && !file.setSize(validSize)) {
+		return false;
+	}
+
+	for (const auto& [index, page] : pages) {
+		const u64 offset = index * pageSize;
+		if (offset >= finalSize) {
+			break;
+		}
+
+		const u64 size = std::min(pageSize, finalSize - offset);
+		if (!file.seek(s64(offset))) {
+			return false;
+		}
+
+		auto [success, bytesWritten] = file.writeBytes(page->data(), size);
+		if (!success || bytesWritten != size) {
+			return false;
+		}
+	}
+
+	// Flush before resizing, so buffered writes can't extend the file past its new size afterwards
+	if (!file.flush() || !file.setSize(finalSize)) {
+		return false;
+	}
+
+	return file.sync();
+}
+
+bool WriteBackCache::commit(CachedFile& file) {
+	if (!file.isDirty()) {
+		return true;
+	}
+
+	const auto journalPath = getJournalPath(file.path);
+	const auto partialJournalPath = getPartialJournalPath(file.path);
+
+	// Write the journal under a temporary name, then rename it once it's fully on disk
+	{
+		IOFile journal(partialJournalPath, "wb");
+		if (!journal.isOpen()) {
+			Helpers::warn("WriteBackCache: Failed to create journal for %s", file.path.string().c_str());
+			return false;
+		}
+
+		JournalHeader header;
+		std::memcpy(header.magic, journalMagic, sizeof(journalMagic));
+		header.pageCount = u32(file.dirtyPages.size());
+		header.validSize = file.validSize;
+		header.finalSize = file.size;
+
+		bool success = journal.writeBytes(&header, sizeof(header)).first;
+		for (const auto& [index, page] : file.dirtyPages) {
+			success = success && journal.writeBytes(&index, sizeof(index)).first;
+			success = success && journal.writeBytes(page->data(), pageSize).first;
+		}
+
+		success = success && journal.sync();
+		journal.close();
+
+		if (!success) {
+			Helpers::warn("WriteBackCache: Failed to write journal for %s", file.path.string().c_str());
+			std::error_code ec;
+			std::filesystem::remove(partialJournalPath, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(partialJournalPath, journalPath, ec);
+	if (ec) {
+		Helpers::warn("WriteBackCache: Failed to commit journal for %s", file.path.string().c_str());
+		std::filesystem::remove(partialJournalPath, ec);
+		return false;
+	}
+
+	// The data is safe from here on. If applying it fails, the journal stays around and gets replayed the next time the file is opened
+	if (!applyPages(file.file, file.validSize, file.size, file.dirtyPages)) {
+		Helpers::warn("WriteBackCache: Failed to write %s", file.path.string().c_str());
+		return false;
+	}
+
+	std::filesystem::remove(journalPath, ec);
+	file.dirtyPages.clear();
+	file.hostSize = file.validSize = file.size;
+	return true;
+}
+
+void WriteBackCache::recoverJournal(const std::filesystem::path& path) {
+	const auto journalPath = getJournalPath(path);
+	const auto partialJournalPath = getPartialJournalPath(path);
+	std::error_code ec;
+
+	// A partial journal belongs to a commit that never happened, so the file itself still holds the previous consistent state
+	if (std::filesystem::exists(partialJournalPath, ec)) {
+		std::filesystem::remove(partialJournalPath, ec);
+	}
+
+	if (!std::filesystem::exists(journalPath, ec)) {
+		return;
+	}
+
+	IOFile journal(journalPath, "rb");
+	JournalHeader header;
+	if (!journal.isOpen() || journal.readBytes(&header, sizeof(header)).second != sizeof(header) ||
+		std::memcmp(header.magic, journalMagic, sizeof(journalMagic)) != 0) {
+		Helpers::warn("WriteBackCache: Corrupt journal for %s", path.string().c_str());
+		return;
+	}
+
+	PageMap pages;
+	for (u32 i = 0; i < header.pageCount; i++) {
+		u64 index;
+		auto page = std::make_unique<Page>();
+
+		if (journal.readBytes(&index, sizeof(index)).second != sizeof(index) || journal.readBytes(page->data(), pageSize).second != pageSize) {
+			Helpers::warn("WriteBackCache: Corrupt journal for %s", path.string().c_str());
+			return;
+		}
+
+		pages[index] = std::move(page);
+	}
+	journal.close();
+
+	IOFile file(path, "r+b");
+	if (!file.isOpen() || !applyPages(file, header.validSize, header.finalSize, pages)) {
+		Helpers::warn("WriteBackCache: Failed to replay journal for %s", path.string().c_str());
+		return;
+	}
+
+	file.close();
+	std::filesystem::remove(journalPath, ec);
+	printf("WriteBackCache: Recovered unsaved data for %s\n", path.string().c_str());
+}
+
+bool WriteBackCache::flushLocked() {
+	// Speculative writes must not reach the host. Files aren't closed either, as the backups point to them
+	if (speculating) {
+		return true;
+	}
+
+	bool success = true;
+
+	for (auto it = files.begin(); it != files.end();) {
+		CachedFile& file = *it->second;
+		success = commit(file) && success;
+
+		// Files no session uses anymore are closed once they're clean, so their host handles don't keep them locked
+		if (file.sessions == 0 && !file.isDirty()) {
+			file.file.close();
+			it = files.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	return success;
+}
+
+bool WriteBackCache::flush() {
+	std::scoped_lock lock(mutex);
+	return flushLocked();
+}
+
+bool WriteBackCache::hasDirtyData() {
+	std::scoped_lock lock(mutex);
+	return std::any_of(files.begin(), files.end(), [](const auto& entry) { return entry.second->isDirty(); });
+}
+
+void WriteBackCache::reset() {
+	std::scoped_lock lock(mutex);
+	rollBack();
+	flushLocked();
+
+	for (auto& [path, file] : files) {
+		file->file.close();
+	}
+
+	files.clear();
+	handles.clear();
+}
+
+void WriteBackCache::beginSpeculation() {
+	std::scoped_lock lock(mutex);
+	speculating = true;
+}
+
+void WriteBackCache::endSpeculation() {
+	std::scoped_lock lock(mutex);
+	rollBack();
+}
+
+void WriteBackCache::rollBack() {
+	for (auto& [file, backup] : backups) {
+		file->size = backup.size;
+		file->validSize = backup.validSize;
+		file->dirtyPages = std::move(backup.dirtyPages);
+	}
+
+	backups.clear();
+	speculating = false;
+}
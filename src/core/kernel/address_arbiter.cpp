@@ -19,7 +19,7 @@ Handle Kernel::makeArbiter() {
 	arbiterCount++;
 
 	Handle ret = makeObject(KernelObjectType::AddressArbiter);
-	objects[ret].data = new AddressArbiter();
+	allocateObjectData<AddressArbiter>(ret);
 	return ret;
 }
 
@@ -27,7 +27,7 @@ Handle Kernel::makeArbiter() {
 void Kernel::createAddressArbiter() {
 	logSVC("CreateAddressArbiter\n");
 	regs[0] = Result::Success;
-	regs[1] = makeArbiter();
+	regs[1] = giveToGuest(makeArbiter());
 }
 
 // Result ArbitrateAddress(Handle arbiter, u32 addr, ArbitrationType type, s32 value, s64 nanoseconds)
@@ -90,20 +90,22 @@ void Kernel::arbitrateAddress() {
 	requireReschedule();
 }
 
-// Signal up to "threadCount" threads waiting on the arbiter indicated by "waitingAddress"
+// Signal up to "threadCount" threads waiting on the arbiter indicated by "waitingAddress". If threadCount < 0 then all threads are released
 void Kernel::signalArbiter(u32 waitingAddress, s32 threadCount) {
 	if (threadCount == 0) [[unlikely]] return;
-	s32 count = 0; // Number of threads we've woken up
+
+	auto it = arbiterWaitQueues.find(waitingAddress);
+	if (it == arbiterWaitQueues.end()) {
+		return;
+	}
 
 	// Wake threads with the highest priority threads being woken up first
-	for (auto index : threadIndices) {
-		Thread& t = threads[index];
-		if (t.status == ThreadStatus::WaitArbiter && t.waitingAddress == waitingAddress) {
-			t.status = ThreadStatus::Ready;
-			count += 1;
-
-			// Check if we've reached the max number of. If count < 0 then all threads are released.
-			if (count == threadCount && threadCount > 0) break;
-		}
+	WaitQueue& queue = it->second;
+	for (s32 count = 0; !queue.empty() && (threadCount < 0 || count < threadCount); count++) {
+		threads[queue.pop().threadIndex].status = ThreadStatus::Ready;
+	}
+
+	if (queue.empty()) {
+		arbiterWaitQueues.erase(it);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "kernel/async_io.hpp"
+
+AsyncIO::~AsyncIO() {
+	{
+		std::scoped_lock lock(mutex);
+		stopping = true;
+	}
+
+	workAvailable.notify_all();
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+void AsyncIO::workerLoop() {
+	std::unique_lock lock(mutex);
+
+	while (true) {
+		workAvailable.wait(lock, [this]() { return stopping || !pending.empty(); });
+		if (pending.empty()) {  // Only reachable when stopping
+			return;
+		}
+
+		Request request = std::move(pending.front());
+		pending.pop_front();
+		busy = true;
+
+		lock.unlock();
+		request.work();
+		lock.lock();
+
+		busy = false;
+		finished.push_back(std::move(request.complete));
+		workDone.notify_all();
+	}
+}
+
+void AsyncIO::submit(Callback work, Callback complete) {
+	{
+		std::scoped_lock lock(mutex);
+		pending.push_back(Request{.work = std::move(work), .complete = std::move(complete)});
+	}
+
+	// Start the I/O thread lazily, so that games that never touch the filesystem after boot don't pay for it
+	if (!worker.joinable()) {
+		worker = std::thread(&AsyncIO::workerLoop, this);
+	}
+
+	outstanding++;
+	workAvailable.notify_one();
+}
+
+usize AsyncIO::poll() {
+	if (outstanding == 0) {
+		return 0;
+	}
+
+	std::vector<Callback> callbacks;
+	{
+		std::scoped_lock lock(mutex);
+		callbacks.swap(finished);
+	}
+
+	// Callbacks run without the lock held, as they may submit new requests
+	for (auto& callback : callbacks) {
+		callback();
+	}
+
+	outstanding -= callbacks.size();
+	return callbacks.size();
+}
+
+void AsyncIO::waitForCompletion() {
+	if (outstanding == 0) {
+		return;
+	}
+
+	std::unique_lock lock(mutex);
+	workDone.wait(lock, [this]() { return !finished.empty(); });
+}
+
+void AsyncIO::drain() {
+	while (outstanding != 0) {
+		{
+			std::unique_lock lock(mutex);
+			workDone.wait(lock, [this]() { return pending.empty() && !busy; });
+		}
+
+		poll();
+	}
+}
+
+void AsyncIO::reset() {
+	// Let queued work run to completion instead of dropping it, as it might be a save write
+	std::unique_lock lock(mutex);
+	workDone.wait(lock, [this]() { return pending.empty() && !busy; });
+
+	finished.clear();
+	outstanding = 0;
+}
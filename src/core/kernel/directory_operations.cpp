@@ -89,6 +89,11 @@ Filename83 convertTo83(const std::string& path) {
 
 void Kernel::handleDirectoryOperation(u32 messagePointer, Handle directory) {
 	const u32 cmd = mem.read32(messagePointer);
+	const IPCProfiler::Scope profile(ipcProfiler, IPCProfiler::DirectorySessions, cmd);
+
+	// Directory reads stat the host files, so let pending writes land first
+	drainAsyncIO();
+
 	switch (cmd) {
 		case DirectoryOps::Close: closeDirectory(messagePointer, directory); break;
 		case DirectoryOps::Read: readDirectory(messagePointer, directory); break;
@@ -1,6 +1,5 @@
 #include "kernel.hpp"
 #include "cpu.hpp"
-#include <bit>
 #include <utility>
 
 const char* Kernel::resetTypeToString(u32 type) {
@@ -14,7 +13,7 @@ const char* Kernel::resetTypeToString(u32 type) {
 
 Handle Kernel::makeEvent(ResetType resetType, Event::CallbackType callback) {
 	Handle ret = makeObject(KernelObjectType::Event);
-	objects[ret].data = new Event(resetType, callback);
+	allocateObjectData<Event>(ret, resetType, callback);
 	return ret;
 }
 
@@ -34,9 +33,8 @@ bool Kernel::signalEvent(Handle handle) {
 	}
 
 	// Check if there's any thread waiting on this event
-	if (event->waitlist != 0) {
-		wakeupAllThreads(event->waitlist, handle);
-		event->waitlist = 0;  // No threads waiting;
+	if (hasWaiters(object)) {
+		wakeupAllThreads(object);
 
 		if (event->resetType == ResetType::OneShot) {
 			event->fired = false;
@@ -63,7 +61,7 @@ void Kernel::svcCreateEvent() {
 	logSVC("CreateEvent(handle pointer = %08X, resetType = %s)\n", outPointer, resetTypeToString(resetType));
 
 	regs[0] = Result::Success;
-	regs[1] = makeEvent(static_cast<ResetType>(resetType));
+	regs[1] = giveToGuest(makeEvent(static_cast<ResetType>(resetType)));
 }
 
 // Result ClearEvent(Handle event)
@@ -134,8 +132,8 @@ void Kernel::waitSynchronization1() {
 		t.wakeupTick = getWakeupTick(ns);
 		t.waitList[0] = handle;
 
-		// Add the current thread to the object's wait list
-		object->getWaitlist() |= (1ull << currentThreadIndex);
+		// Add the current thread to the object's wait queue
+		addWaiter(t);
 
 		requireReschedule();
 	}
@@ -228,8 +226,8 @@ void Kernel::waitSynchronizationN() {
 
 		for (s32 i = 0; i < handleCount; i++) {
 			t.waitList[i] = waitObjects[i].first; // Add object to this thread's waitlist
-			waitObjects[i].second->getWaitlist() |= (1ull << currentThreadIndex); // And add the thread to the object's waitlist
 		}
+		addWaiter(t); // And add the thread to the wait queue of every object
 
 		requireReschedule();
 	} else {
@@ -1,3 +1,7 @@
+#include <memory>
+#include <vector>
+
+#include "cpu.hpp"
 #include "ipc.hpp"
 #include "kernel.hpp"
 
@@ -17,6 +21,13 @@ namespace FileOps {
 
 void Kernel::handleFileOperation(u32 messagePointer, Handle file) {
 	const u32 cmd = mem.read32(messagePointer);
+	const IPCProfiler::Scope profile(ipcProfiler, IPCProfiler::FileSessions, cmd);
+
+	// Everything other than reads and writes operates on the host file synchronously, so it has to wait for in-flight I/O on the I/O thread
+	if (cmd != FileOps::Read && cmd != FileOps::Write) {
+		drainAsyncIO();
+	}
+
 	switch (cmd) {
 		case FileOps::Close: closeFile(messagePointer, file); break;
 		case FileOps::Flush: flushFile(messagePointer, file); break;
@@ -41,6 +52,7 @@ void Kernel::closeFile(u32 messagePointer, Handle fileHandle) {
 	FileSession* session = p->getData<FileSession>();
 	session->isOpen = false;
 	if (session->fd != nullptr) {
+		serviceManager.getFS().getWriteBackCache().untrack(session->fd);
 		fclose(session->fd);
 	}
 
@@ -56,8 +68,9 @@ void Kernel::flushFile(u32 messagePointer, Handle fileHandle) {
 		Helpers::panic("Called FlushFile on non-existent file");
 	}
 
+	// Files in the write-back cache are committed from the flush timer instead, as games tend to flush after every tiny write
 	FileSession* session = p->getData<FileSession>();
-	if (session->fd != nullptr) {
+	if (session->fd != nullptr && !serviceManager.getFS().getWriteBackCache().isTracked(session->fd)) {
 		fflush(session->fd);
 	}
 
@@ -65,6 +78,92 @@ void Kernel::flushFile(u32 messagePointer, Handle fileHandle) {
 	mem.write32(messagePointer + 4, Result::Success);
 }
 
+// Host side of file reads and writes. These only touch the host file, so they can run either on the emulator thread or on the I/O thread
+static std::pair<bool, std::size_t> readHostFile(FILE* fd, u64 offset, u8* data, u32 size) {
+	IOFile f(fd);
+	if (!f.seek(s64(offset))) {
+		return {false, 0};
+	}
+
+	return f.readBytes(data, size);
+}
+
+static std::pair<bool, std::size_t> writeHostFile(FILE* fd, u64 offset, const u8* data, u32 size, bool flush) {
+	IOFile f(fd);
+	if (!f.seek(s64(offset))) {
+		return {false, 0};
+	}
+
+	auto result = f.writeBytes(data, size);
+	if (flush) {
+		f.flush();
+	}
+
+	return result;
+}
+
+void Kernel::submitAsyncIO(AsyncIO::Callback work, AsyncIO::Callback complete) {
+	const int threadIndex = currentThreadIndex;
+	threads[threadIndex].status = ThreadStatus::WaitIPC;
+
+	asyncIO.submit(std::move(work), [this, threadIndex, complete = std::move(complete)]() {
+		complete();
+
+		Thread& t = threads[threadIndex];
+		if (t.status == ThreadStatus::WaitIPC) {
+			t.status = ThreadStatus::Ready;
+			requireReschedule();
+		}
+	});
+
+	// Deliver the reply no earlier than a regular sync request would have woken the thread up
+	scheduleAsyncIOPoll(syncRequestDelayNs);
+	requireReschedule();
+}
+
+void Kernel::scheduleAsyncIOPoll(u64 delayNs) {
+	if (!asyncIOPollScheduled) {
+		asyncIOPollScheduled = true;
+		getScheduler().addEvent(Scheduler::EventType::PollAsyncIO, cpu.getTicks() + Scheduler::nsToCycles(delayNs));
+	}
+}
+
+void Kernel::scheduleSaveDataFlush() {
+	if (!saveDataFlushScheduled) {
+		saveDataFlushScheduled = true;
+		getScheduler().addEvent(Scheduler::EventType::FlushSaveData, cpu.getTicks() + Scheduler::nsToCycles(saveDataFlushDelayNs));
+	}
+}
+
+void Kernel::flushSaveData() {
+	saveDataFlushScheduled = false;
+
+	if (!config.asyncFileIO) {
+		serviceManager.getFS().flushSaveData();
+		return;
+	}
+
+	// Commits sync every dirty file to the disk, which is slow enough to stall frames, so they go on the I/O thread. No guest thread waits
+	// on them. Everything that needs the data on the disk (FS commands, save states, resets and shutdown) drains the I/O thread first
+	saveDataCommitPending = true;
+	asyncIO.submit([&fs = serviceManager.getFS()]() { fs.flushSaveData(); }, [this]() { saveDataCommitPending = false; });
+	scheduleAsyncIOPoll(asyncIOPollIntervalNs);
+}
+
+void Kernel::pollAsyncIO() {
+	asyncIOPollScheduled = false;
+
+	// If every guest thread is blocked, there's nothing to overlap the host I/O with, so block the emulator on it like synchronous I/O would
+	if (currentThreadIndex == idleThreadIndex) {
+		asyncIO.waitForCompletion();
+	}
+
+	asyncIO.poll();
+	if (asyncIO.hasOutstanding()) {
+		scheduleAsyncIOPoll(asyncIOPollIntervalNs);
+	}
+}
+
 void Kernel::readFile(u32 messagePointer, Handle fileHandle) {
 	u64 offset = mem.read64(messagePointer + 4);
 	u32 size = mem.read32(messagePointer + 12);
@@ -85,21 +184,69 @@ void Kernel::readFile(u32 messagePointer, Handle fileHandle) {
 		Helpers::panic("Tried to read closed file");
 	}
 
+	auto archive = file->archive;
+	auto& writeBackCache = serviceManager.getFS().getWriteBackCache();
+	const bool hostRead = file->fd != nullptr || archive->supportsHostReads();
+	const bool cached = file->fd != nullptr && writeBackCache.isTracked(file->fd);
+
+	if (config.asyncFileIO && hostRead) {
+		auto data = std::make_shared<std::vector<u8>>(size);
+		auto bytesRead = std::make_shared<std::optional<u32>>();
+
+		submitAsyncIO(
+			// The session is copied so the I/O thread doesn't depend on the kernel object staying alive
+			[data, bytesRead, session = FileSession(*file), cached, &writeBackCache, offset, size]() mutable {
+				if (cached) {
+					*bytesRead = writeBackCache.read(session.fd, offset, data->data(), size);
+				} else if (session.fd != nullptr) {
+					auto [success, bytes] = readHostFile(session.fd, offset, data->data(), size);
+					if (success) {
+						*bytesRead = u32(bytes);
+					}
+				} else {
+					*bytesRead = session.archive->readFileToHost(&session, offset, size, data->data());
+				}
+			},
+			[this, data, bytesRead, messagePointer, dataPointer]() {
+				if (!bytesRead->has_value()) {
+					Helpers::panic("Kernel::ReadFile failed");
+				}
+
+				const u32 bytes = bytesRead->value();
+				mem.writeBlock(dataPointer, data->data(), bytes);
+				mem.write32(messagePointer + 4, Result::Success);
+				mem.write32(messagePointer + 8, bytes);
+			}
+		);
+
+		return;
+	}
+
+	// Files in the write-back cache might have data that only exists in the cache
+	if (cached) {
+		std::unique_ptr<u8[]> data(new u8[size]);
+		std::optional<u32> bytesRead = writeBackCache.read(file->fd, offset, data.get(), size);
+
+		if (!bytesRead.has_value()) {
+			Helpers::panic("Kernel::ReadFile from write-back cache failed");
+		}
+
+		mem.writeBlock(dataPointer, data.get(), bytesRead.value());
+		mem.write32(messagePointer + 4, Result::Success);
+		mem.write32(messagePointer + 8, bytesRead.value());
+		return;
+	}
+
 	// Handle files with their own file descriptors by just fread'ing the data
 	if (file->fd) {
 		std::unique_ptr<u8[]> data(new u8[size]);
-		IOFile f(file->fd);
-
-		auto [success, bytesRead] = f.readBytes(data.get(), size);
+		auto [success, bytesRead] = readHostFile(file->fd, offset, data.get(), size);
 
 		if (!success) {
 			Helpers::panic("Kernel::ReadFile with file descriptor failed");
 		}
 		else {
-			for (size_t i = 0; i < bytesRead; i++) {
-				mem.write8(u32(dataPointer + i), data[i]);
-			}
-
+			mem.writeBlock(dataPointer, data.get(), u32(bytesRead));
 			mem.write32(messagePointer + 4, Result::Success);
 			mem.write32(messagePointer + 8, u32(bytesRead));
 		}
@@ -108,7 +255,6 @@ void Kernel::readFile(u32 messagePointer, Handle fileHandle) {
 	}
 
 	// Handle files without their own FD, such as SelfNCCH files
-	auto archive = file->archive;
 	std::optional<u32> bytesRead = archive->readFile(file, offset, size, dataPointer);
 	if (!bytesRead.has_value()) {
 		Helpers::panic("Kernel::ReadFile failed");
@@ -140,20 +286,81 @@ void Kernel::writeFile(u32 messagePointer, Handle fileHandle) {
 	if (!file->fd)
 		Helpers::panic("[Kernel::File::WriteFile] Tried to write to file without a valid file descriptor");
 
-	std::unique_ptr<u8[]> data(new u8[size]);
-	for (size_t i = 0; i < size; i++) {
-		data[i] = mem.read8(u32(dataPointer + i));
+	mem.write32(messagePointer, IPC::responseHeader(0x0803, 2, 2));
+
+	// The data is copied out of emulated memory now, as the guest is free to reuse its buffer once the write is handed to the OS
+	// TODO: Should the flush check only the byte of the write option?
+	auto data = std::make_shared<std::vector<u8>>(size);
+	mem.readBlock(dataPointer, data->data(), size);
+
+	// Save files go to the write-back cache, which is just a copy into host memory. The flush flag is left to the flush timer
+	auto& writeBackCache = serviceManager.getFS().getWriteBackCache();
+	if (writeBackCache.isTracked(file->fd)) {
+		// A commit on the I/O thread holds the cache until its files are on the disk. Instead of stalling the emulator on it, the write gets
+		// queued behind the commit and only the guest thread waits
+		if (saveDataCommitPending) {
+			auto bytesWritten = std::make_shared<std::optional<u32>>();
+
+			submitAsyncIO(
+				[data, bytesWritten, &writeBackCache, fd = file->fd, offset, size]() {
+					*bytesWritten = writeBackCache.write(fd, offset, data->data(), size);
+				},
+				[this, bytesWritten, messagePointer]() {
+					if (!bytesWritten->has_value()) {
+						Helpers::panic("Kernel::WriteFile to write-back cache failed");
+					}
+
+					scheduleSaveDataFlush();
+					mem.write32(messagePointer + 4, Result::Success);
+					mem.write32(messagePointer + 8, bytesWritten->value());
+				}
+			);
+
+			return;
+		}
+
+		std::optional<u32> bytesWritten = writeBackCache.write(file->fd, offset, data->data(), size);
+		if (!bytesWritten.has_value()) {
+			Helpers::panic("Kernel::WriteFile to write-back cache failed");
+		}
+
+		scheduleSaveDataFlush();
+		mem.write32(messagePointer + 4, Result::Success);
+		mem.write32(messagePointer + 8, bytesWritten.value());
+		return;
+	}
+
+	// Files outside the cache are written straight to the host, which frames that will be thrown away must not do
+	if (serviceManager.getFS().isSpeculative()) [[unlikely]] {
+		mem.write32(messagePointer + 4, Result::Success);
+		mem.write32(messagePointer + 8, size);
+		return;
 	}
 
-	IOFile f(file->fd);
-	auto [success, bytesWritten] = f.writeBytes(data.get(), size);
+	if (config.asyncFileIO) {
+		auto bytesWritten = std::make_shared<std::optional<u32>>();
+
+		submitAsyncIO(
+			[data, bytesWritten, fd = file->fd, offset, size, writeOption]() {
+				auto [success, bytes] = writeHostFile(fd, offset, data->data(), size, writeOption != 0);
+				if (success) {
+					*bytesWritten = u32(bytes);
+				}
+			},
+			[this, bytesWritten, messagePointer]() {
+				if (!bytesWritten->has_value()) {
+					Helpers::panic("Kernel::WriteFile failed");
+				}
+
+				mem.write32(messagePointer + 4, Result::Success);
+				mem.write32(messagePointer + 8, bytesWritten->value());
+			}
+		);
 
-	// TODO: Should this check only the byte?
-	if (writeOption) {
-		f.flush();
+		return;
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x0803, 2, 2));
+	auto [success, bytesWritten] = writeHostFile(file->fd, offset, data->data(), size, writeOption != 0);
 	if (!success) {
 		Helpers::panic("Kernel::WriteFile failed");
 	} else {
@@ -178,8 +385,18 @@ void Kernel::setFileSize(u32 messagePointer, Handle fileHandle) {
 
 	if (file->fd) {
 		const u64 newSize = mem.read64(messagePointer + 4);
-		IOFile f(file->fd);
-		bool success = f.setSize(newSize);
+		auto& writeBackCache = serviceManager.getFS().getWriteBackCache();
+		bool success;
+
+		if (writeBackCache.isTracked(file->fd)) {
+			success = writeBackCache.setSize(file->fd, newSize);
+			scheduleSaveDataFlush();
+		} else if (serviceManager.getFS().isSpeculative()) [[unlikely]] {
+			success = true;
+		} else {
+			IOFile f(file->fd);
+			success = f.setSize(newSize);
+		}
 
 		if (success) {
 			mem.write32(messagePointer + 4, Result::Success);
@@ -207,8 +424,15 @@ void Kernel::getFileSize(u32 messagePointer, Handle fileHandle) {
 	mem.write32(messagePointer, IPC::responseHeader(0x0804, 3, 0));
 
 	if (file->fd) {
-		IOFile f(file->fd);
-		std::optional<u64> size = f.size();
+		auto& writeBackCache = serviceManager.getFS().getWriteBackCache();
+		std::optional<u64> size;
+
+		if (writeBackCache.isTracked(file->fd)) {
+			size = writeBackCache.size(file->fd);
+		} else {
+			IOFile f(file->fd);
+			size = f.size();
+		}
 
 		if (size.has_value()) {
 			mem.write32(messagePointer + 4, Result::Success);
@@ -235,13 +459,12 @@ void Kernel::openLinkFile(u32 messagePointer, Handle fileHandle) {
 	}
 
 	// Make clone object
-	auto handle = makeObject(KernelObjectType::File);
-	auto& cloneFile = getObjects()[handle];
+	auto handle = giveToGuest(makeObject(KernelObjectType::File));
 
 	// Make a clone of the file by copying the archive/archive path/file path/file descriptor/etc of the original file
 	// TODO: Maybe we should duplicate the file handle instead of copying. This way their offsets will be separate
 	// However we do seek properly on every file access so this shouldn't matter
-	cloneFile.data = new FileSession(*file);
+	allocateObjectData<FileSession>(handle, *file);
 
 	mem.write32(messagePointer, IPC::responseHeader(0x080C, 1, 2));
 	mem.write32(messagePointer + 4, Result::Success);
@@ -0,0 +1,132 @@
+#include "ipc_profiler.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+
+void IPCProfiler::record(Handle target, u32 header, Clock::duration elapsed) {
+	const u64 ns = u64(std::max<s64>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), 0));
+	const u64 key = (u64(target) << 32) | header;
+
+	auto [it, inserted] = commands.try_emplace(key);
+	CommandStats& stats = it->second;
+	if (inserted) {
+		stats.target = target;
+		stats.header = header;
+	}
+
+	const usize bucket = std::min<usize>(ns == 0 ? 0 : std::bit_width(ns) - 1, bucketCount - 1);
+	stats.count++;
+	stats.totalNs += ns;
+	stats.minNs = std::min(stats.minNs, ns);
+	stats.maxNs = std::max(stats.maxNs, ns);
+	stats.histogram[bucket]++;
+}
+
+u64 IPCProfiler::CommandStats::percentileNs(double fraction) const {
+	if (count == 0) {
+		return 0;
+	}
+
+	// The request the percentile falls on, counting from 1
+	const u64 rank = std::max<u64>(u64(fraction * double(count) + 0.999999), 1);
+	u64 seen = 0;
+
+	for (usize i = 0; i < bucketCount - 1; i++) {
+		seen += histogram[i];
+		if (seen >= rank) {
+			return std::min(u64(2) << i, maxNs);
+		}
+	}
+
+	return maxNs;
+}
+
+std::vector<IPCProfiler::CommandStats> IPCProfiler::getStats() const {
+	std::vector<CommandStats> stats;
+	stats.reserve(commands.size());
+
+	for (const auto& [key, command] : commands) {
+		stats.push_back(command);
+	}
+
+	std::sort(stats.begin(), stats.end(), [](const CommandStats& a, const CommandStats& b) {
+		if (a.totalNs != b.totalNs) {
+			return a.totalNs > b.totalNs;
+		}
+
+		return a.target != b.target ? a.target < b.target : a.header < b.header;
+	});
+
+	return stats;
+}
+
+const char* IPCProfiler::getTargetName(Handle target) {
+	switch (target) {
+		case FileSessions: return "File";
+		case DirectorySessions: return "Directory";
+		default: return KernelHandles::getServiceName(target);
+	}
+}
+
+std::string IPCProfiler::dumpTable() const {
+	const auto stats = getStats();
+	std::string out;
+	char line[256];
+
+	std::snprintf(
+		line, sizeof(line), "%-12s %-10s %10s %14s %10s %10s %10s %10s %10s\n", "Target", "Header", "Count", "Total (us)", "Avg (ns)", "Min (ns)",
+		"p50 (ns)", "p99 (ns)", "Max (ns)"
+	);
+	out += line;
+
+	for (const auto& command : stats) {
+		std::snprintf(
+			line, sizeof(line), "%-12s %08X   %10" PRIu64 " %14.1f %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+			getTargetName(command.target), command.header, command.count, double(command.totalNs) / 1000.0, command.totalNs / command.count,
+			command.minNs, command.percentileNs(0.5), command.percentileNs(0.99), command.maxNs
+		);
+		out += line;
+	}
+
+	if (!enabled) {
+		out += "IPC profiling is disabled\n";
+	}
+
+	return out;
+}
+
+std::string IPCProfiler::dumpJSON() const {
+	const auto stats = getStats();
+	std::string out = enabled ? "{\"enabled\":true,\"commands\":[" : "{\"enabled\":false,\"commands\":[";
+	char buffer[256];
+
+	for (usize i = 0; i < stats.size(); i++) {
+		const CommandStats& command = stats[i];
+		std::snprintf(
+			buffer, sizeof(buffer),
+			"%s{\"target\":\"%s\",\"handle\":%u,\"header\":%u,\"count\":%" PRIu64 ",\"totalNs\":%" PRIu64 ",\"minNs\":%" PRIu64
+			",\"maxNs\":%" PRIu64 ",\"histogram\":[",
+			i == 0 ? "" : ",", getTargetName(command.target), command.target, command.header, command.count, command.totalNs, command.minNs,
+			command.maxNs
+		);
+		out += buffer;
+
+		// Trailing empty buckets are left out
+		usize bucketsUsed = bucketCount;
+		while (bucketsUsed > 0 && command.histogram[bucketsUsed - 1] == 0) {
+			bucketsUsed--;
+		}
+
+		for (usize bucket = 0; bucket < bucketsUsed; bucket++) {
+			std::snprintf(buffer, sizeof(buffer), "%s%" PRIu64, bucket == 0 ? "" : ",", command.histogram[bucket]);
+			out += buffer;
+		}
+
+		out += "]}";
+	}
+
+	out += "]}";
+	return out;
+}
@@ -2,9 +2,10 @@
 #include "kernel.hpp"
 #include "kernel_types.hpp"
 #include "cpu.hpp"
+#include "arm_defs.hpp"
 
 Kernel::Kernel(CPU& cpu, Memory& mem, GPU& gpu, const EmulatorConfig& config)
-	: cpu(cpu), regs(cpu.regs()), mem(mem), handleCounter(0), serviceManager(regs, mem, gpu, currentProcess, *this, config) {
+	: cpu(cpu), regs(cpu.regs()), mem(mem), config(config), serviceManager(regs, mem, gpu, currentProcess, *this, config) {
 	objects.reserve(512); // Make room for a few objects to avoid further memory allocs later
 	mutexHandles.reserve(8);
 	portHandles.reserve(32);
@@ -21,12 +22,27 @@ Kernel::Kernel(CPU& cpu, Memory& mem, GPU& gpu, const EmulatorConfig& config)
 		// The state below isn't necessary to initialize but we do it anyways out of caution
 		t.outPointer = 0;
 		t.waitAll = false;
+		t.handleClosed = false;
 	}
 
 	setVersion(1, 69);
 }
 
+Kernel::~Kernel() {
+	// Let queued file I/O, like a save data commit, finish while the objects and services it uses are still around
+	asyncIO.reset();
+
+	for (auto& object : objects) {
+		deleteObjectData(object);
+	}
+}
+
 void Kernel::serviceSVC(u32 svc) {
+	if (LibcHooks::isHookSVC(svc)) [[unlikely]] {
+		callLibcHook(svc);
+		return;
+	}
+
 	switch (svc) {
 		case 0x01: controlMemory(); break;
 		case 0x02: queryMemory(); break;
@@ -75,6 +91,21 @@ void Kernel::serviceSVC(u32 svc) {
 	evalReschedule();
 }
 
+void Kernel::callLibcHook(u32 svc) {
+	const u64 cycles = mem.getLibcHooks().call(svc, regs, mem);
+	cpu.addTicks(cycles);
+
+	// The hook replaces the whole routine, so return to the caller like its bx lr would, switching to Thumb if needed
+	const u32 lr = regs[14];
+	regs[15] = lr & ~1u;
+
+	if (lr & 1) {
+		cpu.setCPSR(cpu.getCPSR() | CPSR::Thumb);
+	} else {
+		cpu.setCPSR(cpu.getCPSR() & ~CPSR::Thumb);
+	}
+}
+
 void Kernel::setVersion(u8 major, u8 minor) {
 	u16 descriptor = (u16(major) << 8) | u16(minor);
 
@@ -87,11 +118,10 @@ Handle Kernel::makeProcess(u32 id) {
 	const Handle resourceLimitHandle = makeObject(KernelObjectType::ResourceLimit);
 
 	// Allocate data
-	objects[processHandle].data = new Process(id);
-	const auto processData = objects[processHandle].getData<Process>();
+	const auto processData = allocateObjectData<Process>(processHandle, id);
 
 	// Link resource limit object with its parent process
-	objects[resourceLimitHandle].data = &processData->limits;
+	getObject(resourceLimitHandle)->data = &processData->limits;
 	processData->limits.handle = resourceLimitHandle;
 	return processHandle;
 }
@@ -111,30 +141,112 @@ void Kernel::deleteObjectData(KernelObject& object) {
 		return;
 	}
 
-	// Resource limit and thread objects do not allocate heap data, so we don't delete anything
+	// Resource limit and thread objects do not allocate their data from a pool, so we don't free anything
 
 	switch (object.type) {
-		case KernelObjectType::AddressArbiter: delete object.getData<AddressArbiter>(); return;
-		case KernelObjectType::Archive: delete object.getData<ArchiveSession>(); return;
-		case KernelObjectType::Directory: delete object.getData<DirectorySession>(); return;
-		case KernelObjectType::Event: delete object.getData<Event>(); return;
-		case KernelObjectType::File: delete object.getData<FileSession>(); return;
-		case KernelObjectType::MemoryBlock: delete object.getData<MemoryBlock>(); return;
-		case KernelObjectType::Port: delete object.getData<Port>(); return;
-		case KernelObjectType::Process: delete object.getData<Process>(); return;
+		case KernelObjectType::AddressArbiter: getObjectPool<AddressArbiter>().free(object.getData<AddressArbiter>()); break;
+		case KernelObjectType::Archive: getObjectPool<ArchiveSession>().free(object.getData<ArchiveSession>()); break;
+		case KernelObjectType::Directory: getObjectPool<DirectorySession>().free(object.getData<DirectorySession>()); break;
+		case KernelObjectType::Event: getObjectPool<Event>().free(object.getData<Event>()); break;
+		case KernelObjectType::File: getObjectPool<FileSession>().free(object.getData<FileSession>()); break;
+		case KernelObjectType::MemoryBlock: getObjectPool<MemoryBlock>().free(object.getData<MemoryBlock>()); break;
+		case KernelObjectType::Port: getObjectPool<Port>().free(object.getData<Port>()); break;
+		case KernelObjectType::Process: getObjectPool<Process>().free(object.getData<Process>()); break;
 		case KernelObjectType::ResourceLimit: return;
-		case KernelObjectType::Session: delete object.getData<Session>(); return;
-		case KernelObjectType::Mutex: delete object.getData<Mutex>(); return;
-		case KernelObjectType::Semaphore: delete object.getData<Semaphore>(); return;
-		case KernelObjectType::Timer: delete object.getData<Timer>(); return;
+		case KernelObjectType::Session: getObjectPool<Session>().free(object.getData<Session>()); break;
+		case KernelObjectType::Mutex: getObjectPool<Mutex>().free(object.getData<Mutex>()); break;
+		case KernelObjectType::Semaphore: getObjectPool<Semaphore>().free(object.getData<Semaphore>()); break;
+		case KernelObjectType::Timer: getObjectPool<Timer>().free(object.getData<Timer>()); break;
 		case KernelObjectType::Thread: return;
 		case KernelObjectType::Dummy: return;
 		default: [[unlikely]] Helpers::warn("unknown object type"); return;
 	}
+
+	object.data = nullptr;
+}
+
+void Kernel::destroyObject(Handle handle) {
+	KernelObject* object = getObject(handle);
+
+	switch (object->type) {
+		// Close file descriptor when closing a file to prevent leaks and properly flush file contents
+		case KernelObjectType::File: {
+			FileSession* file = object->getData<FileSession>();
+			drainAsyncIO();
+
+			if (file->isOpen) {
+				file->isOpen = false;
+
+				if (file->fd != nullptr) {
+					serviceManager.getFS().getWriteBackCache().untrack(file->fd);
+					fclose(file->fd);
+					file->fd = nullptr;
+				}
+			}
+			break;
+		}
+
+		case KernelObjectType::AddressArbiter: arbiterCount--; break;
+		case KernelObjectType::Mutex: std::erase(mutexHandles, handle); break;
+		case KernelObjectType::Timer: std::erase(timerHandles, handle); break;
+		default: break;
+	}
+
+	log("Destroyed %s object with handle %X\n", object->getTypeName(), handle);
+	deleteObjectData(*object);
+	objects.free(handle);
+}
+
+namespace {
+	template <typename T>
+	void addPoolStats(KernelObjectStats& stats, const ObjectPool<T>& pool) {
+		stats.liveObjects = pool.liveObjects();
+		stats.pooledObjects = pool.capacity();
+		stats.pooledBytes = pool.reservedBytes();
+	}
+}  // namespace
+
+std::vector<KernelObjectStats> Kernel::getObjectStats() {
+	std::vector<KernelObjectStats> stats;
+	const auto statsFor = [&](KernelObjectType type) -> KernelObjectStats& {
+		for (auto& entry : stats) {
+			if (entry.type == type) {
+				return entry;
+			}
+		}
+
+		return stats.emplace_back(KernelObjectStats{.type = type});
+	};
+
+	for (u32 i = 0; i < objects.slotCount(); i++) {
+		if (!objects.isFree(i)) {
+			const KernelObject& object = *(objects.begin() + i);
+			statsFor(object.type).handles++;
+		}
+	}
+
+	addPoolStats(statsFor(KernelObjectType::AddressArbiter), getObjectPool<AddressArbiter>());
+	addPoolStats(statsFor(KernelObjectType::Archive), getObjectPool<ArchiveSession>());
+	addPoolStats(statsFor(KernelObjectType::Directory), getObjectPool<DirectorySession>());
+	addPoolStats(statsFor(KernelObjectType::Event), getObjectPool<Event>());
+	addPoolStats(statsFor(KernelObjectType::File), getObjectPool<FileSession>());
+	addPoolStats(statsFor(KernelObjectType::MemoryBlock), getObjectPool<MemoryBlock>());
+	addPoolStats(statsFor(KernelObjectType::Port), getObjectPool<Port>());
+	addPoolStats(statsFor(KernelObjectType::Process), getObjectPool<Process>());
+	addPoolStats(statsFor(KernelObjectType::Session), getObjectPool<Session>());
+	addPoolStats(statsFor(KernelObjectType::Mutex), getObjectPool<Mutex>());
+	addPoolStats(statsFor(KernelObjectType::Semaphore), getObjectPool<Semaphore>());
+	addPoolStats(statsFor(KernelObjectType::Timer), getObjectPool<Timer>());
+	return stats;
 }
 
 void Kernel::reset() {
-	handleCounter = 0;
+	// Any in-flight file operation belongs to the old session. Let it hit the disk but don't deliver its reply
+	asyncIO.reset();
+	asyncIOPollScheduled = false;
+	saveDataFlushScheduled = false;
+	saveDataCommitPending = false;
+
 	arbiterCount = 0;
 	threadCount = 0;
 	aliveThreadCount = 0;
@@ -142,8 +254,9 @@ void Kernel::reset() {
 	for (auto& t : threads) {
 		t.status = ThreadStatus::Dead;
 		t.waitList.clear();
-		t.threadsWaitingForTermination = 0; // No threads are waiting for this thread to terminate cause it's dead
 	}
+	arbiterWaitQueues.clear();
+	objectWaitQueues.clear();
 
 	for (auto& object : objects) {
 		deleteObjectData(object);
@@ -155,6 +268,10 @@ void Kernel::reset() {
 	threadIndices.clear();
 	serviceManager.reset();
 
+	// Start each session with a fresh profile
+	ipcProfiler.reset();
+	ipcProfiler.setEnabled(config.profileIPC);
+
 	needReschedule = false;
 
 	// Allocate handle #0 to a dummy object and make a main process object
@@ -179,33 +296,44 @@ u32 Kernel::getTLSPointer() {
 }
 
 // Result CloseHandle(Handle handle)
+// We don't reference count objects, so every object has a single handle. Objects owned by services and the kernel, or pinned by a service,
+// are never destroyed
 void Kernel::svcCloseHandle() {
-	logSVC("CloseHandle(handle = %d) (Unimplemented)\n", regs[0]);
-	const Handle handle = regs[0];
+	logSVC("CloseHandle(handle = %X)\n", regs[0]);
+	regs[0] = closeHandle(regs[0]);
+}
 
+Result::HorizonResult Kernel::closeHandle(Handle handle) {
 	KernelObject* object = getObject(handle);
-	if (object != nullptr) {
-		switch (object->type) {
-			// Close file descriptor when closing a file to prevent leaks and properly flush file contents
-			case KernelObjectType::File: {
-				FileSession* file = object->getData<FileSession>();
-				if (file->isOpen) {
-					file->isOpen = false;
-
-					if (file->fd != nullptr) {
-						fclose(file->fd);
-						file->fd = nullptr;
-					}
-				}
-				break;
-			}
+	if (object == nullptr) {
+		// The hardcoded handles, like the current thread and the service and shared memory handles, can always be closed
+		return (handle >= KernelHandles::CurrentThread) ? Result::Success : Result::Kernel::InvalidHandle;
+	}
 
-			default: break;
+	// Objects made by services or the kernel, and guest objects that a service pinned, stay alive
+	if (!object->ownedByGuest) {
+		return Result::Success;
+	}
+
+	// Threads waiting on an object keep it alive. We don't track that, so we leave the object around forever instead
+	if (hasWaiters(object)) {
+		Helpers::warn("CloseHandle: Closed a %s object that threads are waiting on", object->getTypeName());
+		object->ownedByGuest = false;
+		return Result::Success;
+	}
+
+	// The thread object that the thread itself refers to has to outlive the thread, so it's destroyed when the thread exits
+	if (object->type == KernelObjectType::Thread) {
+		Thread* t = object->getData<Thread>();
+
+		if (t->handle == handle && t->status != ThreadStatus::Dead) {
+			t->handleClosed = true;
+			return Result::Success;
 		}
 	}
 
-	// Stub to always succeed for now
-	regs[0] = Result::Success;
+	destroyObject(handle);
+	return Result::Success;
 }
 
 // u64 GetSystemTick()
@@ -288,8 +416,8 @@ void Kernel::duplicateHandle() {
 
 	if (original == KernelHandles::CurrentThread) {
 		regs[0] = Result::Success;
-		Handle ret = makeObject(KernelObjectType::Thread);
-		objects[ret].data = &threads[currentThreadIndex];
+		Handle ret = giveToGuest(makeObject(KernelObjectType::Thread));
+		getObject(ret)->data = &threads[currentThreadIndex];
 
 		regs[1] = ret;
 	} else {
@@ -401,3 +529,4 @@ std::string Kernel::getProcessName(u32 pid) {
 }
 
 Scheduler& Kernel::getScheduler() { return cpu.getScheduler(); }
+u64 Kernel::getTicks() { return cpu.getTicks(); }
@@ -156,7 +156,7 @@ void Kernel::mapMemoryBlock() {
 
 Handle Kernel::makeMemoryBlock(u32 addr, u32 size, u32 myPermission, u32 otherPermission) {
 	Handle ret = makeObject(KernelObjectType::MemoryBlock);
-	objects[ret].data = new MemoryBlock(addr, size, myPermission, otherPermission);
+	allocateObjectData<MemoryBlock>(ret, addr, size, myPermission, otherPermission);
 
 	return ret;
 }
@@ -205,7 +205,7 @@ void Kernel::createMemoryBlock() {
 	if (otherPermission == MemoryPermissions::DontCare) otherPermission = MemoryPermissions::ReadWrite;
 
 	regs[0] = Result::Success;
-	regs[1] = makeMemoryBlock(addr, size, myPermission, otherPermission);
+	regs[1] = giveToGuest(makeMemoryBlock(addr, size, myPermission, otherPermission));
 }
 
 void Kernel::unmapMemoryBlock() {
@@ -4,7 +4,7 @@
 Handle Kernel::makePort(const char* name) {
 	Handle ret = makeObject(KernelObjectType::Port);
 	portHandles.push_back(ret); // Push the port handle to our cache of port handles
-	objects[ret].data = new Port(name);
+	allocateObjectData<Port>(ret, name);
 
 	return ret;
 }
@@ -17,7 +17,7 @@ Handle Kernel::makeSession(Handle portHandle) {
 
 	// Allocate data for session
 	const Handle ret = makeObject(KernelObjectType::Session);
-	objects[ret].data = new Session(portHandle);
+	allocateObjectData<Session>(ret, portHandle);
 	return ret;
 }
 
@@ -25,7 +25,7 @@ Handle Kernel::makeSession(Handle portHandle) {
 // If there's no such port, return nullopt
 std::optional<Handle> Kernel::getPortHandle(const char* name) {
 	for (auto handle : portHandles) {
-		const auto data = objects[handle].getData<Port>();
+		const auto data = getObject(handle)->getData<Port>();
 		if (std::strncmp(name, data->name, Port::maxNameLen) == 0) {
 			return handle;
 		}
@@ -57,13 +57,13 @@ void Kernel::connectToPort() {
 
 	Handle portHandle = optionalHandle.value();
 
-	const auto portData = objects[portHandle].getData<Port>();
+	const auto portData = getObject(portHandle)->getData<Port>();
 	if (!portData->isPublic) {
 		Helpers::panic("ConnectToPort: Attempted to connect to private port");
 	}
 
 	// TODO: Actually create session
-	Handle sessionHandle = makeSession(portHandle);
+	Handle sessionHandle = giveToGuest(makeSession(portHandle));
 
 	regs[0] = Result::Success;
 	regs[1] = sessionHandle;
@@ -76,13 +76,15 @@ void Kernel::sendSyncRequest() {
 	u32 messagePointer = getTLSPointer() + 0x80; // The message is stored starting at TLS+0x80
 	logSVC("SendSyncRequest(session handle = %X)\n", handle);
 
-	// Service calls via SendSyncRequest and file access needs to put the caller to sleep for a given amount of time
-	// To make sure that the other threads don't get starved. Various games rely on this (including Sonic Boom: Shattering Crystal it seems)
-	constexpr u64 syncRequestDelayNs = 39000;
 	sleepThread(syncRequestDelayNs);
 
 	// The sync request is being sent at a service rather than whatever port, so have the service manager intercept it
 	if (KernelHandles::isServiceHandle(handle)) {
+		// FS commands open, delete and rename host files, so in-flight file I/O has to land first
+		if (handle == KernelHandles::FS) {
+			drainAsyncIO();
+		}
+
 		// The service call might cause a reschedule and change threads. Hence, set r0 before executing the service call
 		// Because if the service call goes first, we might corrupt the new thread's r0!!
 		regs[0] = Result::Success;
@@ -124,7 +126,7 @@ void Kernel::sendSyncRequest() {
 		regs[0] = Result::Success;
 		handleErrorSyncRequest(messagePointer);
 	} else {
-		const auto portData = objects[portHandle].getData<Port>();
+		const auto portData = getObject(portHandle)->getData<Port>();
 		Helpers::panic("SendSyncRequest targetting port %s\n", portData->name);
 	}
 }
@@ -0,0 +1,373 @@
+#include "savestate.hpp"
+
+#include <unordered_set>
+
+#include "kernel.hpp"
+
+namespace {
+	void doPathState(SaveStateStream& stream, FSPath& path) {
+		stream.value(path.type);
+		stream.vector(path.binary);
+		stream.string(path.string);
+		stream.string(path.utf16_string);
+	}
+
+	bool samePath(const FSPath& a, const FSPath& b) {
+		return a.type == b.type && a.binary == b.binary && a.string == b.string && a.utf16_string == b.utf16_string;
+	}
+
+	void doThreadState(SaveStateStream& stream, Thread& t) {
+		stream.value(t.initialSP);
+		stream.value(t.entrypoint);
+		stream.value(t.priority);
+		stream.value(t.arg);
+		stream.value(t.processorID);
+		stream.value(t.status);
+		stream.value(t.handle);
+		stream.value(t.waitingAddress);
+		stream.vector(t.waitList);
+		stream.value(t.waitAll);
+		stream.value(t.outPointer);
+		stream.value(t.wakeupTick);
+		stream.value(t.gprs);
+		stream.value(t.fprs);
+		stream.value(t.cpsr);
+		stream.value(t.fpscr);
+		stream.value(t.tlsBase);
+		stream.value(t.handleClosed);
+	}
+
+
+	// Allocates the data of an object being loaded, or returns the existing data of an object being saved
+	template <typename T, typename... Args>
+	T* objectData(SaveStateStream& stream, Kernel& kernel, KernelObject& object, Args&&... args) {
+		if (stream.isReading()) {
+			return kernel.allocateObjectData<T>(object.handle, std::forward<Args>(args)...);
+		}
+
+		return object.getData<T>();
+	}
+}  // namespace
+
+void HandleTable::doState(SaveStateStream& stream) {
+	const u32 slotCount = stream.count(slots.size(), sizeof(Handle) + sizeof(KernelObjectType) + sizeof(u16));
+	if (stream.isReading()) {
+		clear();
+		if (slotCount > maxSlots) {
+			stream.fail();
+			return;
+		}
+
+		slots.resize(slotCount, KernelObject(0, KernelObjectType::Dummy));
+		generations.resize(slotCount);
+	}
+
+	for (u32 i = 0; i < slotCount; i++) {
+		KernelObject& object = slots[i];
+		stream.value(object.handle);
+		stream.value(object.type);
+		stream.value(object.ownedByGuest);
+		stream.value(generations[i]);
+	}
+
+	stream.vector(freeSlots);
+
+	// Every free slot has to be on the free list exactly once, or the same slot could be handed out twice
+	if (stream.isReading()) {
+		std::vector<bool> listed(slotCount, false);
+		for (u32 index : freeSlots) {
+			if (index >= slotCount || !isFree(index) || listed[index]) {
+				stream.fail();
+				return;
+			}
+
+			listed[index] = true;
+		}
+
+		for (u32 i = 0; i < slotCount; i++) {
+			const bool free = isFree(i);
+			if (free != listed[i] || (free && (slots[i].handle != 0 || slots[i].type != KernelObjectType::Dummy))) {
+				stream.fail();
+				return;
+			}
+		}
+
+		if (slotCount == 0 || isFree(0)) {
+			stream.fail();
+		}
+	}
+}
+
+// Object data is allocated from the object pools and points to other objects by handle, so when loading we throw away every object and make
+// them all again. The handle table is restored exactly, free list included, to keep the guest's handles valid and to hand out the same
+// handles from then on
+void Kernel::doState(SaveStateStream& stream) {
+	stream.section("KERN");
+	stream.value(currentProcess);
+	stream.value(mainThread);
+	stream.value(currentThreadIndex);
+	stream.value(srvHandle);
+	stream.value(errorPortHandle);
+	stream.value(arbiterCount);
+	stream.value(threadCount);
+	stream.value(aliveThreadCount);
+	stream.value(kernelVersion);
+	stream.value(needReschedule);
+	stream.value(asyncIOPollScheduled);
+	stream.value(saveDataFlushScheduled);
+
+	stream.vector(portHandles);
+	stream.vector(mutexHandles);
+	stream.vector(timerHandles);
+	stream.vector(threadIndices);
+
+	for (auto& t : threads) {
+		doThreadState(stream, t);
+	}
+
+	if (stream.isReading()) {
+		for (int index : threadIndices) {
+			if (index < 0 || index >= int(threads.size())) {
+				stream.fail();
+			}
+		}
+
+		if (currentThreadIndex < 0 || currentThreadIndex >= int(threads.size())) {
+			stream.fail();
+		}
+	}
+
+	// When loading, the old objects are kept around until the new ones are made, so that files that are still open in the loaded state can
+	// keep their host file instead of reopening it, which matters when states are loaded every frame
+	HandleTable oldObjects;
+	std::unordered_set<FILE*> reusedFiles;
+	if (stream.isReading()) {
+		std::swap(oldObjects, objects);
+	}
+
+	objects.doState(stream);
+	for (auto& object : objects) {
+		if (stream.hasFailed()) {
+			break;
+		}
+
+		bool hasData = object.data != nullptr;
+		stream.value(hasData);
+		if (hasData) {
+			doObjectState(stream, object, oldObjects, reusedFiles);
+		}
+	}
+
+	if (stream.isReading()) {
+		// Resource limits live inside their process, so they can only be linked up once every process exists
+		for (auto& object : objects) {
+			if (object.type == KernelObjectType::Process && object.data != nullptr) {
+				ResourceLimits& limits = object.getData<Process>()->limits;
+				if (KernelObject* limitObject = objects.get(limits.handle, KernelObjectType::ResourceLimit); limitObject != nullptr) {
+					limitObject->data = &limits;
+				}
+			}
+		}
+
+		// Close the host files nothing uses anymore. Cloned file sessions share their fd with the original
+		FSService& fs = serviceManager.getFS();
+		for (auto& object : oldObjects) {
+			if (object.type == KernelObjectType::File && object.data != nullptr) {
+				FileSession* file = object.getData<FileSession>();
+				if (file->fd != nullptr && reusedFiles.insert(file->fd).second) {
+					fs.getWriteBackCache().untrack(file->fd);
+					fclose(file->fd);
+				}
+			}
+
+			deleteObjectData(object);
+		}
+
+		// Host I/O from before the load belongs to the old state, and the scheduler events that poll it have been replaced by the loaded ones
+		asyncIO.reset();
+		rebuildWaitQueues();
+	}
+
+	serviceManager.doState(stream);
+}
+
+void Kernel::doObjectState(SaveStateStream& stream, KernelObject& object, HandleTable& oldObjects, std::unordered_set<FILE*>& reusedFiles) {
+	const bool reading = stream.isReading();
+	FSService& fs = serviceManager.getFS();
+
+	// Archives are members of the FS service, saved as an index into its archive list
+	const auto doArchive = [&](ArchiveBase*& archive) {
+		u32 index = 0xFFFFFFFF;
+		if (!reading) {
+			index = fs.getArchiveIndex(archive).value_or(0xFFFFFFFF);
+		}
+
+		stream.value(index);
+		if (reading) {
+			archive = fs.getArchiveFromIndex(index);
+			if (archive == nullptr) {
+				stream.fail();
+			}
+		}
+	};
+
+	switch (object.type) {
+		case KernelObjectType::AddressArbiter: objectData<AddressArbiter>(stream, *this, object); break;
+
+		case KernelObjectType::Archive: {
+			auto session = objectData<ArchiveSession>(stream, *this, object, nullptr, FSPath());
+			doArchive(session->archive);
+			doPathState(stream, session->path);
+			stream.value(session->isOpen);
+			break;
+		}
+
+		case KernelObjectType::Directory: {
+			auto session = objectData<DirectorySession>(stream, *this, object, nullptr, std::nullopt, std::vector<DirectoryEntry>(), 0, false);
+
+			doArchive(session->archive);
+			bool hasPathOnDisk = session->pathOnDisk.has_value();
+			std::filesystem::path pathOnDisk = session->pathOnDisk.value_or(std::filesystem::path());
+			stream.value(hasPathOnDisk);
+			stream.path(pathOnDisk);
+			if (reading) {
+				session->pathOnDisk = hasPathOnDisk ? std::optional(pathOnDisk) : std::nullopt;
+			}
+
+			stream.value(session->currentEntry);
+			stream.value(session->isOpen);
+
+			const u32 entryCount = stream.count(session->entries.size(), sizeof(bool));
+			if (reading) {
+				session->entries.resize(entryCount);
+			}
+
+			for (auto& entry : session->entries) {
+				stream.path(entry.path);
+				stream.value(entry.isDirectory);
+			}
+			break;
+		}
+
+		case KernelObjectType::Event: {
+			auto event = objectData<Event>(stream, *this, object, ResetType::OneShot);
+			stream.value(event->resetType);
+			stream.value(event->callback);
+			stream.value(event->fired);
+			break;
+		}
+
+		case KernelObjectType::File: {
+			auto file = objectData<FileSession>(stream, *this, object, nullptr, FSPath(), FSPath(), nullptr);
+			bool hadDescriptor = file->fd != nullptr;
+
+			doArchive(file->archive);
+			doPathState(stream, file->path);
+			doPathState(stream, file->archivePath);
+			stream.value(file->priority);
+			stream.value(file->openFlags);
+			stream.value(file->isOpen);
+			stream.value(hadDescriptor);
+
+			if (!reading || !file->isOpen || !hadDescriptor || file->archive == nullptr) {
+				break;
+			}
+
+			// Take over the host file of the session that had this handle before loading if it's the same file
+			if (KernelObject* oldObject = oldObjects.get(object.handle, KernelObjectType::File); oldObject != nullptr) {
+				const FileSession* oldFile = oldObject->getData<FileSession>();
+
+				if (oldFile != nullptr && oldFile->fd != nullptr && oldFile->isOpen && oldFile->archive == file->archive &&
+					oldFile->openFlags == file->openFlags && samePath(oldFile->path, file->path)) {
+					file->fd = oldFile->fd;
+					reusedFiles.insert(file->fd);
+					break;
+				}
+			}
+
+			// Otherwise reopen it. Save data was flushed before the state was made, but anything written since then stays written
+			const FileDescriptor opened = file->archive->openFile(file->path, FilePerms(file->openFlags));
+			if (opened.has_value()) {
+				file->fd = opened.value();
+			} else {
+				Helpers::warn("Kernel: Failed to reopen a file while loading a save state");
+				file->isOpen = false;
+			}
+			break;
+		}
+
+		case KernelObjectType::MemoryBlock: {
+			auto block = objectData<MemoryBlock>(stream, *this, object, 0, 0, 0, 0);
+			stream.value(*block);
+			break;
+		}
+
+		case KernelObjectType::Port: {
+			auto port = objectData<Port>(stream, *this, object, "");
+			stream.value(port->name);
+			stream.value(port->isPublic);
+			port->name[Port::maxNameLen] = '\0';
+			break;
+		}
+
+		case KernelObjectType::Process: {
+			auto process = objectData<Process>(stream, *this, object, 0);
+			stream.value(process->id);
+			stream.value(process->limits.handle);
+			stream.value(process->limits.currentCommit);
+			break;
+		}
+
+		// Linked to its process once every object has been loaded
+		case KernelObjectType::ResourceLimit: break;
+
+		case KernelObjectType::Session: {
+			auto session = objectData<Session>(stream, *this, object, 0);
+			stream.value(session->portHandle);
+			break;
+		}
+
+		case KernelObjectType::Mutex: {
+			auto mutex = objectData<Mutex>(stream, *this, object, false, object.handle);
+			stream.value(mutex->ownerThread);
+			stream.value(mutex->handle);
+			stream.value(mutex->lockCount);
+			stream.value(mutex->locked);
+			break;
+		}
+
+		case KernelObjectType::Semaphore: {
+			auto semaphore = objectData<Semaphore>(stream, *this, object, 0, 0);
+			stream.value(semaphore->availableCount);
+			stream.value(semaphore->maximumCount);
+			break;
+		}
+
+		case KernelObjectType::Timer: {
+			auto timer = objectData<Timer>(stream, *this, object, ResetType::OneShot);
+			stream.value(timer->resetType);
+			stream.value(timer->fireTick);
+			stream.value(timer->interval);
+			stream.value(timer->fired);
+			stream.value(timer->running);
+			break;
+		}
+
+		// Thread objects point into our thread array
+		case KernelObjectType::Thread: {
+			int index = reading ? 0 : object.getData<Thread>()->index;
+			stream.value(index);
+
+			if (reading) {
+				if (index < 0 || index >= int(threads.size())) {
+					stream.fail();
+				} else {
+					object.data = &threads[index];
+				}
+			}
+			break;
+		}
+
+		default: stream.fail(); break;
+	}
+}
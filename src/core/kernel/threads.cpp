@@ -1,4 +1,3 @@
-#include <bit>
 #include <cassert>
 #include <cstring>
 
@@ -14,6 +13,8 @@
 void Kernel::switchThread(int newThreadIndex) {
 	auto& oldThread = threads[currentThreadIndex];
 	auto& newThread = threads[newThreadIndex];
+	// Threads only get picked while still waiting if their wait timed out, in which case they stop waiting on their objects
+	removeWaiter(newThread);
 	newThread.status = ThreadStatus::Running;
 	logThread("Switching from thread %d to %d\n", currentThreadIndex, newThreadIndex);
 
@@ -130,7 +131,7 @@ Handle Kernel::makeThread(u32 entrypoint, u32 initialSP, u32 priority, Processor
 	threadIndices.push_back(index);
 	Thread& t = threads[index]; // Reference to thread data
 	Handle ret = makeObject(KernelObjectType::Thread);
-	objects[ret].data = &t;
+	getObject(ret)->data = &t;
 
 	const bool isThumb = (entrypoint & 1) != 0; // Whether the thread starts in thumb mode or not
 
@@ -149,8 +150,8 @@ Handle Kernel::makeThread(u32 entrypoint, u32 initialSP, u32 priority, Processor
 	t.processorID = id;
 	t.status = status;
 	t.handle = ret;
+	t.handleClosed = false;
 	t.waitingAddress = 0;
-	t.threadsWaitingForTermination = 0; // Thread just spawned, no other threads waiting for it to terminate
 
 	t.cpsr = CPSR::UserMode | (isThumb ? CPSR::Thumb : 0);
 	t.fpscr = FPSCR::ThreadDefault;
@@ -163,11 +164,10 @@ Handle Kernel::makeThread(u32 entrypoint, u32 initialSP, u32 priority, Processor
 
 Handle Kernel::makeMutex(bool locked) {
 	Handle ret = makeObject(KernelObjectType::Mutex);
-	objects[ret].data = new Mutex(locked, ret);
+	Mutex* moo = allocateObjectData<Mutex>(ret, locked, ret);
 
 	// If the mutex is initially locked, store the index of the thread that owns it and set lock count to 1
 	if (locked) {
-		Mutex* moo = objects[ret].getData<Mutex>();
 		moo->ownerThread = currentThreadIndex;
 	}
 
@@ -187,14 +187,11 @@ void Kernel::releaseMutex(Mutex* moo) {
 	if (moo->lockCount == 0) {
 		moo->locked = false;
 
-		if (moo->waitlist != 0) {
-			int index = wakeupOneThread(moo->waitlist, moo->handle); // Wake up one thread and get its index
-			moo->waitlist ^= (1ull << index); // Remove thread from waitlist
-
-			// Have new thread acquire mutex
+		// Wake up one thread and have it acquire the mutex
+		if (auto index = wakeupOneThread(getObject(moo->handle)); index.has_value()) {
 			moo->locked = true;
 			moo->lockCount = 1;
-			moo->ownerThread = index;
+			moo->ownerThread = index.value();
 		}
 
 		requireReschedule();
@@ -203,7 +200,7 @@ void Kernel::releaseMutex(Mutex* moo) {
 
 Handle Kernel::makeSemaphore(u32 initialCount, u32 maximumCount) {
 	Handle ret = makeObject(KernelObjectType::Semaphore);
-	objects[ret].data = new Semaphore(initialCount, maximumCount);
+	allocateObjectData<Semaphore>(ret, initialCount, maximumCount);
 
 	return ret;
 }
@@ -212,6 +209,7 @@ void Kernel::sleepThreadOnArbiter(u32 waitingAddress) {
 	Thread& t = threads[currentThreadIndex];
 	t.status = ThreadStatus::WaitArbiter;
 	t.waitingAddress = waitingAddress;
+	addWaiter(t);
 
 	requireReschedule();
 }
@@ -267,90 +265,6 @@ void Kernel::acquireSyncObject(KernelObject* object, const Thread& thread) {
 	}
 }
 
-// Wake up one of the threads in the waitlist (the one with highest prio) and return its index
-// Must not be called with an empty waitlist
-int Kernel::wakeupOneThread(u64 waitlist, Handle handle) {
-	if (waitlist == 0) [[unlikely]]
-		Helpers::panic("[Internal error] It shouldn't be possible to call wakeupOneThread when there's 0 threads waiting!");
-
-	// Find the waiting thread with the highest priority.
-	// We do this by first picking the first thread in the waitlist, then checking each other thread and comparing priority
-	int threadIndex = std::countr_zero(waitlist);    // Index of first thread
-	int maxPriority = threads[threadIndex].priority; // Set initial max prio to the prio of the first thread
-	waitlist ^= (1ull << threadIndex); // Remove thread from the waitlist
-
-	while (waitlist != 0) {
-		int newThread = std::countr_zero(waitlist); // Get new thread and evaluate whether it has a higher priority
-		if (threads[newThread].priority < maxPriority) { // Low priority value means high priority
-			threadIndex = newThread;
-			maxPriority = threads[newThread].priority;
-		}
-
-		waitlist ^= (1ull << threadIndex); // Remove thread from waitlist
-	}
-
-	Thread& t = threads[threadIndex];
-	switch (t.status) {
-		case ThreadStatus::WaitSync1:
-			t.status = ThreadStatus::Ready;
-			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
-			break;
-
-		case ThreadStatus::WaitSyncAny:
-			t.status = ThreadStatus::Ready;
-			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
-
-			// Get the index of the event in the object's waitlist, write it to r1
-			for (size_t i = 0; i < t.waitList.size(); i++) {
-				if (t.waitList[i] == handle) {
-					t.gprs[1] = u32(i);
-					break;
-				}
-			}
-			break;
-
-		case ThreadStatus::WaitSyncAll:
-			Helpers::panic("WakeupOneThread: Thread on WaitSyncAll");
-			break;
-	}
-
-	return threadIndex;
-}
-
-// Wake up every single thread in the waitlist using a bit scanning algorithm
-void Kernel::wakeupAllThreads(u64 waitlist, Handle handle) {
-	while (waitlist != 0) {
-		const uint index = std::countr_zero(waitlist); // Get one of the set bits to see which thread is waiting
-		waitlist ^= (1ull << index); // Remove thread from waitlist by toggling its bit
-
-		// Get the thread we'll be signalling
-		Thread& t = threads[index];
-		switch (t.status) {
-		case ThreadStatus::WaitSync1:
-			t.status = ThreadStatus::Ready;
-			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
-			break;
-
-		case ThreadStatus::WaitSyncAny:
-			t.status = ThreadStatus::Ready;
-			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
-
-			// Get the index of the event in the object's waitlist, write it to r1
-			for (size_t i = 0; i < t.waitList.size(); i++) {
-				if (t.waitList[i] == handle) {
-					t.gprs[1] = u32(i);
-					break;
-				}
-			}
-			break;
-
-		case ThreadStatus::WaitSyncAll:
-			Helpers::panic("WakeupAllThreads: Thread on WaitSyncAll");
-			break;
-		}
-	}
-}
-
 // Make a thread sleep for a certain amount of nanoseconds at minimum
 void Kernel::sleepThread(s64 ns) {
 	if (ns < 0) {
@@ -422,7 +336,7 @@ void Kernel::createThread() {
 	}
 
 	regs[0] = Result::Success;
-	regs[1] = makeThread(entrypoint, initialSP, priority, static_cast<ProcessorID>(id), arg, ThreadStatus::Ready);
+	regs[1] = giveToGuest(makeThread(entrypoint, initialSP, priority, static_cast<ProcessorID>(id), arg, ThreadStatus::Ready));
 	requireReschedule();
 }
 
@@ -509,7 +423,12 @@ void Kernel::setThreadPriority() {
 			return;
 		} else {
 			regs[0] = Result::Success;
-			object->getData<Thread>()->priority = priority;
+
+			// Waiting threads are queued by priority, so requeue the thread with its new one
+			Thread* t = object->getData<Thread>();
+			removeWaiter(*t);
+			t->priority = priority;
+			addWaiter(*t);
 		}
 	}
 	sortThreads();
@@ -575,10 +494,13 @@ void Kernel::exitThread() {
 
 	// Check if any threads are sleeping, waiting for this thread to terminate, and wake them up
 	// This is how thread joining is implemented in the kernel - you wait on a thread, like any other wait object.
-	if (t.threadsWaitingForTermination != 0) {
-		// TODO: Handle cloned handles? Not sure how those interact with wait object signalling
-		wakeupAllThreads(t.threadsWaitingForTermination, t.handle);
-		t.threadsWaitingForTermination = 0; // No other threads waiting
+	// Threads waiting on duplicated handles of this thread are in the same queue, as queues are keyed by object data
+	wakeupAllThreads(getObject(t.handle));
+
+	// If the guest already closed the handle of the thread, nothing can refer to its object anymore
+	if (t.handleClosed) {
+		t.handleClosed = false;
+		destroyObject(t.handle);
 	}
 
 	requireReschedule();
@@ -589,7 +511,7 @@ void Kernel::svcCreateMutex() {
 	logSVC("CreateMutex (locked = %s)\n", locked ? "yes" : "no");
 
 	regs[0] = Result::Success;
-	regs[1] = makeMutex(locked);
+	regs[1] = giveToGuest(makeMutex(locked));
 }
 
 void Kernel::svcReleaseMutex() {
@@ -626,7 +548,7 @@ void Kernel::svcCreateSemaphore() {
 		Helpers::panic("CreateSemaphore: Negative count value");
 
 	regs[0] = Result::Success;
-	regs[1] = makeSemaphore(initialCount, maxCount);
+	regs[1] = giveToGuest(makeSemaphore(initialCount, maxCount));
 }
 
 void Kernel::svcReleaseSemaphore() {
@@ -654,11 +576,8 @@ void Kernel::svcReleaseSemaphore() {
 	// Bump available count
 	s->availableCount += releaseCount;
 
-	// Wake up threads one by one until the available count hits 0 or we run out of threads to wake up
-	while (s->availableCount > 0 && s->waitlist != 0) {
-		int index = wakeupOneThread(s->waitlist, handle); // Wake up highest priority thread
-		s->waitlist ^= (1ull << index); // Remove thread from waitlist
-
+	// Wake up threads one by one, highest priority first, until the available count hits 0 or we run out of threads to wake up
+	while (s->availableCount > 0 && wakeupOneThread(object).has_value()) {
 		s->availableCount--; // Decrement available count
 	}
 }
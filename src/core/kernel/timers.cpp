@@ -6,7 +6,7 @@
 
 Handle Kernel::makeTimer(ResetType type) {
 	Handle ret = makeObject(KernelObjectType::Timer);
-	objects[ret].data = new Timer(type);
+	allocateObjectData<Timer>(ret, type);
 
 	if (type == ResetType::Pulse) {
 		Helpers::panic("Created pulse timer");
@@ -61,9 +61,9 @@ void Kernel::signalTimer(Handle timerHandle, Timer* timer) {
 	requireReschedule();
 
 	// Check if there's any thread waiting on this event
-	if (timer->waitlist != 0) {
-		wakeupAllThreads(timer->waitlist, timerHandle);
-		timer->waitlist = 0;  // No threads waiting;
+	KernelObject* object = getObject(timerHandle);
+	if (hasWaiters(object)) {
+		wakeupAllThreads(object);
 
 		switch (timer->resetType) {
 			case ResetType::OneShot: timer->fired = false; break;
@@ -90,7 +90,7 @@ void Kernel::svcCreateTimer() {
 
 	logSVC("CreateTimer (resetType = %s)\n", resetTypeToString(resetType));
 	regs[0] = Result::Success;
-	regs[1] = makeTimer(static_cast<ResetType>(resetType));
+	regs[1] = giveToGuest(makeTimer(static_cast<ResetType>(resetType)));
 }
 
 void Kernel::svcSetTimer() {
@@ -0,0 +1,117 @@
+#include "kernel.hpp"
+
+namespace {
+	template <typename Key>
+	void removeFromQueue(std::unordered_map<Key, WaitQueue>& queues, const Key& key, int threadIndex) {
+		auto it = queues.find(key);
+		if (it != queues.end()) {
+			it->second.remove(threadIndex);
+
+			if (it->second.empty()) {
+				queues.erase(it);
+			}
+		}
+	}
+}  // namespace
+
+void Kernel::addWaiter(Thread& t) {
+	switch (t.status) {
+		case ThreadStatus::WaitArbiter: arbiterWaitQueues[t.waitingAddress].push({t.priority, t.index, 0}); break;
+
+		case ThreadStatus::WaitSync1:
+		case ThreadStatus::WaitSyncAny:
+		case ThreadStatus::WaitSyncAll:
+			for (usize i = 0; i < t.waitList.size(); i++) {
+				const KernelObject* object = getObject(t.waitList[i]);
+				if (object != nullptr && object->data != nullptr) {
+					objectWaitQueues[object->data].push({t.priority, t.index, u32(i)});
+				}
+			}
+			break;
+
+		default: break;
+	}
+}
+
+void Kernel::removeWaiter(Thread& t) {
+	switch (t.status) {
+		case ThreadStatus::WaitArbiter: removeFromQueue(arbiterWaitQueues, t.waitingAddress, t.index); break;
+
+		case ThreadStatus::WaitSync1:
+		case ThreadStatus::WaitSyncAny:
+		case ThreadStatus::WaitSyncAll:
+			for (Handle handle : t.waitList) {
+				const KernelObject* object = getObject(handle);
+				if (object != nullptr) {
+					removeFromQueue<const void*>(objectWaitQueues, object->data, t.index);
+				}
+			}
+			break;
+
+		default: break;
+	}
+}
+
+// The queues aren't part of save states. Threads of the same priority might come back in a different order than they started waiting in,
+// which the guest can't tell apart from them having started waiting in that order
+void Kernel::rebuildWaitQueues() {
+	arbiterWaitQueues.clear();
+	objectWaitQueues.clear();
+
+	for (int index : threadIndices) {
+		addWaiter(threads[index]);
+	}
+}
+
+// Wakes up a thread that was waiting on a sync object, writing the result of its wait to its registers
+void Kernel::wakeupWaiter(const WaitQueue::Waiter& waiter) {
+	Thread& t = threads[waiter.threadIndex];
+	// Stop waiting on every other object in the thread's wait list
+	removeWaiter(t);
+
+	switch (t.status) {
+		case ThreadStatus::WaitSync1:
+			t.status = ThreadStatus::Ready;
+			t.gprs[0] = Result::Success;  // The thread did not timeout, so write success to r0
+			break;
+
+		case ThreadStatus::WaitSyncAny:
+			t.status = ThreadStatus::Ready;
+			t.gprs[0] = Result::Success;  // The thread did not timeout, so write success to r0
+			t.gprs[1] = waiter.waitIndex;  // Index of the object that woke the thread up in its wait list
+			break;
+
+		case ThreadStatus::WaitSyncAll: Helpers::panic("WakeupWaiter: Thread on WaitSyncAll"); break;
+		default: break;
+	}
+}
+
+std::optional<int> Kernel::wakeupOneThread(KernelObject* object) {
+	auto it = objectWaitQueues.find(object->data);
+	if (it == objectWaitQueues.end()) {
+		return std::nullopt;
+	}
+
+	const WaitQueue::Waiter waiter = it->second.pop();
+	if (it->second.empty()) {
+		objectWaitQueues.erase(it);
+	}
+
+	wakeupWaiter(waiter);
+	return waiter.threadIndex;
+}
+
+void Kernel::wakeupAllThreads(KernelObject* object) {
+	auto it = objectWaitQueues.find(object->data);
+	if (it == objectWaitQueues.end()) {
+		return;
+	}
+
+	// Take the whole queue first, as waking threads up removes them from the queues they were waiting on
+	const WaitQueue queue = std::move(it->second);
+	objectWaitQueues.erase(it);
+
+	for (const auto& waiter : queue) {
+		wakeupWaiter(waiter);
+	}
+}
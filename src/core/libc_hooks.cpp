@@ -0,0 +1,185 @@
+#include "libc_hooks.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "memory.hpp"
+
+namespace {
+	// Rough cost of the guest routines, so that replacing them doesn't make the guest see loads finish in no time
+	constexpr u64 callOverheadCycles = 20;
+	constexpr u64 copyCyclesPerByte = 2;  // Word copies, with a load, a store and loop overhead per word
+	constexpr u64 fillBytesPerCycle = 4;
+	constexpr u64 strlenCyclesPerByte = 3;
+
+	// Copies are staged through a host buffer in chunks of this size
+	constexpr u32 copyChunkSize = 64 * 1024;
+}  // namespace
+
+std::optional<LibcHooks::Function> LibcHooks::functionFromSymbol(std::string_view name) {
+	// The AEABI copies take the same arguments as memcpy and memmove, and the aligned variants only promise more about their arguments
+	if (name.starts_with("__aeabi_") && (name.ends_with('4') || name.ends_with('8'))) {
+		name.remove_suffix(1);
+	}
+
+	if (name == "memcpy" || name == "__aeabi_memcpy") return Function::Memcpy;
+	if (name == "memmove" || name == "__aeabi_memmove") return Function::Memmove;
+	if (name == "memset") return Function::Memset;
+	if (name == "__aeabi_memset") return Function::AeabiMemset;
+	if (name == "__aeabi_memclr") return Function::AeabiMemclr;
+	if (name == "strlen") return Function::Strlen;
+	return std::nullopt;
+}
+
+const char* LibcHooks::functionName(Function function) {
+	switch (function) {
+		case Function::Memcpy: return "memcpy";
+		case Function::Memmove: return "memmove";
+		case Function::Memset: return "memset";
+		case Function::AeabiMemset: return "__aeabi_memset";
+		case Function::AeabiMemclr: return "__aeabi_memclr";
+		case Function::Strlen: return "strlen";
+		default: return "Invalid";
+	}
+}
+
+void LibcHooks::patchEntry(u8* entry, Function function) {
+	// svc #(svcBase + function)
+	const u32 svc = 0xEF000000 | (svcBase + u32(function));
+	std::memcpy(entry, &svc, sizeof(u32));
+}
+
+u32 LibcHooks::printSummary(const PatchCounts& counts) {
+	u32 total = 0;
+	std::string routines;
+
+	for (usize i = 0; i < counts.size(); i++) {
+		if (counts[i] != 0) {
+			total += counts[i];
+			routines += (routines.empty() ? "" : ", ") + std::string(functionName(static_cast<Function>(i))) + " x" + std::to_string(counts[i]);
+		}
+	}
+
+	if (total != 0) {
+		printf("LibcHooks: Hooked %u routines (%s)\n", total, routines.c_str());
+	}
+
+	return total;
+}
+
+u32 LibcHooks::patchSymbols(std::span<const Symbol> symbols, const std::function<u8*(u32 address)>& getCode) {
+	PatchCounts counts{};
+
+	for (const auto& symbol : symbols) {
+		const auto function = functionFromSymbol(symbol.name);
+		if (!function.has_value() || (symbol.address & 3) != 0) {
+			continue;
+		}
+
+		if (u8* entry = getCode(symbol.address); entry != nullptr) {
+			patchEntry(entry, function.value());
+			counts[usize(function.value())]++;
+		}
+	}
+
+	return printSummary(counts);
+}
+
+u64 LibcHooks::call(u32 svc, std::span<u32, 16> regs, Memory& mem) {
+	const auto function = static_cast<Function>(svc - svcBase);
+
+	switch (function) {
+		case Function::Memcpy:
+		case Function::Memmove: {
+			const u32 dest = regs[0];
+			const u32 source = regs[1];
+			const u32 size = regs[2];
+
+			scratch.resize(std::min(size, copyChunkSize));
+
+			// Each chunk is read in full before it's written. Copying away from the overlap, front to back when the destination is below
+			// the source and back to front otherwise, means no chunk overwrites source bytes that haven't been read yet, which gives
+			// memmove semantics with a bounded buffer
+			const bool backwards = dest > source;
+			for (u32 copied = 0; copied < size;) {
+				const u32 count = std::min(size - copied, copyChunkSize);
+				const u32 offset = backwards ? size - copied - count : copied;
+
+				mem.readBlock(source + offset, scratch.data(), count);
+				mem.writeBlock(dest + offset, scratch.data(), count);
+				copied += count;
+			}
+
+			// r0 already holds dest, which is the return value
+			return callOverheadCycles + u64(size) * copyCyclesPerByte;
+		}
+
+		case Function::Memset:
+		case Function::AeabiMemset:
+		case Function::AeabiMemclr: {
+			u32 dest = regs[0];
+			u32 size;
+			u8 value;
+
+			if (function == Function::Memset) {
+				value = u8(regs[1]);
+				size = regs[2];
+			} else {
+				size = regs[1];
+				value = (function == Function::AeabiMemset) ? u8(regs[2]) : 0;
+			}
+
+			const u64 cycles = callOverheadCycles + size / fillBytesPerCycle;
+			while (size != 0) {
+				const u32 count = std::min<u32>(size, Memory::pageSize - (dest & Memory::pageMask));
+				u8* pointer = static_cast<u8*>(mem.getWritePointer(dest));
+
+				if (pointer != nullptr) [[likely]] {
+					std::memset(pointer, value, count);
+				} else {
+					for (u32 i = 0; i < count; i++) {
+						mem.write8(dest + i, value);
+					}
+				}
+
+				dest += count;
+				size -= count;
+			}
+
+			return cycles;
+		}
+
+		case Function::Strlen: {
+			const u32 string = regs[0];
+			u32 address = string;
+
+			while (true) {
+				const u32 count = Memory::pageSize - (address & Memory::pageMask);
+				const u8* pointer = static_cast<const u8*>(mem.getReadPointer(address));
+
+				if (pointer != nullptr) [[likely]] {
+					const void* terminator = std::memchr(pointer, 0, count);
+					if (terminator != nullptr) {
+						address += u32(static_cast<const u8*>(terminator) - pointer);
+						break;
+					}
+
+					address += count;
+				} else {
+					// Pages outside the page tables go through read8, like the guest's own loads would
+					while (mem.read8(address) != 0) {
+						address++;
+					}
+					break;
+				}
+			}
+
+			const u32 length = address - string;
+			regs[0] = length;
+			return callOverheadCycles + u64(length) * strlenCyclesPerByte;
+		}
+
+		default: Helpers::panic("LibcHooks: Invalid hook SVC %06X", svc);
+	}
+}
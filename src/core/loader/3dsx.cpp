@@ -283,20 +283,27 @@ std::optional<u32> Memory::load3DSX(const std::filesystem::path& path) {
 		return std::nullopt;
 	}
 
+	if (!asyncROMFile.open(path, "rb")) {
+		printf("Failed to open 3DSX for async I/O\n");
+		return std::nullopt;
+	}
+
 	loaded3DSX = std::move(hb3dsx);
 	return HB3DSX::entrypoint;
 }
 
 bool HB3DSX::hasRomFs() const { return romFSSize != 0 && romFSOffset != 0; }
 
-std::pair<bool, std::size_t> HB3DSX::readRomFSBytes(void* dst, std::size_t offset, std::size_t size) {
+std::pair<bool, std::size_t> HB3DSX::readRomFSBytes(void* dst, std::size_t offset, std::size_t size) { return readRomFSBytes(file, dst, offset, size); }
+
+std::pair<bool, std::size_t> HB3DSX::readRomFSBytes(IOFile& romFile, void* dst, std::size_t offset, std::size_t size) {
 	if (!hasRomFs()) {
 		return {false, 0};
 	}
 
-	if (!file.seek(romFSOffset + offset)) {
+	if (!romFile.seek(romFSOffset + offset)) {
 		return {false, 0};
 	}
 
-	return file.readBytes(dst, size);
+	return romFile.readBytes(dst, size);
 }
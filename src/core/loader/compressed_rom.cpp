@@ -0,0 +1,462 @@
+#include "loader/compressed_rom.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace CompressedROM::Codec {
+	static constexpr usize minMatch = 4;
+	// The LZ4 block format requires the last 5 bytes to be literals and the last match to start at least 12 bytes before the end
+	static constexpr usize lastLiterals = 5;
+	static constexpr usize matchFindLimit = 12;
+	static constexpr usize maxOffset = 65535;
+
+	static constexpr u32 hashLog = 14;
+	static constexpr u32 hashTableSize = 1u << hashLog;
+
+	static inline u32 read32(const u8* ptr) {
+		u32 value;
+		std::memcpy(&value, ptr, sizeof(u32));
+		return value;
+	}
+
+	static inline u32 hash(u32 sequence) { return (sequence * 2654435761u) >> (32 - hashLog); }
+
+	// Writes a length that didn't fit in the 4 bits of the token as a run of 255s followed by the remainder
+	static inline u8* writeExtendedLength(u8* out, usize length) {
+		while (length >= 255) {
+			*out++ = 255;
+			length -= 255;
+		}
+
+		*out++ = u8(length);
+		return out;
+	}
+
+	static inline u8* writeLiterals(u8* out, u8* token, const u8* literals, usize count) {
+		if (count >= 15) {
+			*token = 15 << 4;
+			out = writeExtendedLength(out, count - 15);
+		} else {
+			*token = u8(count << 4);
+		}
+
+		std::memcpy(out, literals, count);
+		return out + count;
+	}
+
+	usize compress(const u8* src, usize size, u8* dst) {
+		const u8* ip = src;
+		const u8* anchor = src;
+		const u8* const end = src + size;
+		u8* op = dst;
+
+		if (size > matchFindLimit) {
+			const u8* const matchLimit = end - lastLiterals;
+			const u8* const inputLimit = end - matchFindLimit;
+			// Positions are stored relative to src, so 0 doubles as "empty" and gets rejected by the ref < ip check
+			std::vector<u32> table(hashTableSize, 0);
+
+			while (ip < inputLimit) {
+				const u32 sequence = read32(ip);
+				const u32 h = hash(sequence);
+				const u8* ref = src + table[h];
+				table[h] = u32(ip - src);
+
+				if (ref >= ip || usize(ip - ref) > maxOffset || read32(ref) != sequence) {
+					ip++;
+					continue;
+				}
+
+				// Extend the match backwards into the pending literals, then forwards as far as the format allows
+				while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+					ip--;
+					ref--;
+				}
+
+				usize matchLength = minMatch;
+				while (ip + matchLength < matchLimit && ip[matchLength] == ref[matchLength]) {
+					matchLength++;
+				}
+
+				u8* token = op++;
+				op = writeLiterals(op, token, anchor, usize(ip - anchor));
+
+				const usize offset = usize(ip - ref);
+				*op++ = u8(offset & 0xff);
+				*op++ = u8(offset >> 8);
+
+				const usize encodedLength = matchLength - minMatch;
+				if (encodedLength >= 15) {
+					*token |= 15;
+					op = writeExtendedLength(op, encodedLength - 15);
+				} else {
+					*token |= u8(encodedLength);
+				}
+
+				ip += matchLength;
+				anchor = ip;
+
+				// Seed the table with the position right before the match end so back-to-back matches are found quickly
+				if (ip - 2 > src && ip < inputLimit) {
+					table[hash(read32(ip - 2))] = u32(ip - 2 - src);
+				}
+			}
+		}
+
+		// Final sequence only has literals
+		u8* token = op++;
+		op = writeLiterals(op, token, anchor, usize(end - anchor));
+		return usize(op - dst);
+	}
+
+	// Reads the extra bytes of a length whose token nibble was 15. Returns false if the input ends in the middle of it
+	static inline bool readExtendedLength(const u8*& ip, const u8* end, usize& length) {
+		u8 byte;
+		do {
+			if (ip >= end) {
+				return false;
+			}
+
+			byte = *ip++;
+			length += byte;
+		} while (byte == 255);
+
+		return true;
+	}
+
+	bool decompress(const u8* src, usize srcSize, u8* dst, usize dstSize) {
+		const u8* ip = src;
+		const u8* const inputEnd = src + srcSize;
+		u8* op = dst;
+		u8* const outputEnd = dst + dstSize;
+
+		while (ip < inputEnd) {
+			const u8 token = *ip++;
+
+			usize literalCount = token >> 4;
+			if (literalCount == 15 && !readExtendedLength(ip, inputEnd, literalCount)) {
+				return false;
+			}
+
+			if (literalCount > usize(inputEnd - ip) || literalCount > usize(outputEnd - op)) {
+				return false;
+			}
+
+			std::memcpy(op, ip, literalCount);
+			ip += literalCount;
+			op += literalCount;
+
+			// The last sequence has no match part
+			if (ip == inputEnd) {
+				break;
+			}
+
+			if (inputEnd - ip < 2) {
+				return false;
+			}
+
+			const usize offset = usize(ip[0]) | (usize(ip[1]) << 8);
+			ip += 2;
+			if (offset == 0 || offset > usize(op - dst)) {
+				return false;
+			}
+
+			usize matchLength = token & 0xf;
+			if (matchLength == 15 && !readExtendedLength(ip, inputEnd, matchLength)) {
+				return false;
+			}
+
+			matchLength += minMatch;
+			if (matchLength > usize(outputEnd - op)) {
+				return false;
+			}
+
+			const u8* match = op - offset;
+			if (offset >= matchLength) {
+				std::memcpy(op, match, matchLength);
+				op += matchLength;
+			} else {
+				// Overlapping match, used to encode runs. Has to be copied byte by byte
+				for (usize i = 0; i < matchLength; i++) {
+					*op++ = *match++;
+				}
+			}
+		}
+
+		return op == outputEnd;
+	}
+}  // namespace CompressedROM::Codec
+
+namespace CompressedROM {
+	static u64 getBlockCount(u64 size, u32 blockSize) { return (size + blockSize - 1) / blockSize; }
+
+	bool Reader::init(IOFile backingFile) {
+		file = backingFile;
+
+		if (!file.rewind()) {
+			return false;
+		}
+
+		auto [success, bytes] = file.readBytes(&header, sizeof(Header));
+		if (!success || bytes != sizeof(Header) || std::memcmp(header.magic, magic.data(), magic.size()) != 0) {
+			printf("Compressed ROM: Invalid header\n");
+			return false;
+		}
+
+		if (header.version != version) {
+			printf("Compressed ROM: Unsupported version %u\n", header.version);
+			return false;
+		}
+
+		if (header.blockSize < minBlockSize || header.blockSize > maxBlockSize ||
+			header.blockCount != getBlockCount(header.uncompressedSize, header.blockSize)) {
+			printf("Compressed ROM: Invalid block layout\n");
+			return false;
+		}
+
+		index.resize(header.blockCount);
+		std::tie(success, bytes) = file.read(index.data(), index.size(), sizeof(BlockEntry));
+		if (!success || bytes != index.size()) {
+			printf("Compressed ROM: Failed to read block index\n");
+			return false;
+		}
+
+		const u32 maxCompressedSize = u32(Codec::compressBound(header.blockSize));
+		for (const auto& entry : index) {
+			if (entry.compressedSize > maxCompressedSize) {
+				printf("Compressed ROM: Corrupted block index\n");
+				return false;
+			}
+		}
+
+		compressedBuffer.resize(maxCompressedSize);
+		for (auto& slot : cache) {
+			slot.lastUse = 0;
+			slot.data.clear();
+		}
+
+		useCounter = 0;
+		return true;
+	}
+
+	const u8* Reader::getBlock(u32 block) {
+		CacheSlot* victim = &cache[0];
+		for (auto& slot : cache) {
+			if (slot.lastUse != 0 && slot.block == block) {
+				slot.lastUse = ++useCounter;
+				return slot.data.data();
+			}
+
+			if (slot.lastUse < victim->lastUse) {
+				victim = &slot;
+			}
+		}
+
+		const BlockEntry& entry = index[block];
+		const u64 blockStart = u64(block) * header.blockSize;
+		const usize blockSize = usize(std::min<u64>(header.blockSize, header.uncompressedSize - blockStart));
+
+		// Invalidate the victim before touching its data so that a failed read can't leave a half-filled block in the cache
+		victim->lastUse = 0;
+		victim->data.resize(blockSize);
+
+		if (!file.seek(s64(entry.offset))) {
+			return nullptr;
+		}
+
+		if (entry.flags & BlockEntry::Stored) {
+			if (entry.compressedSize != blockSize) {
+				return nullptr;
+			}
+
+			auto [success, bytes] = file.readBytes(victim->data.data(), blockSize);
+			if (!success || bytes != blockSize) {
+				return nullptr;
+			}
+		} else {
+			auto [success, bytes] = file.readBytes(compressedBuffer.data(), entry.compressedSize);
+			if (!success || bytes != entry.compressedSize ||
+				!Codec::decompress(compressedBuffer.data(), entry.compressedSize, victim->data.data(), blockSize)) {
+				return nullptr;
+			}
+		}
+
+		victim->block = block;
+		victim->lastUse = ++useCounter;
+		return victim->data.data();
+	}
+
+	usize Reader::read(u64 offset, void* dst, usize size) {
+		std::scoped_lock lock(mutex);
+
+		if (offset >= header.uncompressedSize) {
+			return 0;
+		}
+
+		size = usize(std::min<u64>(size, header.uncompressedSize - offset));
+		u8* out = static_cast<u8*>(dst);
+		usize bytesRead = 0;
+
+		while (bytesRead < size) {
+			const u32 block = u32(offset / header.blockSize);
+			const usize offsetInBlock = usize(offset % header.blockSize);
+			const usize blockLength = usize(std::min<u64>(header.blockSize, header.uncompressedSize - u64(block) * header.blockSize));
+			const usize count = std::min(size - bytesRead, blockLength - offsetInBlock);
+
+			const u8* data = getBlock(block);
+			if (data == nullptr) {
+				Helpers::warn("Compressed ROM: Failed to decompress block %u", block);
+				break;
+			}
+
+			std::memcpy(out + bytesRead, data + offsetInBlock, count);
+			bytesRead += count;
+			offset += count;
+		}
+
+		return bytesRead;
+	}
+
+	bool isCompressed(IOFile& file) {
+		u8 fileMagic[4];
+		if (!file.rewind()) {
+			return false;
+		}
+
+		auto [success, bytes] = file.readBytes(fileMagic, sizeof(fileMagic));
+		file.rewind();
+
+		return success && bytes == sizeof(fileMagic) && std::memcmp(fileMagic, magic.data(), magic.size()) == 0;
+	}
+
+	bool openROM(IOFile& file, const std::filesystem::path& path) {
+		if (!file.open(path, "rb")) {
+			return false;
+		}
+
+		if (!isCompressed(file)) {
+			return true;
+		}
+
+		auto reader = std::make_shared<Reader>();
+		if (!reader->init(file)) {
+			file.close();
+			return false;
+		}
+
+		file.setCompressedReader(reader);
+		return true;
+	}
+
+	bool compressROM(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, u32 blockSize, const ProgressCallback& progress) {
+		if (blockSize < minBlockSize || blockSize > maxBlockSize) {
+			printf("Compressed ROM: Block size must be between %u and %u bytes\n", minBlockSize, maxBlockSize);
+			return false;
+		}
+
+		IOFile input(inputPath, "rb");
+		if (!input.isOpen()) {
+			printf("Compressed ROM: Failed to open %s\n", inputPath.string().c_str());
+			return false;
+		}
+
+		if (isCompressed(input)) {
+			printf("Compressed ROM: %s is already compressed\n", inputPath.string().c_str());
+			return false;
+		}
+
+		const auto inputSize = input.size();
+		if (!inputSize.has_value()) {
+			return false;
+		}
+
+		IOFile output(outputPath, "wb");
+		if (!output.isOpen()) {
+			printf("Compressed ROM: Failed to create %s\n", outputPath.string().c_str());
+			return false;
+		}
+
+		Header header{};
+		std::memcpy(header.magic, magic.data(), magic.size());
+		header.version = version;
+		header.blockSize = blockSize;
+		header.blockCount = u32(getBlockCount(inputSize.value(), blockSize));
+		header.uncompressedSize = inputSize.value();
+
+		// Reserve space for the header and index, which get written once all block offsets are known
+		std::vector<BlockEntry> index(header.blockCount);
+		u64 outputOffset = sizeof(Header) + index.size() * sizeof(BlockEntry);
+		if (!output.seek(s64(outputOffset))) {
+			return false;
+		}
+
+		// Blocks are compressed in batches, one block per worker thread, then written out in order
+		const usize workerCount = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::vector<u8>> rawBlocks(workerCount, std::vector<u8>(blockSize));
+		std::vector<std::vector<u8>> compressedBlocks(workerCount, std::vector<u8>(Codec::compressBound(blockSize)));
+		std::vector<usize> rawSizes(workerCount), compressedSizes(workerCount);
+		std::vector<std::thread> workers;
+
+		input.rewind();
+		for (u32 firstBlock = 0; firstBlock < header.blockCount; firstBlock += u32(workerCount)) {
+			const usize batchSize = std::min<usize>(workerCount, header.blockCount - firstBlock);
+
+			for (usize i = 0; i < batchSize; i++) {
+				const u64 blockStart = u64(firstBlock + i) * blockSize;
+				rawSizes[i] = usize(std::min<u64>(blockSize, header.uncompressedSize - blockStart));
+
+				auto [success, bytes] = input.readBytes(rawBlocks[i].data(), rawSizes[i]);
+				if (!success || bytes != rawSizes[i]) {
+					printf("Compressed ROM: Failed to read input at offset %llu\n", (unsigned long long)blockStart);
+					return false;
+				}
+			}
+
+			workers.clear();
+			for (usize i = 0; i < batchSize; i++) {
+				workers.emplace_back([&, i]() {
+					compressedSizes[i] = Codec::compress(rawBlocks[i].data(), rawSizes[i], compressedBlocks[i].data());
+				});
+			}
+
+			for (auto& worker : workers) {
+				worker.join();
+			}
+
+			for (usize i = 0; i < batchSize; i++) {
+				BlockEntry& entry = index[firstBlock + i];
+				const bool store = compressedSizes[i] >= rawSizes[i];
+				const u8* data = store ? rawBlocks[i].data() : compressedBlocks[i].data();
+
+				entry.offset = outputOffset;
+				entry.compressedSize = u32(store ? rawSizes[i] : compressedSizes[i]);
+				entry.flags = store ? BlockEntry::Stored : 0;
+
+				auto [success, bytes] = output.writeBytes(data, entry.compressedSize);
+				if (!success || bytes != entry.compressedSize) {
+					printf("Compressed ROM: Failed to write output\n");
+					return false;
+				}
+
+				outputOffset += entry.compressedSize;
+			}
+
+			if (progress) {
+				progress(std::min<u64>(u64(firstBlock + batchSize) * blockSize, header.uncompressedSize), header.uncompressedSize);
+			}
+		}
+
+		output.rewind();
+		auto [headerSuccess, headerBytes] = output.writeBytes(&header, sizeof(Header));
+		auto [indexSuccess, indexBytes] = output.write(index.data(), index.size(), sizeof(BlockEntry));
+		if (!headerSuccess || headerBytes != sizeof(Header) || !indexSuccess || indexBytes != index.size()) {
+			printf("Compressed ROM: Failed to write block index\n");
+			return false;
+		}
+
+		output.close();
+		input.close();
+		return true;
+	}
+}  // namespace CompressedROM
@@ -1,6 +1,8 @@
 #include "memory.hpp"
 
 #include <cstring>
+#include <vector>
+
 #include "elfio/elfio.hpp"
 
 using namespace ELFIO;
@@ -21,6 +23,37 @@ std::optional<u32> Memory::loadELF(std::ifstream& file) {
 		return std::nullopt;
 	}
 
+    // Homebrew ELFs usually keep their symbol table, which tells us where the libc routines we replace are
+    std::vector<LibcHooks::Symbol> functionSymbols;
+    if (config.hleLibcHooks) {
+        for (Elf_Half sectionIndex = 0; sectionIndex < reader.sections.size(); sectionIndex++) {
+            section* symbolSection = reader.sections[sectionIndex];
+            if (symbolSection->get_type() != SHT_SYMTAB) {
+                continue;
+            }
+
+            const symbol_section_accessor symbols(reader, symbolSection);
+            for (Elf_Xword i = 0; i < symbols.get_symbols_num(); i++) {
+                std::string name;
+                Elf64_Addr value;
+                Elf_Xword size;
+                unsigned char bind, type, other;
+                Elf_Half symbolSectionIndex;
+
+                if (symbols.get_symbol(i, name, value, size, bind, type, symbolSectionIndex, other) && type == STT_FUNC) {
+                    functionSymbols.push_back({std::move(name), static_cast<u32>(value)});
+                }
+            }
+        }
+    }
+
+    struct LoadedSegment {
+        u32 vaddr;
+        u32 fcramAddr;
+        u32 fileSize;
+    };
+    std::vector<LoadedSegment> loadedSegments;
+
     auto segNum = reader.segments.size();
     printf("Number of segments: %d\n", segNum);
     printf(" #  Perms       Vaddr           File Size       Mem Size\n");
@@ -58,11 +91,26 @@ std::optional<u32> Memory::loadELF(std::ifstream& file) {
         // This should also assert that findPaddr doesn't fail
         u32 fcramAddr = findPaddr(memorySize).value();
         std::memcpy(&fcram[fcramAddr], data, fileSize);
+        if (x) {
+            loadedSegments.push_back({vaddr, fcramAddr, fileSize});
+        }
 
         // Allocate the segment on the OS side
         allocateMemory(vaddr, fcramAddr, memorySize, true, r, w, x);
     }
 
+    if (!functionSymbols.empty()) {
+        libcHooks.patchSymbols(functionSymbols, [&](u32 address) -> u8* {
+            for (const auto& segment : loadedSegments) {
+                if (address >= segment.vaddr && u64(address) + sizeof(u32) <= u64(segment.vaddr) + segment.fileSize) {
+                    return &fcram[segment.fcramAddr + (address - segment.vaddr)];
+                }
+            }
+
+            return nullptr;
+        });
+    }
+
     // ELF can't specify a region, make it default to USA
     region = Regions::USA;
     return static_cast<u32>(reader.get_entry());
@@ -3,6 +3,7 @@
 #include <cstring>
 #include <optional>
 
+#include "loader/compressed_rom.hpp"
 #include "memory.hpp"
 
 bool Memory::mapCXI(NCSD& ncsd, NCCH& cxi) {
@@ -85,7 +86,7 @@ bool Memory::mapCXI(NCSD& ncsd, NCCH& cxi) {
 
 std::optional<NCSD> Memory::loadNCSD(Crypto::AESEngine& aesEngine, const std::filesystem::path& path) {
 	NCSD ncsd;
-	if (!ncsd.file.open(path, "rb")) return std::nullopt;
+	if (!CompressedROM::openROM(ncsd.file, path)) return std::nullopt;
 
 	u8 magic[4];  // Must be "NCSD"
 	ncsd.file.seek(0x100);
@@ -153,6 +154,11 @@ std::optional<NCSD> Memory::loadNCSD(Crypto::AESEngine& aesEngine, const std::fi
 		return std::nullopt;
 	}
 
+	if (!CompressedROM::openROM(asyncROMFile, path)) {
+		printf("Failed to open ROM for async I/O\n");
+		return std::nullopt;
+	}
+
 	return ncsd;
 }
 
@@ -160,7 +166,7 @@ std::optional<NCSD> Memory::loadNCSD(Crypto::AESEngine& aesEngine, const std::fi
 // This is easy because NCSD is just CXI + some more NCCH partitions, which we can make empty when converting to NCSD
 std::optional<NCSD> Memory::loadCXI(Crypto::AESEngine& aesEngine, const std::filesystem::path& path) {
 	NCSD ncsd;
-	if (!ncsd.file.open(path, "rb")) {
+	if (!CompressedROM::openROM(ncsd.file, path)) {
 		return std::nullopt;
 	}
 
@@ -203,5 +209,10 @@ std::optional<NCSD> Memory::loadCXI(Crypto::AESEngine& aesEngine, const std::fil
 		return std::nullopt;
 	}
 
+	if (!CompressedROM::openROM(asyncROMFile, path)) {
+		printf("Failed to open ROM for async I/O\n");
+		return std::nullopt;
+	}
+
 	return ncsd;
 }
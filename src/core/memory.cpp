@@ -1,18 +1,47 @@
 #include "memory.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <chrono>  // For time since epoch
 #include <cmrc/cmrc.hpp>
+#include <cstring>
 #include <ctime>
 
 #include "config_mem.hpp"
 #include "resource_limits.hpp"
+#include "savestate.hpp"
 #include "services/ptm.hpp"
 
 CMRC_DECLARE(ConsoleFonts);
 
 using namespace KernelMemoryTypes;
 
+namespace {
+	// Calls func with the index of every page set in a dirty page bitmap, in increasing order
+	template <usize size, typename Func>
+	void forEachDirtyPage(const std::array<u64, size>& bitmap, Func&& func) {
+		for (usize word = 0; word < size; word++) {
+			u64 bits = bitmap[word];
+
+			while (bits != 0) {
+				func(u32(word * 64 + std::countr_zero(bits)));
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	// Page table entries are saved as the FCRAM or DSP RAM page they point to, tagged with which of the two it is
+	namespace PageTableEntry {
+		enum : u32 {
+			Unmapped = 0,
+			FCRAMPage = 1u << 28,
+			DSPRAMPage = 2u << 28,
+			TagMask = 0xFu << 28,
+		};
+	}
+}  // namespace
+
 Memory::Memory(u64& cpuTicks, const EmulatorConfig& config) : cpuTicks(cpuTicks), config(config) {
 	fcram = new uint8_t[FCRAM_SIZE]();
 
@@ -25,6 +54,15 @@ void Memory::reset() {
 	// Unallocate all memory
 	memoryInfo.clear();
 	usedFCRAMPages.reset();
+	guardedVRAMPages.reset();
+
+	// Whatever gets loaded next is written without marking pages dirty, so the next snapshot has to start from a new keyframe
+	fcramKeyframe.reset();
+	dirtyFCRAMPages.fill(0);
+	keyframeDiffPages.fill(0);
+	for (auto& word : gpuDirtyFCRAMPages) {
+		word.store(0, std::memory_order_relaxed);
+	}
 	usedUserMemory = u32(0_MB);
 	usedSystemMemory = u32(0_MB);
 
@@ -128,7 +166,12 @@ u8 Memory::read8(u32 vaddr) {
 			case ConfigMem::WifiMac + 4:
 			case ConfigMem::WifiMac + 5: return MACAddress[vaddr - ConfigMem::WifiMac];
 
-			default: Helpers::panic("Unimplemented 8-bit read, addr: %08X", vaddr);
+			default:
+				if (u8* pointer = getVRAMPointer(vaddr, sizeof(u8))) {
+					return *pointer;
+				}
+
+				Helpers::panic("Unimplemented 8-bit read, addr: %08X", vaddr);
 		}
 	}
 }
@@ -143,7 +186,12 @@ u16 Memory::read16(u32 vaddr) {
 	} else {
 		switch (vaddr) {
 			case ConfigMem::WifiMac + 4: return (MACAddress[5] << 8) | MACAddress[4];  // Wifi MAC: Last 2 bytes of MAC Address
-			default: Helpers::panic("Unimplemented 16-bit read, addr: %08X", vaddr);
+			default:
+				if (u8* pointer = getVRAMPointer(vaddr, sizeof(u16))) {
+					return *(u16*)pointer;
+				}
+
+				Helpers::panic("Unimplemented 16-bit read, addr: %08X", vaddr);
 		}
 	}
 }
@@ -183,15 +231,8 @@ u32 Memory::read32(u32 vaddr) {
 				return u32(read8(vaddr)) | (u32(read8(vaddr + 1)) << 8) | (u32(read8(vaddr + 2)) << 16) | (u32(read8(vaddr + 3)) << 24);
 
 			default:
-				if (vaddr >= VirtualAddrs::VramStart && vaddr < VirtualAddrs::VramStart + VirtualAddrs::VramSize) {
-					static int shutUpCounter = 0;
-					if (shutUpCounter < 5) { // Stop spamming about VRAM reads after the first 5
-						shutUpCounter++;
-						Helpers::warn("VRAM read!\n");
-					}
-
-					// TODO: Properly handle framebuffer readbacks and the like
-					return *(u32*)&vram[vaddr - VirtualAddrs::VramStart];
+				if (u8* pointer = getVRAMPointer(vaddr, sizeof(u32))) {
+					return *(u32*)pointer;
 				}
 
 				Helpers::panic("Unimplemented 32-bit read, addr: %08X", vaddr);
@@ -213,14 +254,13 @@ void Memory::write8(u32 vaddr, u8 value) {
 	uintptr_t pointer = writeTable[page];
 	if (pointer != 0) [[likely]] {
 		*(u8*)(pointer + offset) = value;
+		markFCRAMPageDirty(pointer);
 	} else {
 		// VRAM write
-		if (vaddr >= VirtualAddrs::VramStart && vaddr < VirtualAddrs::VramStart + VirtualAddrs::VramSize) {
-			// TODO: Invalidate renderer caches here
-			vram[vaddr - VirtualAddrs::VramStart] = value;
-		}
-
-		else {
+		// TODO: Invalidate renderer caches here
+		if (u8* pointer = getVRAMPointer(vaddr, sizeof(u8))) {
+			*pointer = value;
+		} else {
 			Helpers::panic("Unimplemented 8-bit write, addr: %08X, val: %02X", vaddr, value);
 		}
 	}
@@ -233,6 +273,9 @@ void Memory::write16(u32 vaddr, u16 value) {
 	uintptr_t pointer = writeTable[page];
 	if (pointer != 0) [[likely]] {
 		*(u16*)(pointer + offset) = value;
+		markFCRAMPageDirty(pointer);
+	} else if (u8* vramPointer = getVRAMPointer(vaddr, sizeof(u16))) {
+		*(u16*)vramPointer = value;
 	} else {
 		Helpers::panic("Unimplemented 16-bit write, addr: %08X, val: %08X", vaddr, value);
 	}
@@ -245,11 +288,59 @@ void Memory::write32(u32 vaddr, u32 value) {
 	uintptr_t pointer = writeTable[page];
 	if (pointer != 0) [[likely]] {
 		*(u32*)(pointer + offset) = value;
+		markFCRAMPageDirty(pointer);
+	} else if (u8* vramPointer = getVRAMPointer(vaddr, sizeof(u32))) {
+		*(u32*)vramPointer = value;
 	} else {
 		Helpers::panic("Unimplemented 32-bit write, addr: %08X, val: %08X", vaddr, value);
 	}
 }
 
+u8* Memory::getVRAMPointer(u32 vaddr, u32 size) {
+	const u32 offset = vaddr - VirtualAddrs::VramStart;
+	if (offset >= VirtualAddrs::VramSize || size > VirtualAddrs::VramSize - offset) {
+		return nullptr;
+	}
+
+	flushVRAM(PhysicalAddrs::VRAM + offset, size);
+	return &vram[offset];
+}
+
+void Memory::setVRAMGuard(u32 paddr, u32 size, bool guarded) {
+	const u32 offset = paddr - PhysicalAddrs::VRAM;
+	if (size == 0 || offset >= VirtualAddrs::VramSize) {
+		return;
+	}
+
+	const u32 lastPage = std::min<u32>(offset + (size - 1), VirtualAddrs::VramSize - 1) >> pageShift;
+	for (u32 page = offset >> pageShift; page <= lastPage; page++) {
+		guardedVRAMPages[page] = guarded;
+	}
+}
+
+void Memory::flushVRAM(u32 paddr, u32 size) {
+	const u32 offset = paddr - PhysicalAddrs::VRAM;
+	if (size == 0 || offset >= VirtualAddrs::VramSize) {
+		return;
+	}
+
+	const u32 firstPage = offset >> pageShift;
+	const u32 lastPage = std::min<u32>(offset + (size - 1), VirtualAddrs::VramSize - 1) >> pageShift;
+
+	for (u32 page = firstPage; page <= lastPage; page++) {
+		if (guardedVRAMPages[page]) {
+			// Unguard the pages first, so that they don't fault again even if the renderer can't write them back. The renderer guards the
+			// ones it still holds newer data for again
+			setVRAMGuard(PhysicalAddrs::VRAM + (firstPage << pageShift), (lastPage - firstPage + 1) << pageShift, false);
+
+			if (vramFlushCallback) {
+				vramFlushCallback(paddr, size);
+			}
+			break;
+		}
+	}
+}
+
 void Memory::write64(u32 vaddr, u64 value) {
 	write32(vaddr, u32(value));
 	write32(vaddr + 4, u32(value >> 32));
@@ -270,9 +361,56 @@ void* Memory::getWritePointer(u32 address) {
 
 	uintptr_t pointer = writeTable[page];
 	if (pointer == 0) return nullptr;
+
+	markFCRAMPageDirty(pointer);  // Callers write through the pointer, which we don't get to see
 	return (void*)(pointer + offset);
 }
 
+void Memory::readBlock(u32 vaddr, void* dst, u32 size) {
+	u8* out = static_cast<u8*>(dst);
+
+	while (size != 0) {
+		const uintptr_t pointer = readTable[vaddr >> pageShift];
+		const u32 offset = vaddr & pageMask;
+		const u32 count = std::min<u32>(size, pageSize - offset);
+
+		if (pointer != 0) [[likely]] {
+			std::memcpy(out, (const void*)(pointer + offset), count);
+		} else {
+			for (u32 i = 0; i < count; i++) {
+				out[i] = read8(vaddr + i);
+			}
+		}
+
+		out += count;
+		vaddr += count;
+		size -= count;
+	}
+}
+
+void Memory::writeBlock(u32 vaddr, const void* src, u32 size) {
+	const u8* in = static_cast<const u8*>(src);
+
+	while (size != 0) {
+		const uintptr_t pointer = writeTable[vaddr >> pageShift];
+		const u32 offset = vaddr & pageMask;
+		const u32 count = std::min<u32>(size, pageSize - offset);
+
+		if (pointer != 0) [[likely]] {
+			std::memcpy((void*)(pointer + offset), in, count);
+			markFCRAMPageDirty(pointer);
+		} else {
+			for (u32 i = 0; i < count; i++) {
+				write8(vaddr + i, in[i]);
+			}
+		}
+
+		in += count;
+		vaddr += count;
+		size -= count;
+	}
+}
+
 // Thank you Citra devs
 std::string Memory::readString(u32 address, u32 maxSize) {
 	std::string string;
@@ -496,14 +634,23 @@ void Memory::mirrorMapping(u32 destAddress, u32 sourceAddress, u32 size) {
 u64 Memory::timeSince3DSEpoch() {
 	using namespace std::chrono;
 
-	std::time_t rawTime = std::time(nullptr);   // Get current UTC time
-	auto localTime = std::localtime(&rawTime);  // Convert to local time
+	std::time_t rawTime = std::time(nullptr);  // Get current UTC time
+	std::tm localTime, utcTime;
+
+	// std::localtime and std::gmtime return a buffer shared by every thread, so use the reentrant versions in case several emulators are
+	// running at once
+#ifdef _WIN32
+	localtime_s(&localTime, &rawTime);  // Convert to local time
+	gmtime_s(&utcTime, &rawTime);
+#else
+	localtime_r(&rawTime, &localTime);  // Convert to local time
+	gmtime_r(&rawTime, &utcTime);
+#endif
 
-	bool daylightSavings = localTime->tm_isdst > 0;  // Get if time includes DST
-	localTime = std::gmtime(&rawTime);
+	bool daylightSavings = localTime.tm_isdst > 0;  // Get if time includes DST
 
 	// Use gmtime + mktime to calculate difference between local time and UTC
-	auto timezoneDifference = rawTime - std::mktime(localTime);
+	auto timezoneDifference = rawTime - std::mktime(&utcTime);
 	if (daylightSavings) {
 		timezoneDifference += 60ull * 60ull;  // Add 1 hour (60 seconds * 60 minutes)
 	}
@@ -524,6 +671,7 @@ void Memory::copySharedFont(u8* pointer) {
 	auto fonts = cmrc::ConsoleFonts::get_filesystem();
 	auto font = fonts.open("CitraSharedFontUSRelocated.bin");
 	std::memcpy(pointer, font.begin(), font.size());
+	markFCRAMDirty(PhysicalAddrs::FCRAM + u32(pointer - fcram), u32(font.size()));
 }
 
 std::optional<u64> Memory::getProgramID() {
@@ -534,4 +682,239 @@ std::optional<u64> Memory::getProgramID() {
 	}
 
 	return std::nullopt;
-}
\ No newline at end of file
+}
+namespace {
+	// Calls func with every FCRAM page overlapping the physical range [paddr, paddr + size)
+	template <typename Func>
+	void forEachFCRAMPage(u32 paddr, u32 size, Func&& func) {
+		if (size == 0 || paddr < PhysicalAddrs::FCRAM || paddr - PhysicalAddrs::FCRAM >= Memory::FCRAM_SIZE) {
+			return;
+		}
+
+		const u32 offset = paddr - PhysicalAddrs::FCRAM;
+		const u32 lastPage = u32(std::min<u64>(u64(offset) + size - 1, Memory::FCRAM_SIZE - 1) >> Memory::pageShift);
+
+		for (u32 page = offset >> Memory::pageShift; page <= lastPage; page++) {
+			func(page);
+		}
+	}
+}  // namespace
+
+void Memory::markFCRAMDirty(u32 paddr, u32 size) {
+	forEachFCRAMPage(paddr, size, [&](u32 page) { dirtyFCRAMPages[page / 64] |= u64(1) << (page % 64); });
+}
+
+void Memory::markFCRAMDirtyFromGPU(u32 paddr, u32 size) {
+	forEachFCRAMPage(paddr, size, [&](u32 page) { gpuDirtyFCRAMPages[page / 64].fetch_or(u64(1) << (page % 64), std::memory_order_relaxed); });
+}
+
+// Brings dirtyFCRAMPages up to date with the writes that aren't tracked as they happen. Must only be called while the GPU thread is idle
+void Memory::markHostWritesDirty() {
+	for (usize i = 0; i < dirtyFCRAMPages.size(); i++) {
+		dirtyFCRAMPages[i] |= gpuDirtyFCRAMPages[i].exchange(0, std::memory_order_relaxed);
+	}
+
+	// Services write to their shared memory blocks through host pointers whenever they like, so those blocks are always treated as
+	// modified. The font block is the exception, as the font is only written by copySharedFont, which marks it itself
+	for (const auto& block : sharedMemBlocks) {
+		if (block.handle != KernelHandles::FontSharedMemHandle) {
+			markFCRAMDirty(PhysicalAddrs::FCRAM + block.paddr, block.size);
+		}
+	}
+}
+
+void Memory::captureFCRAM(FCRAMSnapshot& snapshot) {
+	markHostWritesDirty();
+
+	usize dirtyPageCount = 0;
+	for (usize i = 0; i < keyframeDiffPages.size(); i++) {
+		keyframeDiffPages[i] |= dirtyFCRAMPages[i];
+		dirtyPageCount += std::popcount(keyframeDiffPages[i]);
+	}
+	dirtyFCRAMPages.fill(0);
+
+	// Copying all of FCRAM takes a few milliseconds, so it's only done when there's no keyframe or too much changed since the last one
+	if (!fcramKeyframe || dirtyPageCount > keyframeDirtyPageLimit) {
+		std::shared_ptr<u8[]> keyframe(new u8[FCRAM_SIZE]);
+		std::memcpy(keyframe.get(), fcram, FCRAM_SIZE);
+
+		fcramKeyframe = std::move(keyframe);
+		keyframeDiffPages.fill(0);
+	}
+
+	snapshot.keyframe = fcramKeyframe;
+	snapshot.id = ++lastSnapshotID;
+	snapshot.pages.clear();
+	forEachDirtyPage(keyframeDiffPages, [&](u32 page) { snapshot.pages.push_back(page); });
+
+	snapshot.pageData.resize(snapshot.pages.size() * pageSize);
+	for (usize i = 0; i < snapshot.pages.size(); i++) {
+		std::memcpy(&snapshot.pageData[i * pageSize], &fcram[snapshot.pages[i] * pageSize], pageSize);
+	}
+}
+
+void Memory::restoreFCRAM(const FCRAMSnapshot& snapshot) {
+	if (!snapshot.keyframe) [[unlikely]] {
+		Helpers::panic("Memory::restoreFCRAM: Snapshot has no keyframe");
+	}
+
+	markHostWritesDirty();
+
+	// Restoring the snapshot FCRAM was last captured to or restored from, like run-ahead does every frame. Only the pages written since can
+	// differ from it, and each comes back either from the snapshot or, if the snapshot doesn't have it, from the keyframe
+	if (snapshot.id == lastSnapshotID && snapshot.keyframe == fcramKeyframe) {
+		forEachDirtyPage(dirtyFCRAMPages, [&](u32 page) {
+			const auto it = std::lower_bound(snapshot.pages.begin(), snapshot.pages.end(), page);
+
+			if (it != snapshot.pages.end() && *it == page) {
+				std::memcpy(&fcram[page * pageSize], &snapshot.pageData[(it - snapshot.pages.begin()) * pageSize], pageSize);
+			} else {
+				std::memcpy(&fcram[page * pageSize], &fcramKeyframe[page * pageSize], pageSize);
+			}
+		});
+
+		dirtyFCRAMPages.fill(0);
+		return;
+	}
+
+	if (snapshot.keyframe == fcramKeyframe) {
+		// Only the pages written since the keyframe can differ from it, so put those back and apply the snapshot's pages on top
+		for (usize i = 0; i < keyframeDiffPages.size(); i++) {
+			keyframeDiffPages[i] |= dirtyFCRAMPages[i];
+		}
+		forEachDirtyPage(keyframeDiffPages, [&](u32 page) { std::memcpy(&fcram[page * pageSize], &fcramKeyframe[page * pageSize], pageSize); });
+	} else {
+		std::memcpy(fcram, snapshot.keyframe.get(), FCRAM_SIZE);
+		fcramKeyframe = snapshot.keyframe;
+	}
+
+	dirtyFCRAMPages.fill(0);
+	keyframeDiffPages.fill(0);
+	for (usize i = 0; i < snapshot.pages.size(); i++) {
+		const u32 page = snapshot.pages[i];
+
+		std::memcpy(&fcram[page * pageSize], &snapshot.pageData[i * pageSize], pageSize);
+		keyframeDiffPages[page / 64] |= u64(1) << (page % 64);
+	}
+	lastSnapshotID = snapshot.id;
+}
+
+void Memory::doState(SaveStateStream& stream) {
+	stream.section("MEM ");
+	stream.value(usedUserMemory);
+	stream.value(usedSystemMemory);
+	stream.value(region);
+	stream.value(kernelVersion);
+	stream.value(sharedMemBlocks);
+	stream.bitset(usedFCRAMPages);
+
+	const u32 allocationCount = stream.count(memoryInfo.size(), sizeof(MemoryInfo));
+	if (stream.isReading()) {
+		memoryInfo.clear();
+
+		for (u32 i = 0; i < allocationCount; i++) {
+			MemoryInfo info(0, 0, 0, 0);
+			stream.value(info);
+			memoryInfo.push_back(info);
+		}
+	} else {
+		for (auto& info : memoryInfo) {
+			stream.value(info);
+		}
+	}
+
+	// Only mapped pages are stored, as (virtual page, read entry, write entry)
+	const auto encodeEntry = [&](uintptr_t pointer) -> u32 {
+		if (pointer == 0) {
+			return PageTableEntry::Unmapped;
+		}
+
+		const uintptr_t fcramOffset = pointer - uintptr_t(fcram);
+		if (fcramOffset < FCRAM_SIZE) {
+			return PageTableEntry::FCRAMPage | u32(fcramOffset >> pageShift);
+		}
+
+		const uintptr_t dspOffset = pointer - uintptr_t(dspRam);
+		if (dspOffset < DSP_RAM_SIZE) {
+			return PageTableEntry::DSPRAMPage | u32(dspOffset >> pageShift);
+		}
+
+		Helpers::panic("Memory::doState: Page table entry points outside of FCRAM and DSP RAM");
+	};
+
+	const auto decodeEntry = [&](u32 entry) -> uintptr_t {
+		const u32 page = entry & ~PageTableEntry::TagMask;
+
+		switch (entry & PageTableEntry::TagMask) {
+			case PageTableEntry::FCRAMPage:
+				if (page < FCRAM_PAGE_COUNT) {
+					return uintptr_t(&fcram[page * pageSize]);
+				}
+				break;
+
+			case PageTableEntry::DSPRAMPage:
+				if (page < DSP_RAM_SIZE / pageSize) {
+					return uintptr_t(&dspRam[page * pageSize]);
+				}
+				break;
+
+			default: break;
+		}
+
+		stream.fail();
+		return 0;
+	};
+
+	std::vector<std::array<u32, 3>> mappings;
+	if (stream.isWriting()) {
+		for (u32 page = 0; page < totalPageCount; page++) {
+			if (readTable[page] != 0 || writeTable[page] != 0) {
+				mappings.push_back({page, encodeEntry(readTable[page]), encodeEntry(writeTable[page])});
+			}
+		}
+	}
+
+	stream.vector(mappings);
+	if (stream.isReading()) {
+		std::fill(readTable.begin(), readTable.end(), 0);
+		std::fill(writeTable.begin(), writeTable.end(), 0);
+
+		for (const auto& [page, readEntry, writeEntry] : mappings) {
+			if (page >= totalPageCount) {
+				stream.fail();
+				break;
+			}
+
+			readTable[page] = (readEntry == PageTableEntry::Unmapped) ? 0 : decodeEntry(readEntry);
+			writeTable[page] = (writeEntry == PageTableEntry::Unmapped) ? 0 : decodeEntry(writeEntry);
+		}
+	}
+
+	stream.bytes(dspRam, DSP_RAM_SIZE);
+
+	// The emulator writes back guarded VRAM before saving or loading, so VRAM is up to date and no surface the renderer keeps is newer
+	stream.bytes(vram, VirtualAddrs::VramSize);
+	if (stream.isReading()) {
+		guardedVRAMPages.reset();
+	}
+}
+
+void Memory::doFCRAMState(SaveStateStream& stream) {
+	stream.section("FCRM");
+
+	// Pages that were never allocated were never written either, so only the allocated ones are stored. usedFCRAMPages is part of doState
+	for (u32 page = 0; page < FCRAM_PAGE_COUNT; page++) {
+		if (usedFCRAMPages[page]) {
+			stream.bytes(&fcram[page * pageSize], pageSize);
+		} else if (stream.isReading()) {
+			std::memset(&fcram[page * pageSize], 0, pageSize);
+		}
+	}
+
+	// Loading rewrote FCRAM behind the back of the dirty page tracking
+	if (stream.isReading()) {
+		fcramKeyframe.reset();
+		dirtyFCRAMPages.fill(0);
+		keyframeDiffPages.fill(0);
+	}
+}
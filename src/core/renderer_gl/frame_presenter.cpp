@@ -0,0 +1,107 @@
+#include "renderer_gl/frame_presenter.hpp"
+
+void FramePresenter::waitAndDelete(GLsync& fence) {
+	if (fence != nullptr) {
+		glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+void FramePresenter::init(u32 width, u32 height) {
+	this->width = width;
+	this->height = height;
+
+	const auto prevTexture = OpenGL::getTex2D();
+	for (auto& slot : slots) {
+		slot.texture.create(width, height, GL_RGBA8);
+		slot.texture.bind();
+		slot.texture.setMinFilter(OpenGL::Linear);
+		slot.texture.setMagFilter(OpenGL::Linear);
+		slot.drawFramebuffer.createWithDrawTexture(slot.texture);
+	}
+	glBindTexture(GL_TEXTURE_2D, prevTexture);
+
+	initialized = true;
+}
+
+void FramePresenter::publish(OpenGL::Framebuffer& source) {
+	Slot& slot = slots[mailbox.getProducerSlot()];
+	waitAndDelete(slot.presentedFence);
+
+	source.bind(OpenGL::ReadFramebuffer);
+	slot.drawFramebuffer.bind(OpenGL::DrawFramebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	// Frames that got replaced before being presented come back with their fence never waited on
+	if (slot.renderedFence != nullptr) {
+		glDeleteSync(slot.renderedFence);
+	}
+
+	// The fence has to be flushed, as the other context can't wait on a fence that hasn't been submitted yet
+	slot.renderedFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	mailbox.publish();
+}
+
+void FramePresenter::free() {
+	for (auto& slot : slots) {
+		if (slot.renderedFence != nullptr) {
+			glDeleteSync(slot.renderedFence);
+			slot.renderedFence = nullptr;
+		}
+
+		if (slot.presentedFence != nullptr) {
+			glDeleteSync(slot.presentedFence);
+			slot.presentedFence = nullptr;
+		}
+
+		slot.drawFramebuffer.free();
+		slot.texture.free();
+	}
+
+	initialized = false;
+}
+
+bool FramePresenter::present(u32 outputWidth, u32 outputHeight) {
+	if (mailbox.consume()) {
+		hasFrame = true;
+	}
+
+	if (!hasFrame) {
+		return false;
+	}
+
+	Slot& slot = slots[mailbox.getConsumerSlot()];
+	waitAndDelete(slot.renderedFence);
+
+	if (slot.readFramebuffer == 0) {
+		glGenFramebuffers(1, &slot.readFramebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, slot.readFramebuffer);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, slot.texture.handle(), 0);
+	} else {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, slot.readFramebuffer);
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	// Replace the fence of the last time this frame was drawn, if it's being drawn again
+	if (slot.presentedFence != nullptr) {
+		glDeleteSync(slot.presentedFence);
+	}
+	slot.presentedFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	return true;
+}
+
+void FramePresenter::releasePresentContext() {
+	for (auto& slot : slots) {
+		if (slot.readFramebuffer != 0) {
+			glDeleteFramebuffers(1, &slot.readFramebuffer);
+			slot.readFramebuffer = 0;
+		}
+	}
+
+	hasFrame = false;
+}
@@ -20,12 +20,18 @@ using namespace PICA;
 RendererGL::~RendererGL() {}
 
 void RendererGL::reset() {
+	invalidateCaches();
+	clearShaderCache();
+}
+
+// Generated shaders only depend on the register configuration they were made for, so they stay valid when the emulated state is replaced
+void RendererGL::invalidateCaches() {
+	flushDraws();
+	surfaceReadback.reset();
 	depthBufferCache.reset();
 	colourBufferCache.reset();
 	textureCache.reset();
 
-	clearShaderCache();
-
 	// Init the colour/depth buffer settings to some random defaults on reset
 	colourBufferLoc = 0;
 	colourBufferFormat = PICA::ColorFmt::RGBA8;
@@ -33,6 +39,10 @@ void RendererGL::reset() {
 	depthBufferLoc = 0;
 	depthBufferFormat = PICA::DepthFmt::Depth16;
 
+	clobberedRegisterGroups = PICA::RegisterGroup::All;
+	ubershaderDirtyGroups = PICA::RegisterGroup::All;
+	specializedDirtyGroups = PICA::RegisterGroup::All;
+
 	if (triangleProgram.exists()) {
 		const auto oldProgram = OpenGL::getProgram();
 
@@ -56,6 +66,8 @@ void RendererGL::reset() {
 
 void RendererGL::initGraphicsContextInternal() {
 	gl.reset();
+	// The GL state tracker forgot which textures are bound, so every unit needs to be bound again on the next draw
+	clobberedRegisterGroups |= PICA::RegisterGroup::TextureUnits;
 
 	auto gl_resources = cmrc::RendererGL::get_filesystem();
 
@@ -77,11 +89,20 @@ void RendererGL::initGraphicsContextInternal() {
 	gl.useProgram(displayProgram);
 	glUniform1i(OpenGL::uniformLocation(displayProgram, "u_texture"), 0);  // Init sampler object
 
-	vbo.createFixedSize(sizeof(Vertex) * vertexBufferSize, GL_STREAM_DRAW);
-	gl.bindVBO(vbo);
+	vertexStream.create(vertexStreamSize);
+	indexStream.create(indexStreamSize);
+	gl.bindVBO(vertexStream.getHandle());
 	vao.create();
 	gl.bindVAO(vao);
 
+	// The element buffer binding is part of the VAO state, so it only needs to be bound once here
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexStream.getHandle());
+
+	// Multi-draw isn't available on GLES, where batched draws get submitted one by one instead. Base vertex needs GLES 3.2, without it
+	// indexed draws get expanded to plain vertices on the CPU
+	supportsMultiDraw = glMultiDrawArrays != nullptr && glMultiDrawElementsBaseVertex != nullptr;
+	supportsBaseVertex = glDrawElementsBaseVertex != nullptr;
+
 	// Position (x, y, z, w) attributes
 	vao.setAttributeFloat<float>(0, 4, sizeof(Vertex), offsetof(Vertex, s.positions));
 	vao.enableAttribute(0);
@@ -107,6 +128,18 @@ void RendererGL::initGraphicsContextInternal() {
 	vao.setAttributeFloat<float>(7, 2, sizeof(Vertex), offsetof(Vertex, s.texcoord2));
 	vao.enableAttribute(7);
 
+	// The hardware vertex shader VAO. Its attributes depend on the shader, so they get set up by setupDraw
+	hwShaderVao.create();
+	gl.bindVAO(hwShaderVao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexStream.getHandle());
+	hwShaderVaoStride = 0;
+
+	hwShaderUniforms = {};
+	glGenBuffers(1, &hwShaderUbo);
+	gl.bindUBO(hwShaderUbo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(PICA::VertexUniforms), &hwShaderUniforms, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, hwShaderUboBinding, hwShaderUbo);
+
 	dummyVBO.create();
 	dummyVAO.create();
 	gl.disableScissor();
@@ -289,7 +322,7 @@ void RendererGL::setupStencilTest(bool stencilEnable) {
 }
 
 void RendererGL::setupUbershaderTexEnv() {
-	// TODO: Only update uniforms when the TEV config changed. Use an UBO potentially.
+	// TODO: Use an UBO potentially
 	static constexpr std::array<u32, 6> ioBases = {
 		PICA::InternalRegs::TexEnv0Source, PICA::InternalRegs::TexEnv1Source, PICA::InternalRegs::TexEnv2Source,
 		PICA::InternalRegs::TexEnv3Source, PICA::InternalRegs::TexEnv4Source, PICA::InternalRegs::TexEnv5Source,
@@ -400,7 +433,9 @@ void RendererGL::updateFogLUT() {
 	glActiveTexture(GL_TEXTURE0);
 }
 
-void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> vertices) {
+// Sets up the pipeline state for a draw and binds the vertex array. If the state is the same as for the queued draws, the draw joins their batch.
+// Otherwise the queued draws are submitted and a new batch is started
+void RendererGL::setupDraw(PICA::PrimType primType, bool indexed) {
 	// The fourth type is meant to be "Geometry primitive". TODO: Find out what that is
 	static constexpr std::array<OpenGL::Primitives, 4> primTypes = {
 		OpenGL::Triangle,
@@ -409,7 +444,25 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 		OpenGL::Triangle,
 	};
 
-	bool usingUbershader = enableUbershader;
+	// Only re-derive the state of register groups that changed since the last draw. Depth, viewport and framebuffer state stay per-draw,
+	// as they depend on the surface caches too, and the state manager already filters out redundant calls for them
+	const u32 dirtyGroups = gpu.dirtyRegisterGroups | clobberedRegisterGroups;
+	const bool lutsDirty = gpu.lightingLUTDirty || gpu.fogLUTDirty;
+
+	if (dirtyGroups == 0 && !lutsDirty && !drawBatch.empty() && drawBatch.primType == primType && drawBatch.indexed == indexed &&
+		drawBatch.vertexShader == hwVertexShader) {
+		return;
+	}
+
+	// Submit the queued draws before touching any state they depend on
+	flushDraws();
+	gpu.dirtyRegisterGroups = 0;
+	clobberedRegisterGroups = 0;
+	ubershaderDirtyGroups |= dirtyGroups;
+	specializedDirtyGroups |= dirtyGroups;
+
+	// The ubershader only comes with the pass-through vertex shader, so hardware shaded draws always go through shadergen
+	bool usingUbershader = enableUbershader && hwVertexShader == nullptr;
 	if (usingUbershader) {
 		const bool lightsEnabled = (regs[InternalRegs::LightingEnable] & 1) != 0;
 		const uint lightCount = (regs[InternalRegs::LightNumber] & 0x7) + 1;
@@ -428,17 +481,44 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 		gl.useProgram(program);
 	}
 
-	const auto primitiveTopology = primTypes[static_cast<usize>(primType)];
+	drawBatch.primType = primType;
+	drawBatch.topology = primTypes[static_cast<usize>(primType)];
+	drawBatch.indexed = indexed;
+	drawBatch.vertexShader = hwVertexShader;
+
 	gl.disableScissor();
-	gl.bindVBO(vbo);
-	gl.bindVAO(vao);
+	gl.bindVBO(vertexStream.getHandle());
+
+	if (hwVertexShader == nullptr) {
+		gl.bindVAO(vao);
+	} else {
+		gl.bindVAO(hwShaderVao);
+
+		// Each of the shader inputs is a vec4 of floats, packed one after another
+		if (hwShaderVaoStride != hwShaderStride) {
+			hwShaderVaoStride = hwShaderStride;
+			const u32 inputCount = hwShaderStride / sizeof(PICA::Vertex::vec4f);
+
+			for (u32 i = 0; i < 16; i++) {
+				if (i < inputCount) {
+					hwShaderVao.setAttributeFloat<float>(i, 4, hwShaderStride, i * sizeof(PICA::Vertex::vec4f));
+					hwShaderVao.enableAttribute(i);
+				} else {
+					hwShaderVao.disableAttribute(i);
+				}
+			}
+		}
+	}
 
 	gl.enableClipPlane(0);  // Clipping plane 0 is always enabled
 	if (regs[PICA::InternalRegs::ClipEnable] & 1) {
 		gl.enableClipPlane(1);
 	}
 
-	setupBlending();
+	if (dirtyGroups & RegisterGroup::Blend) {
+		setupBlending();
+	}
+
 	auto poop = getColourBuffer(colourBufferLoc, colourBufferFormat, fbSize[0], fbSize[1]);
 	poop->fbo.bind(OpenGL::DrawAndReadFramebuffer);
 
@@ -450,10 +530,16 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 	const int colourMask = getBits<8, 4>(depthControl);
 	gl.setColourMask(colourMask & 1, colourMask & 2, colourMask & 4, colourMask & 8);
 
+	if (colourMask != 0) {
+		if (auto colourBuffer = colourBufferCache.find(poop.value())) {
+			markSurfaceWritten(colourBuffer->get());
+		}
+	}
+
 	static constexpr std::array<GLenum, 8> depthModes = {GL_NEVER, GL_ALWAYS, GL_EQUAL, GL_NOTEQUAL, GL_LESS, GL_LEQUAL, GL_GREATER, GL_GEQUAL};
 
 	// Update ubershader uniforms
-	if (usingUbershader) {
+	if (usingUbershader && ubershaderDirtyGroups != 0) {
 		const float depthScale = f24::fromRaw(regs[PICA::InternalRegs::DepthScale] & 0xffffff).toFloat32();
 		const float depthOffset = f24::fromRaw(regs[PICA::InternalRegs::DepthOffset] & 0xffffff).toFloat32();
 		const bool depthMapEnable = regs[PICA::InternalRegs::DepthmapEnable] & 1;
@@ -476,10 +562,19 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 		// Upload PICA Registers as a single uniform. The shader needs access to the rasterizer registers (for depth, starting from index 0x48)
 		// The texturing and the fragment lighting registers. Therefore we upload them all in one go to avoid multiple slow uniform updates
 		glUniform1uiv(ubershaderData.picaRegLoc, 0x200 - 0x48, &regs[0x48]);
-		setupUbershaderTexEnv();
+
+		if (ubershaderDirtyGroups & RegisterGroup::TexEnv) {
+			setupUbershaderTexEnv();
+		}
+
+		ubershaderDirtyGroups = 0;
 	}
 
-	bindTexturesToSlots();
+	// The bound textures stay valid as long as their registers don't change. Anything that can delete or recreate a texture, like allocating a
+	// surface (which may evict an old one) or resetting the caches, marks the texture units as clobbered so they get bound again here
+	if (dirtyGroups & RegisterGroup::TextureUnits) {
+		bindTexturesToSlots();
+	}
 
 	if (gpu.fogLUTDirty) {
 		updateFogLUT();
@@ -521,13 +616,312 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 		}
 	}
 
-	setupStencilTest(stencilEnable);
+	if (dirtyGroups & RegisterGroup::Stencil) {
+		setupStencilTest(stencilEnable);
+	}
+}
+
+void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> vertices) {
+	hwVertexShader = nullptr;
+	if (vertices.empty()) {
+		return;
+	}
+
+	const u32 vertexBytes = u32(vertices.size_bytes());
+	if (vertexStream.needsFence(vertexBytes)) {
+		flushDraws();
+	}
+
+	setupDraw(primType, false);
+	const u32 vertexOffset = vertexStream.upload(vertices.data(), vertexBytes, sizeof(Vertex));
+
+	drawBatch.firsts.push_back(GLint(vertexOffset / sizeof(Vertex)));
+	drawBatch.counts.push_back(GLsizei(vertices.size()));
+}
+
+void RendererGL::drawIndexed(PICA::PrimType primType, std::span<const Vertex> vertices, std::span<const u16> indices) {
+	hwVertexShader = nullptr;
+	if (!supportsBaseVertex) {
+		Renderer::drawIndexed(primType, vertices, indices);
+		return;
+	}
+
+	if (indices.empty()) {
+		return;
+	}
+
+	const u32 vertexBytes = u32(vertices.size_bytes());
+	const u32 indexBytes = u32(indices.size_bytes());
+	if (vertexStream.needsFence(vertexBytes) || indexStream.needsFence(indexBytes)) {
+		flushDraws();
+	}
+
+	setupDraw(primType, true);
+	const u32 vertexOffset = vertexStream.upload(vertices.data(), vertexBytes, sizeof(Vertex));
+	const u32 indexOffset = indexStream.upload(indices.data(), indexBytes, sizeof(u16));
+
+	drawBatch.firsts.push_back(GLint(vertexOffset / sizeof(Vertex)));
+	drawBatch.counts.push_back(GLsizei(indices.size()));
+	drawBatch.indexOffsets.push_back(reinterpret_cast<const void*>(uintptr_t(indexOffset)));
+}
+
+bool RendererGL::prepareHwShader(const PICAShader& shader, const PICA::VertexConfig& config, u32 vertexCount) {
+	// Hardware shaded indexed draws index into the uploaded attributes, which needs base vertex support
+	if (config.inputCount == 0 || config.inputCount > 16 || !supportsBaseVertex) {
+		hwVertexShader = nullptr;
+		return false;
+	}
+
+	// The attributes of a draw are uploaded in one go, so draws too big for the vertex stream get shaded on the CPU instead
+	if (u64(vertexCount) * config.inputCount * sizeof(PICA::Vertex::vec4f) > vertexStreamSize / 2) {
+		hwVertexShader = nullptr;
+		return false;
+	}
+
+	auto [it, inserted] = hwShaderCache.try_emplace(config);
+	OpenGL::Shader& vertexShader = it->second;
+
+	if (inserted) {
+		std::optional<std::string> source = fragShaderGen.getHwVertexShader(shader, config);
+
+		// Shaders that failed to translate or compile stay in the cache as non-existent shaders, so that we don't retry them every draw
+		if (source.has_value()) {
+			vertexShader.create({source->c_str(), source->size()}, OpenGL::Vertex);
+		}
+	}
+
+	if (!vertexShader.exists()) {
+		hwVertexShader = nullptr;
+		return false;
+	}
+
+	PICA::VertexUniforms uniforms;
+	for (usize i = 0; i < uniforms.floats.size(); i++) {
+		for (int j = 0; j < 4; j++) {
+			uniforms.floats[i][j] = shader.floatUniforms[i][j].toFloat32();
+		}
+	}
+
+	for (usize i = 0; i < uniforms.ints.size(); i++) {
+		for (int j = 0; j < 4; j++) {
+			uniforms.ints[i][j] = shader.intUniforms[i][j];
+		}
+	}
+
+	uniforms.bools = shader.boolUniform & 0xffff;
+	uniforms.padding[0] = uniforms.padding[1] = uniforms.padding[2] = 0;
+
+	// Queued draws might use the old uniforms, so submit them before overwriting the UBO
+	if (std::memcmp(&uniforms, &hwShaderUniforms, sizeof(uniforms)) != 0) {
+		flushDraws();
+		hwShaderUniforms = uniforms;
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, hwShaderUboBinding, hwShaderUbo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(uniforms), &uniforms);
+	}
+
+	hwVertexShader = &vertexShader;
+	hwShaderStride = config.inputCount * sizeof(PICA::Vertex::vec4f);
+	return true;
+}
+
+void RendererGL::drawHwShaded(PICA::PrimType primType, std::span<const PICA::Vertex::vec4f> attributes, std::span<const u16> indices) {
+	if (attributes.empty()) {
+		return;
+	}
+
+	const bool indexed = !indices.empty();
+	const u32 attributeBytes = u32(attributes.size_bytes());
+	const u32 indexBytes = u32(indices.size_bytes());
+	if (vertexStream.needsFence(attributeBytes) || indexStream.needsFence(indexBytes)) {
+		flushDraws();
+	}
+
+	setupDraw(primType, indexed);
+	// Align the attributes to the vertex size, so that the draw can address them by vertex index
+	const u32 attributeOffset = vertexStream.upload(attributes.data(), attributeBytes, hwShaderStride);
+	drawBatch.firsts.push_back(GLint(attributeOffset / hwShaderStride));
+
+	if (indexed) {
+		const u32 indexOffset = indexStream.upload(indices.data(), indexBytes, sizeof(u16));
+		drawBatch.counts.push_back(GLsizei(indices.size()));
+		drawBatch.indexOffsets.push_back(reinterpret_cast<const void*>(uintptr_t(indexOffset)));
+	} else {
+		drawBatch.counts.push_back(GLsizei(attributeBytes / hwShaderStride));
+	}
+}
+
+static bool isInVRAM(u32 location, usize size) {
+	return location >= PhysicalAddrs::VRAM && location - PhysicalAddrs::VRAM + size <= VirtualAddrs::VramSize;
+}
+
+static SurfaceReadback::Surface toReadbackSurface(ColourBuffer& buffer) {
+	return SurfaceReadback::Surface{
+		.location = buffer.location,
+		.width = buffer.size.x(),
+		.height = buffer.size.y(),
+		.depth = false,
+		.format = static_cast<u32>(buffer.format),
+		.writeSerial = buffer.writeSerial,
+	};
+}
+
+static SurfaceReadback::Surface toReadbackSurface(DepthBuffer& buffer) {
+	return SurfaceReadback::Surface{
+		.location = buffer.location,
+		.width = buffer.size.x(),
+		.height = buffer.size.y(),
+		.depth = true,
+		.format = static_cast<u32>(buffer.format),
+		.writeSerial = buffer.writeSerial,
+	};
+}
+
+template <typename SurfaceType>
+void RendererGL::markSurfaceWritten(SurfaceType& surface) {
+	// Only CPU accesses to VRAM can be caught, so surfaces elsewhere are never written back
+	if (!isInVRAM(surface.location, surface.sizeInBytes())) {
+		return;
+	}
+
+#ifdef __ANDROID__
+	// GLES can't read back depth buffers
+	if constexpr (std::is_same<SurfaceType, DepthBuffer>()) {
+		return;
+	}
+#endif
+
+	if (!surface.isGPUDirty()) {
+		gpu.setVRAMGuard(surface.location, u32(surface.sizeInBytes()), true);
+	}
+
+	surface.writeSerial = nextWriteSerial++;
+}
+
+void RendererGL::completeReadbacks(bool wait) {
+	// Serials are unique across surfaces, so the serial of a download tells which surface it's for and whether it's still its latest write
+	const auto findSurface = [&](auto& cache, u64 writeSerial) -> decltype(&*cache.begin()) {
+		for (auto& surface : cache) {
+			if (surface.valid && surface.writeSerial == writeSerial) {
+				return &surface;
+			}
+		}
+
+		return nullptr;
+	};
+
+	const auto isCurrent = [&](u64 writeSerial) {
+		return findSurface(colourBufferCache, writeSerial) != nullptr || findSurface(depthBufferCache, writeSerial) != nullptr;
+	};
+
+	const std::vector<u64> written = surfaceReadback.complete(gpu.getPointerPhys<u8>(PhysicalAddrs::VRAM), wait, isCurrent);
+	if (written.empty()) {
+		return;
+	}
+
+	const auto markWrittenBack = [&](auto* surface) {
+		if (surface != nullptr) {
+			surface->readbackSerial = surface->writeSerial;
+			gpu.setVRAMGuard(surface->location, u32(surface->sizeInBytes()), false);
+		}
+	};
+
+	for (u64 writeSerial : written) {
+		markWrittenBack(findSurface(colourBufferCache, writeSerial));
+		markWrittenBack(findSurface(depthBufferCache, writeSerial));
+	}
+
+	guardDirtySurfaces();
+}
+
+void RendererGL::guardDirtySurfaces() {
+	// Surfaces can share pages, so unguarding one surface's pages might have cleared the guards of a neighbour that's still dirty
+	const auto guard = [&](auto& cache) {
+		for (auto& surface : cache) {
+			if (surface.valid && surface.isGPUDirty()) {
+				gpu.setVRAMGuard(surface.location, u32(surface.sizeInBytes()), true);
+			}
+		}
+	};
+	guard(colourBufferCache);
+	guard(depthBufferCache);
+}
+
+void RendererGL::flushVRAM(u32 paddr, u32 size) {
+	flushDraws();
+	const u32 end = paddr + size;
+
+	// Download every dirty surface overlapping the range that isn't being downloaded already. From now on these get downloaded every frame,
+	// so that the next access finds their data already there
+	const auto startDownloads = [&](auto& cache) {
+		for (auto& surface : cache) {
+			if (surface.valid && surface.isGPUDirty() && surface.location < end && surface.location + surface.sizeInBytes() > paddr) {
+				surface.cpuAccessed = true;
+
+				if (!surfaceReadback.isPending(surface.writeSerial)) {
+					surfaceReadback.start(toReadbackSurface(surface), surface.fbo);
+				}
+			}
+		}
+	};
+	startDownloads(colourBufferCache);
+	startDownloads(depthBufferCache);
+
+	// This waits for the downloads started at the end of last frame too, but those are normally done by now
+	completeReadbacks(true);
+	// The memory unguarded the accessed pages before calling us, which might have included pages of surfaces we didn't write back
+	guardDirtySurfaces();
+}
+
+void RendererGL::flushDraws() {
+	if (drawBatch.empty()) {
+		return;
+	}
+
+	const GLenum topology = static_cast<GLenum>(drawBatch.topology);
+	const GLsizei drawCount = GLsizei(drawBatch.counts.size());
+
+	if (drawBatch.indexed) {
+		if (supportsMultiDraw && drawCount > 1) {
+			glMultiDrawElementsBaseVertex(
+				topology, drawBatch.counts.data(), GL_UNSIGNED_SHORT, drawBatch.indexOffsets.data(), drawCount, drawBatch.firsts.data()
+			);
+		} else {
+			for (GLsizei i = 0; i < drawCount; i++) {
+				glDrawElementsBaseVertex(topology, drawBatch.counts[i], GL_UNSIGNED_SHORT, drawBatch.indexOffsets[i], drawBatch.firsts[i]);
+			}
+		}
+	} else {
+		if (supportsMultiDraw && drawCount > 1) {
+			glMultiDrawArrays(topology, drawBatch.firsts.data(), drawBatch.counts.data(), drawCount);
+		} else {
+			for (GLsizei i = 0; i < drawCount; i++) {
+				glDrawArrays(topology, drawBatch.firsts[i], drawBatch.counts[i]);
+			}
+		}
+	}
 
-	vbo.bufferVertsSub(vertices);
-	OpenGL::draw(primitiveTopology, GLsizei(vertices.size()));
+	// The stream buffers can only reuse the space these draws read from once the GPU is past them
+	vertexStream.fence();
+	indexStream.fence();
+	drawBatch.clear();
 }
 
 void RendererGL::display() {
+	flushDraws();
+
+	// Write back last frame's surface downloads that are done, then download the surfaces the CPU reads from that got rendered to since.
+	// The downloads are picked up at the next frame, so unless the CPU touches the surfaces sooner it never waits on the GPU
+	completeReadbacks(false);
+	const auto startDownloads = [&](auto& cache) {
+		for (auto& surface : cache) {
+			if (surface.valid && surface.cpuAccessed && surface.isGPUDirty() && !surfaceReadback.isPending(surface.writeSerial)) {
+				surfaceReadback.start(toReadbackSurface(surface), surface.fbo);
+			}
+		}
+	};
+	startDownloads(colourBufferCache);
+	startDownloads(depthBufferCache);
 	gl.disableScissor();
 	gl.disableBlend();
 	gl.disableDepth();
@@ -536,6 +930,8 @@ void RendererGL::display() {
 	gl.setColourMask(true, true, true, true);
 	gl.useProgram(displayProgram);
 	gl.bindVAO(dummyVAO);
+	// The blending and texture unit 0 state set up here is what the next draw would otherwise have expected to still be there
+	clobberedRegisterGroups |= RegisterGroup::Blend | RegisterGroup::TextureUnits;
 
 	gl.disableClipPlane(0);
 	gl.disableClipPlane(1);
@@ -565,15 +961,26 @@ void RendererGL::display() {
 		OpenGL::draw(OpenGL::TriangleStrip, 4);
 	}
 
-	if constexpr (!Helpers::isHydraCore()) {
+	if (presentThreadEnabled) {
+		framePresenter.publish(screenFramebuffer);
+	} else if constexpr (!Helpers::isHydraCore()) {
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 		screenFramebuffer.bind(OpenGL::ReadFramebuffer);
 		glBlitFramebuffer(0, 0, 400, 480, 0, 0, outputWindowWidth, outputWindowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 	}
 }
 
+void RendererGL::setPresentThreadEnabled(bool enable) {
+	if (enable && !framePresenter.isInitialized()) {
+		framePresenter.init(400, 480);
+	}
+
+	presentThreadEnabled = enable;
+}
+
 void RendererGL::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) {
 	log("GPU: Clear buffer\nStart: %08X End: %08X\nValue: %08X Control: %08X\n", startAddress, endAddress, value, control);
+	flushDraws();
 	gl.disableScissor();
 
 	const auto color = colourBufferCache.findFromAddress(startAddress);
@@ -583,6 +990,7 @@ void RendererGL::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 co
 		const float b = getBits<8, 8>(value) / 255.0f;
 		const float a = (value & 0xff) / 255.0f;
 		color->get().fbo.bind(OpenGL::DrawFramebuffer);
+		markSurfaceWritten(color->get());
 
 		gl.setColourMask(true, true, true, true);
 		gl.setClearColour(r, g, b, a);
@@ -593,6 +1001,7 @@ void RendererGL::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 co
 	const auto depth = depthBufferCache.findFromAddress(startAddress);
 	if (depth) {
 		depth->get().fbo.bind(OpenGL::DrawFramebuffer);
+		markSurfaceWritten(depth->get());
 
 		float depthVal;
 		const auto format = depth->get().format;
@@ -608,6 +1017,7 @@ void RendererGL::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 co
 		if (format == DepthFmt::Depth24Stencil8) {
 			const u8 stencil = (value >> 24);
 			gl.setStencilMask(0xff);
+			clobberedRegisterGroups |= RegisterGroup::Stencil;
 			OpenGL::setClearStencil(stencil);
 			OpenGL::clearDepthAndStencil();
 		} else {
@@ -629,6 +1039,7 @@ OpenGL::Framebuffer RendererGL::getColourFBO() {
 	if (buffer.has_value()) {
 		return buffer.value().get().fbo;
 	} else {
+		clobberedRegisterGroups |= RegisterGroup::TextureUnits;
 		return colourBufferCache.add(sampleBuffer).fbo;
 	}
 }
@@ -637,14 +1048,16 @@ void RendererGL::bindDepthBuffer() {
 	// Similar logic as the getColourFBO function
 	DepthBuffer sampleBuffer(depthBufferLoc, depthBufferFormat, fbSize[0], fbSize[1]);
 	auto buffer = depthBufferCache.find(sampleBuffer);
-	GLuint tex;
-
-	if (buffer.has_value()) {
-		tex = buffer.value().get().texture.m_handle;
-	} else {
-		tex = depthBufferCache.add(sampleBuffer).texture.m_handle;
+	if (!buffer.has_value()) {
+		clobberedRegisterGroups |= RegisterGroup::TextureUnits;
 	}
 
+	DepthBuffer& depthBuffer = buffer.has_value() ? buffer.value().get() : depthBufferCache.add(sampleBuffer);
+	GLuint tex = depthBuffer.texture.m_handle;
+
+	// The depth buffer only gets bound when the draw tests or writes depth or stencil. Treat it as written either way
+	markSurfaceWritten(depthBuffer);
+
 	if (PICA::DepthFmt::Depth24Stencil8 != depthBufferFormat) {
 		Helpers::panicDev("TODO: Should we remove stencil attachment?");
 	}
@@ -660,6 +1073,8 @@ OpenGL::Texture RendererGL::getTexture(Texture& tex) {
 		return buffer.value().get().texture;
 	} else {
 		const auto textureData = std::span{gpu.getPointerPhys<u8>(tex.location), tex.sizeInBytes()};  // Get pointer to the texture data in 3DS memory
+		// Adding a texture may evict one that an earlier unit got bound to
+		clobberedRegisterGroups |= RegisterGroup::TextureUnits;
 		Texture& newTex = textureCache.add(tex);
 		newTex.decodeTexture(textureData);
 
@@ -677,6 +1092,8 @@ PICA::ColorFmt ToColorFmt(u32 format) {
 }
 
 void RendererGL::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) {
+	flushDraws();
+
 	const u32 inputWidth = inputSize & 0xffff;
 	const u32 inputHeight = inputSize >> 16;
 	const auto inputFormat = ToColorFmt(Helpers::getBits<8, 3>(flags));
@@ -725,6 +1142,8 @@ void RendererGL::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u
 }
 
 void RendererGL::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) {
+	flushDraws();
+
 	// Texture copy size is aligned to 16 byte units
 	const u32 copySize = totalBytes & ~0xf;
 	if (copySize == 0) {
@@ -746,7 +1165,8 @@ void RendererGL::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32
 	}
 
 	if (inputWidth != outputWidth) {
-		Helpers::warn("Input width does not match output width, cannot accelerate texture copy!");
+		// Can't be done as a blit, so run it on the CPU instead
+		Renderer::textureCopy(inputAddr, outputAddr, totalBytes, inputSize, outputSize, flags);
 		return;
 	}
 
@@ -776,12 +1196,12 @@ void RendererGL::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32
 	// Find the source surface.
 	auto srcFramebuffer = getColourBuffer(inputAddr, PICA::ColorFmt::RGBA8, copyStride, copyHeight, false);
 	if (!srcFramebuffer) {
-		static int shutUpCounter = 0; // Don't want to spam the console too much, so shut up after 5 times
-
-		if (shutUpCounter < 5) {
-			shutUpCounter++;
-			printf("RendererGL::TextureCopy failed to locate src framebuffer!\n");
+		if (cpuTextureCopyCount < 5) {
+			cpuTextureCopyCount++;
+			printf("RendererGL::TextureCopy failed to locate src framebuffer, copying on the CPU\n");
 		}
+
+		Renderer::textureCopy(inputAddr, outputAddr, totalBytes, inputSize, outputSize, flags);
 		return;
 	}
 
@@ -792,6 +1212,12 @@ void RendererGL::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32
 	auto destFramebuffer = getColourBuffer(outputAddr, srcFramebuffer->format, copyWidth, copyHeight);
 	Math::Rect<u32> destRect = destFramebuffer->getSubRect(outputAddr, copyWidth, copyHeight);
 
+	// Texture copies keep the tiling of the source, so the destination can be written back like a render target.
+	// Display transfers aren't tracked, as their output is usually linear and the write back only handles tiled surfaces
+	if (auto destBuffer = colourBufferCache.find(destFramebuffer.value())) {
+		markSurfaceWritten(destBuffer->get());
+	}
+
 	// Blit the framebuffers
 	srcFramebuffer->fbo.bind(OpenGL::ReadFramebuffer);
 	destFramebuffer->fbo.bind(OpenGL::DrawFramebuffer);
@@ -818,42 +1244,65 @@ std::optional<ColourBuffer> RendererGL::getColourBuffer(u32 addr, PICA::ColorFmt
 
 	// Otherwise create and cache a new buffer.
 	ColourBuffer sampleBuffer(addr, format, width, height);
+	clobberedRegisterGroups |= RegisterGroup::TextureUnits;
 	return colourBufferCache.add(sampleBuffer);
 }
 
 OpenGL::Program& RendererGL::getSpecializedShader() {
 	constexpr uint uboBlockBinding = 2;
 
-	PICA::FragmentConfig fsConfig(regs);
-
-	CachedProgram& programEntry = shaderCache[fsConfig];
-	OpenGL::Program& program = programEntry.program;
-
-	if (!program.exists()) {
-		std::string fs = fragShaderGen.generate(fsConfig);
+	// Nothing the fragment config or uniforms are built from changed since the last specialized draw, so its program and UBO can be reused as-is
+	if (specializedDirtyGroups == 0 && lastSpecializedProgram != nullptr && lastSpecializedVertexShader == hwVertexShader) {
+		glBindBufferBase(GL_UNIFORM_BUFFER, uboBlockBinding, lastSpecializedProgram->uboBinding);
+		return lastSpecializedProgram->getProgram(hwVertexShader);
+	}
 
-		OpenGL::Shader fragShader({fs.c_str(), fs.size()}, OpenGL::Fragment);
-		program.create({defaultShadergenVs, fragShader});
+	const auto initProgram = [&](OpenGL::Program& program) {
 		gl.useProgram(program);
 
-		fragShader.free();
-
 		// Init sampler objects. Texture 0 goes in texture unit 0, texture 1 in TU 1, texture 2 in TU 2, and the light maps go in TU 3
 		glUniform1i(OpenGL::uniformLocation(program, "u_tex0"), 0);
 		glUniform1i(OpenGL::uniformLocation(program, "u_tex1"), 1);
 		glUniform1i(OpenGL::uniformLocation(program, "u_tex2"), 2);
 		glUniform1i(OpenGL::uniformLocation(program, "u_tex_luts"), 3);
 
+		// Set up the binding for our UBO. Sadly we can't specify it in the shader like normal people,
+		// As it's an OpenGL 4.2 feature that MacOS doesn't support...
+		uint uboIndex = glGetUniformBlockIndex(program.handle(), "FragmentUniforms");
+		glUniformBlockBinding(program.handle(), uboIndex, uboBlockBinding);
+	};
+
+	PICA::FragmentConfig fsConfig(regs);
+
+	CachedProgram& programEntry = shaderCache[fsConfig];
+
+	if (!programEntry.program.exists()) {
+		std::string fs = fragShaderGen.generate(fsConfig);
+
+		// The fragment shader is kept around, as it gets linked with hardware vertex shaders too
+		programEntry.fragmentShader.create({fs.c_str(), fs.size()}, OpenGL::Fragment);
+		programEntry.program.create({defaultShadergenVs, programEntry.fragmentShader});
+		initProgram(programEntry.program);
+
 		// Allocate memory for the program UBO
 		glGenBuffers(1, &programEntry.uboBinding);
 		gl.bindUBO(programEntry.uboBinding);
 		glBufferData(GL_UNIFORM_BUFFER, sizeof(PICA::FragmentUniforms), nullptr, GL_DYNAMIC_DRAW);
+	}
 
-		// Set up the binding for our UBO. Sadly we can't specify it in the shader like normal people,
-		// As it's an OpenGL 4.2 feature that MacOS doesn't support...
-		uint uboIndex = glGetUniformBlockIndex(program.handle(), "FragmentUniforms");
-		glUniformBlockBinding(program.handle(), uboIndex, uboBlockBinding);
+	if (hwVertexShader != nullptr) {
+		OpenGL::Program& hwProgram = programEntry.hwShaderPrograms[hwVertexShader->handle()];
+
+		if (!hwProgram.exists()) {
+			hwProgram.create({*hwVertexShader, programEntry.fragmentShader});
+			initProgram(hwProgram);
+
+			uint vertexUboIndex = glGetUniformBlockIndex(hwProgram.handle(), "VertexUniforms");
+			glUniformBlockBinding(hwProgram.handle(), vertexUboIndex, hwShaderUboBinding);
+		}
 	}
+
+	OpenGL::Program& program = programEntry.getProgram(hwVertexShader);
 	glBindBufferBase(GL_UNIFORM_BUFFER, uboBlockBinding, programEntry.uboBinding);
 
 	// Upload uniform data to our shader's UBO
@@ -939,10 +1388,15 @@ OpenGL::Program& RendererGL::getSpecializedShader() {
 	gl.bindUBO(programEntry.uboBinding);
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PICA::FragmentUniforms), &uniforms);
 
+	lastSpecializedProgram = &programEntry;
+	lastSpecializedVertexShader = hwVertexShader;
+	specializedDirtyGroups = 0;
 	return program;
 }
 
 void RendererGL::screenshot(const std::string& name) {
+	flushDraws();
+
 	constexpr uint width = 400;
 	constexpr uint height = 2 * 240;
 
@@ -968,21 +1422,50 @@ void RendererGL::screenshot(const std::string& name) {
 }
 
 void RendererGL::clearShaderCache() {
+	flushDraws();
+
 	for (auto& shader : shaderCache) {
 		CachedProgram& cachedProgram = shader.second;
 		cachedProgram.program.free();
+		cachedProgram.fragmentShader.free();
 		glDeleteBuffers(1, &cachedProgram.uboBinding);
+
+		for (auto& hwProgram : cachedProgram.hwShaderPrograms) {
+			hwProgram.second.free();
+		}
+	}
+
+	for (auto& shader : hwShaderCache) {
+		shader.second.free();
 	}
 
 	shaderCache.clear();
+	hwShaderCache.clear();
+	lastSpecializedProgram = nullptr;
+	lastSpecializedVertexShader = nullptr;
+	hwVertexShader = nullptr;
 }
 
 void RendererGL::deinitGraphicsContext() {
+	flushDraws();
+	vertexStream.release();
+	indexStream.release();
+	glDeleteBuffers(1, &hwShaderUbo);
+	hwShaderUbo = 0;
+
 	// Invalidate all surface caches since they'll no longer be valid
+	surfaceReadback.reset();
 	textureCache.reset();
 	depthBufferCache.reset();
 	colourBufferCache.reset();
 	clearShaderCache();
+	clobberedRegisterGroups |= RegisterGroup::TextureUnits;
+
+	// The frontend has to stop presenting before the context goes, and enable presentation again once there's a new one
+	if (framePresenter.isInitialized()) {
+		framePresenter.free();
+	}
+	presentThreadEnabled = false;
 
 	// All other GL objects should be invalidated automatically and be recreated by the next call to initGraphicsContext
 	// TODO: Make it so that depth and colour buffers get written back to 3DS memory
@@ -997,6 +1480,8 @@ std::string RendererGL::getUbershader() {
 }
 
 void RendererGL::setUbershader(const std::string& shader) {
+	flushDraws();
+
 	auto gl_resources = cmrc::RendererGL::get_filesystem();
 	auto vertexShaderSource = gl_resources.open("opengl_vertex_shader.vert");
 
@@ -1005,6 +1490,7 @@ void RendererGL::setUbershader(const std::string& shader) {
 	triangleProgram.create({vert, frag});
 
 	initUbershader(triangleProgram);
+	ubershaderDirtyGroups = PICA::RegisterGroup::All;
 
 	glUniform1f(ubershaderData.depthScaleLoc, oldDepthScale);
 	glUniform1f(ubershaderData.depthOffsetLoc, oldDepthOffset);
@@ -0,0 +1,153 @@
+#include "renderer_gl/stream_buffer.hpp"
+
+#include <cstring>
+
+// Buffers are bound to GL_COPY_WRITE_BUFFER for creation and mapping, so that we don't disturb the VBO or the VAO's element buffer binding
+static constexpr GLenum streamTarget = GL_COPY_WRITE_BUFFER;
+
+void StreamBuffer::create(u32 bufferSize) {
+	release();
+
+	size = bufferSize;
+	segmentSize = bufferSize / segmentCount;
+	glGenBuffers(1, &handle);
+	glBindBuffer(streamTarget, handle);
+
+	// Buffer storage is core in GL 4.4, and an extension on GLES. Without it, fall back to mapping every upload
+	constexpr GLbitfield storageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	bool hasStorage = false;
+
+	if (glBufferStorage != nullptr) {
+		glBufferStorage(streamTarget, size, nullptr, storageFlags);
+		hasStorage = true;
+	} else if (glBufferStorageEXT != nullptr) {
+		glBufferStorageEXT(streamTarget, size, nullptr, storageFlags);
+		hasStorage = true;
+	}
+
+	if (hasStorage) {
+		mappedPointer = static_cast<u8*>(glMapBufferRange(streamTarget, 0, size, storageFlags));
+		if (mappedPointer == nullptr) {
+			Helpers::warn("StreamBuffer: Failed to persistently map buffer, falling back to mapping on every upload");
+
+			// Buffers with immutable storage can't be reallocated, so make a new one
+			glDeleteBuffers(1, &handle);
+			glGenBuffers(1, &handle);
+			glBindBuffer(streamTarget, handle);
+			hasStorage = false;
+		}
+	}
+
+	if (!hasStorage) {
+		glBufferData(streamTarget, size, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+void StreamBuffer::release() {
+	for (auto& fence : fences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	if (handle != 0) {
+		if (mappedPointer != nullptr) {
+			glBindBuffer(streamTarget, handle);
+			glUnmapBuffer(streamTarget);
+		}
+
+		glDeleteBuffers(1, &handle);
+	}
+
+	handle = 0;
+	mappedPointer = nullptr;
+	position = 0;
+	currentSegment = 0;
+	unfencedBytes = 0;
+	unfencedSegments = 0;
+}
+
+void StreamBuffer::waitForSegment(u32 segment) {
+	GLsync& fence = fences[segment];
+	if (fence == nullptr) {
+		return;
+	}
+
+	// Flush on the first wait, as a fence that never got submitted would never signal
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (result == GL_TIMEOUT_EXPIRED) {
+		result = glClientWaitSync(fence, 0, 1'000'000);  // 1ms
+	}
+
+	if (result == GL_WAIT_FAILED) {
+		Helpers::warn("StreamBuffer: Failed to wait for fence");
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+u32 StreamBuffer::upload(const void* data, u32 bytes, u32 alignment) {
+	// Data bigger than this could wrap around onto the segment the write pointer is in, which might still have draws pending
+	if (bytes > size / 2) [[unlikely]] {
+		Helpers::panic("StreamBuffer: Upload of %d bytes is too big for a %d byte buffer", bytes, size);
+	}
+
+	u32 offset = (position + alignment - 1) / alignment * alignment;
+	if (offset + bytes > size) {
+		offset = 0;
+	}
+
+	const u32 firstSegment = offset / segmentSize;
+	const u32 lastSegment = (offset + bytes - 1) / segmentSize;
+
+	// Wait on the segments the write pointer enters. The segment it's already in has nothing to wait on, as anything the GPU might still
+	// be reading from it was written before the data we already put there
+	for (u32 segment = firstSegment; segment <= lastSegment; segment++) {
+		if (segment != currentSegment) {
+			waitForSegment(segment);
+		}
+
+		unfencedSegments |= 1 << segment;
+	}
+
+	if (mappedPointer != nullptr) {
+		std::memcpy(mappedPointer + offset, data, bytes);
+	} else {
+		glBindBuffer(streamTarget, handle);
+		void* pointer = glMapBufferRange(streamTarget, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+
+		if (pointer != nullptr) [[likely]] {
+			std::memcpy(pointer, data, bytes);
+			glUnmapBuffer(streamTarget);
+		} else {
+			glBufferSubData(streamTarget, offset, bytes, data);
+		}
+	}
+
+	// Count padding and the skipped tail of the buffer too, so that needsFence stays conservative
+	unfencedBytes += (offset >= position) ? (offset - position + bytes) : (size - position + bytes);
+	position = offset + bytes;
+	currentSegment = lastSegment;
+
+	return offset;
+}
+
+void StreamBuffer::fence() {
+	for (u32 segment = 0; segment < segmentCount; segment++) {
+		if ((unfencedSegments & (1 << segment)) == 0) {
+			continue;
+		}
+
+		// A newer fence implies the older one, so the older one can go
+		if (fences[segment] != nullptr) {
+			glDeleteSync(fences[segment]);
+		}
+
+		fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	unfencedSegments = 0;
+	unfencedBytes = 0;
+}
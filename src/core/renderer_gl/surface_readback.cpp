@@ -0,0 +1,199 @@
+#include "renderer_gl/surface_readback.hpp"
+
+#include <cstring>
+
+#include "memory.hpp"
+#include "renderer_gl/textures.hpp"
+
+// glReadPixels returns RGBA8 pixels for colour surfaces and one u32 per pixel for depth ones, so the downloads are always 4 bytes per pixel
+static constexpr u32 downloadBytesPerPixel = 4;
+
+static usize downloadSize(const SurfaceReadback::Surface& surface) { return usize(surface.width) * surface.height * downloadBytesPerPixel; }
+
+void SurfaceReadback::start(const Surface& surface, OpenGL::Framebuffer& fbo) {
+	GLuint buffer;
+	if (freeBuffers.empty()) {
+		glGenBuffers(1, &buffer);
+	} else {
+		buffer = freeBuffers.back();
+		freeBuffers.pop_back();
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, downloadSize(surface), nullptr, GL_STREAM_READ);
+	fbo.bind(OpenGL::ReadFramebuffer);
+
+	// With a pixel pack buffer bound, glReadPixels only queues the copy into it instead of waiting for the GPU
+	if (!surface.depth) {
+		glReadPixels(0, 0, surface.width, surface.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	} else if (static_cast<PICA::DepthFmt>(surface.format) == PICA::DepthFmt::Depth24Stencil8) {
+		glReadPixels(0, 0, surface.width, surface.height, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+	} else {
+		glReadPixels(0, 0, surface.width, surface.height, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	downloads.push_back(Download{.surface = surface, .buffer = buffer, .fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+}
+
+bool SurfaceReadback::isPending(u64 writeSerial) const {
+	for (const auto& download : downloads) {
+		if (download.surface.writeSerial == writeSerial) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SurfaceReadback::waitForDownload(Download& download, bool wait) {
+	// Flush on the first check, as a fence that never got submitted would never signal
+	GLenum result = glClientWaitSync(download.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED && !wait) {
+		return false;
+	}
+
+	while (result == GL_TIMEOUT_EXPIRED) {
+		result = glClientWaitSync(download.fence, 0, 1'000'000);  // 1ms
+	}
+
+	if (result == GL_WAIT_FAILED) {
+		Helpers::warn("SurfaceReadback: Failed to wait for fence");
+	}
+
+	return true;
+}
+
+void SurfaceReadback::writeBack(const Download& download, u8* vram) {
+	const Surface& surface = download.surface;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, download.buffer);
+	const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, downloadSize(surface), GL_MAP_READ_BIT);
+
+	if (pixels != nullptr) [[likely]] {
+		encode(surface, static_cast<const u8*>(pixels), &vram[surface.location - PhysicalAddrs::VRAM]);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	} else {
+		Helpers::warn("SurfaceReadback: Failed to map download of surface at %08X", surface.location);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void SurfaceReadback::encode(const Surface& surface, const u8* pixels, u8* vram) {
+	const u32 bpp =
+		surface.depth ? PICA::sizePerPixel(static_cast<PICA::DepthFmt>(surface.format)) : PICA::sizePerPixel(static_cast<PICA::ColorFmt>(surface.format));
+	const usize surfaceSize = usize(surface.width) * surface.height * bpp;
+
+	for (u32 y = 0; y < surface.height; y++) {
+		// OpenGL returns the rows bottom to top, while VRAM stores them top to bottom
+		const u8* row = &pixels[usize(surface.height - 1 - y) * surface.width * downloadBytesPerPixel];
+
+		for (u32 x = 0; x < surface.width; x++) {
+			const u32 offset = Texture::getSwizzledOffset(x, y, surface.width, bpp);
+			// Heights that aren't a multiple of 8 leave the last row of tiles partially outside the surface
+			if (offset + bpp > surfaceSize) [[unlikely]] {
+				continue;
+			}
+
+			const u8* pixel = &row[x * downloadBytesPerPixel];
+			u8* out = &vram[offset];
+
+			if (surface.depth) {
+				u32 value;
+				std::memcpy(&value, pixel, sizeof(u32));
+
+				switch (static_cast<PICA::DepthFmt>(surface.format)) {
+					case PICA::DepthFmt::Depth16: {
+						// Depth is read back normalized to 32 bits
+						const u16 depth = u16(value >> 16);
+						out[0] = u8(depth);
+						out[1] = u8(depth >> 8);
+						break;
+					}
+
+					case PICA::DepthFmt::Depth24Stencil8: {
+						// GL_UNSIGNED_INT_24_8 has the depth in the top 24 bits, while the PICA stores it in the bottom 24 with the stencil on top
+						const u32 depth = value >> 8;
+						out[0] = u8(depth);
+						out[1] = u8(depth >> 8);
+						out[2] = u8(depth >> 16);
+						out[3] = u8(value);
+						break;
+					}
+
+					default: {
+						const u32 depth = value >> 8;
+						out[0] = u8(depth);
+						out[1] = u8(depth >> 8);
+						out[2] = u8(depth >> 16);
+						break;
+					}
+				}
+
+				continue;
+			}
+
+			const u8 r = pixel[0];
+			const u8 g = pixel[1];
+			const u8 b = pixel[2];
+			const u8 a = pixel[3];
+
+			// The inverse of Texture::decodeTexel
+			switch (static_cast<PICA::ColorFmt>(surface.format)) {
+				case PICA::ColorFmt::RGBA8:
+					out[0] = a;
+					out[1] = b;
+					out[2] = g;
+					out[3] = r;
+					break;
+
+				case PICA::ColorFmt::RGB8:
+					out[0] = b;
+					out[1] = g;
+					out[2] = r;
+					break;
+
+				case PICA::ColorFmt::RGBA5551: {
+					const u16 texel = u16((r >> 3) << 11) | u16((g >> 3) << 6) | u16((b >> 3) << 1) | u16(a >> 7);
+					out[0] = u8(texel);
+					out[1] = u8(texel >> 8);
+					break;
+				}
+
+				case PICA::ColorFmt::RGB565: {
+					const u16 texel = u16((r >> 3) << 11) | u16((g >> 2) << 5) | u16(b >> 3);
+					out[0] = u8(texel);
+					out[1] = u8(texel >> 8);
+					break;
+				}
+
+				case PICA::ColorFmt::RGBA4: {
+					const u16 texel = u16((r >> 4) << 12) | u16((g >> 4) << 8) | u16((b >> 4) << 4) | u16(a >> 4);
+					out[0] = u8(texel);
+					out[1] = u8(texel >> 8);
+					break;
+				}
+
+				default: break;
+			}
+		}
+	}
+}
+
+void SurfaceReadback::release(Download& download) {
+	glDeleteSync(download.fence);
+	freeBuffers.push_back(download.buffer);
+}
+
+void SurfaceReadback::reset() {
+	for (auto& download : downloads) {
+		release(download);
+	}
+	downloads.clear();
+
+	if (!freeBuffers.empty()) {
+		glDeleteBuffers(GLsizei(freeBuffers.size()), freeBuffers.data());
+		freeBuffers.clear();
+	}
+}
@@ -1,12 +1,14 @@
 #include "renderer_vk/renderer_vk.hpp"
 
 #include <cmrc/cmrc.hpp>
+#include <cstring>
 #include <limits>
 #include <span>
 #include <unordered_set>
 
 #include "SDL_vulkan.h"
 #include "helpers.hpp"
+#include "io_file.hpp"
 #include "renderer_vk/vk_debug.hpp"
 #include "renderer_vk/vk_memory.hpp"
 #include "renderer_vk/vk_pica.hpp"
@@ -59,7 +61,7 @@ static inline vk::UniqueShaderModule createShaderModule(vk::Device device, cmrc:
 std::tuple<vk::UniquePipeline, vk::UniquePipelineLayout> createGraphicsPipeline(
 	vk::Device device, std::span<const vk::PushConstantRange> pushConstants, std::span<const vk::DescriptorSetLayout> setLayouts,
 	vk::ShaderModule vertModule, vk::ShaderModule fragModule, std::span<const vk::VertexInputBindingDescription> vertexBindingDescriptions,
-	std::span<const vk::VertexInputAttributeDescription> vertexAttributeDescriptions, vk::RenderPass renderPass
+	std::span<const vk::VertexInputAttributeDescription> vertexAttributeDescriptions, vk::RenderPass renderPass, vk::PipelineCache pipelineCache = {}
 ) {
 	// Create Pipeline Layout
 	vk::PipelineLayoutCreateInfo graphicsPipelineLayoutInfo = {};
@@ -196,7 +198,7 @@ std::tuple<vk::UniquePipeline, vk::UniquePipelineLayout> createGraphicsPipeline(
 	// Create Pipeline
 	vk::UniquePipeline pipeline = {};
 
-	if (auto createResult = device.createGraphicsPipelineUnique({}, renderPipelineInfo); createResult.result == vk::Result::eSuccess) {
+	if (auto createResult = device.createGraphicsPipelineUnique(pipelineCache, renderPipelineInfo); createResult.result == vk::Result::eSuccess) {
 		pipeline = std::move(createResult.value);
 	} else {
 		Helpers::panic("Error creating graphics pipeline: %s\n", vk::to_string(createResult.result).c_str());
@@ -314,7 +316,8 @@ RendererVK::Texture& RendererVK::getColorRenderTexture(u32 addr, PICA::ColorFmt
 		Helpers::panic("Error creating color render-texture: %s\n", vk::to_string(createResult.result).c_str());
 	}
 
-	// Initial layout transition
+	// Initial layout transition. Barriers can't be recorded inside a render pass, so end the open one first
+	endRenderPass();
 	getCurrentCommandBuffer().pipelineBarrier(
 		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags{}, {}, {},
 		{vk::ImageMemoryBarrier(
@@ -388,10 +391,11 @@ RendererVK::Texture& RendererVK::getDepthRenderTexture(u32 addr, PICA::DepthFmt
 		Helpers::panic("Error creating depth render-texture: %s\n", vk::to_string(createResult.result).c_str());
 	}
 
-	// Initial layout transition (depth and/or stencil)
+	// Initial layout transition (depth and/or stencil). Barriers can't be recorded inside a render pass, so end the open one first
 	if (vk::componentCount(newTexture.format) == 2) {
 		viewInfo.subresourceRange.aspectMask |= vk::ImageAspectFlagBits::eStencil;
 	}
+	endRenderPass();
 	getCurrentCommandBuffer().pipelineBarrier(
 		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags{}, {}, {},
 		{vk::ImageMemoryBarrier(
@@ -403,8 +407,10 @@ RendererVK::Texture& RendererVK::getDepthRenderTexture(u32 addr, PICA::DepthFmt
 	return newTexture;
 }
 
-vk::RenderPass RendererVK::getRenderPass(vk::Format colorFormat, std::optional<vk::Format> depthFormat) {
+vk::RenderPass RendererVK::getRenderPass(vk::Format colorFormat, std::optional<vk::Format> depthFormat, bool clearColor, bool clearDepth) {
+	// Format enums fit in 30 bits, which leaves the top 2 bits for the load ops
 	u64 renderPassHash = static_cast<u32>(colorFormat);
+	renderPassHash |= (static_cast<u64>(clearColor) << 62) | (static_cast<u64>(clearDepth) << 63);
 
 	if (depthFormat.has_value()) {
 		renderPassHash |= (static_cast<u64>(depthFormat.value()) << 32);
@@ -424,7 +430,7 @@ vk::RenderPass RendererVK::getRenderPass(vk::Format colorFormat, std::optional<v
 	vk::AttachmentDescription colorAttachment = {};
 	colorAttachment.format = colorFormat;
 	colorAttachment.samples = vk::SampleCountFlagBits::e1;
-	colorAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+	colorAttachment.loadOp = clearColor ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
 	colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
 	colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eLoad;
 	colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eStore;
@@ -436,9 +442,9 @@ vk::RenderPass RendererVK::getRenderPass(vk::Format colorFormat, std::optional<v
 		vk::AttachmentDescription depthAttachment = {};
 		depthAttachment.format = depthFormat.value();
 		depthAttachment.samples = vk::SampleCountFlagBits::e1;
-		depthAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+		depthAttachment.loadOp = clearDepth ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
 		depthAttachment.storeOp = vk::AttachmentStoreOp::eStore;
-		depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eLoad;
+		depthAttachment.stencilLoadOp = clearDepth ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
 		depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eStore;
 		depthAttachment.initialLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
 		depthAttachment.finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
@@ -627,11 +633,146 @@ vk::Result RendererVK::recreateSwapchain(vk::SurfaceKHR surface, vk::Extent2D sw
 RendererVK::RendererVK(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
 	: Renderer(gpu, internalRegs, externalRegs) {}
 
-RendererVK::~RendererVK() {}
+RendererVK::~RendererVK() { savePipelineCache(); }
 
-void RendererVK::reset() { renderPassCache.clear(); }
+void RendererVK::reset() {
+	endRenderPass();
+	renderPassCache.clear();
+
+	// The next title gets its own pipeline cache
+	savePipelineCache();
+	pipelineCacheNeedsLoad = true;
+}
+
+void RendererVK::loadPipelineCache() {
+	pipelineCacheNeedsLoad = false;
+
+	const std::filesystem::path path = appDataPath.empty() ? std::filesystem::path() : appDataPath / "vulkan_pipeline_cache.bin";
+	if (!pipelineCache || path == pipelineCachePath) {
+		return;
+	}
+
+	savePipelineCache();
+	pipelineCachePath = path;
+
+	std::vector<u8> data;
+	std::error_code ec;
+	if (!path.empty() && std::filesystem::exists(path, ec)) {
+		IOFile file(path, "rb");
+		const u64 size = file.isOpen() ? file.size().value_or(0) : 0;
+		data.resize(size);
+
+		if (size == 0 || file.readBytes(data.data(), size).second != size) {
+			data.clear();
+		}
+	}
+
+	// Drivers are meant to reject caches from other devices or driver versions themselves, but not all of them do
+	const vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+	const bool compatible = data.size() >= 16 + VK_UUID_SIZE && *reinterpret_cast<const u32*>(&data[8]) == properties.vendorID &&
+							*reinterpret_cast<const u32*>(&data[12]) == properties.deviceID &&
+							std::memcmp(&data[16], properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+	if (!compatible) {
+		data.clear();
+	}
+
+	vk::PipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.data();
+
+	if (auto createResult = device->createPipelineCacheUnique(cacheInfo); createResult.result == vk::Result::eSuccess) {
+		pipelineCache = std::move(createResult.value);
+	} else {
+		Helpers::warn("Error creating pipeline cache: %s\n", vk::to_string(createResult.result).c_str());
+	}
+}
+
+void RendererVK::savePipelineCache() {
+	if (!pipelineCache || pipelineCachePath.empty()) {
+		return;
+	}
+
+	if (auto getResult = device->getPipelineCacheData(pipelineCache.get()); getResult.result == vk::Result::eSuccess) {
+		const std::vector<u8>& data = getResult.value;
+		IOFile file(pipelineCachePath, "wb");
+
+		if (!file.isOpen() || file.writeBytes(data.data(), data.size()).second != data.size()) {
+			Helpers::warn("Failed to write pipeline cache to %s\n", pipelineCachePath.string().c_str());
+		}
+	} else {
+		Helpers::warn("Error getting pipeline cache data: %s\n", vk::to_string(getResult.result).c_str());
+	}
+}
+
+vk::Framebuffer RendererVK::getFramebuffer(Texture& colorTexture, Texture* depthTexture) {
+	const vk::ImageView colorView = colorTexture.imageView.get();
+	const vk::ImageView depthView = depthTexture ? depthTexture->imageView.get() : vk::ImageView();
+	const auto key = std::make_tuple(static_cast<VkImageView>(colorView), static_cast<VkImageView>(depthView), colorTexture.size[0], colorTexture.size[1]);
+
+	// Cache hit
+	if (auto it = framebufferCache.find(key); it != framebufferCache.end()) {
+		return it->second.get();
+	}
+
+	// Cache miss
+	std::vector<vk::ImageView> renderTargets = {colorView};
+	if (depthTexture) {
+		renderTargets.emplace_back(depthView);
+	}
+
+	vk::FramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.setRenderPass(getRenderPass(colorTexture.format, depthTexture ? std::make_optional(depthTexture->format) : std::nullopt));
+	framebufferInfo.setAttachments(renderTargets);
+	framebufferInfo.setWidth(colorTexture.size[0]);
+	framebufferInfo.setHeight(colorTexture.size[1]);
+	framebufferInfo.setLayers(1);
+
+	if (auto createResult = device->createFramebufferUnique(framebufferInfo); createResult.result == vk::Result::eSuccess) {
+		return (framebufferCache[key] = std::move(createResult.value)).get();
+	} else {
+		Helpers::panic("Error creating render-texture framebuffer: %s\n", vk::to_string(createResult.result).c_str());
+	}
+	return {};
+}
+
+void RendererVK::beginRenderPass(vk::Framebuffer framebuffer, Texture& colorTexture, Texture* depthTexture) {
+	// Fold pending clears of the attachments into the render pass' load ops
+	const bool clearColor = colorTexture.pendingClear.has_value();
+	const bool clearDepth = depthTexture && depthTexture->pendingClear.has_value();
+
+	std::array<vk::ClearValue, 2> clearValues = {
+		colorTexture.pendingClear.value_or(vk::ClearValue(vk::ClearColorValue())),
+		clearDepth ? depthTexture->pendingClear.value() : vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0)),
+	};
+	colorTexture.pendingClear.reset();
+	if (depthTexture) {
+		depthTexture->pendingClear.reset();
+	}
+
+	vk::RenderPassBeginInfo renderBeginInfo = {};
+	renderBeginInfo.renderPass =
+		getRenderPass(colorTexture.format, depthTexture ? std::make_optional(depthTexture->format) : std::nullopt, clearColor, clearDepth);
+	renderBeginInfo.pClearValues = clearValues.data();
+	renderBeginInfo.clearValueCount = depthTexture ? 2 : 1;
+	renderBeginInfo.renderArea.extent.width = colorTexture.size[0];
+	renderBeginInfo.renderArea.extent.height = colorTexture.size[1];
+	renderBeginInfo.framebuffer = framebuffer;
+
+	getCurrentCommandBuffer().beginRenderPass(renderBeginInfo, vk::SubpassContents::eInline);
+	activeFramebuffer = framebuffer;
+}
+
+void RendererVK::endRenderPass() {
+	if (activeFramebuffer) {
+		getCurrentCommandBuffer().endRenderPass();
+		activeFramebuffer = vk::Framebuffer();
+	}
+}
 
 void RendererVK::display() {
+	// Finish off the frame's last render pass before presenting
+	endRenderPass();
+
 	// Get the next available swapchain image, and signal the semaphore when it's ready
 	static constexpr u32 swapchainImageInvalid = std::numeric_limits<u32>::max();
 	u32 swapchainImageIndex = swapchainImageInvalid;
@@ -687,10 +828,19 @@ void RendererVK::display() {
 		renderPassBeginInfo.renderArea.offset = vk::Offset2D();
 		renderPassBeginInfo.renderArea.extent = vk::Extent2D(400, 240 * 2);
 
-		getCurrentCommandBuffer().beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+		Texture* topScreen = findRenderTexture(topScreenAddr);
+		Texture* bottomScreen = findRenderTexture(bottomScreenAddr);
+
+		// Pending clears are recorded as transfers, which can't happen inside a render pass
+		if (topScreen) {
+			flushPendingClear(*topScreen);
+		}
 
-		const Texture* topScreen = findRenderTexture(topScreenAddr);
-		const Texture* bottomScreen = findRenderTexture(bottomScreenAddr);
+		if (bottomScreen) {
+			flushPendingClear(*bottomScreen);
+		}
+
+		getCurrentCommandBuffer().beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
 
 		if (topScreen || bottomScreen) {
 			getCurrentCommandBuffer().bindPipeline(vk::PipelineBindPoint::eGraphics, displayPipeline.get());
@@ -872,8 +1022,6 @@ void RendererVK::display() {
 	}
 
 	{
-		frameFramebuffers[frameBufferingIndex].clear();
-
 		getCurrentCommandBuffer().reset();
 
 		vk::CommandBufferBeginInfo beginInfo = {};
@@ -1157,7 +1305,6 @@ void RendererVK::initGraphicsContext(SDL_Window* window) {
 	swapImageFreeSemaphore.resize(frameBufferingCount);
 	renderFinishedSemaphore.resize(frameBufferingCount);
 	frameFinishedFences.resize(frameBufferingCount);
-	frameFramebuffers.resize(frameBufferingCount);
 	frameCommandBuffers.resize(frameBufferingCount);
 
 	vk::ImageCreateInfo screenTextureInfo = {};
@@ -1311,33 +1458,66 @@ void RendererVK::initGraphicsContext(SDL_Window* window) {
 
 	vk::RenderPass screenTextureRenderPass = getRenderPass(screenTextureInfo.format, {});
 
+	// Start out with an empty pipeline cache. The running title's cache gets loaded once it starts drawing
+	if (auto createResult = device->createPipelineCacheUnique({}); createResult.result == vk::Result::eSuccess) {
+		pipelineCache = std::move(createResult.value);
+	} else {
+		Helpers::panic("Error creating pipeline cache: %s\n", vk::to_string(createResult.result).c_str());
+	}
+
 	std::tie(displayPipeline, displayPipelineLayout) = createGraphicsPipeline(
 		device.get(), {}, {{displayDescriptorHeap.get()->getDescriptorSetLayout()}}, displayVertexShaderModule.get(),
-		displayFragmentShaderModule.get(), {}, {}, screenTextureRenderPass
+		displayFragmentShaderModule.get(), {}, {}, screenTextureRenderPass, pipelineCache.get()
 	);
 }
 
 void RendererVK::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) {
-	const Texture* renderTexture = findRenderTexture(startAddress);
+	Texture* renderTexture = findRenderTexture(startAddress);
 
 	if (!renderTexture) {
 		// not found
 		return;
 	}
 
+	vk::ClearValue clearValue = {};
 	if (*vk::componentName(renderTexture->format, 0) != 'D') {
 		// Color-Clear
-		vk::ClearColorValue clearColor = {};
+		clearValue.color.float32[0] = Helpers::getBits<24, 8>(value) / 255.0f;  // r
+		clearValue.color.float32[1] = Helpers::getBits<16, 8>(value) / 255.0f;  // g
+		clearValue.color.float32[2] = Helpers::getBits<8, 8>(value) / 255.0f;   // b
+		clearValue.color.float32[3] = Helpers::getBits<0, 8>(value) / 255.0f;   // a
+	} else {
+		// Depth-Clear
+		if (vk::componentBits(renderTexture->format, 0) == 16) {
+			clearValue.depthStencil.depth = (value & 0xffff) / 65535.0f;
+		} else {
+			clearValue.depthStencil.depth = (value & 0xffffff) / 16777215.0f;
+		}
 
-		clearColor.float32[0] = Helpers::getBits<24, 8>(value) / 255.0f;  // r
-		clearColor.float32[1] = Helpers::getBits<16, 8>(value) / 255.0f;  // g
-		clearColor.float32[2] = Helpers::getBits<8, 8>(value) / 255.0f;   // b
-		clearColor.float32[3] = Helpers::getBits<0, 8>(value) / 255.0f;   // a
+		clearValue.depthStencil.stencil = (value >> 24);  // Stencil
+	}
 
-		Vulkan::DebugLabelScope scope(
-			getCurrentCommandBuffer(), clearColor.float32, "ClearBuffer start:%08X end:%08X value:%08X control:%08X\n", startAddress, endAddress,
-			value, control
-		);
+	// Defer the clear, so that if the texture gets drawn to next, the clear becomes the load op of that render pass instead of a separate
+	// transfer. Anything else that reads the texture has to flush it first
+	endRenderPass();
+	renderTexture->pendingClear = clearValue;
+}
+
+void RendererVK::flushPendingClear(Texture& texture) {
+	if (texture.pendingClear.has_value()) {
+		clearTexture(texture, texture.pendingClear.value());
+		texture.pendingClear.reset();
+	}
+}
+
+void RendererVK::clearTexture(Texture& texture, const vk::ClearValue& value) {
+	const Texture* renderTexture = &texture;
+
+	if (*vk::componentName(renderTexture->format, 0) != 'D') {
+		// Color-Clear
+		const vk::ClearColorValue& clearColor = value.color;
+
+		Vulkan::DebugLabelScope scope(getCurrentCommandBuffer(), clearColor.float32, "ClearTexture loc:%08X\n", renderTexture->loc);
 
 		getCurrentCommandBuffer().pipelineBarrier(
 			vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {},
@@ -1370,21 +1550,10 @@ void RendererVK::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 co
 		);
 	} else {
 		// Depth-Clear
-		vk::ClearDepthStencilValue clearDepthStencil = {};
-
-		if (vk::componentBits(renderTexture->format, 0) == 16) {
-			clearDepthStencil.depth = (value & 0xffff) / 65535.0f;
-		} else {
-			clearDepthStencil.depth = (value & 0xffffff) / 16777215.0f;
-		}
-
-		clearDepthStencil.stencil = (value >> 24);  // Stencil
+		const vk::ClearDepthStencilValue& clearDepthStencil = value.depthStencil;
 
 		const std::array<float, 4> scopeColor = {{clearDepthStencil.depth, clearDepthStencil.depth, clearDepthStencil.depth, 1.0f}};
-		Vulkan::DebugLabelScope scope(
-			getCurrentCommandBuffer(), scopeColor, "ClearBuffer start:%08X end:%08X value:%08X control:%08X\n", startAddress, endAddress, value,
-			control
-		);
+		Vulkan::DebugLabelScope scope(getCurrentCommandBuffer(), scopeColor, "ClearTexture loc:%08X\n", renderTexture->loc);
 
 		getCurrentCommandBuffer().pipelineBarrier(
 			vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {},
@@ -1442,6 +1611,9 @@ void RendererVK::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u
 	u32 outputWidth = outputSize & 0xffff;
 	u32 outputHeight = outputSize >> 16;
 
+	// Blits can't happen inside a render pass
+	endRenderPass();
+
 	Texture& srcFramebuffer = getColorRenderTexture(inputAddr, inputFormat, inputWidth, inputHeight);
 	Math::Rect<u32> srcRect = srcFramebuffer.getSubRect(inputAddr, outputWidth, outputHeight);
 
@@ -1465,6 +1637,9 @@ void RendererVK::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u
 		// Helpers::warn("Strided display transfer is not handled correctly!\n");
 	}
 
+	flushPendingClear(srcFramebuffer);
+	flushPendingClear(destFramebuffer);
+
 	const vk::ImageBlit blitRegion(
 		vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
 		{vk::Offset3D{(int)srcRect.left, (int)srcRect.top, 0}, vk::Offset3D{(int)srcRect.right, (int)srcRect.bottom, 1}},
@@ -1519,8 +1694,6 @@ void RendererVK::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u
 	);
 }
 
-void RendererVK::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) {}
-
 void RendererVK::drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) {
 	using namespace Helpers;
 
@@ -1530,60 +1703,33 @@ void RendererVK::drawVertices(PICA::PrimType primType, std::span<const PICA::Ver
 	const int depthFunc = getBits<4, 3>(depthControl);
 	const vk::ColorComponentFlags colorMask = vk::ColorComponentFlags(getBits<8, 4>(depthControl));
 
-	const vk::RenderPass curRenderPass = getRenderPass(colourBufferFormat, depthTestEnable ? std::make_optional(depthBufferFormat) : std::nullopt);
-
-	// Create framebuffer, find a way to cache this!
-	vk::Framebuffer curFramebuffer = {};
-	{
-		std::vector<vk::ImageView> renderTargets;
-
-		const auto& colorTexture = getColorRenderTexture(colourBufferLoc, colourBufferFormat, fbSize[0], fbSize[1]);
-		renderTargets.emplace_back(colorTexture.imageView.get());
+	if (pipelineCacheNeedsLoad) {
+		loadPipelineCache();
+	}
 
-		if (depthTestEnable) {
-			const auto& depthTexture = getDepthRenderTexture(depthBufferLoc, depthBufferFormat, fbSize[0], fbSize[1]);
-			renderTargets.emplace_back(depthTexture.imageView.get());
-		}
+	Texture& colorTexture = getColorRenderTexture(colourBufferLoc, colourBufferFormat, fbSize[0], fbSize[1]);
+	Texture* depthTexture = depthTestEnable ? &getDepthRenderTexture(depthBufferLoc, depthBufferFormat, fbSize[0], fbSize[1]) : nullptr;
+	const vk::Framebuffer framebuffer = getFramebuffer(colorTexture, depthTexture);
 
-		vk::FramebufferCreateInfo framebufferInfo = {};
-		framebufferInfo.setRenderPass(curRenderPass);
-		framebufferInfo.setAttachments(renderTargets);
-		framebufferInfo.setWidth(fbSize[0]);
-		framebufferInfo.setHeight(fbSize[1]);
-		framebufferInfo.setLayers(1);
-		if (auto createResult = device->createFramebufferUnique(framebufferInfo); createResult.result == vk::Result::eSuccess) {
-			curFramebuffer = (frameFramebuffers[frameBufferingIndex].emplace_back(std::move(createResult.value))).get();
-		} else {
-			Helpers::panic("Error creating render-texture framebuffer: %s\n", vk::to_string(createResult.result).c_str());
-		}
+	// Consecutive draws to the same render targets share a render pass. Creating a render target above ends the open pass, so this starts a new one
+	if (framebuffer != activeFramebuffer) {
+		endRenderPass();
+		beginRenderPass(framebuffer, colorTexture, depthTexture);
 	}
 
-	vk::RenderPassBeginInfo renderBeginInfo = {};
-	renderBeginInfo.renderPass = curRenderPass;
-	static const vk::ClearValue ClearColors[] = {
-		vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f}),
-		vk::ClearDepthStencilValue(1.0f, 0),
-		vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f}),
-	};
-	renderBeginInfo.pClearValues = ClearColors;
-	renderBeginInfo.clearValueCount = std::size(ClearColors);
-	renderBeginInfo.renderArea.extent.width = fbSize[0];
-	renderBeginInfo.renderArea.extent.height = fbSize[1];
-	renderBeginInfo.framebuffer = curFramebuffer;
-
 	const vk::CommandBuffer& commandBuffer = getCurrentCommandBuffer();
-
-	// Todo: Rather than starting a new renderpass for each draw, do some state-tracking to re-use render-passes
-	commandBuffer.beginRenderPass(renderBeginInfo, vk::SubpassContents::eInline);
 	static const std::array<float, 4> labelColor = {{1.0f, 0.0f, 0.0f, 1.0f}};
 	Vulkan::insertDebugLabel(commandBuffer, labelColor, "DrawVertices: %u vertices", vertices.size());
-	commandBuffer.endRenderPass();
 }
 
 void RendererVK::screenshot(const std::string& name) {}
 
 void RendererVK::deinitGraphicsContext() {
-	// Invalidate the entire texture cache since they'll no longer be valid
+	endRenderPass();
+	savePipelineCache();
+
+	// Invalidate the entire texture cache since they'll no longer be valid. The framebuffers reference the textures, so they go first
+	framebufferCache.clear();
 	textureCache.clear();
 
 	// TODO: Make it so that depth and colour buffers get written back to 3DS memory
@@ -1,5 +1,6 @@
 #include "services/ac.hpp"
 #include "ipc.hpp"
+#include "savestate.hpp"
 
 namespace ACCommands {
 	enum : u32 {
@@ -21,6 +22,11 @@ void ACService::reset() {
 	disconnectEvent = std::nullopt;
 }
 
+void ACService::doState(SaveStateStream& stream) {
+	stream.value(connected);
+	stream.optional(disconnectEvent);
+}
+
 void ACService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
@@ -1,10 +1,18 @@
 #include "services/amiibo_device.hpp"
 
+#include "savestate.hpp"
+
 void AmiiboDevice::reset() {
 	encrypted = false;
 	loaded = false;
 }
 
+void AmiiboDevice::doState(SaveStateStream& stream) {
+	stream.value(loaded);
+	stream.value(encrypted);
+	stream.value(raw);
+}
+
 // Load amiibo information from our raw 540 byte array
 void AmiiboDevice::loadFromRaw() {
 
@@ -1,6 +1,7 @@
 #include "services/apt.hpp"
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 #include <algorithm>
 #include <vector>
@@ -45,6 +46,15 @@ void APTService::reset() {
 	appletManager.reset();
 }
 
+void APTService::doState(SaveStateStream& stream) {
+	stream.optional(lockHandle);
+	stream.optional(notificationEvent);
+	stream.optional(resumeEvent);
+	stream.value(cpuTimeLimit);
+	stream.value(screencapPostPermission);
+	appletManager.doState(stream);
+}
+
 void APTService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
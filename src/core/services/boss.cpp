@@ -1,5 +1,6 @@
 #include "services/boss.hpp"
 #include "ipc.hpp"
+#include "savestate.hpp"
 
 namespace BOSSCommands {
 	enum : u32 {
@@ -35,6 +36,10 @@ void BOSSService::reset() {
 	optoutFlag = 0;
 }
 
+void BOSSService::doState(SaveStateStream& stream) {
+	stream.value(optoutFlag);
+}
+
 void BOSSService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
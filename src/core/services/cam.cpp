@@ -4,6 +4,7 @@
 
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 namespace CAMCommands {
 	enum : u32 {
@@ -69,6 +70,14 @@ void CAMService::reset() {
 	}
 }
 
+void CAMService::doState(SaveStateStream& stream) {
+	for (auto& port : ports) {
+		stream.optional(port.bufferErrorInterruptEvent);
+		stream.optional(port.receiveEvent);
+		stream.value(port.transferBytes);
+	}
+}
+
 void CAMService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
@@ -2,6 +2,7 @@
 
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 namespace CECDCommands {
 	enum : u32 {
@@ -12,6 +13,10 @@ namespace CECDCommands {
 
 void CECDService::reset() { infoEvent = std::nullopt; }
 
+void CECDService::doState(SaveStateStream& stream) {
+	stream.optional(infoEvent);
+}
+
 void CECDService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
@@ -206,7 +206,7 @@ void CFGService::getRegionCanadaUSA(u32 messagePointer) {
 }
 
 constexpr u16 C(const char name[3]) { return name[0] | (name[1] << 8); }
-static std::unordered_map<u16, u16> countryCodeToTableIDMap = {
+static const std::unordered_map<u16, u16> countryCodeToTableIDMap = {
 	{C("JP"), 1},   {C("AI"), 8},   {C("AG"), 9},   {C("AR"), 10},  {C("AW"), 11},  {C("BS"), 12},  {C("BB"), 13},  {C("BZ"), 14},  {C("BO"), 15},
 	{C("BR"), 16},  {C("VG"), 17},  {C("CA"), 18},  {C("KY"), 19},  {C("CL"), 20},  {C("CO"), 21},  {C("CR"), 22},  {C("DM"), 23},  {C("DO"), 24},
 	{C("EC"), 25},  {C("SV"), 26},  {C("GF"), 27},  {C("GD"), 28},  {C("GP"), 29},  {C("GT"), 30},  {C("GY"), 31},  {C("HT"), 32},  {C("HN"), 33},
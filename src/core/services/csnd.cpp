@@ -3,6 +3,7 @@
 #include "ipc.hpp"
 #include "kernel.hpp"
 #include "result/result.hpp"
+#include "savestate.hpp"
 
 namespace CSNDCommands {
 	enum : u32 {
@@ -19,6 +20,13 @@ void CSNDService::reset() {
 	sharedMemSize = 0;
 }
 
+void CSNDService::doState(SaveStateStream& stream) {
+	stream.fcramPointer(sharedMemory, mem.getFCRAM());
+	stream.optional(csndMutex);
+	stream.value(sharedMemSize);
+	stream.value(initialized);
+}
+
 void CSNDService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 
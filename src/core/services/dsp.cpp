@@ -1,6 +1,7 @@
 #include "services/dsp.hpp"
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 #include <algorithm>
 #include <fstream>
@@ -46,43 +47,71 @@ void DSPService::reset() {
 	loadedComponent.clear();
 }
 
+void DSPService::doState(SaveStateStream& stream) {
+	stream.optional(semaphoreEvent);
+	stream.optional(interrupt0);
+	stream.optional(interrupt1);
+	for (auto& event : pipeEvents) {
+		stream.optional(event);
+	}
+
+	stream.value(semaphoreMask);
+	stream.value(totalEventCount);
+	stream.vector(loadedComponent);
+}
+
 void DSPService::handleSyncRequest(u32 messagePointer) {
-	const u32 command = mem.read32(messagePointer);
-	switch (command) {
-		case DSPCommands::ConvertProcessAddressFromDspDram: convertProcessAddressFromDspDram(messagePointer); break;
-		case DSPCommands::FlushDataCache: flushDataCache(messagePointer); break;
-		case DSPCommands::InvalidateDataCache: invalidateDCache(messagePointer); break;
-		case DSPCommands::GetHeadphoneStatus: getHeadphoneStatus(messagePointer); break;
-		case DSPCommands::GetSemaphoreEventHandle: getSemaphoreEventHandle(messagePointer); break;
-		case DSPCommands::LoadComponent: loadComponent(messagePointer); break;
-		case DSPCommands::ReadPipeIfPossible: readPipeIfPossible(messagePointer); break;
-		case DSPCommands::RecvData: [[likely]] recvData(messagePointer); break;
-		case DSPCommands::RecvDataIsReady: [[likely]] recvDataIsReady(messagePointer); break;
-		case DSPCommands::RegisterInterruptEvents: registerInterruptEvents(messagePointer); break;
-		case DSPCommands::SetSemaphore: setSemaphore(messagePointer); break;
-		case DSPCommands::SetSemaphoreMask: setSemaphoreMask(messagePointer); break;
-		case DSPCommands::UnloadComponent: unloadComponent(messagePointer); break;
-		case DSPCommands::WriteProcessPipe: [[likely]] writeProcessPipe(messagePointer); break;
-		default: Helpers::panic("DSP service requested. Command: %08X\n", command);
+	static constexpr IPC::CommandTable<IPC::CommandHandler<DSPService>, 0x01, 0x1F> commands = {
+		{DSPCommands::RecvData, &DSPService::recvData},
+		{DSPCommands::RecvDataIsReady, &DSPService::recvDataIsReady},
+		{DSPCommands::SetSemaphore, &DSPService::setSemaphore},
+		{DSPCommands::ConvertProcessAddressFromDspDram, &DSPService::convertProcessAddressFromDspDram},
+		{DSPCommands::WriteProcessPipe, &DSPService::writeProcessPipe},
+		{DSPCommands::ReadPipeIfPossible, &DSPService::readPipeIfPossible},
+		{DSPCommands::LoadComponent, &DSPService::loadComponent},
+		{DSPCommands::UnloadComponent, &DSPService::unloadComponent},
+		{DSPCommands::FlushDataCache, &DSPService::flushDataCache},
+		{DSPCommands::InvalidateDataCache, &DSPService::invalidateDCache},
+		{DSPCommands::RegisterInterruptEvents, &DSPService::registerInterruptEvents},
+		{DSPCommands::GetSemaphoreEventHandle, &DSPService::getSemaphoreEventHandle},
+		{DSPCommands::SetSemaphoreMask, &DSPService::setSemaphoreMask},
+		{DSPCommands::GetHeadphoneStatus, &DSPService::getHeadphoneStatus},
+	};
+	static_assert(commands.isValid(), "DSP command table has clashing or out of range commands");
+
+	IPC::CommandBuffer cmd(mem, messagePointer);
+	const auto handler = commands.find(cmd.header());
+	if (handler == nullptr) [[unlikely]] {
+		Helpers::panic("DSP service requested. Command: %08X\n", cmd.header());
 	}
+
+	(this->*handler)(cmd);
 }
 
-void DSPService::convertProcessAddressFromDspDram(u32 messagePointer) {
-	const u32 address = mem.read32(messagePointer + 4);
+void DSPService::convertProcessAddressFromDspDram(IPC::CommandBuffer& cmd) {
+	const u32 address = cmd[1];
 	log("DSP::ConvertProcessAddressFromDspDram (address = %08X)\n", address);
 	const u32 converted = (address << 1) + 0x1FF40000;
 
-	mem.write32(messagePointer, IPC::responseHeader(0xC, 2, 0));
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write32(messagePointer + 8, converted); // Converted address
+	cmd.respond<0xC>(Result::Success, converted);  // Converted address
 }
 
-void DSPService::loadComponent(u32 messagePointer) {
-	u32 size = mem.read32(messagePointer + 4);
-	u32 programMask = mem.read32(messagePointer + 8);
-	u32 dataMask = mem.read32(messagePointer + 12);
-	u32 buffer = mem.read32(messagePointer + 20);
+void DSPService::loadComponent(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 size;
+		u32 programMask;
+		u32 dataMask;
+		u32 bufferDescriptor;
+		u32 buffer;
+	};
+
+	struct Response {
+		u32 loaded;
+		u32 bufferDescriptor;
+		u32 buffer;
+	};
 
+	const auto [size, programMask, dataMask, bufferDescriptor, buffer] = cmd.request<Request>();
 	loadedComponent.resize(size);
 
 	for (u32 i = 0; i < size; i++) {
@@ -92,59 +121,58 @@ void DSPService::loadComponent(u32 messagePointer) {
 	log("DSP::LoadComponent (size = %08X, program mask = %X, data mask = %X\n", size, programMask, dataMask);
 	dsp->loadComponent(loadedComponent, programMask, dataMask);
 
-	mem.write32(messagePointer, IPC::responseHeader(0x11, 2, 2));
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write32(messagePointer + 8, 1); // Component loaded
-	mem.write32(messagePointer + 12, (size << 4) | 0xA);
-	mem.write32(messagePointer + 16, mem.read32(messagePointer + 20)); // Component buffer
+	cmd.respond<0x11, 2>(Result::Success, Response{.loaded = 1, .bufferDescriptor = (size << 4) | 0xA, .buffer = buffer});
 }
 
-void DSPService::unloadComponent(u32 messagePointer) {
+void DSPService::unloadComponent(IPC::CommandBuffer& cmd) {
 	log("DSP::UnloadComponent\n");
 	dsp->unloadComponent();
 
-	mem.write32(messagePointer, IPC::responseHeader(0x12, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x12>(Result::Success);
 }
 
-void DSPService::readPipeIfPossible(u32 messagePointer) {
-	u32 channel = mem.read32(messagePointer + 4);
-	u32 peer = mem.read32(messagePointer + 8);
-	u16 size = mem.read16(messagePointer + 12);
-	u32 buffer = mem.read32(messagePointer + 0x100 + 4);
+void DSPService::readPipeIfPossible(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 channel;
+		u32 peer;
+		u32 size;  // Only the bottom 16 bits are used
+	};
+
+	struct Response {
+		u32 bytesRead;
+		u32 bufferDescriptor;
+		u32 buffer;
+	};
+
+	const auto [channel, peer, sizeWord] = cmd.request<Request>();
+	const u16 size = u16(sizeWord);
+	const u32 buffer = cmd[0x104 / sizeof(u32)];  // The data goes to the static buffer the caller set up
 	log("DSP::ReadPipeIfPossible (channel = %d, peer = %d, size = %04X, buffer = %08X)\n", channel, peer, size, buffer);
-	mem.write32(messagePointer, IPC::responseHeader(0x10, 2, 2));
 
 	std::vector<u8> data = dsp->readPipe(channel, peer, size, buffer);
 	for (uint i = 0; i < data.size(); i++) {
 		mem.write8(buffer + i, data[i]);
 	}
 
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write16(messagePointer + 8, u16(data.size())); // Number of bytes read
+	const u32 bytesRead = u16(data.size());
+	cmd.respond<0x10, 2>(Result::Success, Response{.bytesRead = bytesRead, .bufferDescriptor = (bytesRead << 14) | 2, .buffer = buffer});
 }
 
-void DSPService::recvData(u32 messagePointer) {
-	const u32 registerIndex = mem.read32(messagePointer + 4);
+void DSPService::recvData(IPC::CommandBuffer& cmd) {
+	const u32 registerIndex = cmd[1];
 	log("DSP::RecvData (register = %d)\n", registerIndex);
 	if (registerIndex != 0) Helpers::panic("Unknown register in DSP::RecvData");
 
 	const u16 data = dsp->recvData(registerIndex);
-
-	mem.write32(messagePointer, IPC::responseHeader(0x01, 2, 0));
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write16(messagePointer + 8, data);
+	cmd.respond<0x01>(Result::Success, u32(data));
 }
 
-void DSPService::recvDataIsReady(u32 messagePointer) {
-	const u32 registerIndex = mem.read32(messagePointer + 4);
+void DSPService::recvDataIsReady(IPC::CommandBuffer& cmd) {
+	const u32 registerIndex = cmd[1];
 	log("DSP::RecvDataIsReady (register = %d)\n", registerIndex);
 
 	bool isReady = dsp->recvDataIsReady(registerIndex);
-
-	mem.write32(messagePointer, IPC::responseHeader(0x02, 2, 0));
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write32(messagePointer + 8, isReady ? 1 : 0);
+	cmd.respond<0x02>(Result::Success, u32(isReady ? 1 : 0));
 }
 
 DSPService::DSPEvent& DSPService::getEventRef(u32 type, u32 pipe) {
@@ -162,10 +190,15 @@ DSPService::DSPEvent& DSPService::getEventRef(u32 type, u32 pipe) {
 	}
 }
 
-void DSPService::registerInterruptEvents(u32 messagePointer) {
-	const u32 interrupt = mem.read32(messagePointer + 4);
-	const u32 channel = mem.read32(messagePointer + 8);
-	const u32 eventHandle = mem.read32(messagePointer + 16);
+void DSPService::registerInterruptEvents(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 interrupt;
+		u32 channel;
+		u32 handleDescriptor;
+		u32 eventHandle;
+	};
+
+	const auto [interrupt, channel, handleDescriptor, eventHandle] = cmd.request<Request>();
 	log("DSP::RegisterInterruptEvents (interrupt = %d, channel = %d, event = %d)\n", interrupt, channel, eventHandle);
 
 	// The event handle being 0 means we're removing an event
@@ -175,6 +208,8 @@ void DSPService::registerInterruptEvents(u32 messagePointer) {
 			totalEventCount--;
 			e = std::nullopt;
 		}
+
+		cmd.respond<0x15>(Result::Success);
 	} else {
 		const KernelObject* object = kernel.getObject(eventHandle, KernelObjectType::Event);
 		if (!object) {
@@ -185,85 +220,90 @@ void DSPService::registerInterruptEvents(u32 messagePointer) {
 			Helpers::panic("DSP::RegisterInterruptEvents overflowed total number of allowed events");
 		else {
 			getEventRef(interrupt, channel) = eventHandle;
-			mem.write32(messagePointer, IPC::responseHeader(0x15, 1, 0));
-			mem.write32(messagePointer + 4, Result::Success);
+			kernel.pinObject(eventHandle);  // Games may close their handle while the event is registered, and we still signal it
+			cmd.respond<0x15>(Result::Success);
 
 			totalEventCount++;
 		}
 	}
 }
 
-void DSPService::getHeadphoneStatus(u32 messagePointer) {
+void DSPService::getHeadphoneStatus(IPC::CommandBuffer& cmd) {
 	log("DSP::GetHeadphoneStatus\n");
-
-	mem.write32(messagePointer, IPC::responseHeader(0x1F, 2, 0));
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write32(messagePointer + 8, Result::HeadphonesInserted); // This should be toggleable for shits and giggles
+	cmd.respond<0x1F>(Result::Success, u32(Result::HeadphonesInserted));  // This should be toggleable for shits and giggles
 }
 
-void DSPService::getSemaphoreEventHandle(u32 messagePointer) {
+void DSPService::getSemaphoreEventHandle(IPC::CommandBuffer& cmd) {
+	struct Response {
+		u32 handleDescriptor;
+		u32 eventHandle;
+	};
+
 	log("DSP::GetSemaphoreEventHandle\n");
 
 	if (!semaphoreEvent.has_value()) {
 		semaphoreEvent = kernel.makeEvent(ResetType::OneShot, Event::CallbackType::DSPSemaphore);
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x16, 1, 2));
-	mem.write32(messagePointer + 4, Result::Success);
-	// TODO: Translation descriptor here?
-	mem.write32(messagePointer + 12, semaphoreEvent.value()); // Semaphore event handle
+	cmd.respond<0x16, 2>(Result::Success, Response{.handleDescriptor = 0, .eventHandle = semaphoreEvent.value()});
 	kernel.signalEvent(semaphoreEvent.value());
 }
 
-void DSPService::setSemaphore(u32 messagePointer) {
-	const u16 value = mem.read16(messagePointer + 4);
+void DSPService::setSemaphore(IPC::CommandBuffer& cmd) {
+	const u16 value = u16(cmd[1]);
 	log("DSP::SetSemaphore(value = %04X)\n", value);
 
 	dsp->setSemaphore(value);
-	mem.write32(messagePointer, IPC::responseHeader(0x7, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x7>(Result::Success);
 }
 
-void DSPService::setSemaphoreMask(u32 messagePointer) {
-	const u16 mask = mem.read16(messagePointer + 4);
+void DSPService::setSemaphoreMask(IPC::CommandBuffer& cmd) {
+	const u16 mask = u16(cmd[1]);
 	log("DSP::SetSemaphoreMask(mask = %04X)\n", mask);
 
 	dsp->setSemaphoreMask(mask);
 	semaphoreMask = mask;
 
-	mem.write32(messagePointer, IPC::responseHeader(0x17, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x17>(Result::Success);
 }
 
-void DSPService::writeProcessPipe(u32 messagePointer) {
-	const u32 channel = mem.read32(messagePointer + 4);
-	const u32 size = mem.read32(messagePointer + 8);
-	const u32 buffer = mem.read32(messagePointer + 16);
+void DSPService::writeProcessPipe(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 channel;
+		u32 size;
+		u32 bufferDescriptor;
+		u32 buffer;
+	};
+
+	const auto [channel, size, bufferDescriptor, buffer] = cmd.request<Request>();
 	log("DSP::writeProcessPipe (channel = %d, size = %X, buffer = %08X)\n", channel, size, buffer);
 
 	dsp->writeProcessPipe(channel, size, buffer);
-	mem.write32(messagePointer, IPC::responseHeader(0xD, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0xD>(Result::Success);
 }
 
-void DSPService::flushDataCache(u32 messagePointer) {
-	const u32 address = mem.read32(messagePointer + 4);
-	const u32 size = mem.read32(messagePointer + 8);
-	const Handle process = mem.read32(messagePointer + 16);
+// FlushDataCache and InvalidateDataCache take the same parameters
+namespace {
+	struct CacheOperationRequest {
+		u32 address;
+		u32 size;
+		u32 processDescriptor;
+		Handle process;
+	};
+}  // namespace
+
+void DSPService::flushDataCache(IPC::CommandBuffer& cmd) {
+	const auto [address, size, processDescriptor, process] = cmd.request<CacheOperationRequest>();
 
 	log("DSP::FlushDataCache (addr = %08X, size = %08X, process = %X)\n", address, size, process);
-	mem.write32(messagePointer, IPC::responseHeader(0x13, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x13>(Result::Success);
 }
 
-void DSPService::invalidateDCache(u32 messagePointer) {
-	const u32 address = mem.read32(messagePointer + 4);
-	const u32 size = mem.read32(messagePointer + 8);
-	const Handle process = mem.read32(messagePointer + 16);
+void DSPService::invalidateDCache(IPC::CommandBuffer& cmd) {
+	const auto [address, size, processDescriptor, process] = cmd.request<CacheOperationRequest>();
 
 	log("DSP::InvalidateDataCache (addr = %08X, size = %08X, process = %X)\n", address, size, process);
-	mem.write32(messagePointer, IPC::responseHeader(0x14, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x14>(Result::Success);
 }
 
 DSPService::ComponentDumpResult DSPService::dumpComponent(const std::filesystem::path& path) {
@@ -3,6 +3,7 @@
 #include <string>
 
 #include "ipc.hpp"
+#include "savestate.hpp"
 #include "services/region_codes.hpp"
 
 namespace FRDCommands {
@@ -33,6 +34,10 @@ namespace FRDCommands {
 
 void FRDService::reset() { loggedIn = false; }
 
+void FRDService::doState(SaveStateStream& stream) {
+	stream.value(loggedIn);
+}
+
 void FRDService::handleSyncRequest(u32 messagePointer, FRDService::Type type) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
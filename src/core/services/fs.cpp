@@ -3,6 +3,7 @@
 #include "io_file.hpp"
 #include "ipc.hpp"
 #include "result/result.hpp"
+#include "savestate.hpp"
 
 #ifdef CreateFile // windows.h defines CreateFile & DeleteFile because of course it does.
 #undef CreateDirectory
@@ -49,16 +50,41 @@ namespace FSCommands {
 
 void FSService::reset() {
 	priority = 0;
+	speculative = false;
+	writeBackCache.reset();
+}
+
+void FSService::doState(SaveStateStream& stream) {
+	stream.value(priority);
+}
+
+void FSService::setSpeculative(bool enable) {
+	if (enable == speculative) {
+		return;
+	}
+
+	speculative = enable;
+	if (enable) {
+		writeBackCache.beginSpeculation();
+	} else {
+		writeBackCache.endSpeculation();
+	}
+}
+
+void FSService::flushSaveData() {
+	if (!writeBackCache.flush()) {
+		Helpers::warn("FS: Failed to write back some save data, will retry on the next flush");
+	}
 }
 
 // Creates directories for NAND, ExtSaveData, etc if they don't already exist. Should be executed after loading a new ROM.
 void FSService::initializeFilesystem() {
-	const auto sdmcPath = IOFile::getAppData() / "SDMC"; // Create SDMC directory
-	const auto nandSharedpath = IOFile::getAppData() / ".." / "SharedFiles" / "NAND";
+	const auto sdmcPath = appDataPath / "SDMC"; // Create SDMC directory
+	const auto nandSharedpath = appDataPath / ".." / "SharedFiles" / "NAND";
 
-	const auto savePath = IOFile::getAppData() / "SaveData"; // Create SaveData
-	const auto formatPath = IOFile::getAppData() / "FormatInfo"; // Create folder for storing archive formatting info
-	const auto systemSaveDataPath = IOFile::getAppData() / ".." / "SharedFiles" / "SystemSaveData";
+	const auto savePath = appDataPath / "SaveData"; // Create SaveData
+	const auto formatPath = appDataPath / "FormatInfo"; // Create folder for storing archive formatting info
+	const auto systemSaveDataPath = appDataPath / ".." / "SharedFiles" / "SystemSaveData";
 	namespace fs = std::filesystem;
 
 
@@ -83,6 +109,24 @@ void FSService::initializeFilesystem() {
 	}
 }
 
+std::array<ArchiveBase*, FSService::archiveCount> FSService::getArchives() {
+	return {&selfNcch, &saveData, &sdmc, &sdmcWriteOnly, &ncch, &userSaveData1, &userSaveData2, &extSaveData_sdmc, &sharedExtSaveData_nand,
+			&systemSaveData};
+}
+
+std::optional<u32> FSService::getArchiveIndex(const ArchiveBase* archive) {
+	const auto archives = getArchives();
+	for (u32 i = 0; i < archiveCount; i++) {
+		if (archives[i] == archive) {
+			return i;
+		}
+	}
+
+	return std::nullopt;
+}
+
+ArchiveBase* FSService::getArchiveFromIndex(u32 index) { return (index < archiveCount) ? getArchives()[index] : nullptr; }
+
 ArchiveBase* FSService::getArchiveFromID(u32 id, const FSPath& archivePath) {
 	switch (id) {
 		case ArchiveID::SelfNCCH: return &selfNcch;
@@ -108,10 +152,10 @@ ArchiveBase* FSService::getArchiveFromID(u32 id, const FSPath& archivePath) {
 std::optional<Handle> FSService::openFileHandle(ArchiveBase* archive, const FSPath& path, const FSPath& archivePath, const FilePerms& perms) {
 	FileDescriptor opened = archive->openFile(path, perms);
 	if (opened.has_value()) { // If opened doesn't have a value, we failed to open the file
-		auto handle = kernel.makeObject(KernelObjectType::File);
+		auto handle = kernel.giveToGuest(kernel.makeObject(KernelObjectType::File));
 
-		auto& file = kernel.getObjects()[handle];
-		file.data = new FileSession(archive, path, archivePath, opened.value());
+		auto session = kernel.allocateObjectData<FileSession>(handle, archive, path, archivePath, opened.value());
+		session->openFlags = perms.raw;
 
 		return handle;
 	} else {
@@ -122,9 +166,8 @@ std::optional<Handle> FSService::openFileHandle(ArchiveBase* archive, const FSPa
 Rust::Result<Handle, Result::HorizonResult> FSService::openDirectoryHandle(ArchiveBase* archive, const FSPath& path) {
 	Rust::Result<DirectorySession, Result::HorizonResult> opened = archive->openDirectory(path);
 	if (opened.isOk()) { // If opened doesn't have a value, we failed to open the directory
-		auto handle = kernel.makeObject(KernelObjectType::Directory);
-		auto& object = kernel.getObjects()[handle];
-		object.data = new DirectorySession(opened.unwrap());
+		auto handle = kernel.giveToGuest(kernel.makeObject(KernelObjectType::Directory));
+		kernel.allocateObjectData<DirectorySession>(handle, opened.unwrap());
 
 		return Ok(handle);
 	} else {
@@ -142,9 +185,8 @@ Rust::Result<Handle, Result::HorizonResult> FSService::openArchiveHandle(u32 arc
 
 	Rust::Result<ArchiveBase*, Result::HorizonResult> res = archive->openArchive(path);
 	if (res.isOk()) {
-		auto handle = kernel.makeObject(KernelObjectType::Archive);
-		auto& archiveObject = kernel.getObjects()[handle];
-		archiveObject.data = new ArchiveSession(res.unwrap(), path);
+		auto handle = kernel.giveToGuest(kernel.makeObject(KernelObjectType::Archive));
+		kernel.allocateObjectData<ArchiveSession>(handle, res.unwrap(), path);
 
 		return Ok(handle);
 	}
@@ -164,41 +206,82 @@ FSPath FSService::readPath(u32 type, u32 pointer, u32 size) {
 }
 
 void FSService::handleSyncRequest(u32 messagePointer) {
+	static constexpr IPC::CommandTable<void (FSService::*)(u32), 0x801, 0x875> commands = {
+		{FSCommands::Initialize, &FSService::initialize},
+		{FSCommands::OpenFile, &FSService::openFile},
+		{FSCommands::OpenFileDirectly, &FSService::openFileDirectly},
+		{FSCommands::DeleteFile, &FSService::deleteFile},
+		{FSCommands::RenameFile, &FSService::renameFile},
+		{FSCommands::DeleteDirectory, &FSService::deleteDirectory},
+		{FSCommands::CreateFile, &FSService::createFile},
+		{FSCommands::CreateDirectory, &FSService::createDirectory},
+		{FSCommands::OpenDirectory, &FSService::openDirectory},
+		{FSCommands::OpenArchive, &FSService::openArchive},
+		{FSCommands::ControlArchive, &FSService::controlArchive},
+		{FSCommands::CloseArchive, &FSService::closeArchive},
+		{FSCommands::FormatThisUserSaveData, &FSService::formatThisUserSaveData},
+		{FSCommands::GetFreeBytes, &FSService::getFreeBytes},
+		{FSCommands::GetSdmcArchiveResource, &FSService::getSdmcArchiveResource},
+		{FSCommands::IsSdmcDetected, &FSService::isSdmcDetected},
+		{FSCommands::IsSdmcWritable, &FSService::isSdmcWritable},
+		{FSCommands::CardSlotIsInserted, &FSService::cardSlotIsInserted},
+		{FSCommands::AbnegateAccessRight, &FSService::abnegateAccessRight},
+		{FSCommands::GetFormatInfo, &FSService::getFormatInfo},
+		{FSCommands::GetArchiveResource, &FSService::getArchiveResource},
+		{FSCommands::FormatSaveData, &FSService::formatSaveData},
+		{FSCommands::CreateExtSaveData, &FSService::createExtSaveData},
+		{FSCommands::DeleteExtSaveData, &FSService::deleteExtSaveData},
+		{FSCommands::SetArchivePriority, &FSService::setArchivePriority},
+		{FSCommands::InitializeWithSdkVersion, &FSService::initializeWithSdkVersion},
+		{FSCommands::SetPriority, &FSService::setPriority},
+		{FSCommands::GetPriority, &FSService::getPriority},
+		{FSCommands::SetThisSaveDataSecureValue, &FSService::setThisSaveDataSecureValue},
+		{FSCommands::GetThisSaveDataSecureValue, &FSService::getThisSaveDataSecureValue},
+		{FSCommands::TheGameboyVCFunction, &FSService::theGameboyVCFunction},
+	};
+	static_assert(commands.isValid(), "FS command table has clashing or out of range commands");
+
 	const u32 command = mem.read32(messagePointer);
+
+	// Closing an archive commits its writes. The other commands here operate on host files directly, so cached writes must hit the disk first
 	switch (command) {
-		case FSCommands::CardSlotIsInserted: cardSlotIsInserted(messagePointer); break;
-		case FSCommands::CreateDirectory: createDirectory(messagePointer); break;
-		case FSCommands::CreateExtSaveData: createExtSaveData(messagePointer); break;
-		case FSCommands::CreateFile: createFile(messagePointer); break;
-		case FSCommands::ControlArchive: controlArchive(messagePointer); break;
-		case FSCommands::CloseArchive: closeArchive(messagePointer); break;
-		case FSCommands::DeleteDirectory: deleteDirectory(messagePointer); break;
-		case FSCommands::DeleteExtSaveData: deleteExtSaveData(messagePointer); break;
-		case FSCommands::DeleteFile: deleteFile(messagePointer); break;
-		case FSCommands::FormatSaveData: formatSaveData(messagePointer); break;
-		case FSCommands::FormatThisUserSaveData: formatThisUserSaveData(messagePointer); break;
-		case FSCommands::GetArchiveResource: getArchiveResource(messagePointer); break;
-		case FSCommands::GetFreeBytes: getFreeBytes(messagePointer); break;
-		case FSCommands::GetFormatInfo: getFormatInfo(messagePointer); break;
-		case FSCommands::GetPriority: getPriority(messagePointer); break;
-		case FSCommands::GetSdmcArchiveResource: getSdmcArchiveResource(messagePointer); break;
-		case FSCommands::GetThisSaveDataSecureValue: getThisSaveDataSecureValue(messagePointer); break;
-		case FSCommands::Initialize: initialize(messagePointer); break;
-		case FSCommands::InitializeWithSdkVersion: initializeWithSdkVersion(messagePointer); break;
-		case FSCommands::IsSdmcDetected: isSdmcDetected(messagePointer); break;
-		case FSCommands::IsSdmcWritable: isSdmcWritable(messagePointer); break;
-		case FSCommands::OpenArchive: openArchive(messagePointer); break;
-		case FSCommands::OpenDirectory: openDirectory(messagePointer); break;
-		case FSCommands::OpenFile: [[likely]] openFile(messagePointer); break;
-		case FSCommands::OpenFileDirectly: [[likely]] openFileDirectly(messagePointer); break;
-		case FSCommands::RenameFile: renameFile(messagePointer); break;
-		case FSCommands::SetArchivePriority: setArchivePriority(messagePointer); break;
-		case FSCommands::SetPriority: setPriority(messagePointer); break;
-		case FSCommands::SetThisSaveDataSecureValue: setThisSaveDataSecureValue(messagePointer); break;
-		case FSCommands::AbnegateAccessRight: abnegateAccessRight(messagePointer); break;
-		case FSCommands::TheGameboyVCFunction: theGameboyVCFunction(messagePointer); break;
-		default: Helpers::panic("FS service requested. Command: %08X\n", command);
+		case FSCommands::CloseArchive:
+		case FSCommands::DeleteDirectory:
+		case FSCommands::DeleteExtSaveData:
+		case FSCommands::DeleteFile:
+		case FSCommands::FormatSaveData:
+		case FSCommands::FormatThisUserSaveData:
+		case FSCommands::GetFormatInfo:
+		case FSCommands::RenameFile: flushSaveData(); break;
+		default: break;
+	}
+
+	// The frames this request comes from will be thrown away, and the real ones will make it again
+	if (speculative) [[unlikely]] {
+		switch (command) {
+			case FSCommands::CreateDirectory:
+			case FSCommands::CreateExtSaveData:
+			case FSCommands::CreateFile:
+			case FSCommands::DeleteDirectory:
+			case FSCommands::DeleteExtSaveData:
+			case FSCommands::DeleteFile:
+			case FSCommands::FormatSaveData:
+			case FSCommands::FormatThisUserSaveData:
+			case FSCommands::RenameFile:
+				mem.write32(messagePointer, IPC::responseHeader(command >> 16, 1, 0));
+				mem.write32(messagePointer + 4, Result::Success);
+				return;
+
+			default: break;
+		}
 	}
+
+	const auto handler = commands.find(command);
+	if (handler == nullptr) [[unlikely]] {
+		Helpers::panic("FS service requested. Command: %08X\n", command);
+	}
+
+	(this->*handler)(messagePointer);
 }
 
 void FSService::initialize(u32 messagePointer) {
@@ -227,7 +310,9 @@ void FSService::closeArchive(u32 messagePointer) {
 		log("FSService::CloseArchive: Tried to close invalid archive %X\n", handle);
 		mem.write32(messagePointer + 4, Result::FailurePlaceholder);
 	} else {
+		// Archive handles don't go through CloseHandle, so this is where the archive session dies
 		object->getData<ArchiveSession>()->isOpen = false;
+		kernel.destroyObject(handle);
 		mem.write32(messagePointer + 4, Result::Success);
 	}
 }
@@ -2,6 +2,8 @@
 #include "PICA/regs.hpp"
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
+#include "scheduler.hpp"
 
 // Commands used with SendSyncRequest targetted to the GSP::GPU service
 namespace ServiceCommands {
@@ -42,34 +44,55 @@ void GPUService::reset() {
 	interruptEvent = std::nullopt;
 	gspThreadCount = 0;
 	sharedMem = nullptr;
+	commandPollScheduled = false;
+}
+
+void GPUService::doState(SaveStateStream& stream) {
+	stream.fcramPointer(sharedMem, mem.getFCRAM());
+	stream.value(privilegedProcess);
+	stream.optional(interruptEvent);
+	stream.value(gspThreadCount);
+	stream.value(commandPollScheduled);
 }
 
 void GPUService::handleSyncRequest(u32 messagePointer) {
-	const u32 command = mem.read32(messagePointer);
-	switch (command) {
-		case ServiceCommands::TriggerCmdReqQueue: [[likely]] triggerCmdReqQueue(messagePointer); break;
-		case ServiceCommands::AcquireRight: acquireRight(messagePointer); break;
-		case ServiceCommands::FlushDataCache: flushDataCache(messagePointer); break;
-		case ServiceCommands::ImportDisplayCaptureInfo: importDisplayCaptureInfo(messagePointer); break;
-		case ServiceCommands::RegisterInterruptRelayQueue: registerInterruptRelayQueue(messagePointer); break;
-		case ServiceCommands::ReleaseRight: releaseRight(messagePointer); break;
-		case ServiceCommands::RestoreVramSysArea: restoreVramSysArea(messagePointer); break;
-		case ServiceCommands::SaveVramSysArea: saveVramSysArea(messagePointer); break;
-		case ServiceCommands::SetAxiConfigQoSMode: setAxiConfigQoSMode(messagePointer); break;
-		case ServiceCommands::SetBufferSwap: setBufferSwap(messagePointer); break;
-		case ServiceCommands::SetInternalPriorities: setInternalPriorities(messagePointer); break;
-		case ServiceCommands::SetLCDForceBlack: setLCDForceBlack(messagePointer); break;
-		case ServiceCommands::StoreDataCache: storeDataCache(messagePointer); break;
-		case ServiceCommands::ReadHwRegs: readHwRegs(messagePointer); break;
-		case ServiceCommands::WriteHwRegs: writeHwRegs(messagePointer); break;
-		case ServiceCommands::WriteHwRegsWithMask: writeHwRegsWithMask(messagePointer); break;
-		default: Helpers::panic("GPU service requested. Command: %08X\n", command);
-	}
-}
-
-void GPUService::acquireRight(u32 messagePointer) {
-	const u32 flag = mem.read32(messagePointer + 4);
-	const u32 pid = mem.read32(messagePointer + 12);
+	static constexpr IPC::CommandTable<IPC::CommandHandler<GPUService>, 0x01, 0x1F> commands = {
+		{ServiceCommands::WriteHwRegs, &GPUService::writeHwRegs},
+		{ServiceCommands::WriteHwRegsWithMask, &GPUService::writeHwRegsWithMask},
+		{ServiceCommands::ReadHwRegs, &GPUService::readHwRegs},
+		{ServiceCommands::SetBufferSwap, &GPUService::setBufferSwap},
+		{ServiceCommands::FlushDataCache, &GPUService::flushDataCache},
+		{ServiceCommands::SetLCDForceBlack, &GPUService::setLCDForceBlack},
+		{ServiceCommands::TriggerCmdReqQueue, &GPUService::triggerCmdReqQueue},
+		{ServiceCommands::SetAxiConfigQoSMode, &GPUService::setAxiConfigQoSMode},
+		{ServiceCommands::RegisterInterruptRelayQueue, &GPUService::registerInterruptRelayQueue},
+		{ServiceCommands::AcquireRight, &GPUService::acquireRight},
+		{ServiceCommands::ReleaseRight, &GPUService::releaseRight},
+		{ServiceCommands::ImportDisplayCaptureInfo, &GPUService::importDisplayCaptureInfo},
+		{ServiceCommands::SaveVramSysArea, &GPUService::saveVramSysArea},
+		{ServiceCommands::RestoreVramSysArea, &GPUService::restoreVramSysArea},
+		{ServiceCommands::SetInternalPriorities, &GPUService::setInternalPriorities},
+		{ServiceCommands::StoreDataCache, &GPUService::storeDataCache},
+	};
+	static_assert(commands.isValid(), "GSP::GPU command table has clashing or out of range commands");
+
+	IPC::CommandBuffer cmd(mem, messagePointer);
+	const auto handler = commands.find(cmd.header());
+	if (handler == nullptr) [[unlikely]] {
+		Helpers::panic("GPU service requested. Command: %08X\n", cmd.header());
+	}
+
+	(this->*handler)(cmd);
+}
+
+void GPUService::acquireRight(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 flag;
+		u32 processDescriptor;
+		u32 pid;
+	};
+
+	const auto [flag, processDescriptor, pid] = cmd.request<Request>();
 	log("GSP::GPU::AcquireRight (flag = %X, pid = %X)\n", flag, pid);
 
 	if (flag != 0) {
@@ -82,32 +105,41 @@ void GPUService::acquireRight(u32 messagePointer) {
 		privilegedProcess = pid;
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x16, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x16>(Result::Success);
 }
 
-void GPUService::releaseRight(u32 messagePointer) {
+void GPUService::releaseRight(IPC::CommandBuffer& cmd) {
 	log("GSP::GPU::ReleaseRight\n");
 	if (privilegedProcess == currentPID) {
 		privilegedProcess = 0xFFFFFFFF;
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x17, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x17>(Result::Success);
 }
 
 // TODO: What is the flags field meant to be?
 // What is the "GSP module thread index" meant to be?
 // How does the shared memory handle thing work?
-void GPUService::registerInterruptRelayQueue(u32 messagePointer) {
+void GPUService::registerInterruptRelayQueue(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 flags;
+		u32 handleDescriptor;
+		u32 eventHandle;
+	};
+
+	struct Response {
+		u32 threadIndex;
+		u32 handleDescriptor;
+		u32 sharedMemHandle;
+	};
+
 	// Detect if this function is called a 2nd time because we'll likely need to impl threads properly for the GSP
 	if (gspThreadCount >= 1) {
 		Helpers::panic("RegisterInterruptRelayQueue called a second time. Need to implement GSP threads properly");
 	}
 	gspThreadCount += 1;
 
-	const u32 flags = mem.read32(messagePointer + 4);
-	const u32 eventHandle = mem.read32(messagePointer + 12);
+	const auto [flags, handleDescriptor, eventHandle] = cmd.request<Request>();
 	log("GSP::GPU::RegisterInterruptRelayQueue (flags = %X, event handle = %X)\n", flags, eventHandle);
 
 	const auto event = kernel.getObject(eventHandle, KernelObjectType::Event);
@@ -115,13 +147,15 @@ void GPUService::registerInterruptRelayQueue(u32 messagePointer) {
 		Helpers::panic("Invalid event passed to GSP::GPU::RegisterInterruptRelayQueue");
 	} else {
 		interruptEvent = eventHandle;
+		kernel.pinObject(eventHandle);  // We signal the event on every interrupt, even if the game closed its handle to it
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x13, 2, 2));
-	mem.write32(messagePointer + 4, Result::GSP::SuccessRegisterIRQ); // First init returns a unique result
-	mem.write32(messagePointer + 8, 0); // TODO: GSP module thread index
-	mem.write32(messagePointer + 12, 0); // Translation descriptor
-	mem.write32(messagePointer + 16, KernelHandles::GSPSharedMemHandle);
+	const Response response = {
+		.threadIndex = 0,  // TODO: GSP module thread index
+		.handleDescriptor = 0,
+		.sharedMemHandle = KernelHandles::GSPSharedMemHandle,
+	};
+	cmd.respond<0x13, 2>(Result::GSP::SuccessRegisterIRQ, response);  // First init returns a unique result
 }
 
 void GPUService::requestInterrupt(GPUInterrupt type) {
@@ -157,10 +191,21 @@ void GPUService::requestInterrupt(GPUInterrupt type) {
 	}
 }
 
-void GPUService::readHwRegs(u32 messagePointer) {
-	u32 ioAddr = mem.read32(messagePointer + 4);      // GPU address based at 0x1EB00000, word aligned
-	const u32 size = mem.read32(messagePointer + 8);  // Size in bytes
-	const u32 initialDataPointer = mem.read32(messagePointer + 0x104);
+void GPUService::readHwRegs(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 ioAddr;  // GPU address based at 0x1EB00000, word aligned
+		u32 size;    // Size in bytes
+	};
+
+	struct Response {
+		u32 bufferDescriptor;  // TODO: Make a more generic interface for translation descriptors
+		u32 dataPointer;
+	};
+
+	const Request request = cmd.request<Request>();
+	u32 ioAddr = request.ioAddr;
+	const u32 size = request.size;
+	const u32 initialDataPointer = cmd[0x104 / sizeof(u32)];  // Our output goes to the static buffer the caller set up
 	u32 dataPointer = initialDataPointer;
 	log("GSP::GPU::ReadHwRegs (GPU address = %08X, size = %X, data address = %08X)\n", ioAddr, size, dataPointer);
 	
@@ -179,6 +224,7 @@ void GPUService::readHwRegs(u32 messagePointer) {
 	}
 
 	ioAddr += 0x1EB00000;
+	gpu.sync();  // The registers might still be changing under a command list the GPU thread is running
 	// Read the PICA registers and write them to the output buffer
 	for (u32 i = 0; i < size; i += 4) {
 		const u32 value = gpu.readReg(ioAddr);
@@ -187,17 +233,21 @@ void GPUService::readHwRegs(u32 messagePointer) {
 		ioAddr += 4;
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x4, 1, 2));
-	mem.write32(messagePointer + 4, Result::Success);
-	// Translation descriptor. TODO: Make a more generic interface for this
-	mem.write32(messagePointer + 8, u32(size << 14) | 2);
-	mem.write32(messagePointer + 12, initialDataPointer);
+	cmd.respond<0x4, 2>(Result::Success, Response{.bufferDescriptor = u32(size << 14) | 2, .dataPointer = initialDataPointer});
 }
 
-void GPUService::writeHwRegs(u32 messagePointer) {
-	u32 ioAddr = mem.read32(messagePointer + 4); // GPU address based at 0x1EB00000, word aligned
-	const u32 size = mem.read32(messagePointer + 8); // Size in bytes
-	u32 dataPointer = mem.read32(messagePointer + 16);
+void GPUService::writeHwRegs(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 ioAddr;  // GPU address based at 0x1EB00000, word aligned
+		u32 size;    // Size in bytes
+		u32 bufferDescriptor;
+		u32 dataPointer;
+	};
+
+	const Request request = cmd.request<Request>();
+	u32 ioAddr = request.ioAddr;
+	const u32 size = request.size;
+	u32 dataPointer = request.dataPointer;
 	log("GSP::GPU::writeHwRegs (GPU address = %08X, size = %X, data address = %08X)\n", ioAddr, size, dataPointer);
 
 	// Check for alignment
@@ -214,6 +264,7 @@ void GPUService::writeHwRegs(u32 messagePointer) {
 	}
 
 	ioAddr += 0x1EB00000;
+	gpu.sync();
 	for (u32 i = 0; i < size; i += 4) {
 		const u32 value = mem.read32(dataPointer);
 		gpu.writeReg(ioAddr, value);
@@ -221,18 +272,26 @@ void GPUService::writeHwRegs(u32 messagePointer) {
 		ioAddr += 4;
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x1, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x1>(Result::Success);
 }
 
 // Update sequential GPU registers using an array of data and mask values using this formula
 // GPU register = (register & ~mask) | (data & mask).
-void GPUService::writeHwRegsWithMask(u32 messagePointer) {
-	u32 ioAddr = mem.read32(messagePointer + 4); // GPU address based at 0x1EB00000, word aligned
-	const u32 size = mem.read32(messagePointer + 8); // Size in bytes
+void GPUService::writeHwRegsWithMask(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 ioAddr;  // GPU address based at 0x1EB00000, word aligned
+		u32 size;    // Size in bytes
+		u32 dataDescriptor;
+		u32 dataPointer;
+		u32 maskDescriptor;
+		u32 maskPointer;
+	};
 
-	u32 dataPointer = mem.read32(messagePointer + 16); // Data pointer
-	u32 maskPointer = mem.read32(messagePointer + 24); // Mask pointer
+	const Request request = cmd.request<Request>();
+	u32 ioAddr = request.ioAddr;
+	const u32 size = request.size;
+	u32 dataPointer = request.dataPointer;
+	u32 maskPointer = request.maskPointer;
 
 	log("GSP::GPU::writeHwRegsWithMask (GPU address = %08X, size = %X, data address = %08X, mask address = %08X)\n",
 		ioAddr, size, dataPointer, maskPointer);
@@ -251,6 +310,7 @@ void GPUService::writeHwRegsWithMask(u32 messagePointer) {
 	}
 
 	ioAddr += 0x1EB00000;
+	gpu.sync();
 	for (u32 i = 0; i < size; i += 4) {
 		const u32 current = gpu.readReg(ioAddr);
 		const u32 data = mem.read32(dataPointer);
@@ -264,78 +324,97 @@ void GPUService::writeHwRegsWithMask(u32 messagePointer) {
 		ioAddr += 4;
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x2, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x2>(Result::Success);
 }
 
-void GPUService::flushDataCache(u32 messagePointer) {
-	u32 address = mem.read32(messagePointer + 4);
-	u32 size = mem.read32(messagePointer + 8);
-	u32 processHandle = handle = mem.read32(messagePointer + 16);
-	log("GSP::GPU::FlushDataCache(address = %08X, size = %X, process = %X)\n", address, size, processHandle);
+// FlushDataCache and StoreDataCache take the same parameters
+namespace {
+	struct CacheOperationRequest {
+		u32 address;
+		u32 size;
+		u32 processDescriptor;
+		u32 processHandle;
+	};
+}  // namespace
+
+void GPUService::flushDataCache(IPC::CommandBuffer& cmd) {
+	const auto request = cmd.request<CacheOperationRequest>();
+	handle = request.processHandle;
+	log("GSP::GPU::FlushDataCache(address = %08X, size = %X, process = %X)\n", request.address, request.size, request.processHandle);
+
+	// Games flush the data cache right before handing a buffer to the GPU, often one that an earlier command on the GPU thread still reads from.
+	// So wait for those to be done, the same as with FlushCacheRegions
+	if (gpu.isAsync()) {
+		gpu.sync();
+		collectGXCommands();
+	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0x8, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x8>(Result::Success);
 }
 
-void GPUService::storeDataCache(u32 messagePointer) {
-	u32 address = mem.read32(messagePointer + 4);
-	u32 size = mem.read32(messagePointer + 8);
-	u32 processHandle = handle = mem.read32(messagePointer + 16);
-	log("GSP::GPU::StoreDataCache(address = %08X, size = %X, process = %X)\n", address, size, processHandle);
+void GPUService::storeDataCache(IPC::CommandBuffer& cmd) {
+	const auto request = cmd.request<CacheOperationRequest>();
+	handle = request.processHandle;
+	log("GSP::GPU::StoreDataCache(address = %08X, size = %X, process = %X)\n", request.address, request.size, request.processHandle);
 
-	mem.write32(messagePointer, IPC::responseHeader(0x1F, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x1F>(Result::Success);
 }
 
-void GPUService::setLCDForceBlack(u32 messagePointer) {
-	u32 flag = mem.read32(messagePointer + 4);
+void GPUService::setLCDForceBlack(IPC::CommandBuffer& cmd) {
+	const u32 flag = cmd[1];
 	log("GSP::GPU::SetLCDForceBlank(flag = %d)\n", flag);
 
 	if (flag != 0) {
 		printf("Filled both LCDs with black\n");
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0xB, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0xB>(Result::Success);
 }
 
-void GPUService::triggerCmdReqQueue(u32 messagePointer) {
+void GPUService::triggerCmdReqQueue(IPC::CommandBuffer& cmd) {
 	processCommandBuffer();
-	mem.write32(messagePointer, IPC::responseHeader(0xC, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0xC>(Result::Success);
 }
 
 // Seems to be completely undocumented, probably not very important or useful
-void GPUService::setAxiConfigQoSMode(u32 messagePointer) {
+void GPUService::setAxiConfigQoSMode(IPC::CommandBuffer& cmd) {
 	log("GSP::GPU::SetAxiConfigQoSMode\n");
-	mem.write32(messagePointer, IPC::responseHeader(0x10, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x10>(Result::Success);
 }
 
-void GPUService::setBufferSwap(u32 messagePointer) {
-	FramebufferInfo info{};
-	const u32 screenId = mem.read32(messagePointer + 4);  // Selects either PDC0 or PDC1
-	info.activeFb = mem.read32(messagePointer + 8);
-	info.leftFramebufferVaddr = mem.read32(messagePointer + 12);
-	info.rightFramebufferVaddr = mem.read32(messagePointer + 16);
-	info.stride = mem.read32(messagePointer + 20);
-	info.format = mem.read32(messagePointer + 24);
-	info.displayFb = mem.read32(messagePointer + 28);  // Selects either framebuffer A or B
+void GPUService::setBufferSwap(IPC::CommandBuffer& cmd) {
+	struct Request {
+		u32 screenId;  // Selects either PDC0 or PDC1
+		u32 activeFb;
+		u32 leftFramebufferVaddr;
+		u32 rightFramebufferVaddr;
+		u32 stride;
+		u32 format;
+		u32 displayFb;  // Selects either framebuffer A or B
+	};
+
+	const Request request = cmd.request<Request>();
+	const FramebufferInfo info = {
+		.activeFb = request.activeFb,
+		.leftFramebufferVaddr = request.leftFramebufferVaddr,
+		.rightFramebufferVaddr = request.rightFramebufferVaddr,
+		.stride = request.stride,
+		.format = request.format,
+		.displayFb = request.displayFb,
+		.attribute = 0,
+	};
 
 	log("GSP::GPU::SetBufferSwap\n");
 	Helpers::warn("Untested GSP::GPU::SetBufferSwap call");
 
-	setBufferSwapImpl(screenId, info);
-	mem.write32(messagePointer, IPC::responseHeader(0x05, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	setBufferSwapImpl(request.screenId, info);
+	cmd.respond<0x05>(Result::Success);
 }
 
 // Seems to also be completely undocumented
-void GPUService::setInternalPriorities(u32 messagePointer) {
+void GPUService::setInternalPriorities(IPC::CommandBuffer& cmd) {
 	log("GSP::GPU::SetInternalPriorities\n");
-	mem.write32(messagePointer, IPC::responseHeader(0x1E, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x1E>(Result::Success);
 }
 
 void GPUService::processCommandBuffer() {
@@ -407,14 +486,14 @@ void GPUService::memoryFill(u32* cmd) {
 	u32 end1 = cmd[6];
 	u32 control1 = control >> 16;
 
+	using Type = PICA::GXCommand::Type;
+
 	if (start0 != 0) {
-		gpu.clearBuffer(VaddrToPaddr(start0), VaddrToPaddr(end0), value0, control0);
-		requestInterrupt(GPUInterrupt::PSC0);
+		runGXCommand({Type::MemoryFill, u8(GPUInterrupt::PSC0), {VaddrToPaddr(start0), VaddrToPaddr(end0), value0, control0}});
 	}
 
 	if (start1 != 0) {
-		gpu.clearBuffer(VaddrToPaddr(start1), VaddrToPaddr(end1), value1, control1);
-		requestInterrupt(GPUInterrupt::PSC1);
+		runGXCommand({Type::MemoryFill, u8(GPUInterrupt::PSC1), {VaddrToPaddr(start1), VaddrToPaddr(end1), value1, control1}});
 	}
 }
 
@@ -426,8 +505,8 @@ void GPUService::triggerDisplayTransfer(u32* cmd) {
 	const u32 flags = cmd[5];
 
 	log("GSP::GPU::TriggerDisplayTransfer (Stubbed)\n");
-	gpu.displayTransfer(inputAddr, outputAddr, inputSize, outputSize, flags);
-	requestInterrupt(GPUInterrupt::PPF); // Send "Display transfer finished" interrupt
+	// Send "Display transfer finished" interrupt once it's done
+	runGXCommand({PICA::GXCommand::Type::DisplayTransfer, u8(GPUInterrupt::PPF), {inputAddr, outputAddr, inputSize, outputSize, flags}});
 }
 
 void GPUService::triggerDMARequest(u32* cmd) {
@@ -437,12 +516,68 @@ void GPUService::triggerDMARequest(u32* cmd) {
 	const bool flush = cmd[7] == 1;
 
 	log("GSP::GPU::TriggerDMARequest (source = %08X, dest = %08X, size = %08X)\n", source, dest, size);
-	gpu.fireDMA(dest, source, size);
-	requestInterrupt(GPUInterrupt::DMA);
+	runGXCommand({PICA::GXCommand::Type::DMA, u8(GPUInterrupt::DMA), {dest, source, size}});
 }
 
 void GPUService::flushCacheRegions(u32* cmd) {
 	log("GSP::GPU::FlushCacheRegions (Stubbed)\n");
+
+	// The game is about to touch memory the GPU may still be working on, so finish everything in flight and raise its interrupts
+	if (gpu.isAsync()) {
+		gpu.sync();
+		collectGXCommands();
+	}
+}
+
+// Runs a GX command on the spot, or queues it on the GPU thread in asynchronous mode. Either way, its interrupt only fires once it has run
+void GPUService::runGXCommand(const PICA::GXCommand& command) {
+	if (!gpu.isAsync()) {
+		gpu.executeGXCommand(command);
+		requestInterrupt(static_cast<GPUInterrupt>(command.tag));
+		return;
+	}
+
+	GPUThread& thread = gpu.getCommandThread();
+	// Slots in the ring are only freed up once their interrupt has been raised
+	if (thread.isFull()) [[unlikely]] {
+		thread.waitForCompletion();
+		collectGXCommands();
+	}
+
+	thread.submit(command);
+	scheduleCommandPoll();
+}
+
+void GPUService::collectGXCommands() {
+	gpu.getCommandThread().collect([this](u8 tag) { requestInterrupt(static_cast<GPUInterrupt>(tag)); });
+}
+
+void GPUService::finishGXCommands() {
+	gpu.sync();
+	collectGXCommands();
+}
+
+void GPUService::scheduleCommandPoll() {
+	if (!commandPollScheduled) {
+		commandPollScheduled = true;
+
+		kernel.getScheduler().addEvent(Scheduler::EventType::PollGPU, kernel.getTicks() + Scheduler::nsToCycles(commandPollIntervalNs));
+	}
+}
+
+void GPUService::pollCommandThread() {
+	commandPollScheduled = false;
+	GPUThread& thread = gpu.getCommandThread();
+
+	// If every guest thread is blocked, most likely on one of our interrupts, there's nothing to overlap the GPU work with
+	if (kernel.isIdle()) {
+		thread.waitForCompletion();
+	}
+
+	collectGXCommands();
+	if (thread.hasOutstanding()) {
+		scheduleCommandPoll();
+	}
 }
 
 void GPUService::setBufferSwapImpl(u32 screenId, const FramebufferInfo& info) {
@@ -459,6 +594,7 @@ void GPUService::setBufferSwapImpl(u32 screenId, const FramebufferInfo& info) {
 		Framebuffer1BSecondAddr,
 	};
 
+	gpu.sync();  // Transfers on the GPU thread might still be reading the framebuffer registers
 	auto& regs = gpu.getExtRegisters();
 
 	const u32 fbIndex = info.activeFb * 4 + screenId * 2;
@@ -488,8 +624,7 @@ void GPUService::processCommandList(u32* cmd) {
 	[[maybe_unused]] const bool flushBuffer = cmd[7] == 1; // Flush buffer (0 = don't flush, 1 = flush)
 
 	log("GPU::GSP::processCommandList. Address: %08X, size in bytes: %08X\n", address, size);
-	gpu.startCommandList(address, size);
-	requestInterrupt(GPUInterrupt::P3D); // Send an IRQ when command list processing is over
+	runGXCommand({PICA::GXCommand::Type::CommandList, u8(GPUInterrupt::P3D), {address, size}});  // Send an IRQ when command list processing is over
 }
 
 // TODO: Emulate the transfer engine & its registers
@@ -503,34 +638,34 @@ void GPUService::triggerTextureCopy(u32* cmd) {
 	const u32 flags = cmd[6];
 
 	log("GSP::GPU::TriggerTextureCopy (Stubbed)\n");
-	gpu.textureCopy(inputAddr, outputAddr, totalBytes, inputSize, outputSize, flags);
 	// This uses the transfer engine and thus needs to fire a PPF interrupt.
 	// NSMB2 relies on this
-	requestInterrupt(GPUInterrupt::PPF);
+	runGXCommand({PICA::GXCommand::Type::TextureCopy, u8(GPUInterrupt::PPF), {inputAddr, outputAddr, totalBytes, inputSize, outputSize, flags}});
 }
 
 // Used when transitioning from the app to an OS applet, such as software keyboard, mii maker, mii selector, etc
 // Stubbed until we decide to support LLE applets
-void GPUService::saveVramSysArea(u32 messagePointer) {
+void GPUService::saveVramSysArea(IPC::CommandBuffer& cmd) {
 	Helpers::warn("GSP::GPU::SaveVramSysArea (stubbed)");
-
-	mem.write32(messagePointer, IPC::responseHeader(0x19, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x19>(Result::Success);
 }
 
-void GPUService::restoreVramSysArea(u32 messagePointer) {
+void GPUService::restoreVramSysArea(IPC::CommandBuffer& cmd) {
 	Helpers::warn("GSP::GPU::RestoreVramSysArea (stubbed)");
-
-	mem.write32(messagePointer, IPC::responseHeader(0x1A, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x1A>(Result::Success);
 }
 
 // Used in similar fashion to the SaveVramSysArea function
-void GPUService::importDisplayCaptureInfo(u32 messagePointer) {
-	Helpers::warn("GSP::GPU::ImportDisplayCaptureInfo (stubbed)");
+void GPUService::importDisplayCaptureInfo(IPC::CommandBuffer& cmd) {
+	struct Response {
+		CaptureInfo topScreen;
+		CaptureInfo bottomScreen;
+	};
 
-	mem.write32(messagePointer, IPC::responseHeader(0x18, 9, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	Helpers::warn("GSP::GPU::ImportDisplayCaptureInfo (stubbed)");
+	// If the GSP module isn't set up, we reply without any capture info
+	cmd[0] = IPC::responseHeader(0x18, 9, 0);
+	cmd[1] = Result::Success;
 
 	if (sharedMem == nullptr) {
 		Helpers::warn("GSP::GPU::ImportDisplayCaptureInfo called without GSP module being properly initialized!");
@@ -555,13 +690,5 @@ void GPUService::importDisplayCaptureInfo(u32 messagePointer) {
 		.stride = bottomScreen->framebufferInfo[bottomScreen->index].stride,
 	};
 
-	mem.write32(messagePointer + 8, topScreenCapture.leftFramebuffer);
-	mem.write32(messagePointer + 12, topScreenCapture.rightFramebuffer);
-	mem.write32(messagePointer + 16, topScreenCapture.format);
-	mem.write32(messagePointer + 20, topScreenCapture.stride);
-
-	mem.write32(messagePointer + 24, bottomScreenCapture.leftFramebuffer);
-	mem.write32(messagePointer + 28, bottomScreenCapture.rightFramebuffer);
-	mem.write32(messagePointer + 32, bottomScreenCapture.format);
-	mem.write32(messagePointer + 36, bottomScreenCapture.stride);
+	cmd.respond<0x18>(Result::Success, Response{.topScreen = topScreenCapture, .bottomScreen = bottomScreenCapture});
 }
@@ -1,5 +1,6 @@
 #include "services/hid.hpp"
 #include "ipc.hpp"
+#include "savestate.hpp"
 #include "kernel.hpp"
 #include <bit>
 
@@ -37,91 +38,126 @@ void HIDService::reset() {
 	roll = pitch = yaw = 0;
 }
 
+void HIDService::doState(SaveStateStream& stream) {
+	stream.fcramPointer(sharedMem, mem.getFCRAM());
+	stream.value(nextPadIndex);
+	stream.value(nextTouchscreenIndex);
+	stream.value(nextAccelerometerIndex);
+	stream.value(nextGyroIndex);
+
+	stream.value(newButtons);
+	stream.value(oldButtons);
+	stream.value(circlePadX);
+	stream.value(circlePadY);
+	stream.value(touchScreenX);
+	stream.value(touchScreenY);
+	stream.value(roll);
+	stream.value(pitch);
+	stream.value(yaw);
+
+	stream.value(accelerometerEnabled);
+	stream.value(eventsInitialized);
+	stream.value(gyroEnabled);
+	stream.value(touchScreenPressed);
+
+	for (auto& event : events) {
+		stream.optional(event);
+	}
+}
+
 void HIDService::handleSyncRequest(u32 messagePointer) {
-	const u32 command = mem.read32(messagePointer);
-	switch (command) {
-		case HIDCommands::DisableAccelerometer: disableAccelerometer(messagePointer); break;
-		case HIDCommands::DisableGyroscopeLow: disableGyroscopeLow(messagePointer); break;
-		case HIDCommands::EnableAccelerometer: enableAccelerometer(messagePointer); break;
-		case HIDCommands::EnableGyroscopeLow: enableGyroscopeLow(messagePointer); break;
-		case HIDCommands::GetGyroscopeLowCalibrateParam: getGyroscopeLowCalibrateParam(messagePointer); break;
-		case HIDCommands::GetGyroscopeLowRawToDpsCoefficient: getGyroscopeCoefficient(messagePointer); break;
-		case HIDCommands::GetIPCHandles: getIPCHandles(messagePointer); break;
-		case HIDCommands::GetSoundVolume: getSoundVolume(messagePointer); break;
-		default: Helpers::panic("HID service requested. Command: %08X\n", command);
+	static constexpr IPC::CommandTable<IPC::CommandHandler<HIDService>, 0x0A, 0x17> commands = {
+		{HIDCommands::GetIPCHandles, &HIDService::getIPCHandles},
+		{HIDCommands::EnableAccelerometer, &HIDService::enableAccelerometer},
+		{HIDCommands::DisableAccelerometer, &HIDService::disableAccelerometer},
+		{HIDCommands::EnableGyroscopeLow, &HIDService::enableGyroscopeLow},
+		{HIDCommands::DisableGyroscopeLow, &HIDService::disableGyroscopeLow},
+		{HIDCommands::GetGyroscopeLowRawToDpsCoefficient, &HIDService::getGyroscopeCoefficient},
+		{HIDCommands::GetGyroscopeLowCalibrateParam, &HIDService::getGyroscopeLowCalibrateParam},
+		{HIDCommands::GetSoundVolume, &HIDService::getSoundVolume},
+	};
+	static_assert(commands.isValid(), "HID command table has clashing or out of range commands");
+
+	IPC::CommandBuffer cmd(mem, messagePointer);
+	const auto handler = commands.find(cmd.header());
+	if (handler == nullptr) [[unlikely]] {
+		Helpers::panic("HID service requested. Command: %08X\n", cmd.header());
 	}
+
+	(this->*handler)(cmd);
 }
 
-void HIDService::enableAccelerometer(u32 messagePointer) {
+void HIDService::enableAccelerometer(IPC::CommandBuffer& cmd) {
 	log("HID::EnableAccelerometer\n");
 	accelerometerEnabled = true;
 
-	mem.write32(messagePointer, IPC::responseHeader(0x11, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x11>(Result::Success);
 }
 
-void HIDService::disableAccelerometer(u32 messagePointer) {
+void HIDService::disableAccelerometer(IPC::CommandBuffer& cmd) {
 	log("HID::DisableAccelerometer\n");
 	accelerometerEnabled = false;
 
-	mem.write32(messagePointer, IPC::responseHeader(0x12, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x12>(Result::Success);
 }
 
-void HIDService::enableGyroscopeLow(u32 messagePointer) {
+void HIDService::enableGyroscopeLow(IPC::CommandBuffer& cmd) {
 	log("HID::EnableGyroscopeLow\n");
 	gyroEnabled = true;
 
-	mem.write32(messagePointer, IPC::responseHeader(0x13, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x13>(Result::Success);
 }
 
-void HIDService::disableGyroscopeLow(u32 messagePointer) {
+void HIDService::disableGyroscopeLow(IPC::CommandBuffer& cmd) {
 	log("HID::DisableGyroscopeLow\n");
 	gyroEnabled = false;
 
-	mem.write32(messagePointer, IPC::responseHeader(0x14, 1, 0));
-	mem.write32(messagePointer + 4, Result::Success);
+	cmd.respond<0x14>(Result::Success);
 }
 
-void HIDService::getGyroscopeLowCalibrateParam(u32 messagePointer) {
+void HIDService::getGyroscopeLowCalibrateParam(IPC::CommandBuffer& cmd) {
+	struct AxisCalibration {
+		s16 zero;
+		s16 positiveUnit;
+		s16 negativeUnit;
+	};
+
+	struct Response {
+		std::array<AxisCalibration, 3> axes;  // x, y and z
+		u16 padding;
+	};
+
 	log("HID::GetGyroscopeLowCalibrateParam\n");
 	constexpr s16 unit = 6700; // Approximately from Citra which took it from hardware
+	constexpr AxisCalibration calibration = {.zero = 0, .positiveUnit = unit, .negativeUnit = -unit};
 
-	mem.write32(messagePointer, IPC::responseHeader(0x16, 6, 0));
-	mem.write32(messagePointer + 4, Result::Success);
-	// Fill calibration data (for x/y/z depending on i)
-	for (int i = 0; i < 3; i++) {
-		const u32 pointer = messagePointer + 8 + i * 3 * sizeof(u16); // Pointer to write the calibration info for the current coordinate
-
-		mem.write16(pointer, 0); // Zero point
-		mem.write16(pointer + 1 * sizeof(u16), unit); // Positive unit point
-		mem.write16(pointer + 2 * sizeof(u16), -unit); // Negative unit point
-	}
+	cmd.respond<0x16>(Result::Success, Response{.axes = {calibration, calibration, calibration}, .padding = 0});
 }
 
-void HIDService::getGyroscopeCoefficient(u32 messagePointer) {
+void HIDService::getGyroscopeCoefficient(IPC::CommandBuffer& cmd) {
 	log("HID::GetGyroscopeLowRawToDpsCoefficient\n");
 
 	constexpr float gyroscopeCoeff = 14.375f; // Same as retail 3DS
-	mem.write32(messagePointer, IPC::responseHeader(0x15, 2, 0));
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write32(messagePointer + 8, Helpers::bit_cast<u32, float>(gyroscopeCoeff));
+	cmd.respond<0x15>(Result::Success, gyroscopeCoeff);
 }
 
 // The volume here is in the range [0, 0x3F]
 // It is read directly from I2C Device 3 register 0x09
 // Since we currently do not have audio, set the volume a bit below max (0x30)
-void HIDService::getSoundVolume(u32 messagePointer) {
+void HIDService::getSoundVolume(IPC::CommandBuffer& cmd) {
 	log("HID::GetSoundVolume\n");
 	constexpr u8 volume = 0x30;
 
-	mem.write32(messagePointer, IPC::responseHeader(0x17, 2, 0));
-	mem.write32(messagePointer + 4, Result::Success);
-	mem.write8(messagePointer + 8, volume);
+	cmd.respond<0x17>(Result::Success, u32(volume));
 }
 
-void HIDService::getIPCHandles(u32 messagePointer) {
+void HIDService::getIPCHandles(IPC::CommandBuffer& cmd) {
+	struct Response {
+		u32 handleDescriptor;
+		Handle sharedMemHandle;
+		std::array<Handle, 5> events;
+	};
+
 	log("HID::GetIPCHandles\n");
 
 	// Initialize HID events
@@ -133,15 +169,16 @@ void HIDService::getIPCHandles(u32 messagePointer) {
 		}
 	}
 
-	mem.write32(messagePointer, IPC::responseHeader(0xA, 1, 7));
-	mem.write32(messagePointer + 4, Result::Success); // Result code
-	mem.write32(messagePointer + 8, 0x14000000); // Translation descriptor
-	mem.write32(messagePointer + 12, KernelHandles::HIDSharedMemHandle); // Shared memory handle
+	Response response = {
+		.handleDescriptor = 0x14000000,  // Copy 6 handles
+		.sharedMemHandle = KernelHandles::HIDSharedMemHandle,
+	};
 
-	// Write HID event handles
 	for (int i = 0; i < events.size(); i++) {
-		mem.write32(messagePointer + 16 + sizeof(Handle) * i, events[i].value());
+		response.events[i] = events[i].value();
 	}
+
+	cmd.respond<0xA, 7>(Result::Success, response);
 }
 
 void HIDService::updateInputs(u64 currentTick) {
@@ -2,6 +2,7 @@
 
 #include "ipc.hpp"
 #include "result/result.hpp"
+#include "savestate.hpp"
 
 namespace HTTPCommands {
 	enum : u32 {
@@ -13,6 +14,10 @@ namespace HTTPCommands {
 
 void HTTPService::reset() { initialized = false; }
 
+void HTTPService::doState(SaveStateStream& stream) {
+	stream.value(initialized);
+}
+
 void HTTPService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
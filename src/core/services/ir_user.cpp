@@ -4,6 +4,7 @@
 
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 namespace IRUserCommands {
 	enum : u32 {
@@ -24,6 +25,24 @@ void IRUserService::reset() {
 	connectedDevice = false;
 }
 
+void IRUserService::doState(SaveStateStream& stream) {
+	stream.optional(connectionStatusEvent);
+	stream.optional(receiveEvent);
+	stream.value(connectedDevice);
+
+	// MemoryBlock has no default constructor, so the optional can't go through stream.optional
+	bool hasSharedMemory = sharedMemory.has_value();
+	MemoryBlock block = sharedMemory.value_or(MemoryBlock(0, 0, 0, 0));
+	stream.value(hasSharedMemory);
+	if (hasSharedMemory) {
+		stream.value(block);
+	}
+
+	if (stream.isReading()) {
+		sharedMemory = hasSharedMemory ? std::optional<MemoryBlock>(block) : std::nullopt;
+	}
+}
+
 void IRUserService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
@@ -58,6 +77,7 @@ void IRUserService::initializeIrnopShared(u32 messagePointer) {
 
 	MemoryBlock* memoryBlock = object->getData<MemoryBlock>();
 	sharedMemory = *memoryBlock;
+	kernel.pinObject(sharedMemHandle);  // The shared memory stays in use until FinalizeIrnop, even if the game closes its handle
 
 	// Set the initialized byte in shared mem to 1
 	mem.write8(memoryBlock->addr + offsetof(SharedMemoryStatus, isInitialized), 1);
@@ -1,6 +1,7 @@
 #include "services/ldr_ro.hpp"
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 #include <cstdio>
 #include <string>
@@ -1193,6 +1194,10 @@ void LDRService::reset() {
 	loadedCRS = 0;
 }
 
+void LDRService::doState(SaveStateStream& stream) {
+	stream.value(loadedCRS);
+}
+
 void LDRService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
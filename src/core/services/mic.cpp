@@ -1,6 +1,7 @@
 #include "services/mic.hpp"
 #include "ipc.hpp"
 #include "kernel/kernel.hpp"
+#include "savestate.hpp"
 
 namespace MICCommands {
 	enum : u32 {
@@ -29,6 +30,14 @@ void MICService::reset() {
 	eventHandle = std::nullopt;
 }
 
+void MICService::doState(SaveStateStream& stream) {
+	stream.value(gain);
+	stream.value(micEnabled);
+	stream.value(shouldClamp);
+	stream.value(currentlySampling);
+	stream.optional(eventHandle);
+}
+
 void MICService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
@@ -1,5 +1,6 @@
 #include "services/ndm.hpp"
 #include "ipc.hpp"
+#include "savestate.hpp"
 
 namespace NDMCommands {
 	enum : u32 {
@@ -17,6 +18,10 @@ namespace NDMCommands {
 
 void NDMService::reset() { exclusiveState = ExclusiveState::None; }
 
+void NDMService::doState(SaveStateStream& stream) {
+	stream.value(exclusiveState);
+}
+
 void NDMService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
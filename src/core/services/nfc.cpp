@@ -2,6 +2,7 @@
 #include "io_file.hpp"
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 namespace NFCCommands {
 	enum : u32 {
@@ -32,6 +33,15 @@ void NFCService::reset() {
 	initialized = false;
 }
 
+void NFCService::doState(SaveStateStream& stream) {
+	stream.optional(tagInRangeEvent);
+	stream.optional(tagOutOfRangeEvent);
+	stream.value(adapterStatus);
+	stream.value(tagStatus);
+	stream.value(initialized);
+	device.doState(stream);
+}
+
 void NFCService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
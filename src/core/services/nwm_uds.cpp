@@ -1,6 +1,7 @@
 #include "ipc.hpp"
 #include "kernel.hpp"
 #include "result/result.hpp"
+#include "savestate.hpp"
 #include "services/nwm_uds.hpp"
 
 namespace NWMCommands {
@@ -14,6 +15,11 @@ void NwmUdsService::reset() {
 	initialized = false;
 }
 
+void NwmUdsService::doState(SaveStateStream& stream) {
+	stream.value(initialized);
+	stream.optional(eventHandle);
+}
+
 void NwmUdsService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 
@@ -4,6 +4,7 @@
 
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 ServiceManager::ServiceManager(std::span<u32, 16> regs, Memory& mem, GPU& gpu, u32& currentPID, Kernel& kernel, const EmulatorConfig& config)
 	: regs(regs), mem(mem), kernel(kernel), ac(mem), am(mem), boss(mem), act(mem), apt(mem, kernel), cam(mem, kernel), cecd(mem, kernel), cfg(mem),
@@ -48,6 +49,34 @@ void ServiceManager::reset() {
 	notificationSemaphore = std::nullopt;
 }
 
+void ServiceManager::doState(SaveStateStream& stream) {
+	stream.section("SRV ");
+	stream.optional(notificationSemaphore);
+
+	// Services without any state of their own (ACT, AM, CFG, DLP::SRVR, LCD, news:u, NIM, PTM, MCU::HWC) are skipped
+	ac.doState(stream);
+	apt.doState(stream);
+	boss.doState(stream);
+	cam.doState(stream);
+	cecd.doState(stream);
+	csnd.doState(stream);
+	dsp.doState(stream);
+	hid.doState(stream);
+	http.doState(stream);
+	ir_user.doState(stream);
+	frd.doState(stream);
+	fs.doState(stream);
+	gsp_gpu.doState(stream);
+	ldr.doState(stream);
+	mic.doState(stream);
+	ndm.doState(stream);
+	nfc.doState(stream);
+	nwm_uds.doState(stream);
+	soc.doState(stream);
+	ssl.doState(stream);
+	y2r.doState(stream);
+}
+
 // Match IPC messages to a "srv:" command based on their header
 namespace Commands {
 	enum : u32 {
@@ -93,7 +122,7 @@ void ServiceManager::registerClient(u32 messagePointer) {
 }
 
 // clang-format off
-static std::map<std::string, Handle> serviceMap = {
+static const std::map<std::string, Handle> serviceMap = {
 	{ "ac:u", KernelHandles::AC },
 	{ "act:a", KernelHandles::ACT },
 	{ "act:u", KernelHandles::ACT },
@@ -196,6 +225,10 @@ void ServiceManager::unsubscribe(u32 messagePointer) {
 }
 
 void ServiceManager::sendCommandToService(u32 messagePointer, Handle handle) {
+	// The header is only worth reading if it's going to be recorded, as the service overwrites it with its response
+	IPCProfiler& profiler = kernel.getIPCProfiler();
+	const IPCProfiler::Scope profile(profiler, handle, profiler.isEnabled() ? mem.read32(messagePointer) : 0);
+
 	switch (handle) {
 		// Breaking alphabetical order a bit to place the ones I think are most common at the top
 		case KernelHandles::GPU: [[likely]] gsp_gpu.handleSyncRequest(messagePointer); break;
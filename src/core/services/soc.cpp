@@ -2,6 +2,7 @@
 
 #include "ipc.hpp"
 #include "result/result.hpp"
+#include "savestate.hpp"
 
 namespace SOCCommands {
 	enum : u32 {
@@ -11,6 +12,10 @@ namespace SOCCommands {
 
 void SOCService::reset() { initialized = false; }
 
+void SOCService::doState(SaveStateStream& stream) {
+	stream.value(initialized);
+}
+
 void SOCService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
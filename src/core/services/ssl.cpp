@@ -1,5 +1,6 @@
 #include "ipc.hpp"
 #include "result/result.hpp"
+#include "savestate.hpp"
 #include "services/ssl.hpp"
 
 namespace SSLCommands {
@@ -16,6 +17,11 @@ void SSLService::reset() {
 	rng.seed();
 }
 
+void SSLService::doState(SaveStateStream& stream) {
+	stream.value(initialized);
+	stream.value(rng);
+}
+
 void SSLService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
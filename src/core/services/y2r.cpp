@@ -2,6 +2,7 @@
 
 #include "ipc.hpp"
 #include "kernel.hpp"
+#include "savestate.hpp"
 
 namespace Y2RCommands {
 	enum : u32 {
@@ -64,6 +65,22 @@ void Y2RService::reset() {
 	isBusy = false;
 }
 
+void Y2RService::doState(SaveStateStream& stream) {
+	stream.optional(transferEndEvent);
+	stream.value(transferEndInterruptEnabled);
+	stream.value(conversionCoefficients);
+	stream.value(inputFmt);
+	stream.value(outputFmt);
+	stream.value(rotation);
+	stream.value(alignment);
+	stream.value(spacialDithering);
+	stream.value(temporalDithering);
+	stream.value(alpha);
+	stream.value(inputLineWidth);
+	stream.value(inputLines);
+	stream.value(isBusy);
+}
+
 void Y2RService::handleSyncRequest(u32 messagePointer) {
 	const u32 command = mem.read32(messagePointer);
 	switch (command) {
@@ -4,7 +4,11 @@
 #include <SDL_filesystem.h>
 #endif
 
+#include <cstring>
 #include <fstream>
+#include <memory>
+
+#include "loader/compressed_rom.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -16,8 +20,10 @@ __declspec(dllexport) DWORD AmdPowerXpressRequestHighPerformance = 1;
 }
 #endif
 
-Emulator::Emulator()
-	: config(getConfigPath()), kernel(cpu, memory, gpu, config), cpu(memory, kernel, *this), gpu(memory, config), memory(cpu.getTicksRef(), config),
+Emulator::Emulator() : Emulator(EmulatorConfig(getConfigPath())) {}
+
+Emulator::Emulator(const EmulatorConfig& emulatorConfig)
+	: config(emulatorConfig), kernel(cpu, memory, gpu, config), cpu(memory, kernel, *this), gpu(memory, config), memory(cpu.getTicksRef(), config),
 	  cheats(memory, kernel.getServiceManager().getHID()), lua(*this), running(false)
 #ifdef PANDA3DS_ENABLE_HTTP_SERVER
 	  ,
@@ -42,6 +48,8 @@ Emulator::Emulator()
 }
 
 Emulator::~Emulator() {
+	// Memory is torn down before the GPU, so the GPU thread must not be in the middle of a command when we start destroying things
+	gpu.sync();
 	config.save();
 	lua.close();
 
@@ -61,6 +69,8 @@ void Emulator::reset(ReloadOption reload) {
 
 	// Kernel must be reset last because it depends on CPU/Memory state
 	kernel.reset();
+	// Run-ahead gets another chance if it was disabled after failing to restore a frame
+	runAheadDisabled = false;
 
 	// Reloading r13 and r15 needs to happen after everything has been reset
 	// Otherwise resetting the kernel or cpu might nuke them
@@ -84,6 +94,135 @@ void Emulator::reset(ReloadOption reload) {
 	}
 }
 
+void Emulator::prepareForSaveState(bool writeBackVRAM, bool commitSaveData) {
+	kernel.drainAsyncIO();
+	getServiceManager().getGSP().finishGXCommands();
+
+	// Get the renderer to write back anything it rendered to VRAM. This also finishes its pending downloads, so none of them can land in
+	// VRAM after it's been replaced
+	if (writeBackVRAM) {
+		memory.flushVRAM(PhysicalAddrs::VRAM, VirtualAddrs::VramSize);
+	}
+
+	// Commit the save data the guest wrote
+	if (commitSaveData) {
+		getServiceManager().getFS().flushSaveData();
+	}
+}
+
+void Emulator::doState(SaveStateStream& stream) {
+	stream.section("EMU ");
+
+	// The state of one DSP core doesn't mean anything to another
+	Audio::DSPCore::Type dspType = config.dspType;
+	stream.value(dspType);
+	if (dspType != config.dspType) {
+		Helpers::warn("Save state was made with the %s DSP core", Audio::DSPCore::typeToString(dspType));
+		stream.fail();
+		return;
+	}
+
+	scheduler.doState(stream);
+	cpu.doState(stream);
+	memory.doState(stream);
+	gpu.doState(stream);
+	kernel.doState(stream);
+	dsp->doState(stream);
+}
+
+void Emulator::takeSnapshot(Snapshot& snapshot, SnapshotKind kind) {
+	prepareForSaveState(true, kind == SnapshotKind::Full);
+
+	snapshot.state.clear();
+	SaveStateStream stream = SaveStateStream::writer(snapshot.state);
+	doState(stream);
+	memory.captureFCRAM(snapshot.fcram);
+}
+
+bool Emulator::restoreSnapshot(const Snapshot& snapshot, SnapshotKind kind) {
+	prepareForSaveState(true, kind == SnapshotKind::Full);
+
+	SaveStateStream stream = SaveStateStream::reader(snapshot.state);
+	stream.setKeepHostCaches(kind == SnapshotKind::RunAhead);
+	doState(stream);
+	if (stream.hasFailed()) {
+		Helpers::warn("Failed to restore snapshot");
+		return false;
+	}
+
+	memory.restoreFCRAM(snapshot.fcram);
+	return true;
+}
+
+void Emulator::saveState(std::vector<u8>& output) {
+	prepareForSaveState();
+
+	SaveState::Header header = {
+		.magic = SaveState::magic,
+		.version = SaveState::version,
+		.programID = memory.getProgramID().value_or(0),
+		.payloadSize = 0,
+	};
+
+	output.clear();
+	SaveStateStream stream = SaveStateStream::writer(output);
+	stream.value(header);
+	doState(stream);
+	memory.doFCRAMState(stream);
+
+	header.payloadSize = output.size() - sizeof(header);
+	std::memcpy(output.data(), &header, sizeof(header));
+}
+
+bool Emulator::loadState(std::span<const u8> input) {
+	SaveState::Header header;
+	if (input.size() < sizeof(header)) {
+		return false;
+	}
+
+	std::memcpy(&header, input.data(), sizeof(header));
+	if (header.magic != SaveState::magic || header.version != SaveState::version || header.payloadSize > input.size() - sizeof(header)) {
+		Helpers::warn("Invalid save state, or one made by a different version of the emulator");
+		return false;
+	}
+
+	if (header.programID != memory.getProgramID().value_or(0)) {
+		Helpers::warn("Save state is for a different game (program ID %016llX)", header.programID);
+		return false;
+	}
+
+	// Keep the current state around, so that a state that turns out to be broken halfway through loading doesn't leave us with half of it
+	Snapshot backup;
+	takeSnapshot(backup);
+
+	SaveStateStream stream = SaveStateStream::reader(input.subspan(sizeof(header), header.payloadSize));
+	doState(stream);
+	memory.doFCRAMState(stream);
+
+	if (stream.hasFailed()) {
+		Helpers::warn("Failed to load save state");
+		restoreSnapshot(backup);
+		return false;
+	}
+
+	// The state may come from another run, which had different code in the places our JIT has compiled
+	cpu.clearCache();
+	return true;
+}
+
+usize Emulator::getSaveStateSize() {
+	// Measuring doesn't look at the contents of VRAM or the save files, so there's nothing to write back
+	prepareForSaveState(false, false);
+
+	SaveStateStream stream = SaveStateStream::measurer();
+	doState(stream);
+
+	// FCRAM is stored one allocated page at a time, so all of it is the most it can take. Leave some room for the rest of the state to grow,
+	// as kernel objects, pipe data and queued audio come and go
+	constexpr usize slack = 1_MB;
+	return sizeof(SaveState::Header) + stream.size() + sizeof(u32) + Memory::FCRAM_SIZE + slack;
+}
+
 #ifndef __LIBRETRO__
 std::filesystem::path Emulator::getAndroidAppPath() {
 	// SDL_GetPrefPath fails to get the path due to no JNI environment
@@ -124,13 +263,13 @@ void Emulator::togglePause() { running ? pause() : resume(); }
 
 void Emulator::runFrame() {
 	if (running) {
-		cpu.runFrame(); // Run 1 frame of instructions
-		gpu.display();  // Display graphics
-
-		// Run cheats if any are loaded
-		if (cheats.haveCheats()) [[unlikely]] {
-			cheats.run();
+		if (config.runAheadFrames > 0 && !runAheadDisabled) {
+			runAhead();
+			return;
 		}
+
+		runEmulatedFrame();
+		gpu.display();  // Display graphics
 	} else if (romType != ROMType::None) {
 		// If the emulator is not running and a game is loaded, we still want to display the framebuffer otherwise we will get weird
 		// double-buffering issues
@@ -138,6 +277,58 @@ void Emulator::runFrame() {
 	}
 }
 
+void Emulator::runEmulatedFrame() {
+	cpu.runFrame();  // Run 1 frame of instructions
+
+	// Run cheats if any are loaded
+	if (cheats.haveCheats()) [[unlikely]] {
+		cheats.run();
+	}
+}
+
+// Games usually take a frame or more to show the effect of an input. Run-ahead hides that by running the real frame with the current input,
+// saving the state, then running the frames after it with the same input and only displaying the last one. The speculative frames are then
+// thrown away by going back to the saved state, so emulation itself stays exactly as if run-ahead was off
+void Emulator::runAhead() {
+	// The LLE DSP can't be restored from a snapshot without desyncing the audio firmware
+	if (config.dspType == Audio::DSPCore::Type::Teakra) {
+		if (!runAheadWarned) {
+			Helpers::warn("Run-ahead is not supported with the Teakra DSP core, running frames normally");
+			runAheadWarned = true;
+		}
+
+		runEmulatedFrame();
+		gpu.display();
+		return;
+	}
+
+	runEmulatedFrame();
+	takeSnapshot(runAheadSnapshot, SnapshotKind::RunAhead);
+
+	// Audio of the speculative frames would be played again once they're run for real, and their IPC requests would be profiled twice.
+	// Their filesystem changes are kept away from the host and undone along with the rest of their state
+	IPCProfiler& profiler = kernel.getIPCProfiler();
+	FSService& fs = getServiceManager().getFS();
+	const bool profiling = profiler.isEnabled();
+	dsp->setAudioEnabled(false);
+	profiler.setEnabled(false);
+	fs.setSpeculative(true);
+	for (int i = 0; i < config.runAheadFrames; i++) {
+		runEmulatedFrame();
+	}
+	gpu.display();
+
+	const bool restored = restoreSnapshot(runAheadSnapshot, SnapshotKind::RunAhead);
+	fs.setSpeculative(false);
+	dsp->setAudioEnabled(config.audioEnabled);
+	profiler.setEnabled(profiling);
+
+	if (!restored) {
+		Helpers::warn("Run-ahead: Failed to go back to the real frame, disabling run-ahead");
+		runAheadDisabled = true;
+	}
+}
+
 void Emulator::pollScheduler() {
 	auto& events = scheduler.events;
 
@@ -172,6 +363,9 @@ void Emulator::pollScheduler() {
 			}
 
 			case Scheduler::EventType::SignalY2R: kernel.getServiceManager().getY2R().signalConversionDone(); break;
+			case Scheduler::EventType::PollAsyncIO: kernel.pollAsyncIO(); break;
+			case Scheduler::EventType::FlushSaveData: kernel.flushSaveData(); break;
+			case Scheduler::EventType::PollGPU: kernel.getServiceManager().getGSP().pollCommandThread(); break;
 
 			default: {
 				Helpers::panic("Scheduler: Unimplemented event type received: %d\n", static_cast<int>(eventType));
@@ -216,11 +410,13 @@ bool Emulator::loadROM(const std::filesystem::path& path) {
 	// Reset whatever state needs to be reset before loading a new ROM
 	memory.loadedCXI = std::nullopt;
 	memory.loaded3DSX = std::nullopt;
+	romFSIndex.clear();
 
 	const std::filesystem::path appDataPath = getAppDataRoot();
 	const std::filesystem::path dataPath = appDataPath / path.filename().stem();
 	const std::filesystem::path aesKeysPath = appDataPath / "sysdata" / "aes_keys.txt";
-	IOFile::setAppDataDir(dataPath);
+	kernel.getServiceManager().getFS().setAppDataPath(dataPath);
+	gpu.getRenderer()->setAppDataPath(dataPath);
 
 	// Open the text file containing our AES keys if it exists. We use the std::filesystem::exists overload that takes an error code param to
 	// avoid the call throwing exceptions
@@ -235,9 +431,9 @@ bool Emulator::loadROM(const std::filesystem::path& path) {
 
 	if (extension == ".elf" || extension == ".axf")
 		success = loadELF(path);
-	else if (extension == ".3ds" || extension == ".cci")
+	else if (extension == ".3ds" || extension == ".cci" || extension == ".zcci")
 		success = loadNCSD(path, ROMType::NCSD);
-	else if (extension == ".cxi" || extension == ".app")
+	else if (extension == ".cxi" || extension == ".app" || extension == ".zcxi")
 		success = loadNCSD(path, ROMType::CXI);
 	else if (extension == ".3dsx")
 		success = load3DSX(path);
@@ -248,6 +444,7 @@ bool Emulator::loadROM(const std::filesystem::path& path) {
 
 	if (success) {
 		romPath = path;
+		buildRomFSIndex();
 #ifdef PANDA3DS_ENABLE_DISCORD_RPC
 		updateDiscord();
 #endif
@@ -349,63 +546,92 @@ void Emulator::updateDiscord() {
 void Emulator::updateDiscord() {}
 #endif
 
-static void dumpRomFSNode(const RomFS::RomFSNode& node, const char* romFSBase, const std::filesystem::path& path) {
-	for (auto& file : node.files) {
-		const auto p = path / file->name;
-		std::ofstream outFile(p);
+std::optional<u64> Emulator::getRomFSSize() {
+	if (romType == ROMType::NCSD || romType == ROMType::CXI) {
+		auto cxi = memory.getCXI();
+		if (cxi != nullptr && cxi->hasRomFS()) {
+			return cxi->romFS.size;
+		}
+	} else if (romType == ROMType::HB_3DSX) {
+		auto hb3dsx = memory.get3DSX();
+		if (hb3dsx != nullptr && hb3dsx->hasRomFs()) {
+			return hb3dsx->romFSSize;
+		}
+	}
 
-		outFile.write(romFSBase + file->dataOffset, file->dataSize);
+	return std::nullopt;
+}
+
+bool Emulator::readRomFS(u64 offset, void* dst, u64 size) {
+	if (romType == ROMType::HB_3DSX) {
+		auto hb3dsx = memory.get3DSX();
+		return hb3dsx != nullptr && readRomFS(hb3dsx->file, offset, dst, size);
+	} else {
+		return readRomFS(memory.CXIFile, offset, dst, size);
+	}
+}
+
+bool Emulator::readRomFS(IOFile& file, u64 offset, void* dst, u64 size) {
+	const std::optional<u64> romFSSize = getRomFSSize();
+	if (!romFSSize.has_value() || offset > romFSSize.value() || size > romFSSize.value() - offset) {
+		return false;
+	}
+
+	if (romType == ROMType::HB_3DSX) {
+		if (!file.seek(s64(memory.get3DSX()->romFSOffset + offset))) {
+			return false;
+		}
+
+		auto [success, bytes] = file.readBytes(dst, size);
+		return success && bytes == size;
+	} else {
+		auto cxi = memory.getCXI();
+		auto [success, bytes] = cxi->readFromFile(file, cxi->romFS, (u8*)dst, offset, size);
+		return success && bytes == size;
 	}
+}
 
-	for (auto& directory : node.directories) {
-		const auto newPath = path / directory->name;
-		
-		// Create the directory for the new folder
-		std::error_code ec;
-		std::filesystem::create_directories(newPath, ec);
+void Emulator::buildRomFSIndex() {
+	romFSIndex.clear();
 
-		if (!ec) {
-			dumpRomFSNode(*directory, romFSBase, newPath);
+	const std::optional<u64> romFSSize = getRomFSSize();
+	if (romFSSize.has_value()) {
+		const bool success = romFSIndex.build([this](u64 offset, void* dst, u64 size) { return readRomFS(offset, dst, size); }, romFSSize.value());
+		if (!success) {
+			printf("Failed to index RomFS\n");
 		}
 	}
 }
 
-RomFS::DumpingResult Emulator::dumpRomFS(const std::filesystem::path& path) {
+RomFS::DumpingResult Emulator::dumpRomFS(const std::filesystem::path& path, const RomFS::ProgressCallback& progress) {
 	using namespace RomFS;
 
 	if (romType != ROMType::NCSD && romType != ROMType::CXI && romType != ROMType::HB_3DSX) {
 		return DumpingResult::InvalidFormat;
 	}
 
-	// Contents of RomFS as raw bytes
-	std::vector<u8> romFS;
-	u64 size;
+	if (!romFSIndex.isValid() || !romPath.has_value()) {
+		return DumpingResult::NoRomFS;
+	}
 
-	if (romType == ROMType::HB_3DSX) {
-		auto hb3dsx = memory.get3DSX();
-		if (!hb3dsx->hasRomFs()) {
-			return DumpingResult::NoRomFS;
-		}
-		size = hb3dsx->romFSSize;
+	// Every extraction thread reads through its own handle to the ROM, as they'd otherwise race on the file position
+	auto openReader = [this]() -> ReadCallback {
+		std::shared_ptr<IOFile> file(new IOFile(), [](IOFile* f) {
+			f->close();
+			delete f;
+		});
 
-		romFS.resize(size);
-		hb3dsx->readRomFSBytes(&romFS[0], 0, size);
-	} else {
-		auto cxi = memory.getCXI();
-		if (!cxi->hasRomFS()) {
-			return DumpingResult::NoRomFS;
+		if (!CompressedROM::openROM(*file, romPath.value())) {
+			return {};
 		}
 
-		const u64 offset = cxi->romFS.offset;
-		size = cxi->romFS.size;
+		return [this, file](u64 offset, void* dst, u64 size) { return readRomFS(*file, offset, dst, size); };
+	};
 
-		romFS.resize(size);
-		cxi->readFromFile(memory.CXIFile, cxi->partitionInfo, &romFS[0], offset - cxi->fileOffset, size);
+	if (!extract(romFSIndex, openReader, path, progress)) {
+		printf("Some RomFS files failed to dump\n");
 	}
 
-	std::unique_ptr<RomFSNode> node = parseRomFSTree((uintptr_t)&romFS[0], size);
-	dumpRomFSNode(*node, (const char*)&romFS[0], path);
-
 	return DumpingResult::Success;
 }
 
@@ -0,0 +1,44 @@
+#include "frame_limiter.hpp"
+
+#include <thread>
+
+namespace {
+	// How long before the deadline we stop sleeping and start spinning
+	constexpr auto spinTime = std::chrono::microseconds(1500);
+	// If we're this far behind, eg because the host hitched or the window was being dragged, give up on catching up. Otherwise the limiter
+	// would run a burst of frames as fast as it can afterwards
+	constexpr auto maxLag = std::chrono::milliseconds(100);
+}  // namespace
+
+void FrameLimiter::setSpeed(double multiplier) {
+	speed = (multiplier > 0.0) ? multiplier : 0.0;
+	if (speed > 0.0) {
+		frameTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / (refreshRate * speed)));
+	}
+
+	// Start counting from the next frame at the new speed
+	started = false;
+}
+
+void FrameLimiter::wait() {
+	if (speed == 0.0) {
+		return;
+	}
+
+	const auto now = Clock::now();
+	if (!started || now - nextFrame > maxLag) {
+		nextFrame = now;
+		started = true;
+	}
+
+	// Deadlines are spaced exactly one frame apart rather than counted from when wait was called, so that the time spent running frames
+	// doesn't add up as drift
+	nextFrame += frameTime;
+	if (nextFrame - now > spinTime) {
+		std::this_thread::sleep_until(nextFrame - spinTime);
+	}
+
+	while (Clock::now() < nextFrame) {
+		std::this_thread::yield();
+	}
+}
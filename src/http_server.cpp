@@ -67,6 +67,30 @@ class HttpActionStep : public HttpAction {
 	int getFrames() const { return frames; }
 };
 
+class HttpActionKernelObjects : public HttpAction {
+	DeferredResponseWrapper& response;
+
+  public:
+	HttpActionKernelObjects(DeferredResponseWrapper& response) : HttpAction(HttpActionType::KernelObjects), response(response) {}
+	DeferredResponseWrapper& getResponse() { return response; }
+};
+
+class HttpActionIPCProfile : public HttpAction {
+	DeferredResponseWrapper& response;
+	bool json;
+	bool reset;
+	std::optional<bool> enable;
+
+  public:
+	HttpActionIPCProfile(DeferredResponseWrapper& response, bool json, bool reset, std::optional<bool> enable)
+		: HttpAction(HttpActionType::IPCProfile), response(response), json(json), reset(reset), enable(enable) {}
+
+	DeferredResponseWrapper& getResponse() { return response; }
+	bool wantsJSON() const { return json; }
+	bool wantsReset() const { return reset; }
+	std::optional<bool> getEnable() const { return enable; }
+};
+
 std::unique_ptr<HttpAction> HttpAction::createScreenshotAction(DeferredResponseWrapper& response) {
 	return std::make_unique<HttpActionScreenshot>(response);
 }
@@ -83,6 +107,14 @@ std::unique_ptr<HttpAction> HttpAction::createStepAction(DeferredResponseWrapper
 	return std::make_unique<HttpActionStep>(response, frames);
 }
 
+std::unique_ptr<HttpAction> HttpAction::createKernelObjectsAction(DeferredResponseWrapper& response) {
+	return std::make_unique<HttpActionKernelObjects>(response);
+}
+
+std::unique_ptr<HttpAction> HttpAction::createIPCProfileAction(DeferredResponseWrapper& response, bool json, bool reset, std::optional<bool> enable) {
+	return std::make_unique<HttpActionIPCProfile>(response, json, reset, enable);
+}
+
 HttpServer::HttpServer(Emulator* emulator)
 	: emulator(emulator), server(std::make_unique<httplib::Server>()), keyMap({
 																		   {"A", {HID::Keys::A}},
@@ -180,6 +212,35 @@ void HttpServer::startHttpServer() {
 
 	server->Get("/status", [this](const httplib::Request&, httplib::Response& response) { response.set_content(status(), "text/plain"); });
 
+	// Kernel objects are only safe to look at from the emulator thread, so this waits for the next time actions are processed
+	server->Get("/kernel_objects", [this](const httplib::Request&, httplib::Response& response) {
+		DeferredResponseWrapper wrapper(response);
+		std::unique_lock lock(wrapper.mutex);
+		pushAction(HttpAction::createKernelObjectsAction(wrapper));
+		wrapper.cv.wait(lock, [&wrapper] { return wrapper.ready; });
+	});
+
+	// Per-service, per-command IPC statistics. "format=json" dumps them as JSON instead of a table, "reset=1" clears them after dumping them
+	// and "enable=0/1" turns profiling off or on
+	server->Get("/ipc_profile", [this](const httplib::Request& request, httplib::Response& response) {
+		const auto param = [&request](const char* name) -> std::optional<std::string> {
+			auto it = request.params.find(name);
+			return it == request.params.end() ? std::nullopt : std::optional(it->second);
+		};
+
+		const bool json = param("format") == "json";
+		const bool reset = param("reset") == "1";
+		std::optional<bool> enable = std::nullopt;
+		if (auto value = param("enable"); value.has_value()) {
+			enable = (*value == "1");
+		}
+
+		DeferredResponseWrapper wrapper(response);
+		std::unique_lock lock(wrapper.mutex);
+		pushAction(HttpAction::createIPCProfileAction(wrapper, json, reset, enable));
+		wrapper.cv.wait(lock, [&wrapper] { return wrapper.ready; });
+	});
+
 	server->Get("/load_rom", [this](const httplib::Request& request, httplib::Response& response) {
 		auto it = request.params.find("path");
 		if (it == request.params.end()) {
@@ -243,6 +304,21 @@ std::string HttpServer::status() {
 	return stringStream.str();
 }
 
+std::string HttpServer::kernelObjectStats() {
+	const HandleTable& handles = emulator->kernel.getHandleTable();
+	std::stringstream stringStream;
+
+	stringStream << "Handle table: " << handles.liveCount() << " live, " << handles.freeSlotCount() << " free, " << handles.slotCount()
+				 << " slots\n";
+
+	for (const auto& stats : emulator->kernel.getObjectStats()) {
+		stringStream << kernelObjectTypeToString(stats.type) << ": " << stats.handles << " handles, " << stats.liveObjects << "/"
+					 << stats.pooledObjects << " pooled objects, " << stats.pooledBytes << " bytes\n";
+	}
+
+	return stringStream.str();
+}
+
 void HttpServer::processActions() {
 	std::scoped_lock lock(actionQueueMutex);
 
@@ -333,6 +409,41 @@ void HttpServer::processActions() {
 
 			case HttpActionType::Reset: emulator->reset(Emulator::ReloadOption::Reload); break;
 
+			case HttpActionType::KernelObjects: {
+				DeferredResponseWrapper& response = static_cast<HttpActionKernelObjects*>(action.get())->getResponse();
+				response.inner_response.set_content(kernelObjectStats(), "text/plain");
+
+				std::unique_lock<std::mutex> lock(response.mutex);
+				response.ready = true;
+				response.cv.notify_one();
+				break;
+			}
+
+			case HttpActionType::IPCProfile: {
+				HttpActionIPCProfile* profileAction = static_cast<HttpActionIPCProfile*>(action.get());
+				DeferredResponseWrapper& response = profileAction->getResponse();
+				IPCProfiler& profiler = emulator->getIPCProfiler();
+
+				if (profileAction->wantsJSON()) {
+					response.inner_response.set_content(profiler.dumpJSON(), "application/json");
+				} else {
+					response.inner_response.set_content(profiler.dumpTable(), "text/plain");
+				}
+
+				if (profileAction->wantsReset()) {
+					profiler.reset();
+				}
+
+				if (auto enable = profileAction->getEnable(); enable.has_value()) {
+					profiler.setEnabled(*enable);
+				}
+
+				std::unique_lock<std::mutex> lock(response.mutex);
+				response.ready = true;
+				response.cv.notify_one();
+				break;
+			}
+
 			case HttpActionType::Step: {
 				HttpActionStep* stepAction = static_cast<HttpActionStep*>(action.get());
 				framesToRun = stepAction->getFrames();
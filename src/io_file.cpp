@@ -1,6 +1,7 @@
 #include "io_file.hpp"
 
 #include "helpers.hpp"
+#include "loader/compressed_rom.hpp"
 
 #ifdef _MSC_VER
 // 64 bit offsets for MSVC
@@ -16,9 +17,9 @@
 #endif
 
 #ifdef WIN32
-#include <io.h>  // For _chsize_s
+#include <io.h>  // For _chsize_s and _commit
 #else
-#include <unistd.h>  // For ftruncate
+#include <unistd.h>  // For ftruncate and fsync
 #endif
 
 #ifdef __ANDROID__
@@ -55,6 +56,9 @@ bool IOFile::open(const char* filename, const char* permissions) {
 }
 
 void IOFile::close() {
+	compressedReader = nullptr;
+	compressedPosition = 0;
+
 	if (isOpen()) {
 		fclose(handle);
 		handle = nullptr;
@@ -67,11 +71,19 @@ std::pair<bool, std::size_t> IOFile::read(void* data, std::size_t length, std::s
 	}
 
 	if (length == 0) return {true, 0};
+
+	if (compressedReader) {
+		const std::size_t bytes = compressedReader->read(compressedPosition, data, length * dataSize);
+		compressedPosition += bytes;
+		return {true, bytes / dataSize};
+	}
+
 	return {true, std::fread(data, dataSize, length, handle)};
 }
 
 std::pair<bool, std::size_t> IOFile::write(const void* data, std::size_t length, std::size_t dataSize) {
-	if (!isOpen()) {
+	// Compressed ROM containers are read-only
+	if (!isOpen() || compressedReader) {
 		return {false, std::numeric_limits<std::size_t>::max()};
 	}
 
@@ -87,6 +99,7 @@ std::pair<bool, std::size_t> IOFile::writeBytes(const void* data, std::size_t co
 
 std::optional<std::uint64_t> IOFile::size() {
 	if (!isOpen()) return {};
+	if (compressedReader) return compressedReader->size();
 
 	std::uint64_t pos = ftello(handle);
 	if (fseeko(handle, 0, SEEK_END) != 0) {
@@ -102,6 +115,19 @@ std::optional<std::uint64_t> IOFile::size() {
 }
 
 bool IOFile::seek(std::int64_t offset, int origin) {
+	if (isOpen() && compressedReader) {
+		std::int64_t base = 0;
+		if (origin == SEEK_CUR) {
+			base = std::int64_t(compressedPosition);
+		} else if (origin == SEEK_END) {
+			base = std::int64_t(compressedReader->size());
+		}
+
+		if (base + offset < 0) return false;
+		compressedPosition = std::uint64_t(base + offset);
+		return true;
+	}
+
 	if (!isOpen() || fseeko(handle, offset, origin) != 0) return false;
 
 	return true;
@@ -113,16 +139,26 @@ bool IOFile::flush() {
 	return true;
 }
 
+bool IOFile::sync() {
+	if (!flush()) return false;
+
+#ifdef WIN32
+	return _commit(_fileno(handle)) == 0;
+#else
+	return fsync(fileno(handle)) == 0;
+#endif
+}
+
 bool IOFile::rewind() { return seek(0, SEEK_SET); }
 FILE* IOFile::getHandle() { return handle; }
 
-void IOFile::setAppDataDir(const std::filesystem::path& dir) {
-	if (dir == "") Helpers::panic("Failed to set app data directory");
-	appData = dir;
+void IOFile::setCompressedReader(std::shared_ptr<CompressedROM::Reader> reader) {
+	compressedReader = reader;
+	compressedPosition = 0;
 }
 
 bool IOFile::setSize(std::uint64_t size) {
-	if (!isOpen()) return false;
+	if (!isOpen() || compressedReader) return false;
 	bool success;
 
 #ifdef WIN32
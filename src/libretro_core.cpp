@@ -1,5 +1,8 @@
-#include <stdexcept>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
 
 #include <libretro.h>
 
@@ -198,7 +201,7 @@ static void ConfigCheckVariables() {
 
 void retro_get_system_info(retro_system_info* info) {
 	info->need_fullpath = true;
-	info->valid_extensions = "3ds|3dsx|elf|axf|cci|cxi|app";
+	info->valid_extensions = "3ds|3dsx|elf|axf|cci|cxi|app|zcci|zcxi";
 	info->library_version = "0.8";
 	info->library_name = "Panda3DS";
 	info->block_extract = true;
@@ -354,13 +357,28 @@ void retro_run() {
 
 void retro_set_controller_port_device(uint port, uint device) {}
 
+// Frontends expect the state size to stay the same from one call to the next, eg for rewind buffers, so it only ever grows
+static usize serializeSize = 0;
+static std::vector<u8> serializeBuffer;
+
 usize retro_serialize_size() {
-	usize size = 0;
-	return size;
+	serializeSize = std::max(serializeSize, emulator->getSaveStateSize());
+	return serializeSize;
+}
+
+bool retro_serialize(void* data, usize size) {
+	emulator->saveState(serializeBuffer);
+	if (serializeBuffer.size() > size) {
+		return false;
+	}
+
+	// Anything past the end of the state is ignored when loading, so pad it out to the size the frontend asked for
+	std::memcpy(data, serializeBuffer.data(), serializeBuffer.size());
+	std::memset(static_cast<u8*>(data) + serializeBuffer.size(), 0, size - serializeBuffer.size());
+	return true;
 }
 
-bool retro_serialize(void* data, usize size) { return false; }
-bool retro_unserialize(const void* data, usize size) { return false; }
+bool retro_unserialize(const void* data, usize size) { return emulator->loadState(std::span(static_cast<const u8*>(data), size)); }
 
 uint retro_get_region() { return RETRO_REGION_NTSC; }
 uint retro_api_version() { return RETRO_API_VERSION; }
@@ -107,21 +107,29 @@ void LuaManager::reset() {
 }
 
 // Initialize C++ thunks for Lua code to call here
-// All code beyond this point is terrible and full of global state, don't judge
-
-Emulator* LuaManager::g_emulator = nullptr;
-
-#define MAKE_MEMORY_FUNCTIONS(size)                                               \
-	static int read##size##Thunk(lua_State* L) {                                  \
-		const u32 vaddr = (u32)lua_tonumber(L, 1);                                \
-		lua_pushnumber(L, LuaManager::g_emulator->getMemory().read##size(vaddr)); \
-		return 1;                                                                 \
-	}                                                                             \
-	static int write##size##Thunk(lua_State* L) {                                 \
-		const u32 vaddr = (u32)lua_tonumber(L, 1);                                \
-		const u##size value = (u##size)lua_tonumber(L, 2);                        \
-		LuaManager::g_emulator->getMemory().write##size(vaddr, value);            \
-		return 0;                                                                 \
+// The address of this is the registry key our LuaManager pointer is stored under, as it can't collide with keys used by Lua libraries
+static const char managerRegistryKey = 0;
+
+Emulator& LuaManager::getEmulator(lua_State* L) {
+	lua_pushlightuserdata(L, (void*)&managerRegistryKey);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	auto manager = static_cast<LuaManager*>(lua_touserdata(L, -1));
+	lua_pop(L, 1);
+
+	return manager->emulator;
+}
+
+#define MAKE_MEMORY_FUNCTIONS(size)                                                  \
+	static int read##size##Thunk(lua_State* L) {                                     \
+		const u32 vaddr = (u32)lua_tonumber(L, 1);                                   \
+		lua_pushnumber(L, LuaManager::getEmulator(L).getMemory().read##size(vaddr)); \
+		return 1;                                                                    \
+	}                                                                                \
+	static int write##size##Thunk(lua_State* L) {                                    \
+		const u32 vaddr = (u32)lua_tonumber(L, 1);                                   \
+		const u##size value = (u##size)lua_tonumber(L, 2);                           \
+		LuaManager::getEmulator(L).getMemory().write##size(vaddr, value);            \
+		return 0;                                                                    \
 	}
 
 MAKE_MEMORY_FUNCTIONS(8)
@@ -131,7 +139,7 @@ MAKE_MEMORY_FUNCTIONS(64)
 #undef MAKE_MEMORY_FUNCTIONS
 
 static int getAppIDThunk(lua_State* L) {
-	std::optional<u64> id = LuaManager::g_emulator->getMemory().getProgramID();
+	std::optional<u64> id = LuaManager::getEmulator(L).getMemory().getProgramID();
 	
 	// If the app has an ID, return true + its ID
 	// Otherwise return false and 0 as the ID
@@ -150,17 +158,17 @@ static int getAppIDThunk(lua_State* L) {
 }
 
 static int pauseThunk(lua_State* L) {
-	LuaManager::g_emulator->pause();
+	LuaManager::getEmulator(L).pause();
 	return 0;
 }
 
 static int resumeThunk(lua_State* L) {
-	LuaManager::g_emulator->resume();
+	LuaManager::getEmulator(L).resume();
 	return 0;
 }
 
 static int resetThunk(lua_State* L) {
-	LuaManager::g_emulator->reset(Emulator::ReloadOption::Reload);
+	LuaManager::getEmulator(L).reset(Emulator::ReloadOption::Reload);
 	return 0;
 }
 
@@ -176,19 +184,19 @@ static int loadROMThunk(lua_State* L) {
 
 	const auto path = std::filesystem::path(std::string(str, pathLength));
 	// Load ROM and reply if it succeeded or not
-	lua_pushboolean(L, LuaManager::g_emulator->loadROM(path) ? 1 : 0);
+	lua_pushboolean(L, LuaManager::getEmulator(L).loadROM(path) ? 1 : 0);
 	return 1;
 }
 
 static int getButtonsThunk(lua_State* L) {
-	auto buttons = LuaManager::g_emulator->getServiceManager().getHID().getOldButtons();
+	auto buttons = LuaManager::getEmulator(L).getServiceManager().getHID().getOldButtons();
 	lua_pushinteger(L, static_cast<lua_Integer>(buttons));
 
 	return 1;
 }
 
 static int getCirclepadThunk(lua_State* L) {
-	auto& hid = LuaManager::g_emulator->getServiceManager().getHID();
+	auto& hid = LuaManager::getEmulator(L).getServiceManager().getHID();
 	s16 x = hid.getCirclepadX();
 	s16 y = hid.getCirclepadY();
 
@@ -198,7 +206,7 @@ static int getCirclepadThunk(lua_State* L) {
 }
 
 static int getButtonThunk(lua_State* L) {
-	auto& hid = LuaManager::g_emulator->getServiceManager().getHID();
+	auto& hid = LuaManager::getEmulator(L).getServiceManager().getHID();
 	// This function accepts a mask. You can use it to check if one or more buttons are pressed at a time
 	const u32 mask = (u32)lua_tonumber(L, 1);
 	const bool result = (hid.getOldButtons() & mask) == mask;
@@ -209,7 +217,8 @@ static int getButtonThunk(lua_State* L) {
 }
 
 static int disassembleARMThunk(lua_State* L) {
-	static Common::CapstoneDisassembler disassembler;
+	// One disassembler per thread, as emulator instances on different threads may run scripts at the same time
+	static thread_local Common::CapstoneDisassembler disassembler;
 	// We want the disassembler to only be fully initialized when this function is first used
 	if (!disassembler.isInitialized()) {
 		disassembler.init(CS_ARCH_ARM, CS_MODE_ARM);
@@ -242,6 +251,55 @@ static int disassembleTeakThunk(lua_State* L) {
 	return 1;
 }
 
+// Returns an array with a table of statistics for every IPC command profiled so far, the ones we spent the most time on first
+static int getIPCProfileThunk(lua_State* L) {
+	const auto stats = LuaManager::getEmulator(L).getIPCProfiler().getStats();
+	lua_createtable(L, int(stats.size()), 0);
+
+	const auto setField = [L](const char* name, lua_Number value) {
+		lua_pushnumber(L, value);
+		lua_setfield(L, -2, name);
+	};
+
+	for (usize i = 0; i < stats.size(); i++) {
+		const IPCProfiler::CommandStats& command = stats[i];
+		lua_createtable(L, 0, 10);
+
+		lua_pushstring(L, IPCProfiler::getTargetName(command.target));
+		lua_setfield(L, -2, "target");
+		setField("handle", lua_Number(command.target));
+		setField("header", lua_Number(command.header));
+		setField("count", lua_Number(command.count));
+		setField("totalNs", lua_Number(command.totalNs));
+		setField("minNs", lua_Number(command.minNs));
+		setField("maxNs", lua_Number(command.maxNs));
+		setField("p50Ns", lua_Number(command.percentileNs(0.5)));
+		setField("p99Ns", lua_Number(command.percentileNs(0.99)));
+
+		lua_rawseti(L, -2, int(i + 1));
+	}
+
+	return 1;
+}
+
+static int dumpIPCProfileThunk(lua_State* L) {
+	const IPCProfiler& profiler = LuaManager::getEmulator(L).getIPCProfiler();
+	const std::string dump = lua_toboolean(L, 1) ? profiler.dumpJSON() : profiler.dumpTable();
+
+	lua_pushlstring(L, dump.data(), dump.size());
+	return 1;
+}
+
+static int resetIPCProfileThunk(lua_State* L) {
+	LuaManager::getEmulator(L).getIPCProfiler().reset();
+	return 0;
+}
+
+static int setIPCProfilingThunk(lua_State* L) {
+	LuaManager::getEmulator(L).getIPCProfiler().setEnabled(lua_toboolean(L, 1) != 0);
+	return 0;
+}
+
 // clang-format off
 static constexpr luaL_Reg functions[] = {
 	{ "__read8", read8Thunk },
@@ -262,6 +320,10 @@ static constexpr luaL_Reg functions[] = {
 	{ "__getButton", getButtonThunk },
 	{ "__disassembleARM", disassembleARMThunk },
 	{ "__disassembleTeak", disassembleTeakThunk },
+	{ "__getIPCProfile", getIPCProfileThunk },
+	{ "__dumpIPCProfile", dumpIPCProfileThunk },
+	{ "__resetIPCProfile", resetIPCProfileThunk },
+	{ "__setIPCProfiling", setIPCProfilingThunk },
 	{ nullptr, nullptr },
 };
 // clang-format on
@@ -298,6 +360,11 @@ void LuaManager::initializeThunks() {
 		disassembleARM = function(pc, instruction) return GLOBALS.__disassembleARM(pc, instruction) end,
 		disassembleTeak = function(opcode, exp) return GLOBALS.__disassembleTeak(opcode, exp or 0) end,
 
+		getIPCProfile = function() return GLOBALS.__getIPCProfile() end,
+		dumpIPCProfile = function(json) return GLOBALS.__dumpIPCProfile(json or false) end,
+		resetIPCProfile = function() GLOBALS.__resetIPCProfile() end,
+		setIPCProfiling = function(enabled) GLOBALS.__setIPCProfiling(enabled) end,
+
 		Frame = __Frame,
 		ButtonA = __ButtonA,
 		ButtonB = __ButtonB,
@@ -317,6 +384,11 @@ void LuaManager::initializeThunks() {
 		lua_setglobal(L, name);
 	};
 
+	// Let our thunks find the emulator this Lua state belongs to
+	lua_pushlightuserdata(L, (void*)&managerRegistryKey);
+	lua_pushlightuserdata(L, this);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+
 	luaL_register(L, "GLOBALS", functions);
 	// Add values for event enum
 	addIntConstant(LuaEvent::Frame, "__Frame");
@@ -3,6 +3,7 @@
 #include <QDesktopServices>
 #include <QFileDialog>
 #include <QString>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <fstream>
@@ -100,12 +101,31 @@ MainWindow::MainWindow(QApplication* app, QWidget* parent) : QMainWindow(parent)
 		usingVk = (rendererType == RendererType::Vulkan);
 
 		if (usingGL) {
-			// Make GL context current for this thread, enable VSync
-			GL::Context* glContext = screen.getGLContext();
-			glContext->MakeCurrent();
-			glContext->SetSwapInterval(emu->getConfig().vsyncEnabled ? 1 : 0);
+			// With threaded presentation, frames are put on screen by a thread of its own using the screen's context, and we render on a
+			// context shared with it
+			if (emu->getConfig().threadedPresentation && emu->getRenderer()->supportsPresentThread()) {
+				emuGLContext = screen.createSharedGLContext();
 
-			emu->initGraphicsContext(glContext);
+				if (emuGLContext == nullptr) {
+					Helpers::warn("Failed to create a shared GL context, presenting from the emulator thread");
+				}
+			}
+
+			if (emuGLContext != nullptr) {
+				emuGLContext->MakeCurrent();
+				emu->initGraphicsContext(emuGLContext.get());
+				emu->getRenderer()->setPresentThreadEnabled(true);
+
+				usingPresentThread = true;
+				presentThread = std::thread([this]() { presentThreadMainLoop(); });
+			} else {
+				// Make GL context current for this thread, enable VSync
+				GL::Context* glContext = screen.getGLContext();
+				glContext->MakeCurrent();
+				glContext->SetSwapInterval(emu->getConfig().vsyncEnabled ? 1 : 0);
+
+				emu->initGraphicsContext(glContext);
+			}
 		} else if (usingVk) {
 			Helpers::panic("Vulkan on Qt is currently WIP, try the SDL frontend instead!");
 		} else {
@@ -119,6 +139,8 @@ MainWindow::MainWindow(QApplication* app, QWidget* parent) : QMainWindow(parent)
 }
 
 void MainWindow::emuThreadMainLoop() {
+	frameLimiter.setSpeed(emu->getConfig().emulationSpeed);
+
 	while (appRunning) {
 		{
 			std::unique_lock lock(messageQueueMutex);
@@ -140,15 +162,56 @@ void MainWindow::emuThreadMainLoop() {
 			emu->getServiceManager().getHID().updateInputs(emu->getTicks());
 		}
 
-		swapEmuBuffer();
+		if (!usingPresentThread) {
+			swapEmuBuffer();
+		} else if (emu->running) {
+			frameLimiter.wait();
+		} else {
+			// Paused emulators don't run frames, but still shouldn't spin
+			std::this_thread::sleep_for(std::chrono::milliseconds(16));
+			frameLimiter.reset();
+		}
 	}
 
-	// Unbind GL context if we're using GL, otherwise some setups seem to be unable to join this thread
-	if (usingGL) {
+	if (usingPresentThread) {
+		presentThread.join();
+		emu->getRenderer()->setPresentThreadEnabled(false);
+		emuGLContext->DoneCurrent();
+	} else if (usingGL) {
+		// Unbind GL context if we're using GL, otherwise some setups seem to be unable to join this thread
 		screen.getGLContext()->DoneCurrent();
 	}
 }
 
+// Puts the newest frame on screen at every refresh with vsync, or whenever a new one comes in without it. Emulation never waits on this
+void MainWindow::presentThreadMainLoop() {
+	const bool vsync = emu->getConfig().vsyncEnabled;
+	Renderer* renderer = emu->getRenderer();
+	GL::Context* glContext = screen.getGLContext();
+
+	glContext->MakeCurrent();
+	glContext->SetSwapInterval(vsync ? 1 : 0);
+
+	// How long to wait for a frame before checking whether the app is closing
+	constexpr auto frameTimeout = std::chrono::milliseconds(16);
+
+	while (appRunning) {
+		if (!vsync && !renderer->waitForFrame(frameTimeout)) {
+			continue;
+		}
+
+		if (renderer->presentFrame()) {
+			glContext->SwapBuffers();
+		} else {
+			// Nothing has been rendered yet, eg because no ROM is loaded
+			renderer->waitForFrame(frameTimeout);
+		}
+	}
+
+	renderer->releasePresentContext();
+	glContext->DoneCurrent();
+}
+
 void MainWindow::swapEmuBuffer() {
 	if (usingGL) {
 		screen.getGLContext()->SwapBuffers();
@@ -160,7 +223,7 @@ void MainWindow::swapEmuBuffer() {
 void MainWindow::selectROM() {
 	auto path = QFileDialog::getOpenFileName(
 		this, tr("Select 3DS ROM to load"), QString::fromStdU16String(emu->getConfig().defaultRomPath.u16string()),
-		tr("Nintendo 3DS ROMs (*.3ds *.cci *.cxi *.app *.3dsx *.elf *.axf)")
+		tr("Nintendo 3DS ROMs (*.3ds *.cci *.cxi *.app *.zcci *.zcxi *.3dsx *.elf *.axf)")
 	);
 
 	if (!path.isEmpty()) {
@@ -360,6 +423,12 @@ void MainWindow::dispatchMessage(const EmulatorMessage& message) {
 			emu->getRenderer()->setUbershader(*message.string.str);
 			delete message.string.str;
 			break;
+
+		case MessageType::SetTurbo: {
+			const EmulatorConfig& config = emu->getConfig();
+			frameLimiter.setSpeed(message.turbo.enabled ? config.turboSpeed : config.emulationSpeed);
+			break;
+		}
 	}
 }
 
@@ -390,6 +459,16 @@ void MainWindow::keyPressEvent(QKeyEvent* event) {
 		switch (event->key()) {
 			case Qt::Key_F4: sendMessage(EmulatorMessage{.type = MessageType::TogglePause}); break;
 			case Qt::Key_F5: sendMessage(EmulatorMessage{.type = MessageType::Reset}); break;
+
+			// Hold Tab to fast-forward. Only works with threaded presentation, as otherwise vsync paces emulation
+			case Qt::Key_Tab: {
+				if (!event->isAutoRepeat()) {
+					EmulatorMessage message{.type = MessageType::SetTurbo};
+					message.turbo.enabled = true;
+					sendMessage(message);
+				}
+				break;
+			}
 		}
 	}
 }
@@ -417,6 +496,10 @@ void MainWindow::keyReleaseEvent(QKeyEvent* event) {
 
 			default: releaseKey(key); break;
 		}
+	} else if (event->key() == Qt::Key_Tab && !event->isAutoRepeat()) {
+		EmulatorMessage message{.type = MessageType::SetTurbo};
+		message.turbo.enabled = false;
+		sendMessage(message);
 	}
 }
 
@@ -52,6 +52,21 @@ bool ScreenWidget::createGLContext() {
 	return glContext != nullptr;
 }
 
+std::unique_ptr<GL::Context> ScreenWidget::createSharedGLContext() {
+	std::optional<WindowInfo> windowInfo = getWindowInfo();
+	if (!windowInfo.has_value() || glContext == nullptr) {
+		return nullptr;
+	}
+
+	// WGL and GLX contexts need a drawable, and make one of their own for the window. Everything else can do without, which keeps the shared
+	// context from taking over the window's surface
+	if (windowInfo->type != WindowInfo::Type::Win32 && windowInfo->type != WindowInfo::Type::X11) {
+		windowInfo->type = WindowInfo::Type::Surfaceless;
+	}
+
+	return glContext->CreateSharedContext(*windowInfo);
+}
+
 qreal ScreenWidget::devicePixelRatioFromScreen() const {
 	const QScreen* screenForRatio = window()->windowHandle()->screen();
 	if (!screenForRatio) {
@@ -2,6 +2,9 @@
 
 #include <glad/gl.h>
 
+#include <chrono>
+#include <thread>
+
 FrontendSDL::FrontendSDL() : keyboardMappings(InputMappings::defaultKeyboardMappings()) {
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
 		Helpers::panic("Failed to initialize SDL2");
@@ -51,6 +54,17 @@ FrontendSDL::FrontendSDL() : keyboardMappings(InputMappings::defaultKeyboardMapp
 		}
 
 		SDL_GL_SetSwapInterval(config.vsyncEnabled ? 1 : 0);
+
+		// Frames get presented from the main thread while the emulator runs on its own thread, with a context that shares its objects
+		if (config.threadedPresentation && emu.getRenderer()->supportsPresentThread()) {
+			SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+			presentContext = SDL_GL_CreateContext(window);
+
+			if (presentContext == nullptr) {
+				Helpers::warn("Failed to create presentation context, presenting from the emulator thread: %s", SDL_GetError());
+			}
+			SDL_GL_MakeCurrent(window, glContext);
+		}
 	}
 
 #ifdef PANDA3DS_ENABLE_VULKAN
@@ -74,252 +88,376 @@ void FrontendSDL::run() {
 	keyboardAnalogY = false;
 	holdingRightClick = false;
 
+#ifdef PANDA3DS_ENABLE_OPENGL
+	if (presentContext != nullptr) {
+		runThreaded();
+		return;
+	}
+#endif
+
 	while (programRunning) {
 #ifdef PANDA3DS_ENABLE_HTTP_SERVER
 		httpServer.processActions();
 #endif
 
 		emu.runFrame();
-		HIDService& hid = emu.getServiceManager().getHID();
 
+		SDL_Event event;
+		while (programRunning && SDL_PollEvent(&event)) {
+			handleEvent(event);
+		}
+
+		updateInputs();
+		// TODO: Should this be uncommented?
+		// kernel.evalReschedule();
+
+		SDL_GL_SwapWindow(window);
+	}
+}
+
+#ifdef PANDA3DS_ENABLE_OPENGL
+// The main thread polls events and presents frames, paced by vsync, while the emulator runs on its own thread, paced by the frame limiter.
+// Neither waits for the other, so a slow frame on one side doesn't hold up the other
+void FrontendSDL::runThreaded() {
+	const bool vsync = emu.getConfig().vsyncEnabled;
+	Renderer* renderer = emu.getRenderer();
+
+	SDL_GL_MakeCurrent(window, nullptr);
+	std::thread emuThread([this]() { emuThreadMainLoop(); });
+
+	SDL_GL_MakeCurrent(window, presentContext);
+	SDL_GL_SetSwapInterval(vsync ? 1 : 0);
+
+	// How long to wait for a frame before checking for events again
+	constexpr auto frameTimeout = std::chrono::milliseconds(16);
+
+	while (programRunning) {
 		SDL_Event event;
 		while (SDL_PollEvent(&event)) {
-			namespace Keys = HID::Keys;
-
-			switch (event.type) {
-				case SDL_QUIT:
-					printf("Bye :(\n");
-					programRunning = false;
-					return;
-
-				case SDL_KEYDOWN: {
-					if (emu.romType == ROMType::None) break;
-
-					u32 key = getMapping(event.key.keysym.sym);
-					if (key != HID::Keys::Null) {
-						switch (key) {
-							case HID::Keys::CirclePadRight:
-								hid.setCirclepadX(0x9C);
-								keyboardAnalogX = true;
-								break;
-							case HID::Keys::CirclePadLeft:
-								hid.setCirclepadX(-0x9C);
-								keyboardAnalogX = true;
-								break;
-							case HID::Keys::CirclePadUp:
-								hid.setCirclepadY(0x9C);
-								keyboardAnalogY = true;
-								break;
-							case HID::Keys::CirclePadDown:
-								hid.setCirclepadY(-0x9C);
-								keyboardAnalogY = true;
-								break;
-							default: hid.pressKey(key); break;
-						}
-					} else {
-						switch (event.key.keysym.sym) {
-							// Use the F4 button as a hot-key to pause or resume the emulator
-							// We can't use the audio play/pause buttons because it's annoying
-							case SDLK_F4: {
-								emu.togglePause();
-								break;
-							}
-
-							// Use F5 as a reset button
-							case SDLK_F5: {
-								emu.reset(Emulator::ReloadOption::Reload);
-								break;
-							}
-						}
-					}
-					break;
-				}
+			if (event.type == SDL_QUIT) {
+				printf("Bye :(\n");
+				programRunning = false;
+				break;
+			}
 
-				case SDL_KEYUP: {
-					if (emu.romType == ROMType::None) break;
-
-					u32 key = getMapping(event.key.keysym.sym);
-					if (key != HID::Keys::Null) {
-						switch (key) {
-							// Err this is probably not ideal
-							case HID::Keys::CirclePadRight:
-							case HID::Keys::CirclePadLeft:
-								hid.setCirclepadX(0);
-								keyboardAnalogX = false;
-								break;
-							case HID::Keys::CirclePadUp:
-							case HID::Keys::CirclePadDown:
-								hid.setCirclepadY(0);
-								keyboardAnalogY = false;
-								break;
-							default: hid.releaseKey(key); break;
-						}
-					}
-					break;
-				}
+			std::scoped_lock lock(eventMutex);
+			pendingEvents.push_back(event);
+		}
 
-				case SDL_MOUSEBUTTONDOWN:
-					if (emu.romType == ROMType::None) break;
-
-					if (event.button.button == SDL_BUTTON_LEFT) {
-						const s32 x = event.button.x;
-						const s32 y = event.button.y;
-
-						// Check if touch falls in the touch screen area
-						if (y >= 240 && y <= 480 && x >= 40 && x < 40 + 320) {
-							// Convert to 3DS coordinates
-							u16 x_converted = static_cast<u16>(x) - 40;
-							u16 y_converted = static_cast<u16>(y) - 240;
-
-							hid.setTouchScreenPress(x_converted, y_converted);
-						} else {
-							hid.releaseTouchScreen();
-						}
-					} else if (event.button.button == SDL_BUTTON_RIGHT) {
-						holdingRightClick = true;
-					}
+		// With vsync, every refresh gets the newest frame, even if it's the same as last time, and the swap paces us. Without it, only draw
+		// when there's a new frame, as nothing else would keep us from spinning
+		if (!vsync && !renderer->waitForFrame(frameTimeout)) {
+			continue;
+		}
 
-					break;
+		if (renderer->presentFrame()) {
+			SDL_GL_SwapWindow(window);
+		} else {
+			// Nothing has been rendered yet, eg because no ROM is loaded
+			renderer->waitForFrame(frameTimeout);
+		}
+	}
 
-				case SDL_MOUSEBUTTONUP:
-					if (emu.romType == ROMType::None) break;
+	emuThread.join();
+	renderer->releasePresentContext();
+	SDL_GL_MakeCurrent(window, glContext);
+}
 
-					if (event.button.button == SDL_BUTTON_LEFT) {
-						hid.releaseTouchScreen();
-					} else if (event.button.button == SDL_BUTTON_RIGHT) {
-						holdingRightClick = false;
-					}
-					break;
+void FrontendSDL::emuThreadMainLoop() {
+	SDL_GL_MakeCurrent(window, glContext);
+	emu.getRenderer()->setPresentThreadEnabled(true);
+	frameLimiter.setSpeed(emu.getConfig().emulationSpeed);
+	turbo = false;
 
-				case SDL_CONTROLLERDEVICEADDED:
-					if (gameController == nullptr) {
-						gameController = SDL_GameControllerOpen(event.cdevice.which);
-						gameControllerID = event.cdevice.which;
-					}
-					break;
+	std::vector<SDL_Event> events;
+	while (programRunning) {
+#ifdef PANDA3DS_ENABLE_HTTP_SERVER
+		httpServer.processActions();
+#endif
+
+		emu.runFrame();
+
+		{
+			std::scoped_lock lock(eventMutex);
+			events.swap(pendingEvents);
+		}
+
+		for (auto& event : events) {
+			handleEvent(event);
+		}
+		events.clear();
 
-				case SDL_CONTROLLERDEVICEREMOVED:
-					if (event.cdevice.which == gameControllerID) {
-						SDL_GameControllerClose(gameController);
-						gameController = nullptr;
-						gameControllerID = 0;
+		updateInputs();
+
+		// Paused emulators don't run frames, but still shouldn't spin
+		if (emu.running) {
+			frameLimiter.wait();
+		} else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(16));
+			frameLimiter.reset();
+		}
+	}
+
+	emu.getRenderer()->setPresentThreadEnabled(false);
+	SDL_GL_MakeCurrent(window, nullptr);
+}
+#endif
+
+void FrontendSDL::setTurbo(bool enable) {
+	// Held keys repeat their key down events
+	if (turbo == enable) {
+		return;
+	}
+
+	const EmulatorConfig& config = emu.getConfig();
+	turbo = enable;
+	frameLimiter.setSpeed(enable ? config.turboSpeed : config.emulationSpeed);
+}
+
+void FrontendSDL::handleEvent(SDL_Event& event) {
+	HIDService& hid = emu.getServiceManager().getHID();
+	namespace Keys = HID::Keys;
+
+	switch (event.type) {
+		case SDL_QUIT:
+			printf("Bye :(\n");
+			programRunning = false;
+			return;
+
+		case SDL_KEYDOWN: {
+			if (emu.romType == ROMType::None) break;
+
+			u32 key = getMapping(event.key.keysym.sym);
+			if (key != HID::Keys::Null) {
+				switch (key) {
+					case HID::Keys::CirclePadRight:
+						hid.setCirclepadX(0x9C);
+						keyboardAnalogX = true;
+						break;
+					case HID::Keys::CirclePadLeft:
+						hid.setCirclepadX(-0x9C);
+						keyboardAnalogX = true;
+						break;
+					case HID::Keys::CirclePadUp:
+						hid.setCirclepadY(0x9C);
+						keyboardAnalogY = true;
+						break;
+					case HID::Keys::CirclePadDown:
+						hid.setCirclepadY(-0x9C);
+						keyboardAnalogY = true;
+						break;
+					default: hid.pressKey(key); break;
+				}
+			} else {
+				switch (event.key.keysym.sym) {
+					// Use the F4 button as a hot-key to pause or resume the emulator
+					// We can't use the audio play/pause buttons because it's annoying
+					case SDLK_F4: {
+						emu.togglePause();
+						break;
 					}
-					break;
-
-				case SDL_CONTROLLERBUTTONUP:
-				case SDL_CONTROLLERBUTTONDOWN: {
-					if (emu.romType == ROMType::None) break;
-					u32 key = 0;
-
-					switch (event.cbutton.button) {
-						case SDL_CONTROLLER_BUTTON_A: key = Keys::B; break;
-						case SDL_CONTROLLER_BUTTON_B: key = Keys::A; break;
-						case SDL_CONTROLLER_BUTTON_X: key = Keys::Y; break;
-						case SDL_CONTROLLER_BUTTON_Y: key = Keys::X; break;
-						case SDL_CONTROLLER_BUTTON_LEFTSHOULDER: key = Keys::L; break;
-						case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER: key = Keys::R; break;
-						case SDL_CONTROLLER_BUTTON_DPAD_LEFT: key = Keys::Left; break;
-						case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: key = Keys::Right; break;
-						case SDL_CONTROLLER_BUTTON_DPAD_UP: key = Keys::Up; break;
-						case SDL_CONTROLLER_BUTTON_DPAD_DOWN: key = Keys::Down; break;
-						case SDL_CONTROLLER_BUTTON_BACK: key = Keys::Select; break;
-						case SDL_CONTROLLER_BUTTON_START: key = Keys::Start; break;
+
+					// Use F5 as a reset button
+					case SDLK_F5: {
+						emu.reset(Emulator::ReloadOption::Reload);
+						break;
 					}
 
-					if (key != 0) {
-						if (event.cbutton.state == SDL_PRESSED) {
-							hid.pressKey(key);
-						} else {
-							hid.releaseKey(key);
-						}
+					// Hold Tab to fast-forward. Only works when frames are presented on their own thread, as otherwise vsync paces emulation
+					case SDLK_TAB: {
+						setTurbo(true);
+						break;
 					}
-					break;
 				}
+			}
+			break;
+		}
 
-				// Detect mouse motion events for gyroscope emulation
-				case SDL_MOUSEMOTION: {
-					if (emu.romType == ROMType::None) break;
+		case SDL_KEYUP: {
+			if (emu.romType == ROMType::None) break;
+
+			u32 key = getMapping(event.key.keysym.sym);
+			if (key != HID::Keys::Null) {
+				switch (key) {
+					// Err this is probably not ideal
+					case HID::Keys::CirclePadRight:
+					case HID::Keys::CirclePadLeft:
+						hid.setCirclepadX(0);
+						keyboardAnalogX = false;
+						break;
+					case HID::Keys::CirclePadUp:
+					case HID::Keys::CirclePadDown:
+						hid.setCirclepadY(0);
+						keyboardAnalogY = false;
+						break;
+					default: hid.releaseKey(key); break;
+				}
+			} else if (event.key.keysym.sym == SDLK_TAB) {
+				setTurbo(false);
+			}
+			break;
+		}
 
-					// Handle "dragging" across the touchscreen
-					if (hid.isTouchScreenPressed()) {
-						const s32 x = event.motion.x;
-						const s32 y = event.motion.y;
+		case SDL_MOUSEBUTTONDOWN:
+			if (emu.romType == ROMType::None) break;
 
-						// Check if touch falls in the touch screen area and register the new touch screen position
-						if (y >= 240 && y <= 480 && x >= 40 && x < 40 + 320) {
-							// Convert to 3DS coordinates
-							u16 x_converted = static_cast<u16>(x) - 40;
-							u16 y_converted = static_cast<u16>(y) - 240;
+			if (event.button.button == SDL_BUTTON_LEFT) {
+				const s32 x = event.button.x;
+				const s32 y = event.button.y;
 
-							hid.setTouchScreenPress(x_converted, y_converted);
-						}
-					}
+				// Check if touch falls in the touch screen area
+				if (y >= 240 && y <= 480 && x >= 40 && x < 40 + 320) {
+					// Convert to 3DS coordinates
+					u16 x_converted = static_cast<u16>(x) - 40;
+					u16 y_converted = static_cast<u16>(y) - 240;
 
-					// We use right click to indicate we want to rotate the console. If right click is not held, then this is not a gyroscope rotation
-					if (holdingRightClick) {
-						// Relative motion since last mouse motion event
-						const s32 motionX = event.motion.xrel;
-						const s32 motionY = event.motion.yrel;
-
-						// The gyroscope involves lots of weird math I don't want to bother with atm
-						// So up until then, we will set the gyroscope euler angles to fixed values based on the direction of the relative motion
-						const s32 roll = motionX > 0 ? 0x7f : -0x7f;
-						const s32 pitch = motionY > 0 ? 0x7f : -0x7f;
-						hid.setRoll(roll);
-						hid.setPitch(pitch);
-					}
-					break;
+					hid.setTouchScreenPress(x_converted, y_converted);
+				} else {
+					hid.releaseTouchScreen();
 				}
+			} else if (event.button.button == SDL_BUTTON_RIGHT) {
+				holdingRightClick = true;
+			}
 
-				case SDL_DROPFILE: {
-					char* droppedDir = event.drop.file;
+			break;
 
-					if (droppedDir) {
-						const std::filesystem::path path(droppedDir);
+		case SDL_MOUSEBUTTONUP:
+			if (emu.romType == ROMType::None) break;
 
-						if (path.extension() == ".amiibo") {
-							emu.loadAmiibo(path);
-						} else if (path.extension() == ".lua") {
-							emu.getLua().loadFile(droppedDir);
-						} else {
-							loadROM(path);
-						}
+			if (event.button.button == SDL_BUTTON_LEFT) {
+				hid.releaseTouchScreen();
+			} else if (event.button.button == SDL_BUTTON_RIGHT) {
+				holdingRightClick = false;
+			}
+			break;
 
-						SDL_free(droppedDir);
-					}
-					break;
+		case SDL_CONTROLLERDEVICEADDED:
+			if (gameController == nullptr) {
+				gameController = SDL_GameControllerOpen(event.cdevice.which);
+				gameControllerID = event.cdevice.which;
+			}
+			break;
+
+		case SDL_CONTROLLERDEVICEREMOVED:
+			if (event.cdevice.which == gameControllerID) {
+				SDL_GameControllerClose(gameController);
+				gameController = nullptr;
+				gameControllerID = 0;
+			}
+			break;
+
+		case SDL_CONTROLLERBUTTONUP:
+		case SDL_CONTROLLERBUTTONDOWN: {
+			if (emu.romType == ROMType::None) break;
+			u32 key = 0;
+
+			switch (event.cbutton.button) {
+				case SDL_CONTROLLER_BUTTON_A: key = Keys::B; break;
+				case SDL_CONTROLLER_BUTTON_B: key = Keys::A; break;
+				case SDL_CONTROLLER_BUTTON_X: key = Keys::Y; break;
+				case SDL_CONTROLLER_BUTTON_Y: key = Keys::X; break;
+				case SDL_CONTROLLER_BUTTON_LEFTSHOULDER: key = Keys::L; break;
+				case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER: key = Keys::R; break;
+				case SDL_CONTROLLER_BUTTON_DPAD_LEFT: key = Keys::Left; break;
+				case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: key = Keys::Right; break;
+				case SDL_CONTROLLER_BUTTON_DPAD_UP: key = Keys::Up; break;
+				case SDL_CONTROLLER_BUTTON_DPAD_DOWN: key = Keys::Down; break;
+				case SDL_CONTROLLER_BUTTON_BACK: key = Keys::Select; break;
+				case SDL_CONTROLLER_BUTTON_START: key = Keys::Start; break;
+			}
+
+			if (key != 0) {
+				if (event.cbutton.state == SDL_PRESSED) {
+					hid.pressKey(key);
+				} else {
+					hid.releaseKey(key);
 				}
 			}
+			break;
 		}
 
-		// Update controller analog sticks and HID service
-		if (emu.romType != ROMType::None) {
-			if (gameController != nullptr) {
-				const s16 stickX = SDL_GameControllerGetAxis(gameController, SDL_CONTROLLER_AXIS_LEFTX);
-				const s16 stickY = SDL_GameControllerGetAxis(gameController, SDL_CONTROLLER_AXIS_LEFTY);
-				constexpr s16 deadzone = 3276;
-				constexpr s16 maxValue = 0x9C;
-				constexpr s16 div = 0x8000 / maxValue;
-
-				// Avoid overriding the keyboard's circlepad input
-				if (abs(stickX) < deadzone && !keyboardAnalogX) {
-					hid.setCirclepadX(0);
-				} else {
-					hid.setCirclepadX(stickX / div);
+		// Detect mouse motion events for gyroscope emulation
+		case SDL_MOUSEMOTION: {
+			if (emu.romType == ROMType::None) break;
+
+			// Handle "dragging" across the touchscreen
+			if (hid.isTouchScreenPressed()) {
+				const s32 x = event.motion.x;
+				const s32 y = event.motion.y;
+
+				// Check if touch falls in the touch screen area and register the new touch screen position
+				if (y >= 240 && y <= 480 && x >= 40 && x < 40 + 320) {
+					// Convert to 3DS coordinates
+					u16 x_converted = static_cast<u16>(x) - 40;
+					u16 y_converted = static_cast<u16>(y) - 240;
+
+					hid.setTouchScreenPress(x_converted, y_converted);
 				}
+			}
+
+			// We use right click to indicate we want to rotate the console. If right click is not held, then this is not a gyroscope rotation
+			if (holdingRightClick) {
+				// Relative motion since last mouse motion event
+				const s32 motionX = event.motion.xrel;
+				const s32 motionY = event.motion.yrel;
+
+				// The gyroscope involves lots of weird math I don't want to bother with atm
+				// So up until then, we will set the gyroscope euler angles to fixed values based on the direction of the relative motion
+				const s32 roll = motionX > 0 ? 0x7f : -0x7f;
+				const s32 pitch = motionY > 0 ? 0x7f : -0x7f;
+				hid.setRoll(roll);
+				hid.setPitch(pitch);
+			}
+			break;
+		}
+
+		case SDL_DROPFILE: {
+			char* droppedDir = event.drop.file;
+
+			if (droppedDir) {
+				const std::filesystem::path path(droppedDir);
 
-				if (abs(stickY) < deadzone && !keyboardAnalogY) {
-					hid.setCirclepadY(0);
+				if (path.extension() == ".amiibo") {
+					emu.loadAmiibo(path);
+				} else if (path.extension() == ".lua") {
+					emu.getLua().loadFile(droppedDir);
 				} else {
-					hid.setCirclepadY(-(stickY / div));
+					loadROM(path);
 				}
+
+				SDL_free(droppedDir);
+			}
+			break;
+		}
+	}
+}
+
+void FrontendSDL::updateInputs() {
+	HIDService& hid = emu.getServiceManager().getHID();
+
+	// Update controller analog sticks and HID service
+	if (emu.romType != ROMType::None) {
+		if (gameController != nullptr) {
+			const s16 stickX = SDL_GameControllerGetAxis(gameController, SDL_CONTROLLER_AXIS_LEFTX);
+			const s16 stickY = SDL_GameControllerGetAxis(gameController, SDL_CONTROLLER_AXIS_LEFTY);
+			constexpr s16 deadzone = 3276;
+			constexpr s16 maxValue = 0x9C;
+			constexpr s16 div = 0x8000 / maxValue;
+
+			// Avoid overriding the keyboard's circlepad input
+			if (abs(stickX) < deadzone && !keyboardAnalogX) {
+				hid.setCirclepadX(0);
+			} else {
+				hid.setCirclepadX(stickX / div);
 			}
 
-			hid.updateInputs(emu.getTicks());
+			if (abs(stickY) < deadzone && !keyboardAnalogY) {
+				hid.setCirclepadY(0);
+			} else {
+				hid.setCirclepadY(-(stickY / div));
+			}
 		}
-		// TODO: Should this be uncommented?
-		// kernel.evalReschedule();
 
-		SDL_GL_SwapWindow(window);
+		hid.updateInputs(emu.getTicks());
 	}
 }
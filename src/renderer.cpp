@@ -3,10 +3,29 @@
 #include <algorithm>
 #include <unordered_map>
 
+#include "PICA/gpu.hpp"
+
 Renderer::Renderer(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
 	: gpu(gpu), regs(internalRegs), externalRegs(externalRegs) {}
 Renderer::~Renderer() {}
 
+void Renderer::drawIndexed(PICA::PrimType primType, std::span<const PICA::Vertex> vertices, std::span<const u16> indices) {
+	expandedVertices.resize(indices.size());
+	for (usize i = 0; i < indices.size(); i++) {
+		expandedVertices[i] = vertices[indices[i]];
+	}
+
+	drawVertices(primType, expandedVertices);
+}
+
+void Renderer::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) {
+	gpu.getTransferEngine().displayTransfer(inputAddr, outputAddr, inputSize, outputSize, flags);
+}
+
+void Renderer::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) {
+	gpu.getTransferEngine().textureCopy(inputAddr, outputAddr, totalBytes, inputSize, outputSize, flags);
+}
+
 std::optional<RendererType> Renderer::typeFromString(std::string inString) {
 	// Transform to lower-case to make the setting case-insensitive
 	std::transform(inString.begin(), inString.end(), inString.begin(), [](unsigned char c) { return std::tolower(c); });
@@ -0,0 +1,108 @@
+// Command-line converter from raw .3ds/.cci/.cxi images to the block-compressed .zcci/.zcxi container, and back
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include "loader/compressed_rom.hpp"
+
+static void printUsage(const char* name) {
+	printf("Usage: %s [-b block size in KB] [-d] <input> [output]\n", name);
+	printf("  -b  Block size in KB (default: %u). Larger blocks compress better, smaller blocks make random reads cheaper\n", CompressedROM::defaultBlockSize / 1024);
+	printf("  -d  Decompress a container back into a raw image\n");
+}
+
+// Default output paths: .3ds/.cci -> .zcci, .cxi/.app -> .zcxi, and the reverse for decompression
+static std::filesystem::path getDefaultOutput(const std::filesystem::path& input, bool decompress) {
+	std::filesystem::path output = input;
+	const auto extension = input.extension();
+
+	if (decompress) {
+		output.replace_extension(extension == ".zcxi" ? ".cxi" : ".cci");
+	} else {
+		output.replace_extension((extension == ".cxi" || extension == ".app") ? ".zcxi" : ".zcci");
+	}
+
+	return output;
+}
+
+static bool decompressROM(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath) {
+	IOFile input;
+	if (!CompressedROM::openROM(input, inputPath) || !input.isCompressed()) {
+		printf("%s is not a compressed ROM\n", inputPath.string().c_str());
+		return false;
+	}
+
+	IOFile output(outputPath, "wb");
+	if (!output.isOpen()) {
+		printf("Failed to create %s\n", outputPath.string().c_str());
+		return false;
+	}
+
+	std::vector<u8> buffer(4_MB);
+	const u64 size = input.size().value_or(0);
+
+	for (u64 offset = 0; offset < size; offset += buffer.size()) {
+		auto [readSuccess, bytesRead] = input.readBytes(buffer.data(), buffer.size());
+		if (!readSuccess || bytesRead == 0) {
+			return false;
+		}
+
+		auto [writeSuccess, bytesWritten] = output.writeBytes(buffer.data(), bytesRead);
+		if (!writeSuccess || bytesWritten != bytesRead) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	u32 blockSize = CompressedROM::defaultBlockSize;
+	bool decompress = false;
+	int argIndex = 1;
+
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++) {
+		if (std::strcmp(argv[argIndex], "-d") == 0) {
+			decompress = true;
+		} else if (std::strcmp(argv[argIndex], "-b") == 0 && argIndex + 1 < argc) {
+			blockSize = u32(std::strtoul(argv[++argIndex], nullptr, 10) * 1024);
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (argIndex >= argc) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path input = argv[argIndex];
+	const std::filesystem::path output = (argIndex + 1 < argc) ? std::filesystem::path(argv[argIndex + 1]) : getDefaultOutput(input, decompress);
+
+	bool success;
+	if (decompress) {
+		success = decompressROM(input, output);
+	} else {
+		success = CompressedROM::compressROM(input, output, blockSize, [](u64 done, u64 total) {
+			printf("\r%llu / %llu MB", (unsigned long long)(done >> 20), (unsigned long long)(total >> 20));
+			fflush(stdout);
+		});
+		printf("\n");
+	}
+
+	if (!success) {
+		printf("Conversion failed\n");
+		return 1;
+	}
+
+	std::error_code ec;
+	const auto inputSize = std::filesystem::file_size(input, ec);
+	const auto outputSize = std::filesystem::file_size(output, ec);
+	if (!decompress && !ec && inputSize != 0) {
+		printf("%s: %.1f%% of the original size\n", output.string().c_str(), 100.0 * double(outputSize) / double(inputSize));
+	}
+
+	return 0;
+}
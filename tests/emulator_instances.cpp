@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "PICA/regs.hpp"
+#include "emulator.hpp"
+
+// Checks that emulator instances don't share state, by running two ROMs one after the other and then both at once on their own threads.
+// Each ROM is a tiny ARM program that gets the FS and GSP services from srv:, opens a file in its save data, then keeps folding a counter into
+// a hash. Every iteration writes the hash to the file, draws a triangle and reads the hash back into itself, so the service map, the
+// title's save data directory and the GPU's vertex buffers all end up in the results, and any state leaking between instances changes them
+namespace {
+	constexpr u32 codeAddress = 0x00100000;
+	constexpr u32 dataAddress = 0x00100800;    // IPC requests and the buffers they point to
+	constexpr u32 resultAddress = 0x00101000;  // The program writes its hash here, followed by its iteration count
+	constexpr u32 segmentSize = 0x2000;
+	constexpr u32 segmentFileOffset = 0x100;
+	constexpr int frameCount = 30;
+
+	struct RunResult {
+		bool loaded = false;
+		u32 hash = 0;
+		u32 iterations = 0;
+
+		bool operator==(const RunResult& other) const = default;
+	};
+
+	struct Program {
+		std::vector<u32> code;
+		std::vector<u32> data;  // Loaded at dataAddress
+	};
+
+	// The program sends IPC requests by copying them from its data to its command buffer as they are, so they're all built up front.
+	// Offsets into the data are used as ARM immediates and have to stay below 0x400
+	class ProgramData {
+		std::vector<u32> words;
+
+	  public:
+		// Appends the given words and returns their offset from dataAddress
+		u32 add(std::initializer_list<u32> values) {
+			const u32 offset = u32(words.size() * sizeof(u32));
+			words.insert(words.end(), values);
+			return offset;
+		}
+
+		// Service and port names are 8 bytes, padded with zeroes
+		u32 addName(std::string_view name) {
+			std::array<u32, 2> nameWords = {};
+			std::memcpy(nameWords.data(), name.data(), std::min(name.size(), sizeof(nameWords)));
+			return add({nameWords[0], nameWords[1]});
+		}
+
+		static constexpr u32 staticBuffer(u32 size, u32 index) { return (size << 14) | (index << 10) | 2; }
+		static constexpr u32 mappedBuffer(u32 size, bool writable) { return (size << 4) | (writable ? 0xC : 0xA); }
+
+		// srv: GetServiceHandle
+		u32 getServiceHandle(std::string_view name) {
+			const u32 offset = add({0x00050100});
+			addName(name);
+			add({u32(name.size()), 0});
+			return offset;
+		}
+
+		// GSP::GPU WriteHwRegs to consecutive internal PICA registers
+		u32 writeInternalRegs(u32 reg, std::initializer_list<u32> values) {
+			const u32 valuesAddress = dataAddress + add(values);
+			const u32 size = u32(values.size() * sizeof(u32));
+			return add({0x00010082, 0x401000 + reg * 4, size, staticBuffer(size, 0), valuesAddress});
+		}
+
+		std::vector<u32> take() { return std::move(words); }
+	};
+
+	// add rd, rn, #imm, for a multiple of 4 below 0x400 (imm / 4 rotated right by 30)
+	constexpr u32 addImm(u32 rd, u32 rn, u32 imm) { return 0xE2800F00 | (rn << 16) | (rd << 12) | (imm >> 2); }
+	// b/bl from the instruction at index "from" to the one at index "to"
+	constexpr u32 branch(usize from, usize to, bool link) { return (link ? 0xEB000000 : 0xEA000000) | (u32(to - from - 2) & 0xFFFFFF); }
+
+	// hash = hash + (hash << shift) + counter, forever, with the save file and GPU requests in between. The seed has to fit in an ARM immediate
+	Program makeProgram(u8 seed, u32 shift) {
+		using namespace PICA::InternalRegs;
+		ProgramData data;
+
+		const u32 srvPort = data.addName("srv:");
+		const u32 getFS = data.getServiceHandle("fs:USER");
+		const u32 getGSP = data.getServiceHandle("gsp::Gpu");
+		const u32 filePath = data.add({0x0072002F, 0});  // u"/r"
+		const u32 writeBuffer = data.add({0});
+		const u32 readBuffer = data.add({0});
+
+		// FS: FormatThisUserSaveData, then OpenFileDirectly on the SaveData archive (4, empty path) with read/write/create
+		const u32 format = data.add({0x080F0180, 1, 1, 1, 1, 1, 0});
+		const u32 open = data.add(
+			{0x08030204, 0, 4, 1, 0, 4, 6, 7, 0, ProgramData::staticBuffer(0, 0), dataAddress + filePath, ProgramData::staticBuffer(6, 1),
+			 dataAddress + filePath}
+		);
+		// File: Write and Read 4 bytes at offset 0
+		const u32 write = data.add({0x08030102, 0, 0, 4, 0, ProgramData::mappedBuffer(4, false), dataAddress + writeBuffer});
+		const u32 read = data.add({0x080200C2, 0, 0, 4, ProgramData::mappedBuffer(4, true), dataAddress + readBuffer});
+
+		// A triangle list of 3 vertices with a single fixed attribute, through a vertex shader that's just an END
+		const std::array<u32, 4> drawSetup = {
+			data.writeInternalRegs(AttribFormatHigh, {1u << 16}),
+			data.writeInternalRegs(VertexCountReg, {3}),
+			data.writeInternalRegs(VertexShaderInputBufferCfg, {0, 0}),  // One input attribute, entrypoint 0
+			data.writeInternalRegs(VertexShaderTransferIndex, {0, 0x88000000}),
+		};
+		const u32 draw = data.writeInternalRegs(SignalDrawArrays, {1});
+
+		std::vector<u32> code = {
+			0,  // b start, filled in below
+			// request: Copies the IPC request at r1 to the command buffer and sends it to handle r0
+			0xE5912000,  // ldr r2, [r1]
+			0xE1A03322,  // lsr r3, r2, #6
+			0xE203303F,  // and r3, r3, #0x3F
+			0xE202203F,  // and r2, r2, #0x3F
+			0xE0822003,  // add r2, r2, r3
+			0xE3A03000,  // mov r3, #0
+			0xE791C103,  // copy: ldr r12, [r1, r3, lsl #2]
+			0xE784C103,  // str r12, [r4, r3, lsl #2]
+			0xE2833001,  // add r3, r3, #1
+			0xE1530002,  // cmp r3, r2
+			0x9AFFFFFA,  // bls copy
+			0xEF000032,  // svc SendSyncRequest
+			0xE12FFF1E,  // bx lr
+		};
+		constexpr usize requestIndex = 1;
+		code[0] = branch(0, code.size(), false);
+
+		// Sends the request at the given data offset to the handle in register handleReg
+		const auto call = [&](u32 handleReg, u32 offset) {
+			code.push_back(0xE1A00000 | handleReg);  // mov r0, handleReg
+			code.push_back(addImm(1, 5, offset));    // add r1, r5, #offset
+			code.push_back(branch(code.size(), requestIndex, true));
+		};
+
+		code.insert(code.end(), {
+			0xEE1D4F70,             // start: mrc p15, 0, r4, c13, c0, 3
+			0xE2844080,             // add r4, r4, #0x80 (command buffer)
+			0xE3A05601,             // mov r5, #0x100000
+			0xE3855B02,             // orr r5, r5, #0x800 (dataAddress)
+			addImm(1, 5, srvPort),  // add r1, r5, #srvPort
+			0xEF00002D,             // svc ConnectToPort
+			0xE1A06001,             // mov r6, r1
+		});
+
+		call(6, getFS);
+		code.push_back(0xE594700C);  // ldr r7, [r4, #12]
+		call(6, getGSP);
+		code.push_back(0xE594800C);  // ldr r8, [r4, #12]
+		call(7, format);
+		call(7, open);
+		code.push_back(0xE594900C);  // ldr r9, [r4, #12]
+		for (u32 request : drawSetup) {
+			call(8, request);
+		}
+
+		code.push_back(0xE3A0A000 | seed);  // mov r10, #seed
+		code.push_back(0xE3A0B000);         // mov r11, #0
+		const usize loopIndex = code.size();
+		code.insert(code.end(), {
+			0xE08AA00A | (shift << 7),  // loop: add r10, r10, r10, lsl #shift
+			0xE08AA00B,                 // add r10, r10, r11
+			0xE28BB001,                 // add r11, r11, #1
+			0xE585A000 | writeBuffer,   // str r10, [r5, #writeBuffer]
+		});
+		call(9, write);
+		call(8, draw);
+		call(9, read);
+		code.insert(code.end(), {
+			0xE5950000 | readBuffer,                     // ldr r0, [r5, #readBuffer]
+			0xE02AA3E0,                                  // eor r10, r10, r0, ror #7
+			0xE585A000 | (resultAddress - dataAddress),  // str r10, [r5, #0x800]
+			0xE585B004 | (resultAddress - dataAddress),  // str r11, [r5, #0x804]
+		});
+		code.push_back(branch(code.size(), loopIndex, false));
+
+		return {std::move(code), data.take()};
+	}
+
+	template <typename T>
+	void put(std::vector<u8>& buffer, usize offset, T value) {
+		std::memcpy(&buffer[offset], &value, sizeof(T));
+	}
+
+	// Writes a 32-bit ARM ELF with a single RWX segment holding the code and data, loaded at codeAddress
+	std::filesystem::path writeELF(const std::string& name, const Program& program) {
+		constexpr u32 dataOffset = dataAddress - codeAddress;
+		const u32 fileSize = dataOffset + u32(program.data.size() * sizeof(u32));
+		std::vector<u8> elf(segmentFileOffset + fileSize, 0);
+
+		// ELF header
+		const u8 ident[] = {0x7F, 'E', 'L', 'F', 1, 1, 1};  // 32-bit, little endian, version 1
+		std::memcpy(&elf[0], ident, sizeof(ident));
+		put<u16>(elf, 0x10, 2);            // Executable
+		put<u16>(elf, 0x12, 40);           // ARM
+		put<u32>(elf, 0x14, 1);            // Version
+		put<u32>(elf, 0x18, codeAddress);  // Entrypoint
+		put<u32>(elf, 0x1C, 0x34);         // Program header offset
+		put<u32>(elf, 0x24, 0x05000000);   // EABI version 5
+		put<u16>(elf, 0x28, 0x34);         // ELF header size
+		put<u16>(elf, 0x2A, 0x20);         // Program header size
+		put<u16>(elf, 0x2C, 1);            // Program header count
+		put<u16>(elf, 0x2E, 0x28);         // Section header size. We have no sections
+
+		// Program header
+		put<u32>(elf, 0x34, 1);            // Loadable segment
+		put<u32>(elf, 0x38, segmentFileOffset);
+		put<u32>(elf, 0x3C, codeAddress);  // Virtual address
+		put<u32>(elf, 0x40, codeAddress);  // Physical address
+		put<u32>(elf, 0x44, fileSize);     // Size in file
+		put<u32>(elf, 0x48, segmentSize);  // Size in memory, which includes where the program writes its results
+		put<u32>(elf, 0x4C, 7);            // RWX
+		put<u32>(elf, 0x50, 0x1000);       // Alignment
+
+		std::memcpy(&elf[segmentFileOffset], program.code.data(), program.code.size() * sizeof(u32));
+		std::memcpy(&elf[segmentFileOffset + dataOffset], program.data.data(), program.data.size() * sizeof(u32));
+
+		const auto path = std::filesystem::temp_directory_path() / name;
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(elf.data()), std::streamsize(elf.size()));
+		return path;
+	}
+
+	// Catch2 assertions aren't thread-safe, so this only reports what happened and the checks are made on the main thread
+	RunResult runROM(const std::filesystem::path& path) {
+		EmulatorConfig config;
+		config.rendererType = RendererType::Null;
+		config.dspType = Audio::DSPCore::Type::Null;
+		config.audioEnabled = false;
+		config.discordRpcEnabled = false;
+		config.asyncFileIO = false;  // File requests then always take the same emulated time, however busy the host is
+		config.usePortableBuild = true;  // Keep the files of our test titles next to the test binary rather than in the user's app data
+
+		auto emu = std::make_unique<Emulator>(config);
+		RunResult result;
+		result.loaded = emu->loadROM(path);
+		if (!result.loaded) {
+			return result;
+		}
+
+		for (int i = 0; i < frameCount; i++) {
+			emu->runFrame();
+		}
+
+		Memory& mem = emu->getMemory();
+		result.hash = mem.read32(resultAddress);
+		result.iterations = mem.read32(resultAddress + 4);
+		return result;
+	}
+}  // namespace
+
+TEST_CASE("Emulator instances running at once match running alone", "[emulator]") {
+	const auto programA = makeProgram(1, 5);
+	const auto programB = makeProgram(7, 3);
+	const auto pathA = writeELF("alber_instance_test_a.elf", programA);
+	const auto pathB = writeELF("alber_instance_test_b.elf", programB);
+
+	const RunResult aloneA = runROM(pathA);
+	const RunResult aloneB = runROM(pathB);
+	REQUIRE(aloneA.loaded);
+	REQUIRE(aloneB.loaded);
+	REQUIRE(aloneA.iterations != 0);
+	REQUIRE(aloneB.iterations != 0);
+	REQUIRE(aloneA.hash != aloneB.hash);
+
+	RunResult concurrentA, concurrentB;
+	std::thread threadA([&] { concurrentA = runROM(pathA); });
+	std::thread threadB([&] { concurrentB = runROM(pathB); });
+	threadA.join();
+	threadB.join();
+
+	REQUIRE(concurrentA == aloneA);
+	REQUIRE(concurrentB == aloneB);
+
+	std::error_code error;
+	std::filesystem::remove(pathA, error);
+	std::filesystem::remove(pathB, error);
+}
@@ -0,0 +1,134 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "emulator.hpp"
+#include "handle_table.hpp"
+#include "object_pool.hpp"
+
+TEST_CASE("Closed handles stop resolving and their slots get reused", "[kernel]") {
+	HandleTable table;
+	const Handle dummy = table.allocate(KernelObjectType::Dummy).value();
+	const Handle event = table.allocate(KernelObjectType::Event).value();
+	const Handle mutex = table.allocate(KernelObjectType::Mutex).value();
+
+	// Fresh slots hand out their index as the handle
+	REQUIRE(dummy == 0);
+	REQUIRE(event == 1);
+	REQUIRE(mutex == 2);
+	REQUIRE(table.get(event, KernelObjectType::Event) != nullptr);
+	REQUIRE(table.get(event, KernelObjectType::Mutex) == nullptr);
+
+	table.free(event);
+	REQUIRE(table.get(event) == nullptr);
+	REQUIRE(table.freeSlotCount() == 1);
+
+	// The slot comes back with a new generation, so the old handle still doesn't resolve
+	const Handle timer = table.allocate(KernelObjectType::Timer).value();
+	REQUIRE(HandleTable::getIndex(timer) == HandleTable::getIndex(event));
+	REQUIRE(timer != event);
+	REQUIRE(table.get(event) == nullptr);
+	REQUIRE(table.get(timer, KernelObjectType::Timer) != nullptr);
+	REQUIRE(table.slotCount() == 3);
+	REQUIRE(table.liveCount() == 3);
+
+	// Hardcoded handles never resolve to table entries
+	REQUIRE(table.get(0xFFFF8000) == nullptr);
+	REQUIRE(table.get(0xFFFF8001) == nullptr);
+}
+
+TEST_CASE("Creating and closing objects in a loop doesn't grow the table", "[kernel]") {
+	HandleTable table;
+	table.allocate(KernelObjectType::Dummy);
+
+	std::set<Handle> seen;
+	for (int i = 0; i < 100000; i++) {
+		const Handle handle = table.allocate(KernelObjectType::Event).value();
+		// Generations wrap around eventually, but not this soon
+		if (i < 1000) {
+			REQUIRE(seen.insert(handle).second);
+		}
+
+		table.free(handle);
+	}
+
+	REQUIRE(table.slotCount() == 2);
+	REQUIRE(table.liveCount() == 1);
+}
+
+TEST_CASE("Object pools reuse freed objects", "[kernel]") {
+	struct Object {
+		int& liveObjects;
+		int value;
+
+		Object(int& liveObjects, int value) : liveObjects(liveObjects), value(value) { liveObjects++; }
+		~Object() { liveObjects--; }
+	};
+
+	int liveObjects = 0;
+	ObjectPool<Object, 4> pool;
+	std::vector<Object*> objects;
+
+	for (int i = 0; i < 6; i++) {
+		objects.push_back(pool.allocate(liveObjects, i));
+	}
+
+	REQUIRE(liveObjects == 6);
+	REQUIRE(pool.liveObjects() == 6);
+	REQUIRE(pool.capacity() == 8);
+	REQUIRE(objects[5]->value == 5);
+
+	Object* freed = objects[2];
+	pool.free(freed);
+	REQUIRE(liveObjects == 5);
+
+	// The most recently freed object is handed out first, and no new slab is needed
+	Object* reused = pool.allocate(liveObjects, 42);
+	REQUIRE(reused == freed);
+	REQUIRE(reused->value == 42);
+	REQUIRE(pool.capacity() == 8);
+
+	objects[2] = reused;
+	for (Object* object : objects) {
+		pool.free(object);
+	}
+
+	REQUIRE(liveObjects == 0);
+	REQUIRE(pool.liveObjects() == 0);
+	REQUIRE(pool.reservedBytes() >= 8 * sizeof(Object));
+}
+
+TEST_CASE("Events registered with a service survive the guest closing them", "[kernel]") {
+	EmulatorConfig config;
+	config.rendererType = RendererType::Null;
+	config.dspType = Audio::DSPCore::Type::Null;
+	config.audioEnabled = false;
+	config.discordRpcEnabled = false;
+	config.usePortableBuild = true;
+
+	auto emu = std::make_unique<Emulator>(config);
+	Kernel& kernel = emu->getKernel();
+	Memory& mem = emu->getMemory();
+
+	// DSP::RegisterInterruptEvents(interrupt = 2, pipe = 0, event), sent from the main thread's IPC buffer
+	const Handle event = kernel.giveToGuest(kernel.makeEvent(ResetType::OneShot));
+	const u32 messagePointer = VirtualAddrs::TLSBase + 0x80;
+	mem.write32(messagePointer, 0x00150082);
+	mem.write32(messagePointer + 4, 2);
+	mem.write32(messagePointer + 8, 0);
+	mem.write32(messagePointer + 12, 0);
+	mem.write32(messagePointer + 16, event);
+	emu->getServiceManager().getDSP().handleSyncRequest(messagePointer);
+	REQUIRE(mem.read32(messagePointer + 4) == Result::Success);
+
+	// The DSP service signals the event later on, so closing the guest's handle must not destroy it
+	REQUIRE(kernel.closeHandle(event) == Result::Success);
+	REQUIRE(kernel.getObject(event, KernelObjectType::Event) != nullptr);
+	REQUIRE(kernel.signalEvent(event));
+
+	// Events no service holds onto still get destroyed
+	const Handle unregistered = kernel.giveToGuest(kernel.makeEvent(ResetType::OneShot));
+	REQUIRE(kernel.closeHandle(unregistered) == Result::Success);
+	REQUIRE(kernel.getObject(unregistered) == nullptr);
+}
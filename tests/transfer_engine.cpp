@@ -0,0 +1,127 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+
+#include "PICA/gpu.hpp"
+#include "config.hpp"
+#include "memory.hpp"
+
+// Runs display transfers between linear RGBA8 images in FCRAM on the CPU transfer engine
+namespace {
+	constexpr u32 inputAddr = PhysicalAddrs::FCRAM + 0x10000;
+	constexpr u32 outputAddr = PhysicalAddrs::FCRAM + 0x20000;
+	constexpr u32 imageBytes = 0x1000;
+	constexpr u8 untouched = 0xAA;
+
+	// Flags for linear RGBA8 in, linear RGBA8 out
+	constexpr u32 linearFlags = (1 << 1) | (1 << 5);
+
+	constexpr u32 makeSize(u32 width, u32 height) { return width | (height << 16); }
+	constexpr u32 makeFlags(PICA::Scaling scaling) { return linearFlags | (static_cast<u32>(scaling) << 24); }
+
+	EmulatorConfig makeConfig() {
+		EmulatorConfig config;
+		config.rendererType = RendererType::Null;
+		return config;
+	}
+
+	struct TransferTest {
+		u64 ticks = 0;
+		EmulatorConfig config = makeConfig();
+		Memory mem{ticks, config};
+		GPU gpu{mem, config};
+
+		u8* input() { return mem.getFCRAM() + (inputAddr - PhysicalAddrs::FCRAM); }
+		u8* output() { return mem.getFCRAM() + (outputAddr - PhysicalAddrs::FCRAM); }
+
+		// Sets every channel of every input pixel to value(x, y)
+		template <typename Func>
+		void fillInput(u32 width, u32 height, Func value) {
+			for (u32 y = 0; y < height; y++) {
+				for (u32 x = 0; x < width; x++) {
+					std::memset(&input()[(y * width + x) * 4], value(x, y), 4);
+				}
+			}
+
+			std::memset(output(), untouched, imageBytes);
+		}
+
+		bool outputUntouched() {
+			for (u32 i = 0; i < imageBytes; i++) {
+				if (output()[i] != untouched) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void transfer(u32 inputSize, u32 outputSize, PICA::Scaling scaling) {
+			gpu.getTransferEngine().displayTransfer(inputAddr, outputAddr, inputSize, outputSize, makeFlags(scaling));
+		}
+	};
+}  // namespace
+
+TEST_CASE("Display transfers average the pixels they scale down", "[transfer]") {
+	TransferTest test;
+
+	SECTION("Horizontal scaling") {
+		test.fillInput(16, 2, [](u32 x, u32 y) { return u8(x * 10 + y); });
+		test.transfer(makeSize(16, 2), makeSize(16, 2), PICA::Scaling::X);
+
+		for (u32 y = 0; y < 2; y++) {
+			for (u32 x = 0; x < 8; x++) {
+				const u8 expected = u8(((x * 2) * 10 + y + (x * 2 + 1) * 10 + y) / 2);
+				for (u32 channel = 0; channel < 4; channel++) {
+					REQUIRE(test.output()[(y * 8 + x) * 4 + channel] == expected);
+				}
+			}
+		}
+
+		// Nothing past the 8x2 output is written
+		REQUIRE(test.output()[8 * 2 * 4] == untouched);
+	}
+
+	SECTION("Horizontal and vertical scaling") {
+		test.fillInput(16, 4, [](u32 x, u32 y) { return u8(x * 4 + y * 64); });
+		test.transfer(makeSize(16, 4), makeSize(16, 4), PICA::Scaling::XY);
+
+		for (u32 y = 0; y < 2; y++) {
+			for (u32 x = 0; x < 8; x++) {
+				const u8 expected = u8(x * 8 + y * 128 + 34);
+				for (u32 channel = 0; channel < 4; channel++) {
+					REQUIRE(test.output()[(y * 8 + x) * 4 + channel] == expected);
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("Display transfers reading past their input are rejected", "[transfer]") {
+	TransferTest test;
+	test.fillInput(8, 8, [](u32 x, u32 y) { return u8(x + y * 8); });
+
+	SECTION("Unscaled output taller than the input") {
+		test.transfer(makeSize(8, 8), makeSize(8, 16), PICA::Scaling::None);
+		REQUIRE(test.outputUntouched());
+	}
+
+	SECTION("Unscaled output wider than the input") {
+		test.transfer(makeSize(8, 8), makeSize(16, 8), PICA::Scaling::None);
+		REQUIRE(test.outputUntouched());
+	}
+
+	SECTION("Scaled output covering more than the input") {
+		// 16x16 scaled down to 8x8 needs a 16x16 input
+		test.transfer(makeSize(8, 8), makeSize(16, 16), PICA::Scaling::XY);
+		REQUIRE(test.outputUntouched());
+
+		// Scaled down to 8x8, but every output pixel averages two input pixels horizontally
+		test.transfer(makeSize(8, 8), makeSize(16, 8), PICA::Scaling::X);
+		REQUIRE(test.outputUntouched());
+	}
+
+	SECTION("Matching sizes still go through") {
+		test.transfer(makeSize(8, 8), makeSize(8, 8), PICA::Scaling::None);
+		REQUIRE(test.output()[(7 * 8 + 7) * 4] == 63);
+	}
+}